@@ -12,6 +12,7 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <CommandBufferCache.h>
 
 class Sample_03_Window
     : public ApiWithoutSecrets::OS::TutorialBase
@@ -63,6 +64,8 @@ class Sample_03_Window
     VulkanHolder<vk::Semaphore> mSemaphoreAvailable;
     VulkanHolder<vk::Semaphore> mSemaphoreFinished;
 
+    CommandBufferCache mCommandBufferCache;
+
 public:
     
     bool CheckPhysicalDeviceProperties(const vk::PhysicalDevice & physicalDevice, uint32_t &selected_graphics_queue_family_index, uint32_t &selected_present_queue_family_index)
@@ -632,70 +635,74 @@ public:
         }
         mDevice->resetFences(1, renderingResource.fence.get());
 
-        // Preapare command buffer
+        // Command buffer is recorded again only if something it depends on has changed
+        StateHash stateHash;
+        stateHash.Add(renderingResource.undefinedLayout).Add(mFramebufferExtents.width).Add(mFramebufferExtents.height).Add(*mPipeline).Add(*mVertexBuffer);
         auto& cmdBuffer = renderingResource.commandBuffer;
-        vk::CommandBufferBeginInfo beginInfo;
-        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-        cmdBuffer->begin(beginInfo);
-
-        vk::ImageSubresourceRange range;
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        vk::ImageMemoryBarrier barrierFromPresentToDraw;
-        barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromPresentToDraw.image = renderingResource.imageHandle;
-        barrierFromPresentToDraw.subresourceRange = range;
-        renderingResource.undefinedLayout = false;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
-
-        vk::ClearColorValue targetColor = std::array<float, 4>{ 0.1f, 1.0f, 0.1f, 1.0f };
-        vk::ClearValue clearValue(targetColor);
-
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.setRenderPass(mRenderPass);
-        renderPassInfo.setFramebuffer(renderingResource.framebuffer);
-        renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
-        renderPassInfo.setClearValueCount(1);
-        renderPassInfo.setPClearValues(&clearValue);
-        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
-
-        // Could be static, but let's try dynamic approach
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
-        vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
-        cmdBuffer->setViewport(0, 1, &viewport);
-        cmdBuffer->setScissor(0, 1, &scissor);
-
-        vk::DeviceSize offset = 0;
-        cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-
-        cmdBuffer->draw(4, 1, 0, 0);
-
-        cmdBuffer->endRenderPass();
-
-
-        vk::ImageMemoryBarrier barrierFromDrawToPresent;
-        barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromDrawToPresent.image = renderingResource.imageHandle;
-        barrierFromDrawToPresent.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
-
-        cmdBuffer->end();
+        if (mCommandBufferCache.Begin(imageIdx.value, stateHash.Get())) {
+            // Submitted many times, so no eOneTimeSubmit
+            cmdBuffer->begin(vk::CommandBufferBeginInfo());
+
+            vk::ImageSubresourceRange range;
+            range.aspectMask = vk::ImageAspectFlagBits::eColor;
+            range.baseMipLevel = 0;
+            range.levelCount = 1;
+            range.baseArrayLayer = 0;
+            range.layerCount = 1;
+
+            vk::ImageMemoryBarrier barrierFromPresentToDraw;
+            barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromPresentToDraw.image = renderingResource.imageHandle;
+            barrierFromPresentToDraw.subresourceRange = range;
+            renderingResource.undefinedLayout = false;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+
+            vk::ClearColorValue targetColor = std::array<float, 4>{ 0.1f, 1.0f, 0.1f, 1.0f };
+            vk::ClearValue clearValue(targetColor);
+
+            vk::RenderPassBeginInfo renderPassInfo;
+            renderPassInfo.setRenderPass(mRenderPass);
+            renderPassInfo.setFramebuffer(renderingResource.framebuffer);
+            renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
+            renderPassInfo.setClearValueCount(1);
+            renderPassInfo.setPClearValues(&clearValue);
+            cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
+
+            // Could be static, but let's try dynamic approach
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
+            vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
+            cmdBuffer->setViewport(0, 1, &viewport);
+            cmdBuffer->setScissor(0, 1, &scissor);
+
+            vk::DeviceSize offset = 0;
+            cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
+
+            cmdBuffer->draw(4, 1, 0, 0);
+
+            cmdBuffer->endRenderPass();
+
+
+            vk::ImageMemoryBarrier barrierFromDrawToPresent;
+            barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromDrawToPresent.image = renderingResource.imageHandle;
+            barrierFromDrawToPresent.subresourceRange = range;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+
+            cmdBuffer->end();
+            mCommandBufferCache.End();
+        }
 
         // Submit
         vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eTransfer;
@@ -15,6 +15,12 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
+#include <MeshFile.h>
+#include <MeshOptimizer.h>
+#include <VertexPacking.h>
+#include <GpuTimer.h>
+#include <CommandBufferCache.h>
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
 #include <math/OgreMatrix4.h>
@@ -28,12 +34,6 @@ class Sample_03_Window
         Ogre::Vector4 normal;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
-
     struct RenderingResource
     {
         vk::Image imageHandle;
@@ -63,6 +63,11 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
+
+    bool mPackVertexes = false;
+    VertexPackingOptions mVertexPacking;
+    PackedVertexDecode mVertexDecode;
 
     VulkanHolder<vk::CommandPool> mCommandPool;
 
@@ -79,48 +84,8 @@ class Sample_03_Window
     VulkanHolder<vk::Semaphore> mSemaphoreAvailable;
     VulkanHolder<vk::Semaphore> mSemaphoreFinished;
 
-    static Mesh GenerateSphere(const float radius, const uint16_t rings, const uint16_t segments)
-    {
-        assert(rings > 1);
-        assert(segments > 2);
-
-        Mesh sphere;
-
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        const float deltaRingAngle = static_cast<float>(M_PI / rings);
-        const float deltaSegAngle  = static_cast<float>(2.0 * M_PI / segments);
-        uint16_t verticeIndex = 0;
-
-        // Generate the group of rings for the sphere
-        for (uint16_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
-            float r0 = radius * std::sin(ringIdx * deltaRingAngle);
-            float y0 = radius * std::cos(ringIdx * deltaRingAngle);
-            // Generate the group of segments for the current ring
-            for (uint16_t segIdx = 0; segIdx <= segments; ++segIdx) {
-                float x0 = r0 * std::sin(segIdx * deltaSegAngle);
-                float z0 = r0 * std::cos(segIdx * deltaSegAngle);
-
-                VertexData vertex;
-                vertex.position = Ogre::Vector4(x0, y0, z0, 1.0f);
-                vertex.normal   = Ogre::Vector4(Ogre::Vector3(x0, y0, z0).normalisedCopy());
-                sphere.vertexes.push_back(vertex);
-
-                if (ringIdx != rings) {
-                    // each vertex (except the last) has six indicies pointing to it
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    sphere.indexes.push_back(verticeIndex + segments);
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    ++verticeIndex;
-                }
-            }
-        }
-        return sphere;
-    }
+    CommandBufferCache mCommandBufferCache;
+    GpuTimer mDrawTimer;
 
 public:
 
@@ -194,8 +159,28 @@ public:
         return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
     }
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    /**
+     * Load shader module from glsl source file
+     */
+    VulkanHolder<vk::ShaderModule> LoadShaderFromSourceFile(const std::string & filename)
     {
+        auto code = GetBinaryShaderFromSourceFile(filename);
+        if (code.empty()) {
+            throw std::runtime_error("LoadShader: Failed to read shader file!");
+        }
+        vk::ShaderModuleCreateInfo shaderInfo;
+        shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+        shaderInfo.setCodeSize(code.size());
+
+        return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+    }
+
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, uint32_t rings, bool optimizeMesh,
+        bool packVertexes, PositionPacking positionPacking, const std::string & meshPath)
+        : mPackVertexes(packVertexes)
+    {
+        mVertexPacking.position = positionPacking;
+
         vk::ApplicationInfo applicationInfo;
         applicationInfo.pApplicationName = "Vulkan sample: Window";
         applicationInfo.pEngineName = "Vulkan";
@@ -489,7 +474,7 @@ public:
         */
 
         std::cout << "Loading vertex shader... ";
-        mVertexShader = LoadShader(QUOTE(SHADERS_DIR) "/spv/07.vert.spv");
+        mVertexShader = mPackVertexes ? LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/07.packed.vert") : LoadShader(QUOTE(SHADERS_DIR) "/spv/07.vert.spv");
         std::cout << "OK" << std::endl;
 
         std::cout << "Loading fragment shader... ";
@@ -517,11 +502,14 @@ public:
 
             vk::VertexInputBindingDescription inputBindingInfo;
             inputBindingInfo.setBinding(0);
-            inputBindingInfo.setStride(sizeof(VertexData));
+            inputBindingInfo.setStride(mPackVertexes ? VertexPacking::GetStride(mVertexPacking) : sizeof(VertexData));
             inputBindingInfo.setInputRate(vk::VertexInputRate::eVertex); // consumed per vertex
 
             std::vector<vk::VertexInputAttributeDescription> attributeInfos;
-            {
+            if (mPackVertexes) {
+                attributeInfos = VertexPacking::GetAttributes(mVertexPacking, inputBindingInfo.binding);
+            }
+            else {
                 // Position
                 vk::VertexInputAttributeDescription attr;
                 attr.setLocation(0);
@@ -529,13 +517,9 @@ public:
                 attr.setFormat(vk::Format::eR32G32B32A32Sfloat);
                 attr.setOffset(offsetof(VertexData, position));
                 attributeInfos.push_back(attr);
-            }
-            {
+
                 // Normal
-                vk::VertexInputAttributeDescription attr;
                 attr.setLocation(1);
-                attr.setBinding(inputBindingInfo.binding);
-                attr.setFormat(vk::Format::eR32G32B32A32Sfloat);
                 attr.setOffset(offsetof(VertexData, normal));
                 attributeInfos.push_back(attr);
             }
@@ -581,7 +565,14 @@ public:
             blendingInfo.setAttachmentCount(1);
             blendingInfo.setPAttachments(&colorAttachmentBlending);
 
+            // Decoding parameters of packed positions
+            vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(PackedVertexDecode));
+
             vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            if (mPackVertexes) {
+                pipelineLayoutInfo.setPushConstantRangeCount(1);
+                pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
+            }
             mPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
 
             vk::GraphicsPipelineCreateInfo grapichsPipelineInfo;
@@ -602,12 +593,65 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        // Blobs of a mesh file go from the mapped file to the buffers as is, unless the mesh is optimized or packed first
+        MeshFile meshFile;
+        IndexedMesh<VertexData> mesh;
+        const bool copyMeshFile = !meshPath.empty() && !optimizeMesh && !packVertexes;
+        if (!meshPath.empty()) {
+            std::cout << "Load mesh...";
+            meshFile.Open(meshPath);
+            meshFile.CheckVertexType<VertexData>();
+            if (!copyMeshFile) {
+                mesh = meshFile.Load<VertexData>();
+            }
+        }
+        else {
+            std::cout << "Generate mesh...";
+            mesh = MeshBuilder::GenerateSphere<VertexData>(0.5f, rings, rings, 1.0f);
+        }
+        if (copyMeshFile) {
+            std::cout << "OK" << std::endl;
+            std::cout << "Mesh: " << meshFile.GetLods()[0].indexesCount / 3 << " triangles, " << meshFile.GetHeader().vertexesCount << " vertexes" << std::endl;
+        }
+        else {
+            VertexCacheStatistics cacheBefore, cacheAfter;
+            if (optimizeMesh) {
+                MeshOptimizer::Optimize(mesh, cacheBefore, cacheAfter);
+            }
+            else {
+                cacheBefore = cacheAfter = MeshOptimizer::AnalyzeVertexCache(mesh.GetIndexes(), static_cast<uint32_t>(mesh.vertexes.size()));
+            }
+            std::cout << "OK" << std::endl;
+            std::cout << "Mesh: " << mesh.GetIndexesCount() / 3 << " triangles, " << mesh.vertexes.size() << " vertexes, ACMR = " << cacheBefore.acmr << " -> " << cacheAfter.acmr
+                << ", ATVR = " << cacheBefore.atvr << " -> " << cacheAfter.atvr << std::endl;
+        }
+
+        PackedVertexes packedVertexes;
+        if (mPackVertexes) {
+            packedVertexes = VertexPacking::Pack(mesh.vertexes, mVertexPacking);
+            mVertexDecode = packedVertexes.decode;
+            std::cout << "Packed vertexes: " << packedVertexes.stride << " bytes per vertex instead of " << sizeof(VertexData) << ", vertex buffer "
+                << packedVertexes.data.size() << " bytes instead of " << mesh.GetVertexesSize() << std::endl;
+        }
+
         std::cout << "Prepare vertex buffer...";
         {
-            auto mesh = GenerateSphere(0.5f, 32, 32);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
-            const uint32_t vertexBufferSize  = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size()  * sizeof(decltype(mesh.indexes)::value_type));
+            mIndexesNumber = copyMeshFile ? meshFile.GetLods()[0].indexesCount : mesh.GetIndexesCount();
+            mIndexType = copyMeshFile ? meshFile.GetIndexType() : mesh.indexType;
+            uint32_t vertexBufferSize  = mesh.GetVertexesSize();
+            const void* vertexData = mesh.vertexes.data();
+            uint32_t indexesBufferSize = mesh.GetIndexesSize();
+            const void* indexesData = mesh.GetIndexesData();
+            if (mPackVertexes) {
+                vertexBufferSize = static_cast<uint32_t>(packedVertexes.data.size());
+                vertexData = packedVertexes.data.data();
+            }
+            else if (copyMeshFile) {
+                vertexBufferSize = static_cast<uint32_t>(meshFile.GetVertexesSize());
+                vertexData = meshFile.GetVertexes();
+                indexesBufferSize = static_cast<uint32_t>(meshFile.GetLodIndexesSize(0));
+                indexesData = meshFile.GetLodIndexes(0);
+            }
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -649,7 +693,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.vertexes.data(), vertexBufferSize);
+                std::memcpy(devicePtr, vertexData, vertexBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mVertexMemory);
@@ -684,7 +728,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, indexesData, indexesBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mIndexesMemory);
@@ -711,6 +755,8 @@ public:
         mSemaphoreFinished  = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
 
 
+        mDrawTimer.Init(mDevice, mPhysicalDevice, static_cast<uint32_t>(mRenderingResources.size()), "Draw");
+
         CanRender = true;
     }
 
@@ -736,72 +782,83 @@ public:
             return false;
         }
         mDevice->resetFences(1, renderingResource.fence.get());
+        mDrawTimer.Collect(imageIdx.value);
 
 
-        // Preapare command buffer
+        // Command buffer is recorded again only if something it depends on has changed
+        StateHash stateHash;
+        stateHash.Add(renderingResource.undefinedLayout).Add(mFramebufferExtents.width).Add(mFramebufferExtents.height).Add(*mPipeline).Add(*mVertexBuffer).Add(*mIndexesBuffer).Add(mIndexesNumber);
         auto& cmdBuffer = renderingResource.commandBuffer;
-        vk::CommandBufferBeginInfo beginInfo;
-        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-        cmdBuffer->begin(beginInfo);
-
-        vk::ImageSubresourceRange range;
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        vk::ImageMemoryBarrier barrierFromPresentToDraw;
-        barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromPresentToDraw.image = renderingResource.imageHandle;
-        barrierFromPresentToDraw.subresourceRange = range;
-        renderingResource.undefinedLayout = false;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
-
-        vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
-        vk::ClearValue clearValue(targetColor);
-
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.setRenderPass(mRenderPass);
-        renderPassInfo.setFramebuffer(renderingResource.framebuffer);
-        renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
-        renderPassInfo.setClearValueCount(1);
-        renderPassInfo.setPClearValues(&clearValue);
-        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
-
-        // Could be static, but let's try dynamic approach
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
-        vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
-        cmdBuffer->setViewport(0, 1, &viewport);
-        cmdBuffer->setScissor(0, 1, &scissor);
-
-        vk::DeviceSize offset = 0;
-        cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
-
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
-
-        cmdBuffer->endRenderPass();
-
-        vk::ImageMemoryBarrier barrierFromDrawToPresent;
-        barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromDrawToPresent.image = renderingResource.imageHandle;
-        barrierFromDrawToPresent.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
-
-        cmdBuffer->end();
+        if (mCommandBufferCache.Begin(imageIdx.value, stateHash.Get())) {
+            // Submitted many times, so no eOneTimeSubmit
+            cmdBuffer->begin(vk::CommandBufferBeginInfo());
+
+            vk::ImageSubresourceRange range;
+            range.aspectMask = vk::ImageAspectFlagBits::eColor;
+            range.baseMipLevel = 0;
+            range.levelCount = 1;
+            range.baseArrayLayer = 0;
+            range.layerCount = 1;
+
+            vk::ImageMemoryBarrier barrierFromPresentToDraw;
+            barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromPresentToDraw.image = renderingResource.imageHandle;
+            barrierFromPresentToDraw.subresourceRange = range;
+            renderingResource.undefinedLayout = false;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+
+            vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
+            vk::ClearValue clearValue(targetColor);
+
+            vk::RenderPassBeginInfo renderPassInfo;
+            renderPassInfo.setRenderPass(mRenderPass);
+            renderPassInfo.setFramebuffer(renderingResource.framebuffer);
+            renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
+            renderPassInfo.setClearValueCount(1);
+            renderPassInfo.setPClearValues(&clearValue);
+            mDrawTimer.Reset(*cmdBuffer, imageIdx.value);
+            cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
+
+            // Could be static, but let's try dynamic approach
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
+            vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
+            cmdBuffer->setViewport(0, 1, &viewport);
+            cmdBuffer->setScissor(0, 1, &scissor);
+
+            vk::DeviceSize offset = 0;
+            cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
+            cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
+            if (mPackVertexes) {
+                cmdBuffer->pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(PackedVertexDecode), &mVertexDecode);
+            }
+
+            mDrawTimer.Begin(*cmdBuffer, imageIdx.value);
+            cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+            mDrawTimer.End(*cmdBuffer, imageIdx.value);
+
+            cmdBuffer->endRenderPass();
+
+            vk::ImageMemoryBarrier barrierFromDrawToPresent;
+            barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromDrawToPresent.image = renderingResource.imageHandle;
+            barrierFromDrawToPresent.subresourceRange = range;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+
+            cmdBuffer->end();
+            mCommandBufferCache.End();
+        }
 
         // Submit
         vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eTransfer;
@@ -818,6 +875,7 @@ public:
             std::cout << "Failed to submit command! Stoppping." << std::endl;
             return false;
         }
+        mDrawTimer.Submitted(imageIdx.value);
 
         vk::PresentInfoKHR presentInfo;
         presentInfo.waitSemaphoreCount = 1;
@@ -843,9 +901,38 @@ public:
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
+        // Pass --rings N to change the sphere tessellation and --optimize to reorder it for the vertex cache and overdraw
+        // --packed and --packed-half select compressed vertexes with unorm16 or half positions
+        // --mesh file.mesh draws a mesh made by MeshConverter instead of the sphere
+        uint32_t rings = 32;
+        bool optimizeMesh = false;
+        bool packVertexes = false;
+        PositionPacking positionPacking = PositionPacking::Unorm16;
+        std::string meshPath;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (arg == "--rings" && i + 1 < argc) {
+                rings = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--optimize") {
+                optimizeMesh = true;
+            }
+            else if (arg == "--packed") {
+                packVertexes = true;
+                positionPacking = PositionPacking::Unorm16;
+            }
+            else if (arg == "--packed-half") {
+                packVertexes = true;
+                positionPacking = PositionPacking::Half;
+            }
+            else if (arg == "--mesh" && i + 1 < argc) {
+                meshPath = argv[++i];
+            }
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("07 - Simple shading", 512, 512)) {
@@ -853,7 +940,7 @@ int main()
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, rings, optimizeMesh, packVertexes, positionPacking, meshPath);
         if (!window.RenderingLoop(application)) {
             return -1;
         }
@@ -15,6 +15,8 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
+#include <CommandBufferCache.h>
 
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
@@ -31,12 +33,6 @@ class Sample_03_Window
         Ogre::Vector4 normal;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
-
     struct VertexUniformBuffer
     {
         Ogre::Matrix4 modelView  = Ogre::Matrix4::IDENTITY;
@@ -76,6 +72,7 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
     VulkanHolder<vk::Buffer> mMatrixesBuffer;
     VulkanHolder<vk::DeviceMemory> mMatrixesMemory;
@@ -95,6 +92,8 @@ class Sample_03_Window
     VulkanHolder<vk::Semaphore> mSemaphoreAvailable;
     VulkanHolder<vk::Semaphore> mSemaphoreFinished;
 
+    CommandBufferCache mCommandBufferCache;
+
     VertexUniformBuffer mMatrixes;
     Ogre::Vector3 mPosition;
 
@@ -104,56 +103,6 @@ class Sample_03_Window
     Ogre::Quaternion mRotationX;
     Ogre::Quaternion mRotationY;
 
-    static Mesh GenerateCube(const float size)
-    {
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        Mesh cube;
-        const float halfSize = size / 2.0f;
-
-        // front side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f )} );
-        // back side  
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f )} );
-        // left side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f )} );
-        // right side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f )} );
-        // up side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f )} );
-        // down side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f )} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f )} );
-
-        cube.indexes = { /* front */   0,  1,  2,    0,  2,  3,
-                         /* back  */   4,  5,  6,    4,  6,  7,  
-                         /* left  */   8,  9, 10,    8, 10, 11,
-                         /* right */  12, 13, 14,   12, 14, 15, 
-                         /* up    */  16, 17, 18,   16, 18, 19,  
-                         /* down */   20, 21, 22,   20, 22, 23 
-        };
-
-        return cube;
-    }
-
 public:
 
     bool CheckPhysicalDeviceProperties(const vk::PhysicalDevice & physicalDevice, uint32_t &selected_graphics_queue_family_index, uint32_t &selected_present_queue_family_index)
@@ -667,10 +616,11 @@ public:
 
         std::cout << "Prepare vertex buffer...";
         {
-            auto mesh = GenerateCube(1.0f);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+            auto mesh = MeshBuilder::GenerateCube<VertexData>(1.0f);
+            mIndexesNumber = mesh.GetIndexesCount();
+            mIndexType = mesh.indexType;
             const uint32_t vertexBufferSize  = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size()  * sizeof(decltype(mesh.indexes)::value_type));
+            const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -747,7 +697,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mIndexesMemory);
@@ -856,56 +806,6 @@ public:
         mDevice->resetFences(1, renderingResource.fence.get());
 
 
-        // Prepare command buffer
-        auto& cmdBuffer = renderingResource.commandBuffer;
-        vk::CommandBufferBeginInfo beginInfo;
-        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-        cmdBuffer->begin(beginInfo);
-
-        vk::ImageSubresourceRange range;
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-
-        vk::ImageMemoryBarrier barrierFromPresentToDraw;
-        barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromPresentToDraw.image = renderingResource.imageHandle;
-        barrierFromPresentToDraw.subresourceRange = range;
-        renderingResource.undefinedLayout = false;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
-        
-
-        vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
-        vk::ClearValue clearValue(targetColor);
-
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.setRenderPass(mRenderPass);
-        renderPassInfo.setFramebuffer(renderingResource.framebuffer);
-        renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
-        renderPassInfo.setClearValueCount(1);
-        renderPassInfo.setPClearValues(&clearValue);
-        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
-
-        // Could be static, but let's try dynamic approach
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
-        vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
-        cmdBuffer->setViewport(0, 1, &viewport);
-        cmdBuffer->setScissor(0, 1, &scissor);
-
-        vk::DeviceSize offset = 0;
-        cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
-
         // Update matrixes
         mPosition = Ogre::Vector3(0.0f, 0.0f, -3.0f);
         Ogre::Quaternion currentOrientation = mRotationY * mRotationX * mDefaultOrientation;
@@ -919,25 +819,79 @@ public:
         std::memcpy(devicePtr, &mMatrixes, sizeof(mMatrixes));
         mDevice->unmapMemory(mMatrixesMemory);
 
-        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
-
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
-
-        cmdBuffer->endRenderPass();
+        // Command buffer is recorded again only if something it depends on has changed
+        StateHash stateHash;
+        stateHash.Add(renderingResource.undefinedLayout).Add(mFramebufferExtents.width).Add(mFramebufferExtents.height).Add(*mPipeline).Add(*mVertexBuffer).Add(*mIndexesBuffer).Add(mIndexesNumber).Add(*mDescriptorSet);
+        auto& cmdBuffer = renderingResource.commandBuffer;
+        if (mCommandBufferCache.Begin(imageIdx.value, stateHash.Get())) {
+            // Submitted many times, so no eOneTimeSubmit
+            cmdBuffer->begin(vk::CommandBufferBeginInfo());
+
+            vk::ImageSubresourceRange range;
+            range.aspectMask = vk::ImageAspectFlagBits::eColor;
+            range.baseMipLevel = 0;
+            range.levelCount = 1;
+            range.baseArrayLayer = 0;
+            range.layerCount = 1;
+
+
+            vk::ImageMemoryBarrier barrierFromPresentToDraw;
+            barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLayout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromPresentToDraw.image = renderingResource.imageHandle;
+            barrierFromPresentToDraw.subresourceRange = range;
+            renderingResource.undefinedLayout = false;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+        
 
-        if (mQueueFamilyPresent != mQueueFamilyGraphics) {
-            vk::ImageMemoryBarrier barrierFromDrawToPresent;
-            barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-            barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-            barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
-            barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-            barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
-            barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromDrawToPresent.image = renderingResource.imageHandle;
-            barrierFromDrawToPresent.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+            vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
+            vk::ClearValue clearValue(targetColor);
+
+            vk::RenderPassBeginInfo renderPassInfo;
+            renderPassInfo.setRenderPass(mRenderPass);
+            renderPassInfo.setFramebuffer(renderingResource.framebuffer);
+            renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
+            renderPassInfo.setClearValueCount(1);
+            renderPassInfo.setPClearValues(&clearValue);
+            cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
+
+            // Could be static, but let's try dynamic approach
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
+            vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
+            cmdBuffer->setViewport(0, 1, &viewport);
+            cmdBuffer->setScissor(0, 1, &scissor);
+
+            vk::DeviceSize offset = 0;
+            cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
+            cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
+
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
+
+            cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+
+            cmdBuffer->endRenderPass();
+
+            if (mQueueFamilyPresent != mQueueFamilyGraphics) {
+                vk::ImageMemoryBarrier barrierFromDrawToPresent;
+                barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+                barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+                barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
+                barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
+                barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
+                barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
+                barrierFromDrawToPresent.image = renderingResource.imageHandle;
+                barrierFromDrawToPresent.subresourceRange = range;
+                cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+            }
+            cmdBuffer->end();
+            mCommandBufferCache.End();
         }
-        cmdBuffer->end();
 
         // Submit
         vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eTransfer;
@@ -15,6 +15,10 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
+#include <MeshFile.h>
+#include <CommandBufferCache.h>
+#include <BindlessTextures.h>
 
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
@@ -32,12 +36,6 @@ class Sample_03_Window
         Ogre::Vector2 texcoord;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
-
     struct VertexUniformBuffer
     {
         Ogre::Matrix4 modelView  = Ogre::Matrix4::IDENTITY;
@@ -54,6 +52,20 @@ class Sample_03_Window
         bool undefinedLaout;
     };
 
+    struct TextureResource
+    {
+        vk::Extent3D extents;
+        VulkanHolder<vk::Image> stagingImage;
+        VulkanHolder<vk::DeviceMemory> stagingImageMemory;
+        VulkanHolder<vk::Image> image;
+        VulkanHolder<vk::DeviceMemory> imageMemory;
+        VulkanHolder<vk::ImageView> view;
+    };
+
+    // Textures of the cube faces in bindless mode
+    static constexpr uint32_t CUBE_FACES = 6;
+    static constexpr uint32_t FACE_INDEXES = 6;
+
     VulkanHolder<vk::Instance> mVulkan;
     VulkanHolder<vk::Device> mDevice;
     VulkanHolder<vk::SurfaceKHR> mSurface;
@@ -77,6 +89,7 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
     VulkanHolder<vk::Buffer> mMatrixesBuffer;
     VulkanHolder<vk::DeviceMemory> mMatrixesMemory;
@@ -96,6 +109,8 @@ class Sample_03_Window
     VulkanHolder<vk::Semaphore> mSemaphoreAvailable;
     VulkanHolder<vk::Semaphore> mSemaphoreFinished;
 
+    CommandBufferCache mCommandBufferCache;
+
     VertexUniformBuffer mMatrixes;
     Ogre::Vector3 mPosition;
 
@@ -105,110 +120,17 @@ class Sample_03_Window
     Ogre::Quaternion mRotationX;
     Ogre::Quaternion mRotationY;
 
-    vk::Extent3D mTextureExtents;
-
-    VulkanHolder<vk::Image> mStagingImage;
-    VulkanHolder<vk::DeviceMemory> mStagingImageMemory;
-
-    VulkanHolder<vk::Image> mTextureImage;
-    VulkanHolder<vk::DeviceMemory> mTextureImageMemory;
-    VulkanHolder<vk::ImageView> mTextureView;
+    std::vector<TextureResource> mTextures;
     VulkanHolder<vk::Sampler> mTextureSampler;
 
-    bool mFirstDraw = true;
+    // Bindless mode: all textures are in one table, each face of the cube is drawn with own texture index
+    bool mBindless;
+    BindlessTextures mBindlessTextures;
+    std::array<uint32_t, CUBE_FACES> mFaceTextures;
+    // A loaded mesh has no faces and is drawn at once with the first texture
+    uint32_t mBindlessDraws = CUBE_FACES;
 
-    static Mesh GenerateCube(const float size)
-    {
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        Mesh cube;
-        const float halfSize = size / 2.0f;
-
-        // front side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-        // back side  
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f, -1.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-        // left side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-        // right side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 1.0f,  0.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-        // up side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f,  1.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-        // down side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 1.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(  halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f, -1.0f,  0.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
-
-        cube.indexes = { /* front */   0,  1,  2,    0,  2,  3,
-                         /* back  */   4,  5,  6,    4,  6,  7,  
-                         /* left  */   8,  9, 10,    8, 10, 11,
-                         /* right */  12, 13, 14,   12, 14, 15, 
-                         /* up    */  16, 17, 18,   16, 18, 19,  
-                         /* down */   20, 21, 22,   20, 22, 23 
-        };
-
-        return cube;
-    }
-
-    static Mesh GenerateSphere(const float radius, const uint16_t rings, const uint16_t segments)
-    {
-        assert(rings > 1);
-        assert(segments > 2);
-
-        Mesh sphere;
-
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        const float deltaRingAngle = static_cast<float>(M_PI / rings);
-        const float deltaSegAngle = static_cast<float>(2.0 * M_PI / segments);
-        uint16_t verticeIndex = 0;
-
-        // Generate the group of rings for the sphere
-        for (uint16_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
-            float r0 = radius * std::sin(ringIdx * deltaRingAngle);
-            float y0 = radius * std::cos(ringIdx * deltaRingAngle);
-            // Generate the group of segments for the current ring
-            for (uint16_t segIdx = 0; segIdx <= segments; ++segIdx) {
-                float x0 = r0 * std::sin(segIdx * deltaSegAngle);
-                float z0 = r0 * std::cos(segIdx * deltaSegAngle);
-
-                VertexData vertex;
-                vertex.position = Ogre::Vector4(x0, y0, z0, 1.0f);
-                vertex.normal = Ogre::Vector4(Ogre::Vector3(x0, y0, z0).normalisedCopy());
-                sphere.vertexes.push_back(vertex);
-
-                if (ringIdx != rings) {
-                    // each vertex (except the last) has six indicies pointing to it
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    sphere.indexes.push_back(verticeIndex + segments);
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    ++verticeIndex;
-                }
-            }
-        }
-        return sphere;
-    }
+    bool mFirstDraw = true;
 
 public:
 
@@ -282,12 +204,30 @@ public:
         return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
     }
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    /**
+     * Load shader module from glsl source file
+     */
+    VulkanHolder<vk::ShaderModule> LoadShaderFromSourceFile(const std::string & filename)
+    {
+        auto code = GetBinaryShaderFromSourceFile(filename);
+        if (code.empty()) {
+            throw std::runtime_error("LoadShader: Failed to read shader file!");
+        }
+        vk::ShaderModuleCreateInfo shaderInfo;
+        shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+        shaderInfo.setCodeSize(code.size());
+
+        return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+    }
+
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, bool bindless, const std::string & meshPath)
+        : mBindless(bindless)
     {
         vk::ApplicationInfo applicationInfo;
         applicationInfo.pApplicationName = "Vulkan sample: Window";
         applicationInfo.pEngineName = "Vulkan";
-        applicationInfo.apiVersion = VK_MAKE_VERSION(1, 0, 0);
+        // Descriptor indexing needs features and properties queries of Vulkan 1.1
+        applicationInfo.apiVersion = mBindless ? VK_MAKE_VERSION(1, 1, 0) : VK_MAKE_VERSION(1, 0, 0);
         applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 
@@ -353,6 +293,12 @@ public:
 
         std::cout << "Check device extensions...";
         std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        if (mBindless) {
+            if (!BindlessTextures::IsSupported(mPhysicalDevice)) {
+                throw std::runtime_error("Device doesn't support descriptor indexing, run without --bindless");
+            }
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
         CheckDeviceExtensions(mPhysicalDevice, deviceExtensions);
         std::cout << "OK" << std::endl;
 
@@ -369,12 +315,18 @@ public:
         vk::PhysicalDeviceFeatures features;
         features.setSamplerAnisotropy(VK_TRUE);
 
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+        if (mBindless) {
+            BindlessTextures::EnableFeatures(features, indexingFeatures);
+        }
+
         vk::DeviceCreateInfo deviceCreateInfo;
         deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
         deviceCreateInfo.ppEnabledExtensionNames = &deviceExtensions[0];
         deviceCreateInfo.queueCreateInfoCount = 1;
         deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
         deviceCreateInfo.pEnabledFeatures = &features;
+        deviceCreateInfo.pNext = mBindless ? &indexingFeatures : nullptr;
         mDevice = mPhysicalDevice.createDevice(deviceCreateInfo);
         mDevice->waitIdle();
         std::cout << "OK" << std::endl;
@@ -577,7 +529,7 @@ public:
         std::cout << "OK" << std::endl;
 
         std::cout << "Loading fragment shader... ";
-        mFragmentShader = LoadShader(QUOTE(SHADERS_DIR) "/spv/09.frag.spv");
+        mFragmentShader = mBindless ? LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/09.bindless.frag") : LoadShader(QUOTE(SHADERS_DIR) "/spv/09.frag.spv");
         std::cout << "OK" << std::endl;
 
         std::cout << "Create descriptors set... ";
@@ -593,8 +545,9 @@ public:
             bindings[1].setDescriptorCount(1);
             bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
+            // In bindless mode the texture is taken from the global table
             vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
-            descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+            descriptorSetInfo.setBindingCount(mBindless ? 1 : static_cast<uint32_t>(bindings.size()));
             descriptorSetInfo.setPBindings(&bindings[0]);
 
             mDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
@@ -624,6 +577,10 @@ public:
                 throw std::runtime_error("Failed to allocate descriptors set");
             }
             mDescriptorSet = MakeHolder(decriptorSet, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
+
+            if (mBindless) {
+                mBindlessTextures.Init(mDevice, mPhysicalDevice, 1024, vk::ShaderStageFlagBits::eFragment);
+            }
             std::cout << "OK" << std::endl;
         }
 
@@ -721,9 +678,17 @@ public:
             blendingInfo.setAttachmentCount(1);
             blendingInfo.setPAttachments(&colorAttachmentBlending);
 
+            // Bindless: set 1 is the textures table, the texture index is pushed per draw
+            std::array<vk::DescriptorSetLayout, 2> setLayouts = { mDescriptorSetLayout, mBindlessTextures.GetLayout() };
+            vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t));
+
             vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-            pipelineLayoutInfo.setSetLayoutCount(1);
-            pipelineLayoutInfo.setPSetLayouts(mDescriptorSetLayout.get());
+            pipelineLayoutInfo.setSetLayoutCount(mBindless ? 2 : 1);
+            pipelineLayoutInfo.setPSetLayouts(&setLayouts[0]);
+            if (mBindless) {
+                pipelineLayoutInfo.setPushConstantRangeCount(1);
+                pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
+            }
             mPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
 
             vk::GraphicsPipelineCreateInfo grapichsPipelineInfo;
@@ -746,10 +711,20 @@ public:
 
         std::cout << "Prepare vertex buffer...";
         {
-            auto mesh = GenerateCube(1.0f);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+            IndexedMesh<VertexData> mesh;
+            if (!meshPath.empty()) {
+                MeshFile meshFile;
+                meshFile.Open(meshPath);
+                mesh = meshFile.Load<VertexData>();
+                mBindlessDraws = 1;
+            }
+            else {
+                mesh = MeshBuilder::GenerateCube<VertexData>(1.0f);
+            }
+            mIndexesNumber = mesh.GetIndexesCount();
+            mIndexType = mesh.indexType;
             const uint32_t vertexBufferSize  = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size()  * sizeof(decltype(mesh.indexes)::value_type));
+            const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -826,7 +801,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mIndexesMemory);
@@ -880,116 +855,128 @@ public:
             std::cout << "OK" << std::endl;
         }
 
-        std::cout << "Load image...";
+        std::cout << "Load images...";
         {
             // Image is downloaded from http://opengameart.org/content/more-wood-panels-batch-of-16-seamless-textures-with-normalmaps-verywornsjpg 
-            RgbaImage rgbaImage = LoadBmpImage(QUOTE(RESOURCES_DIR) "/09_texture.bmp");
-            if (rgbaImage.pixels.empty()) {
-                throw std::runtime_error("Failed to load texture");
+            std::vector<std::string> files = { QUOTE(RESOURCES_DIR) "/09_texture.bmp" };
+            if (mBindless) {
+                files.push_back(QUOTE(RESOURCES_DIR) "/14_texture.bmp");
+                files.push_back(QUOTE(RESOURCES_DIR) "/16_texture.bmp");
             }
-            mTextureExtents = vk::Extent3D(rgbaImage.width, rgbaImage.height, 1);
-
-            vk::ImageCreateInfo imageInfo;
-            imageInfo.setImageType(vk::ImageType::e2D);
-            imageInfo.setExtent(mTextureExtents);
-            imageInfo.setMipLevels(1);
-            imageInfo.setArrayLayers(1);
-            imageInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
-            imageInfo.setTiling(vk::ImageTiling::eLinear);
-            imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
-            imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc);
-            imageInfo.setSharingMode(vk::SharingMode::eExclusive);
-            imageInfo.setSamples(vk::SampleCountFlagBits::e1);
-            mStagingImage = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
-
-            vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(mStagingImage);
+            mTextures.resize(files.size());
 
-            vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
-            for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
-                if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
-                    (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))) {
+            for (size_t t = 0; t < files.size(); ++t) {
+                TextureResource & texture = mTextures[t];
+                RgbaImage rgbaImage = LoadBmpImage(files[t]);
+                if (rgbaImage.pixels.empty()) {
+                    throw std::runtime_error("Failed to load texture");
+                }
+                texture.extents = vk::Extent3D(rgbaImage.width, rgbaImage.height, 1);
+
+                vk::ImageCreateInfo imageInfo;
+                imageInfo.setImageType(vk::ImageType::e2D);
+                imageInfo.setExtent(texture.extents);
+                imageInfo.setMipLevels(1);
+                imageInfo.setArrayLayers(1);
+                imageInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
+                imageInfo.setTiling(vk::ImageTiling::eLinear);
+                imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
+                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc);
+                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+                texture.stagingImage = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
+
+                vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(texture.stagingImage);
 
-                    vk::MemoryAllocateInfo allocateInfo;
-                    allocateInfo.setAllocationSize(imageMemoryRequirments.size);
-                    allocateInfo.setMemoryTypeIndex(i);
-                    mStagingImageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+                    if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
+                        (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))) {
+
+                        vk::MemoryAllocateInfo allocateInfo;
+                        allocateInfo.setAllocationSize(imageMemoryRequirments.size);
+                        allocateInfo.setMemoryTypeIndex(i);
+                        texture.stagingImageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                    }
                 }
-            }
-            if (!mStagingImageMemory) {
-                throw std::runtime_error("Failed to allocate memory for staging image");
-            }
-            mDevice->bindImageMemory(mStagingImage, mStagingImageMemory, 0);
+                if (!texture.stagingImageMemory) {
+                    throw std::runtime_error("Failed to allocate memory for staging image");
+                }
+                mDevice->bindImageMemory(texture.stagingImage, texture.stagingImageMemory, 0);
 
-            vk::ImageSubresource subres;
-            subres.setMipLevel(0);
-            subres.setArrayLayer(0);
-            subres.setAspectMask(vk::ImageAspectFlagBits::eColor);
+                vk::ImageSubresource subres;
+                subres.setMipLevel(0);
+                subres.setArrayLayer(0);
+                subres.setAspectMask(vk::ImageAspectFlagBits::eColor);
 
-            vk::SubresourceLayout colorLayout = mDevice->getImageSubresourceLayout(mStagingImage, subres);
+                vk::SubresourceLayout colorLayout = mDevice->getImageSubresourceLayout(texture.stagingImage, subres);
 
-            void* imageData = mDevice->mapMemory(mStagingImageMemory, 0, rgbaImage.width * rgbaImage.height * 4);
-            assert(rgbaImage.pixels.size() == rgbaImage.width * rgbaImage.height * 4);
+                void* imageData = mDevice->mapMemory(texture.stagingImageMemory, 0, rgbaImage.width * rgbaImage.height * 4);
+                assert(rgbaImage.pixels.size() == rgbaImage.width * rgbaImage.height * 4);
 
-            if (colorLayout.rowPitch == rgbaImage.width * 4) {
-                std::memcpy(imageData, &rgbaImage.pixels[0], static_cast<size_t>(rgbaImage.width * rgbaImage.height * 4));
-            }
-            else {
-                uint8_t* dataBytes = static_cast<uint8_t*>(imageData);
-                for (uint32_t y = 0; y < rgbaImage.height; y++) {
-                    std::memcpy(&dataBytes[y * colorLayout.rowPitch], &rgbaImage.pixels[y * rgbaImage.width * 4], rgbaImage.width * 4);
+                if (colorLayout.rowPitch == rgbaImage.width * 4) {
+                    std::memcpy(imageData, &rgbaImage.pixels[0], static_cast<size_t>(rgbaImage.width * rgbaImage.height * 4));
+                }
+                else {
+                    uint8_t* dataBytes = static_cast<uint8_t*>(imageData);
+                    for (uint32_t y = 0; y < rgbaImage.height; y++) {
+                        std::memcpy(&dataBytes[y * colorLayout.rowPitch], &rgbaImage.pixels[y * rgbaImage.width * 4], rgbaImage.width * 4);
+                    }
                 }
-            }
 
-            mDevice->unmapMemory(mStagingImageMemory);
+                mDevice->unmapMemory(texture.stagingImageMemory);
+            }
 
             std::cout << "OK" << std::endl;
         }
 
-        std::cout << "Create texture...";
+        std::cout << "Create textures...";
         {
-            vk::ImageCreateInfo imageInfo;
-            imageInfo.setImageType(vk::ImageType::e2D);
-            imageInfo.setExtent(mTextureExtents);
-            imageInfo.setMipLevels(1);
-            imageInfo.setArrayLayers(1);
-            imageInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
-            imageInfo.setTiling(vk::ImageTiling::eOptimal);
-            imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
-            imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
-            imageInfo.setSharingMode(vk::SharingMode::eExclusive);
-            imageInfo.setSamples(vk::SampleCountFlagBits::e1);
-            mTextureImage = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
-
-            vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(mTextureImage);
-            vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
-            for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
-                if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
-                    (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eDeviceLocal))) {
+            for (auto & texture : mTextures) {
+                vk::ImageCreateInfo imageInfo;
+                imageInfo.setImageType(vk::ImageType::e2D);
+                imageInfo.setExtent(texture.extents);
+                imageInfo.setMipLevels(1);
+                imageInfo.setArrayLayers(1);
+                imageInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
+                imageInfo.setTiling(vk::ImageTiling::eOptimal);
+                imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
+                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+                texture.image = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
+
+                vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(texture.image);
+                vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+                    if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
+                        (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eDeviceLocal))) {
 
-                    vk::MemoryAllocateInfo allocateInfo;
-                    allocateInfo.setAllocationSize(imageMemoryRequirments.size);
-                    allocateInfo.setMemoryTypeIndex(i);
-                    mTextureImageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                        vk::MemoryAllocateInfo allocateInfo;
+                        allocateInfo.setAllocationSize(imageMemoryRequirments.size);
+                        allocateInfo.setMemoryTypeIndex(i);
+                        texture.imageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                    }
                 }
+                if (!texture.imageMemory) {
+                    throw std::runtime_error("Failed to allocate memory for staging image");
+                }
+                mDevice->bindImageMemory(texture.image, texture.imageMemory, 0);
+
+                vk::ImageSubresourceRange range;
+                range.setAspectMask(vk::ImageAspectFlagBits::eColor);
+                range.setBaseMipLevel(0);
+                range.setLevelCount(1);
+                range.setBaseArrayLayer(0);
+                range.setLayerCount(1);
+
+                vk::ImageViewCreateInfo viewInfo;
+                viewInfo.setImage(texture.image);
+                viewInfo.setViewType(vk::ImageViewType::e2D);
+                viewInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
+                viewInfo.setSubresourceRange(range);
+                texture.view = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
             }
-            if (!mTextureImageMemory) {
-                throw std::runtime_error("Failed to allocate memory for staging image");
-            }
-            mDevice->bindImageMemory(mTextureImage, mTextureImageMemory, 0);
-
-            vk::ImageSubresourceRange range;
-            range.setAspectMask(vk::ImageAspectFlagBits::eColor);
-            range.setBaseMipLevel(0);
-            range.setLevelCount(1);
-            range.setBaseArrayLayer(0);
-            range.setLayerCount(1);
-
-            vk::ImageViewCreateInfo viewInfo;
-            viewInfo.setImage(mTextureImage);
-            viewInfo.setViewType(vk::ImageViewType::e2D);
-            viewInfo.setFormat(vk::Format::eR8G8B8A8Unorm);
-            viewInfo.setSubresourceRange(range);
-            mTextureView = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
 
             // https://vulkan-tutorial.com/Texture_mapping/Image_view_and_sampler
             vk::SamplerCreateInfo samplerInfo;
@@ -1031,7 +1018,7 @@ public:
 
             vk::DescriptorImageInfo imageInfo;
             imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-            imageInfo.imageView = mTextureView;
+            imageInfo.imageView = mTextures[0].view;
             imageInfo.sampler = mTextureSampler;
 
             writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
@@ -1041,7 +1028,17 @@ public:
             writeDescriptorsInfo[1].setDescriptorCount(1);
             writeDescriptorsInfo[1].setPImageInfo(&imageInfo);
 
-            mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+            mDevice->updateDescriptorSets(mBindless ? 1 : static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+
+            if (mBindless) {
+                std::vector<uint32_t> indexes;
+                for (auto & texture : mTextures) {
+                    indexes.push_back(mBindlessTextures.Add(texture.view, mTextureSampler));
+                }
+                for (uint32_t face = 0; face < CUBE_FACES; ++face) {
+                    mFaceTextures[face] = indexes[face % indexes.size()];
+                }
+            }
             
             std::cout << "OK" << std::endl;
         }
@@ -1084,104 +1081,6 @@ public:
         }
         mDevice->resetFences(1, renderingResource.fence.get());
 
-        // Prepare command buffer
-        auto& cmdBuffer = renderingResource.commandBuffer;
-        vk::CommandBufferBeginInfo beginInfo;
-        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-        cmdBuffer->begin(beginInfo);
-
-        vk::ImageSubresourceRange range;
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        if (mFirstDraw) {
-            vk::ImageMemoryBarrier barrierFromPreinitToTransSrc;
-            barrierFromPreinitToTransSrc.srcAccessMask = vk::AccessFlagBits::eHostWrite;
-            barrierFromPreinitToTransSrc.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-            barrierFromPreinitToTransSrc.oldLayout = vk::ImageLayout::ePreinitialized;
-            barrierFromPreinitToTransSrc.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-            barrierFromPreinitToTransSrc.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransSrc.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransSrc.image = mStagingImage;
-            barrierFromPreinitToTransSrc.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransSrc);
-
-            vk::ImageMemoryBarrier barrierFromPreinitToTransDst;
-            barrierFromPreinitToTransDst.srcAccessMask = vk::AccessFlagBits::eHostWrite;
-            barrierFromPreinitToTransDst.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-            barrierFromPreinitToTransDst.oldLayout = vk::ImageLayout::ePreinitialized;
-            barrierFromPreinitToTransDst.newLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrierFromPreinitToTransDst.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransDst.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransDst.image = mTextureImage;
-            barrierFromPreinitToTransDst.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransDst);
-
-            vk::ImageSubresourceLayers subResource;
-            subResource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-            subResource.setBaseArrayLayer(0);
-            subResource.setMipLevel(0);
-            subResource.setLayerCount(1);
-
-            vk::ImageCopy copyInfo;
-            copyInfo.setSrcSubresource(subResource);
-            copyInfo.setDstSubresource(subResource);
-            copyInfo.setSrcOffset(vk::Offset3D(0, 0, 0));
-            copyInfo.setDstOffset(vk::Offset3D(0, 0, 0));
-            copyInfo.setExtent(mTextureExtents);
-
-            cmdBuffer->copyImage(mStagingImage, vk::ImageLayout::eTransferSrcOptimal, mTextureImage, vk::ImageLayout::eTransferDstOptimal, 1, &copyInfo);
-
-            vk::ImageMemoryBarrier barrierFromTransDstToSampler;
-            barrierFromTransDstToSampler.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-            barrierFromTransDstToSampler.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-            barrierFromTransDstToSampler.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrierFromTransDstToSampler.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-            barrierFromTransDstToSampler.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromTransDstToSampler.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromTransDstToSampler.image = mTextureImage;
-            barrierFromTransDstToSampler.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromTransDstToSampler);
-        }
-
-        vk::ImageMemoryBarrier barrierFromPresentToDraw;
-        barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromPresentToDraw.image = renderingResource.imageHandle;
-        barrierFromPresentToDraw.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
-        renderingResource.undefinedLaout = false;
-
-        vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
-        vk::ClearValue clearValue(targetColor);
-
-        vk::RenderPassBeginInfo renderPassInfo;
-        renderPassInfo.setRenderPass(mRenderPass);
-        renderPassInfo.setFramebuffer(renderingResource.framebuffer);
-        renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
-        renderPassInfo.setClearValueCount(1);
-        renderPassInfo.setPClearValues(&clearValue);
-        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
-
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
-
-        // Could be static, but let's try dynamic approach
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
-        vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
-        cmdBuffer->setViewport(0, 1, &viewport);
-        cmdBuffer->setScissor(0, 1, &scissor);
-
-        vk::DeviceSize offset = 0;
-        cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
-
         // Update matrixes
         mPosition = Ogre::Vector3(0.0f, 0.0f, -3.0f);
         Ogre::Quaternion currentOrientation = mRotationY * mRotationX * mDefaultOrientation;
@@ -1195,24 +1094,140 @@ public:
         std::memcpy(devicePtr, &mMatrixes, sizeof(mMatrixes));
         mDevice->unmapMemory(mMatrixesMemory);
 
-        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
+        // Command buffer is recorded again only if something it depends on has changed
+        StateHash stateHash;
+        stateHash.Add(renderingResource.undefinedLaout).Add(mFramebufferExtents.width).Add(mFramebufferExtents.height).Add(*mPipeline).Add(*mVertexBuffer).Add(*mIndexesBuffer).Add(mIndexesNumber).Add(*mDescriptorSet).Add(mFirstDraw);
+        auto& cmdBuffer = renderingResource.commandBuffer;
+        if (mCommandBufferCache.Begin(imageIdx.value, stateHash.Get())) {
+            // Submitted many times, so no eOneTimeSubmit
+            cmdBuffer->begin(vk::CommandBufferBeginInfo());
+
+            vk::ImageSubresourceRange range;
+            range.aspectMask = vk::ImageAspectFlagBits::eColor;
+            range.baseMipLevel = 0;
+            range.levelCount = 1;
+            range.baseArrayLayer = 0;
+            range.layerCount = 1;
+
+            if (mFirstDraw) {
+                for (auto & texture : mTextures) {
+                    vk::ImageMemoryBarrier barrierFromPreinitToTransSrc;
+                    barrierFromPreinitToTransSrc.srcAccessMask = vk::AccessFlagBits::eHostWrite;
+                    barrierFromPreinitToTransSrc.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+                    barrierFromPreinitToTransSrc.oldLayout = vk::ImageLayout::ePreinitialized;
+                    barrierFromPreinitToTransSrc.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+                    barrierFromPreinitToTransSrc.srcQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromPreinitToTransSrc.dstQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromPreinitToTransSrc.image = texture.stagingImage;
+                    barrierFromPreinitToTransSrc.subresourceRange = range;
+                    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransSrc);
+
+                    vk::ImageMemoryBarrier barrierFromPreinitToTransDst;
+                    barrierFromPreinitToTransDst.srcAccessMask = vk::AccessFlagBits::eHostWrite;
+                    barrierFromPreinitToTransDst.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+                    barrierFromPreinitToTransDst.oldLayout = vk::ImageLayout::ePreinitialized;
+                    barrierFromPreinitToTransDst.newLayout = vk::ImageLayout::eTransferDstOptimal;
+                    barrierFromPreinitToTransDst.srcQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromPreinitToTransDst.dstQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromPreinitToTransDst.image = texture.image;
+                    barrierFromPreinitToTransDst.subresourceRange = range;
+                    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransDst);
+
+                    vk::ImageSubresourceLayers subResource;
+                    subResource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+                    subResource.setBaseArrayLayer(0);
+                    subResource.setMipLevel(0);
+                    subResource.setLayerCount(1);
+
+                    vk::ImageCopy copyInfo;
+                    copyInfo.setSrcSubresource(subResource);
+                    copyInfo.setDstSubresource(subResource);
+                    copyInfo.setSrcOffset(vk::Offset3D(0, 0, 0));
+                    copyInfo.setDstOffset(vk::Offset3D(0, 0, 0));
+                    copyInfo.setExtent(texture.extents);
+
+                    cmdBuffer->copyImage(texture.stagingImage, vk::ImageLayout::eTransferSrcOptimal, texture.image, vk::ImageLayout::eTransferDstOptimal, 1, &copyInfo);
+
+                    vk::ImageMemoryBarrier barrierFromTransDstToSampler;
+                    barrierFromTransDstToSampler.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+                    barrierFromTransDstToSampler.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+                    barrierFromTransDstToSampler.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+                    barrierFromTransDstToSampler.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+                    barrierFromTransDstToSampler.srcQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromTransDstToSampler.dstQueueFamilyIndex = mQueueFamilyPresent;
+                    barrierFromTransDstToSampler.image = texture.image;
+                    barrierFromTransDstToSampler.subresourceRange = range;
+                    cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromTransDstToSampler);
+                }
+            }
 
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+            vk::ImageMemoryBarrier barrierFromPresentToDraw;
+            barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromPresentToDraw.image = renderingResource.imageHandle;
+            barrierFromPresentToDraw.subresourceRange = range;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+            renderingResource.undefinedLaout = false;
+
+            vk::ClearColorValue targetColor = std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f };
+            vk::ClearValue clearValue(targetColor);
+
+            vk::RenderPassBeginInfo renderPassInfo;
+            renderPassInfo.setRenderPass(mRenderPass);
+            renderPassInfo.setFramebuffer(renderingResource.framebuffer);
+            renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
+            renderPassInfo.setClearValueCount(1);
+            renderPassInfo.setPClearValues(&clearValue);
+            cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline);
+
+            // Could be static, but let's try dynamic approach
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
+            vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
+            cmdBuffer->setViewport(0, 1, &viewport);
+            cmdBuffer->setScissor(0, 1, &scissor);
+
+            vk::DeviceSize offset = 0;
+            cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
+            cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
+
+            if (mBindless) {
+                // The table is bound once, faces select own textures with push constants
+                std::array<vk::DescriptorSet, 2> descriptorSets = { mDescriptorSet, mBindlessTextures.GetSet() };
+                cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), &descriptorSets[0], 0, nullptr);
+
+                const uint32_t faceIndexes = (mBindlessDraws == CUBE_FACES) ? FACE_INDEXES : mIndexesNumber;
+                for (uint32_t face = 0; face < mBindlessDraws; ++face) {
+                    cmdBuffer->pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, sizeof(uint32_t), &mFaceTextures[face]);
+                    cmdBuffer->drawIndexed(faceIndexes, 1, face * faceIndexes, 0, 0);
+                }
+            } else {
+                cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
 
-        cmdBuffer->endRenderPass();
+                cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+            }
 
-        vk::ImageMemoryBarrier barrierFromDrawToPresent;
-        barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
-        barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromDrawToPresent.image = renderingResource.imageHandle;
-        barrierFromDrawToPresent.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+            cmdBuffer->endRenderPass();
+
+            vk::ImageMemoryBarrier barrierFromDrawToPresent;
+            barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+            barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+            barrierFromDrawToPresent.oldLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
+            barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
+            barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
+            barrierFromDrawToPresent.image = renderingResource.imageHandle;
+            barrierFromDrawToPresent.subresourceRange = range;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
         
-        cmdBuffer->end();
+            cmdBuffer->end();
+            mCommandBufferCache.End();
+        }
 
         // Submit
         vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eTransfer;
@@ -1278,9 +1293,23 @@ public:
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
+        // Pass --bindless to select textures of the cube faces from the global table with VK_EXT_descriptor_indexing
+        // --mesh file.mesh draws a mesh made by MeshConverter --texcoord instead of the cube
+        bool bindless = false;
+        std::string meshPath;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (arg == "--bindless") {
+                bindless = true;
+            }
+            else if (arg == "--mesh" && i + 1 < argc) {
+                meshPath = argv[++i];
+            }
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("09 - Texture", 512, 512)) {
@@ -1288,7 +1317,7 @@ int main()
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, bindless, meshPath);
         window.SetMouseListener(&application);
         if (!window.RenderingLoop(application)) {
             return -1;
@@ -5,24 +5,56 @@
 * Copyright (c) 2016 Alexey Gruzdev
 */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <limits>
+#include <string>
 #include <thread>
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <ResourceStateTracker.h>
+#include <DescriptorAllocator.h>
+
+/**
+ * Storage format of the heat field
+ * Computations are always made in fp32, the format affects only memory bandwidth
+ */
+enum class HeatPrecision
+{
+    Float32, // r32f
+    Float16  // r16f
+};
 
 class Sample_03_Window
     : public ApiWithoutSecrets::OS::TutorialBase
 {
+    // Error against the fp32 run is measured each ERROR_CHECK_PERIOD steps
+    static const uint32_t ERROR_CHECK_PERIOD = 100;
+    static const uint32_t ERROR_BLOCK_SIZE = 16;
+
+    // Sparse stepping: the grid is split into tiles, only active tiles are dispatched
+    static const uint32_t TILE_SIZE = 16;
+    static const uint32_t TILES_LIST_GROUP_SIZE = 64;
+
+    // Conversion workgroup covers 16x16 invocations with 2x2 pixels each, must match 11.cvt.comp
+    static const uint32_t CONVERSION_TILE_SIZE = 32;
+
+    struct SparseConstants
+    {
+        float threshold;
+        uint32_t tilesX;
+        uint32_t tilesY;
+    };
+
     struct RenderingResource
     {
         vk::Image imageHandle;
         VulkanHolder<vk::ImageView> imageView;
         VulkanHolder<vk::CommandBuffer> commandBuffer;
         VulkanHolder<vk::Fence> fence;
-        VulkanHolder<vk::DescriptorSet> descriptorSet;
         bool undefinedLaout;
     };
 
@@ -45,8 +77,9 @@ class Sample_03_Window
     VulkanHolder<vk::DescriptorSetLayout> mDescriptorSetLayout;
     VulkanHolder<vk::DescriptorSetLayout> mIterationDescriptorSetLayout;
     
-    VulkanHolder<vk::DescriptorPool> mDescriptorPool;
-    VulkanHolder<vk::DescriptorSet> mIterationDescriptorSet;
+    // Sets of ping-pong bindings are taken from the cache, so they are written only on the first use
+    DescriptorAllocator mDescriptorAllocator;
+    DescriptorSetCache mDescriptorCache;
 
     // Conversion
     VulkanHolder<vk::PipelineLayout> mConversionPipelineLayout;
@@ -56,6 +89,46 @@ class Sample_03_Window
     VulkanHolder<vk::PipelineLayout> mIterationPipelineLayout;
     VulkanHolder<vk::Pipeline> mIterationPipeline;
 
+    HeatPrecision mPrecision;
+    vk::Format mHeatFormat;
+    VulkanHolder<vk::ShaderModule> mHeatIterationHalfShader;
+
+    // Error tracking. The fp32 reference is computed alongside the half precision field
+    VulkanHolder<vk::Pipeline> mReferencePipeline;
+
+    VulkanHolder<vk::ShaderModule> mErrorShader;
+    VulkanHolder<vk::DescriptorSetLayout> mErrorDescriptorSetLayout;
+    VulkanHolder<vk::PipelineLayout> mErrorPipelineLayout;
+    VulkanHolder<vk::Pipeline> mErrorPipeline;
+
+    VulkanHolder<vk::Buffer> mErrorBuffer;
+    VulkanHolder<vk::DeviceMemory> mErrorBufferMemory;
+    vk::Extent2D mErrorGroups;
+
+    // Sparse stepping
+    bool mSparse;
+    float mSparseThreshold;
+    vk::Extent2D mTilesCount;
+    VulkanHolder<vk::ShaderModule> mHeatIterationSparseShader;
+    VulkanHolder<vk::ShaderModule> mTilesListShader;
+    VulkanHolder<vk::DescriptorSetLayout> mTilesDescriptorSetLayout;
+    vk::DescriptorSet mTilesDescriptorSet;
+    VulkanHolder<vk::Pipeline> mTilesListPipeline;
+
+    VulkanHolder<vk::Buffer> mChangedTilesBuffer;    // uint per tile
+    VulkanHolder<vk::DeviceMemory> mChangedTilesMemory;
+    VulkanHolder<vk::Buffer> mActiveTilesBuffer;     // compacted list of active tiles indexes
+    VulkanHolder<vk::DeviceMemory> mActiveTilesMemory;
+    VulkanHolder<vk::Buffer> mDispatchArgsBuffer;    // VkDispatchIndirectCommand
+    VulkanHolder<vk::DeviceMemory> mDispatchArgsMemory;
+
+    // Layouts and pending writes of the images used by Draw()
+    ResourceStateTracker mStateTracker;
+
+    VulkanHolder<vk::QueryPool> mQueryPool;
+    float mTimestampPeriod = 1.0f;
+    uint64_t mFrameCounter = 0;
+
     VulkanHolder<vk::CommandPool> mCommandPool;
 
     std::array<ComputeResource, 2> mComputeResources; // ping-pong
@@ -64,6 +137,10 @@ class Sample_03_Window
     VulkanHolder<vk::Image> mInitialImage;
     VulkanHolder<vk::DeviceMemory> mInitialImageMemory;
 
+    std::array<ComputeResource, 2> mReferenceResources; // ping-pong for fp32 reference
+    VulkanHolder<vk::Image> mInitialReferenceImage;
+    VulkanHolder<vk::DeviceMemory> mInitialReferenceImageMemory;
+
     std::vector<RenderingResource> mRenderingResources;
 
     vk::PhysicalDevice mPhysicalDevice;
@@ -152,11 +229,187 @@ public:
         return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
     }
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    /**
+     * Load shader module from glsl source file
+     */
+    VulkanHolder<vk::ShaderModule> LoadShaderFromSourceFile(const std::string & filename, const std::vector<std::string> & defines = {})
+    {
+        auto code = GetBinaryShaderFromSourceFile(filename, defines);
+        if (code.empty()) {
+            throw std::runtime_error("LoadShader: Failed to read shader file!");
+        }
+        vk::ShaderModuleCreateInfo shaderInfo;
+        shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+        shaderInfo.setCodeSize(code.size());
+
+        return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+    }
+
+    /**
+     * Create device local image for the heat field with view and sampler
+     */
+    void CreateComputeResource(ComputeResource & computeResource, vk::Format format)
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.setImageType(vk::ImageType::e2D);
+        imageInfo.setExtent(vk::Extent3D(mComputeImageExtents.width, mComputeImageExtents.height, 1));
+        imageInfo.setMipLevels(1);
+        imageInfo.setArrayLayers(1);
+        imageInfo.setFormat(format);
+        imageInfo.setTiling(vk::ImageTiling::eOptimal);
+        imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
+        imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
+        imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+        imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+
+        computeResource.image = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
+
+        vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(computeResource.image);
+        vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
+                (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eDeviceLocal))) {
+
+                vk::MemoryAllocateInfo allocateInfo;
+                allocateInfo.setAllocationSize(imageMemoryRequirments.size);
+                allocateInfo.setMemoryTypeIndex(i);
+                computeResource.memory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+            }
+        }
+        if (!computeResource.memory) {
+            throw std::runtime_error("Failed to allocate memory for compute image");
+        }
+        mDevice->bindImageMemory(computeResource.image, computeResource.memory, 0);
+
+        vk::ImageSubresourceRange range;
+        range.setAspectMask(vk::ImageAspectFlagBits::eColor);
+        range.setBaseMipLevel(0);
+        range.setLevelCount(1);
+        range.setBaseArrayLayer(0);
+        range.setLayerCount(1);
+
+        vk::ImageViewCreateInfo viewInfo;
+        viewInfo.setImage(computeResource.image);
+        viewInfo.setViewType(vk::ImageViewType::e2D);
+        viewInfo.setFormat(format);
+        viewInfo.setSubresourceRange(range);
+        computeResource.view = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
+
+        // https://vulkan-tutorial.com/Texture_mapping/Image_view_and_sampler
+        vk::SamplerCreateInfo samplerInfo;
+        samplerInfo.setMagFilter(vk::Filter::eLinear);
+        samplerInfo.setMinFilter(vk::Filter::eLinear);
+        samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToBorder);
+        samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToBorder);
+        samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToBorder);
+        samplerInfo.setAnisotropyEnable(VK_FALSE);
+        samplerInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
+        samplerInfo.setUnnormalizedCoordinates(VK_FALSE); // Use [0, 1)
+        samplerInfo.setCompareEnable(VK_FALSE);
+        samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+        samplerInfo.setMipLodBias(0.0f);
+        samplerInfo.setMinLod(0.0f);
+        samplerInfo.setMaxLod(0.0f);
+        computeResource.sampler = MakeHolder(mDevice->createSampler(samplerInfo), [this](vk::Sampler & sampler) { mDevice->destroySampler(sampler); });
+    }
+
+    /**
+     * Create host visible image with the initial heat distribution: hot bottom line
+     */
+    void CreateInitialImage(vk::Format format, VulkanHolder<vk::Image> & image, VulkanHolder<vk::DeviceMemory> & imageMemory)
+    {
+        vk::ImageCreateInfo imageInfo;
+        imageInfo.setImageType(vk::ImageType::e2D);
+        imageInfo.setExtent(vk::Extent3D(mComputeImageExtents.width, mComputeImageExtents.height, 1));
+        imageInfo.setMipLevels(1);
+        imageInfo.setArrayLayers(1);
+        imageInfo.setFormat(format);
+        imageInfo.setTiling(vk::ImageTiling::eLinear);
+        imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
+        imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc);
+        imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+        imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+
+        image = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
+
+        vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(image);
+        vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
+                (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))) {
+
+                vk::MemoryAllocateInfo allocateInfo;
+                allocateInfo.setAllocationSize(imageMemoryRequirments.size);
+                allocateInfo.setMemoryTypeIndex(i);
+                imageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+            }
+        }
+        if (!imageMemory) {
+            throw std::runtime_error("Failed to allocate memory for compute image");
+        }
+        mDevice->bindImageMemory(image, imageMemory, 0);
+
+        vk::ImageSubresource subres;
+        subres.setMipLevel(0);
+        subres.setArrayLayer(0);
+        subres.setAspectMask(vk::ImageAspectFlagBits::eColor);
+
+        vk::SubresourceLayout colorLayout = mDevice->getImageSubresourceLayout(image, subres);
+
+        void* imageDataRaw = mDevice->mapMemory(imageMemory, colorLayout.offset, colorLayout.size);
+        if (imageDataRaw == nullptr) {
+            throw std::runtime_error("Failed to map memory");
+        }
+
+        std::memset(imageDataRaw, 0, colorLayout.rowPitch * mComputeImageExtents.height);
+        void* imageLine = static_cast<uint8_t*>(imageDataRaw) + colorLayout.rowPitch * (mComputeImageExtents.height - 1);
+        if (format == vk::Format::eR16Sfloat) {
+            std::fill_n(static_cast<uint16_t*>(imageLine), mComputeImageExtents.width, FloatToHalf(512.0f));
+        } else {
+            std::fill_n(static_cast<float*>(imageLine), mComputeImageExtents.width, 512.0f);
+        }
+
+        mDevice->unmapMemory(imageMemory);
+    }
+
+    /**
+     * Create buffer and allocate memory with requested properties
+     */
+    void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, VulkanHolder<vk::Buffer> & buffer, VulkanHolder<vk::DeviceMemory> & bufferMemory)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.setSize(size);
+        bufferInfo.setUsage(usage);
+        bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+        buffer = MakeHolder(mDevice->createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice->destroyBuffer(buffer); });
+
+        vk::MemoryRequirements bufferRequirements = mDevice->getBufferMemoryRequirements(buffer);
+        vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((bufferRequirements.memoryTypeBits & (1 << i)) &&
+                ((memroProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+
+                vk::MemoryAllocateInfo allocateInfo;
+                allocateInfo.setAllocationSize(bufferRequirements.size);
+                allocateInfo.setMemoryTypeIndex(i);
+                bufferMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                break;
+            }
+        }
+        if (!bufferMemory) {
+            throw std::runtime_error("Failed to allocate memory for buffer");
+        }
+        mDevice->bindBufferMemory(buffer, bufferMemory, 0);
+    }
+
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, HeatPrecision precision, bool sparse, float sparseThreshold)
+        : mPrecision(precision), mSparse(sparse), mSparseThreshold(sparseThreshold)
     {
         (void)width;
         (void)height;
 
+        mHeatFormat = (mPrecision == HeatPrecision::Float16) ? vk::Format::eR16Sfloat : vk::Format::eR32Sfloat;
+
         vk::ApplicationInfo applicationInfo;
         applicationInfo.pApplicationName = "Vulkan sample: Window";
         applicationInfo.pEngineName = "Vulkan";
@@ -207,6 +460,16 @@ public:
         mPhysicalDevice = devices.front();
         std::cout << "OK" << std::endl;
 
+        std::cout << "Check heat field format...";
+        {
+            const vk::FormatProperties formatProperties = mPhysicalDevice.getFormatProperties(mHeatFormat);
+            if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage)) {
+                throw std::runtime_error("Heat field format can't be used as storage image");
+            }
+            mTimestampPeriod = mPhysicalDevice.getProperties().limits.timestampPeriod;
+        }
+        std::cout << "OK" << std::endl;
+
         /*
          * Create surface for the created window
          * Requires VK_KHR_SURFACE_EXTENSION_NAME and VK_KHR_WIN32_SURFACE_EXTENSION_NAME
@@ -341,17 +604,7 @@ public:
 
         std::cout << "Loading shader... ";
         {
-            {
-                auto code = GetBinaryFileContents(QUOTE(SHADERS_DIR) "/spv/11.cvt.comp.spv");
-                if (code.empty()) {
-                    throw std::runtime_error("LoadShader: Failed to read shader file!");
-                }
-                vk::ShaderModuleCreateInfo shaderInfo;
-                shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
-                shaderInfo.setCodeSize(code.size());
-
-                mConversionShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
-            }
+            mConversionShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/11.cvt.comp");
             {
                 auto code = GetBinaryFileContents(QUOTE(SHADERS_DIR) "/spv/11.heat.comp.spv");
                 if (code.empty()) {
@@ -363,6 +616,16 @@ public:
 
                 mHeatIterationShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
             }
+            if (mPrecision == HeatPrecision::Float16) {
+                mHeatIterationHalfShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/11.heat.r16f.comp");
+                mErrorShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/11.error.comp");
+            }
+            if (mSparse) {
+                // Tiled kernel replaces the dense one, fp32 shader is still used for the reference
+                const std::vector<std::string> defines = { (mPrecision == HeatPrecision::Float16) ? "HEAT_FORMAT=r16f" : "HEAT_FORMAT=r32f" };
+                mHeatIterationSparseShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/11.heat.sparse.comp", defines);
+                mTilesListShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/11.tiles.comp");
+            }
             // Descriptors layout for conversion
             {
                 std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
@@ -407,35 +670,62 @@ public:
                 mIterationDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
             }
 
-            // Pool
+            // Descriptors layout for error measurement
             {
-                std::array<vk::DescriptorPoolSize, 2> poolSize;
-                poolSize[0].setType(vk::DescriptorType::eCombinedImageSampler);
-                poolSize[0].setDescriptorCount(static_cast<uint32_t>(swapchainImages.size()));
-                poolSize[1].setType(vk::DescriptorType::eStorageImage);
-                poolSize[1].setDescriptorCount(3 * static_cast<uint32_t>(swapchainImages.size()));
-
-                vk::DescriptorPoolCreateInfo poolInfo;
-                poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
-                poolInfo.setMaxSets(1 + static_cast<uint32_t>(swapchainImages.size()));
-                poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSize.size()));
-                poolInfo.setPPoolSizes(&poolSize[0]);
-
-                mDescriptorPool = MakeHolder(mDevice->createDescriptorPool(poolInfo), [this](vk::DescriptorPool & pool) { mDevice->destroyDescriptorPool(pool); });
+                std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+
+                // Half precision field
+                bindings[0].setBinding(0);
+                bindings[0].setDescriptorType(vk::DescriptorType::eStorageImage);
+                bindings[0].setDescriptorCount(1);
+                bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                // Reference fp32 field
+                bindings[1].setBinding(1);
+                bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+                bindings[1].setDescriptorCount(1);
+                bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                // Per workgroup errors
+                bindings[2].setBinding(2);
+                bindings[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+                bindings[2].setDescriptorCount(1);
+                bindings[2].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+                descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+                descriptorSetInfo.setPBindings(&bindings[0]);
+                mErrorDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
             }
 
-            // Descriptors set for iteration
+            // Descriptors layout for sparse stepping: changed flags, active tiles list, dispatch arguments
             {
-                vk::DescriptorSetAllocateInfo allocInfo;
-                allocInfo.setDescriptorPool(mDescriptorPool);
-                allocInfo.setDescriptorSetCount(1);
-                allocInfo.setPSetLayouts(mIterationDescriptorSetLayout.get());
-
-                vk::DescriptorSet decriptorSetTmp;
-                if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &decriptorSetTmp)) {
-                    throw std::runtime_error("Failed to allocate descriptors set");
+                std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+                for (uint32_t i = 0; i < bindings.size(); ++i) {
+                    bindings[i].setBinding(i);
+                    bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+                    bindings[i].setDescriptorCount(1);
+                    bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
                 }
-                mIterationDescriptorSet = MakeHolder(decriptorSetTmp, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
+
+                vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+                descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+                descriptorSetInfo.setPBindings(&bindings[0]);
+                mTilesDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
+            }
+
+            // Pools grow on demand, sizes are per set
+            {
+                mDescriptorAllocator.Init(mDevice, {
+                    vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 1),
+                    vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 2),
+                    vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1) });
+                mDescriptorCache.Init(mDevice, mDescriptorAllocator);
+            }
+
+            // Descriptors set for sparse stepping, written once
+            if (mSparse) {
+                mTilesDescriptorSet = mDescriptorAllocator.Allocate(mTilesDescriptorSetLayout);
             }
 
             std::cout << "OK" << std::endl;
@@ -465,12 +755,26 @@ public:
         {
             vk::PipelineShaderStageCreateInfo stageInfos[2];
             stageInfos[0].setStage(vk::ShaderStageFlagBits::eCompute);
-            stageInfos[0].setModule(mHeatIterationShader);
+            if (mSparse) {
+                stageInfos[0].setModule(mHeatIterationSparseShader);
+            } else {
+                stageInfos[0].setModule((mPrecision == HeatPrecision::Float16) ? mHeatIterationHalfShader : mHeatIterationShader);
+            }
             stageInfos[0].setPName("main"); // Shader entry point
 
+            // Sparse stepping uses the second set for tiles buffers, dense kernels just ignore it
+            std::array<vk::DescriptorSetLayout, 2> setLayouts = { mIterationDescriptorSetLayout, mTilesDescriptorSetLayout };
+
+            std::array<vk::PushConstantRange, 1> pushConstants;
+            pushConstants[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+            pushConstants[0].setSize(sizeof(SparseConstants));
+            pushConstants[0].setOffset(0);
+
             vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-            pipelineLayoutInfo.setSetLayoutCount(1);
-            pipelineLayoutInfo.setPSetLayouts(mIterationDescriptorSetLayout.get());
+            pipelineLayoutInfo.setSetLayoutCount(static_cast<uint32_t>(setLayouts.size()));
+            pipelineLayoutInfo.setPSetLayouts(&setLayouts[0]);
+            pipelineLayoutInfo.setPushConstantRangeCount(static_cast<uint32_t>(pushConstants.size()));
+            pipelineLayoutInfo.setPPushConstantRanges(&pushConstants[0]);
             mIterationPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
 
             vk::ComputePipelineCreateInfo computePipelineInfo;
@@ -478,6 +782,40 @@ public:
             computePipelineInfo.setLayout(mIterationPipelineLayout);
             mIterationPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
 
+            if (mPrecision == HeatPrecision::Float16) {
+                // The reference iteration has the same layout, but fp32 storage
+                stageInfos[0].setModule(mHeatIterationShader);
+                computePipelineInfo.setStage(stageInfos[0]);
+                mReferencePipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+            }
+
+            if (mSparse) {
+                stageInfos[0].setModule(mTilesListShader);
+                computePipelineInfo.setStage(stageInfos[0]);
+                mTilesListPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+            }
+
+            std::cout << "OK" << std::endl;
+        }
+
+        if (mPrecision == HeatPrecision::Float16) {
+            std::cout << "Create error measurement pipeline...";
+
+            vk::PipelineShaderStageCreateInfo stageInfo;
+            stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+            stageInfo.setModule(mErrorShader);
+            stageInfo.setPName("main"); // Shader entry point
+
+            vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            pipelineLayoutInfo.setSetLayoutCount(1);
+            pipelineLayoutInfo.setPSetLayouts(mErrorDescriptorSetLayout.get());
+            mErrorPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+            vk::ComputePipelineCreateInfo computePipelineInfo;
+            computePipelineInfo.setStage(stageInfo);
+            computePipelineInfo.setLayout(mErrorPipelineLayout);
+            mErrorPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+
             std::cout << "OK" << std::endl;
         }
 
@@ -510,120 +848,61 @@ public:
         std::cout << "Create buffers...";
         {
             mComputeImageExtents = vk::Extent2D(256, 256);
+            mTilesCount = vk::Extent2D((mComputeImageExtents.width  + TILE_SIZE - 1) / TILE_SIZE,
+                                       (mComputeImageExtents.height + TILE_SIZE - 1) / TILE_SIZE);
 
             for (auto & computeResource : mComputeResources) {
-                vk::ImageCreateInfo imageInfo;
-                imageInfo.setImageType(vk::ImageType::e2D);
-                imageInfo.setExtent(vk::Extent3D(mComputeImageExtents.width, mComputeImageExtents.height, 1));
-                imageInfo.setMipLevels(1);
-                imageInfo.setArrayLayers(1);
-                imageInfo.setFormat(vk::Format::eR32Sfloat);
-                imageInfo.setTiling(vk::ImageTiling::eOptimal);
-                imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
-                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
-                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
-                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
-
-                computeResource.image = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
-
-                vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(computeResource.image);
-                vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
-                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
-                    if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
-                        (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eDeviceLocal))) {
-
-                        vk::MemoryAllocateInfo allocateInfo;
-                        allocateInfo.setAllocationSize(imageMemoryRequirments.size);
-                        allocateInfo.setMemoryTypeIndex(i);
-                        computeResource.memory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
-                    }
-                }
-                if (!computeResource.memory) {
-                    throw std::runtime_error("Failed to allocate memory for compute image");
-                }
-                mDevice->bindImageMemory(computeResource.image, computeResource.memory, 0);
-
-                vk::ImageSubresourceRange range;
-                range.setAspectMask(vk::ImageAspectFlagBits::eColor);
-                range.setBaseMipLevel(0);
-                range.setLevelCount(1);
-                range.setBaseArrayLayer(0);
-                range.setLayerCount(1);
-
-                vk::ImageViewCreateInfo viewInfo;
-                viewInfo.setImage(computeResource.image);
-                viewInfo.setViewType(vk::ImageViewType::e2D);
-                viewInfo.setFormat(vk::Format::eR32Sfloat);
-                viewInfo.setSubresourceRange(range);
-                computeResource.view = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
-
-                // https://vulkan-tutorial.com/Texture_mapping/Image_view_and_sampler
-                vk::SamplerCreateInfo samplerInfo;
-                samplerInfo.setMagFilter(vk::Filter::eLinear);
-                samplerInfo.setMinFilter(vk::Filter::eLinear);
-                samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToBorder);
-                samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToBorder);
-                samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToBorder);
-                samplerInfo.setAnisotropyEnable(VK_FALSE);
-                samplerInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
-                samplerInfo.setUnnormalizedCoordinates(VK_FALSE); // Use [0, 1)
-                samplerInfo.setCompareEnable(VK_FALSE);
-                samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
-                samplerInfo.setMipLodBias(0.0f);
-                samplerInfo.setMinLod(0.0f);
-                samplerInfo.setMaxLod(0.0f);
-                computeResource.sampler = MakeHolder(mDevice->createSampler(samplerInfo), [this](vk::Sampler & sampler) { mDevice->destroySampler(sampler); });
+                CreateComputeResource(computeResource, mHeatFormat);
             }
+            CreateInitialImage(mHeatFormat, mInitialImage, mInitialImageMemory);
 
-            {
-                vk::ImageCreateInfo imageInfo;
-                imageInfo.setImageType(vk::ImageType::e2D);
-                imageInfo.setExtent(vk::Extent3D(mComputeImageExtents.width, mComputeImageExtents.height, 1));
-                imageInfo.setMipLevels(1);
-                imageInfo.setArrayLayers(1);
-                imageInfo.setFormat(vk::Format::eR32Sfloat);
-                imageInfo.setTiling(vk::ImageTiling::eLinear);
-                imageInfo.setInitialLayout(vk::ImageLayout::ePreinitialized);
-                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc);
-                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
-                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
-
-                mInitialImage = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
-
-                vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(mInitialImage);
-                vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
-                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
-                    if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
-                        (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))) {
-
-                        vk::MemoryAllocateInfo allocateInfo;
-                        allocateInfo.setAllocationSize(imageMemoryRequirments.size);
-                        allocateInfo.setMemoryTypeIndex(i);
-                        mInitialImageMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
-                    }
+            if (mPrecision == HeatPrecision::Float16) {
+                for (auto & computeResource : mReferenceResources) {
+                    CreateComputeResource(computeResource, vk::Format::eR32Sfloat);
                 }
-                if (!mInitialImageMemory) {
-                    throw std::runtime_error("Failed to allocate memory for compute image");
-                }
-                mDevice->bindImageMemory(mInitialImage, mInitialImageMemory, 0);
+                CreateInitialImage(vk::Format::eR32Sfloat, mInitialReferenceImage, mInitialReferenceImageMemory);
 
-                vk::ImageSubresource subres;
-                subres.setMipLevel(0);
-                subres.setArrayLayer(0);
-                subres.setAspectMask(vk::ImageAspectFlagBits::eColor);
+                // One (max, sum of squares) pair for each workgroup of the error shader
+                mErrorGroups = vk::Extent2D((mComputeImageExtents.width  + ERROR_BLOCK_SIZE - 1) / ERROR_BLOCK_SIZE,
+                                            (mComputeImageExtents.height + ERROR_BLOCK_SIZE - 1) / ERROR_BLOCK_SIZE);
 
-                vk::SubresourceLayout colorLayout = mDevice->getImageSubresourceLayout(mInitialImage, subres);
+                CreateBuffer(mErrorGroups.width * mErrorGroups.height * 2 * sizeof(float), vk::BufferUsageFlagBits::eStorageBuffer,
+                    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mErrorBuffer, mErrorBufferMemory);
+            }
 
-                void* imageDataRaw = mDevice->mapMemory(mInitialImageMemory, 0, mComputeImageExtents.width * mComputeImageExtents.height * sizeof(float));
-                if (imageDataRaw == nullptr) {
-                    throw std::runtime_error("Failed to map memory");
+            if (mSparse) {
+                const uint32_t tilesTotal = mTilesCount.width * mTilesCount.height;
+                CreateBuffer(tilesTotal * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal, mChangedTilesBuffer, mChangedTilesMemory);
+                CreateBuffer(tilesTotal * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal, mActiveTilesBuffer, mActiveTilesMemory);
+                // Host visible to report the number of active tiles
+                CreateBuffer(sizeof(vk::DispatchIndirectCommand), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                    vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mDispatchArgsBuffer, mDispatchArgsMemory);
+
+                std::array<vk::DescriptorBufferInfo, 3> descriptorBufferInfos;
+                descriptorBufferInfos[0].setBuffer(mChangedTilesBuffer);
+                descriptorBufferInfos[0].setOffset(0);
+                descriptorBufferInfos[0].setRange(VK_WHOLE_SIZE);
+
+                descriptorBufferInfos[1].setBuffer(mActiveTilesBuffer);
+                descriptorBufferInfos[1].setOffset(0);
+                descriptorBufferInfos[1].setRange(VK_WHOLE_SIZE);
+
+                descriptorBufferInfos[2].setBuffer(mDispatchArgsBuffer);
+                descriptorBufferInfos[2].setOffset(0);
+                descriptorBufferInfos[2].setRange(VK_WHOLE_SIZE);
+
+                std::array<vk::WriteDescriptorSet, 3> writeDescriptorsInfo;
+                for (uint32_t i = 0; i < writeDescriptorsInfo.size(); ++i) {
+                    writeDescriptorsInfo[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+                    writeDescriptorsInfo[i].setDstSet(mTilesDescriptorSet);
+                    writeDescriptorsInfo[i].setDstBinding(i);
+                    writeDescriptorsInfo[i].setDstArrayElement(0);
+                    writeDescriptorsInfo[i].setDescriptorCount(1);
+                    writeDescriptorsInfo[i].setPBufferInfo(&descriptorBufferInfos[i]);
                 }
-
-                std::memset(imageDataRaw, 0, colorLayout.rowPitch * mComputeImageExtents.height);
-                float* imageLine = static_cast<float*>(static_cast<void*>(static_cast<uint8_t*>(imageDataRaw) + colorLayout.rowPitch * (mComputeImageExtents.height - 1)));
-                std::fill_n(imageLine, mComputeImageExtents.width, 512.0f);
-
-                mDevice->unmapMemory(mInitialImageMemory);
+                mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
             }
 
             std::cout << "OK" << std::endl;
@@ -647,51 +926,17 @@ public:
             mRenderingResources[i].fence = MakeHolder(mDevice->createFence(fenceInfo), [this](vk::Fence & fence) { mDevice->destroyFence(fence); });
 
             mRenderingResources[i].undefinedLaout = true;
-
-            // For each rendering resource prepare own descriptor set, with corresponding image
-
-            vk::DescriptorSetAllocateInfo allocInfo;
-            allocInfo.setDescriptorPool(mDescriptorPool);
-            allocInfo.setDescriptorSetCount(1);
-            allocInfo.setPSetLayouts(mDescriptorSetLayout.get());
-
-            vk::DescriptorSet decriptorSetTmp;
-            if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &decriptorSetTmp)) {
-                throw std::runtime_error("Failed to allocate descriptors set");
-            }
-            mRenderingResources[i].descriptorSet = MakeHolder(decriptorSetTmp, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
-
-            std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
-            std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
-
-            descriptorImageInfo[0].setImageView(mComputeResources[0].view);
-            descriptorImageInfo[0].setSampler(mComputeResources[0].sampler);
-            descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
-
-            descriptorImageInfo[1].setImageView(mRenderingResources[i].imageView);
-            descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
-
-            writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-            writeDescriptorsInfo[0].setDstSet(mRenderingResources[i].descriptorSet);
-            writeDescriptorsInfo[0].setDstBinding(0);
-            writeDescriptorsInfo[0].setDstArrayElement(0);
-            writeDescriptorsInfo[0].setDescriptorCount(1);
-            writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
-
-            writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
-            writeDescriptorsInfo[1].setDstSet(mRenderingResources[i].descriptorSet);
-            writeDescriptorsInfo[1].setDstBinding(1);
-            writeDescriptorsInfo[1].setDstArrayElement(0);
-            writeDescriptorsInfo[1].setDescriptorCount(1);
-            writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
-
-            mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
         }
 
 
         mSemaphoreAvailable = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
         mSemaphoreFinished  = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
 
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.setQueryCount(2);
+        queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+        mQueryPool = MakeHolder(mDevice->createQueryPool(queryPoolInfo), [this](vk::QueryPool & pool) { mDevice->destroyQueryPool(pool); });
+
         CanRender = true;
     }
 
@@ -730,28 +975,14 @@ public:
         if (mFirstDraw) {
             mNextComputeResIdx = 0;
 
-            vk::ImageMemoryBarrier barrierFromPreinitToTransSrc;
-            barrierFromPreinitToTransSrc.srcAccessMask = vk::AccessFlagBits::eHostWrite;
-            barrierFromPreinitToTransSrc.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-            barrierFromPreinitToTransSrc.oldLayout = vk::ImageLayout::ePreinitialized;
-            barrierFromPreinitToTransSrc.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-            barrierFromPreinitToTransSrc.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransSrc.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPreinitToTransSrc.image = mInitialImage;
-            barrierFromPreinitToTransSrc.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransSrc);
-
-            for (uint32_t idx = 0; idx < 2; ++idx) {
-                vk::ImageMemoryBarrier barrierFromPreinitToTransDst;
-                barrierFromPreinitToTransDst.srcAccessMask = vk::AccessFlagBits::eHostWrite;
-                barrierFromPreinitToTransDst.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-                barrierFromPreinitToTransDst.oldLayout = vk::ImageLayout::ePreinitialized;
-                barrierFromPreinitToTransDst.newLayout = vk::ImageLayout::eTransferDstOptimal;
-                barrierFromPreinitToTransDst.srcQueueFamilyIndex = mQueueFamilyPresent;
-                barrierFromPreinitToTransDst.dstQueueFamilyIndex = mQueueFamilyPresent;
-                barrierFromPreinitToTransDst.image = mComputeResources[idx].image;
-                barrierFromPreinitToTransDst.subresourceRange = range;
-                cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPreinitToTransDst);
+            auto initializeResources = [&](vk::Image initialImage, std::array<ComputeResource, 2> & resources) {
+                mStateTracker.SetImageState(initialImage, vk::ImageLayout::ePreinitialized, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostWrite);
+                mStateTracker.UseImage(initialImage, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal);
+                for (uint32_t idx = 0; idx < 2; ++idx) {
+                    mStateTracker.SetImageState(resources[idx].image, vk::ImageLayout::ePreinitialized, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostWrite);
+                    mStateTracker.UseImage(resources[idx].image, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal);
+                }
+                mStateTracker.Flush(cmdBuffer);
 
                 vk::ImageSubresourceLayers subResource;
                 subResource.setAspectMask(vk::ImageAspectFlagBits::eColor);
@@ -766,87 +997,67 @@ public:
                 copyInfo.setDstOffset(vk::Offset3D(0, 0, 0));
                 copyInfo.setExtent(vk::Extent3D(mComputeImageExtents.width, mComputeImageExtents.height, 1));
 
-                cmdBuffer->copyImage(mInitialImage, vk::ImageLayout::eTransferSrcOptimal, mComputeResources[idx].image, vk::ImageLayout::eTransferDstOptimal, 1, &copyInfo);
-
-                vk::ImageMemoryBarrier barrierFromTransDstToGeneral;
-                barrierFromTransDstToGeneral.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-                barrierFromTransDstToGeneral.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-                barrierFromTransDstToGeneral.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-                barrierFromTransDstToGeneral.newLayout = vk::ImageLayout::eGeneral;
-                barrierFromTransDstToGeneral.srcQueueFamilyIndex = mQueueFamilyPresent;
-                barrierFromTransDstToGeneral.dstQueueFamilyIndex = mQueueFamilyPresent;
-                barrierFromTransDstToGeneral.image = mComputeResources[idx].image;
-                barrierFromTransDstToGeneral.subresourceRange = range;
-                cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromTransDstToGeneral);
+                for (uint32_t idx = 0; idx < 2; ++idx) {
+                    cmdBuffer->copyImage(initialImage, vk::ImageLayout::eTransferSrcOptimal, resources[idx].image, vk::ImageLayout::eTransferDstOptimal, 1, &copyInfo);
+                    // Transition is recorded by the flush below together with the other images
+                    mStateTracker.UseImage(resources[idx].image, vk::PipelineStageFlagBits::eComputeShader,
+                        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eGeneral);
+                }
+            };
+
+            initializeResources(mInitialImage, mComputeResources);
+            if (mPrecision == HeatPrecision::Float16) {
+                initializeResources(mInitialReferenceImage, mReferenceResources);
             }
+
+            if (mSparse) {
+                // All tiles are active on the first step
+                cmdBuffer->fillBuffer(mChangedTilesBuffer, 0, VK_WHOLE_SIZE, 1);
+                cmdBuffer->fillBuffer(mDispatchArgsBuffer, 0, VK_WHOLE_SIZE, 1);
+            }
+            mStateTracker.Flush(cmdBuffer);
         }
 
+        const bool measureError = (mPrecision == HeatPrecision::Float16) && (mFrameCounter % ERROR_CHECK_PERIOD == 0);
+
         /* 
          * Iteration
          * Swap buffers bindings
          */
-        {
-            std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
-            std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
-
-            descriptorImageInfo[0].setImageView(mComputeResources[mNextComputeResIdx].view);
-            descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
+        const vk::DescriptorSet iterationSet = mDescriptorCache.Get(mIterationDescriptorSetLayout, DescriptorBindings()
+            .Image(2, vk::DescriptorType::eStorageImage, mComputeResources[mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral)
+            .Image(3, vk::DescriptorType::eStorageImage, mComputeResources[1 - mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral));
 
-            descriptorImageInfo[1].setImageView(mComputeResources[1 - mNextComputeResIdx].view);
-            descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
-
-            writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eStorageImage);
-            writeDescriptorsInfo[0].setDstSet(mIterationDescriptorSet);
-            writeDescriptorsInfo[0].setDstBinding(2);
-            writeDescriptorsInfo[0].setDstArrayElement(0);
-            writeDescriptorsInfo[0].setDescriptorCount(1);
-            writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
-
-            writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
-            writeDescriptorsInfo[1].setDstSet(mIterationDescriptorSet);
-            writeDescriptorsInfo[1].setDstBinding(3);
-            writeDescriptorsInfo[1].setDstArrayElement(0);
-            writeDescriptorsInfo[1].setDescriptorCount(1);
-            writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
-
-            mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+        /*
+         * Reference fp32 iteration and error measurement
+         */
+        vk::DescriptorSet referenceSet;
+        if (mPrecision == HeatPrecision::Float16) {
+            referenceSet = mDescriptorCache.Get(mIterationDescriptorSetLayout, DescriptorBindings()
+                .Image(2, vk::DescriptorType::eStorageImage, mReferenceResources[mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral)
+                .Image(3, vk::DescriptorType::eStorageImage, mReferenceResources[1 - mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral));
+        }
+        vk::DescriptorSet errorSet;
+        if (measureError) {
+            errorSet = mDescriptorCache.Get(mErrorDescriptorSetLayout, DescriptorBindings()
+                .Image(0, vk::DescriptorType::eStorageImage, mComputeResources[1 - mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral)
+                .Image(1, vk::DescriptorType::eStorageImage, mReferenceResources[1 - mNextComputeResIdx].view, vk::Sampler(), vk::ImageLayout::eGeneral)
+                .Buffer(2, vk::DescriptorType::eStorageBuffer, mErrorBuffer));
         }
 
         /* 
          * Conversion
-         * Bind another sampler
+         * Bind another sampler and the own image of the each rendering resource
          * On the each draw ping-pong buffer is switched
          */
-        {
-            std::array<vk::WriteDescriptorSet, 1> writeDescriptorsInfo;
-            std::array<vk::DescriptorImageInfo, 1> descriptorImageInfo;
-
-            descriptorImageInfo[0].setImageView(mComputeResources[1 - mNextComputeResIdx].view);
-            descriptorImageInfo[0].setSampler(mComputeResources[1 - mNextComputeResIdx].sampler);
-            //descriptorImageInfo[0].setImageView(mComputeResources[1].view);
-            //descriptorImageInfo[0].setSampler(mComputeResources[1].sampler);
-            descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
-
-            writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
-            writeDescriptorsInfo[0].setDstSet(renderingResource.descriptorSet);
-            writeDescriptorsInfo[0].setDstBinding(0);
-            writeDescriptorsInfo[0].setDstArrayElement(0);
-            writeDescriptorsInfo[0].setDescriptorCount(1);
-            writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
-
-            mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
-        }
-
-        vk::ImageMemoryBarrier barrierFromPresentToDraw;
-        barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-        barrierFromPresentToDraw.newLayout = vk::ImageLayout::eGeneral;
-        barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromPresentToDraw.image = renderingResource.imageHandle;
-        barrierFromPresentToDraw.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+        const vk::DescriptorSet conversionSet = mDescriptorCache.Get(mDescriptorSetLayout, DescriptorBindings()
+            .Image(0, vk::DescriptorType::eCombinedImageSampler, mComputeResources[1 - mNextComputeResIdx].view, mComputeResources[1 - mNextComputeResIdx].sampler, vk::ImageLayout::eGeneral)
+            .Image(1, vk::DescriptorType::eStorageImage, renderingResource.imageView, vk::Sampler(), vk::ImageLayout::eGeneral));
+
+        // The acquire semaphore is waited at the transfer stage, the transition must come after it
+        mStateTracker.SetImageState(renderingResource.imageHandle, renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits::eTransfer);
+        mStateTracker.UseImage(renderingResource.imageHandle, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eGeneral);
+        mStateTracker.Flush(cmdBuffer);
         renderingResource.undefinedLaout = false;
 
         vk::ClearColorValue targetColor = std::array<float, 4>{ 0.1f, 0.1f, 0.1f, 1.0f };
@@ -855,29 +1066,107 @@ public:
         cmdBuffer->clearColorImage(renderingResource.imageHandle, vk::ImageLayout::eGeneral, &targetColor, 1, &range);
 
         // Make iteration
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mIterationPipeline);
+        cmdBuffer->resetQueryPool(mQueryPool, 0, 2);
+
+        cmdBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, mQueryPool, 0);
+
+        if (mSparse) {
+            SparseConstants constants;
+            constants.threshold = mSparseThreshold;
+            constants.tilesX = mTilesCount.width;
+            constants.tilesY = mTilesCount.height;
+
+            std::array<vk::DescriptorSet, 2> descriptorSets = { iterationSet, mTilesDescriptorSet };
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mIterationPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), &descriptorSets[0], 0, nullptr);
+            cmdBuffer->pushConstants(mIterationPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(SparseConstants), &constants);
+
+            // Changed flags of the previous step are read, dispatch arguments are rewritten
+            vk::MemoryBarrier barrierPrevStepToList;
+            barrierPrevStepToList.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            barrierPrevStepToList.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eTransfer,
+                vk::DependencyFlags(), 1, &barrierPrevStepToList, 0, nullptr, 0, nullptr);
+
+            cmdBuffer->fillBuffer(mDispatchArgsBuffer, 0, sizeof(uint32_t), 0);
+
+            vk::MemoryBarrier barrierResetToList;
+            barrierResetToList.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            barrierResetToList.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                vk::DependencyFlags(), 1, &barrierResetToList, 0, nullptr, 0, nullptr);
+
+            // Collect active tiles
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mTilesListPipeline);
+            const uint32_t tilesTotal = mTilesCount.width * mTilesCount.height;
+            cmdBuffer->dispatch((tilesTotal + TILES_LIST_GROUP_SIZE - 1) / TILES_LIST_GROUP_SIZE, 1, 1);
+
+            vk::MemoryBarrier barrierListToIteration;
+            barrierListToIteration.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierListToIteration.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+                vk::DependencyFlags(), 1, &barrierListToIteration, 0, nullptr, 0, nullptr);
+
+            // Step only active tiles, one workgroup per tile
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mIterationPipeline);
+            cmdBuffer->dispatchIndirect(mDispatchArgsBuffer, 0);
+
+            // Number of active tiles is reported by host
+            vk::MemoryBarrier barrierListToHost;
+            barrierListToHost.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierListToHost.dstAccessMask = vk::AccessFlagBits::eHostRead;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+                vk::DependencyFlags(), 1, &barrierListToHost, 0, nullptr, 0, nullptr);
+        } else {
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mIterationPipeline);
+
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mIterationPipelineLayout, 0, 1, &iterationSet, 0, nullptr);
+
+            cmdBuffer->dispatch(mComputeImageExtents.width - 2, mComputeImageExtents.height - 2, 1);
+        }
+
+        cmdBuffer->writeTimestamp(vk::PipelineStageFlagBits::eComputeShader, mQueryPool, 1);
+
+        if (mPrecision == HeatPrecision::Float16) {
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mReferencePipeline);
 
-        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mIterationPipelineLayout, 0, 1, mIterationDescriptorSet.get(), 0, nullptr);
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mIterationPipelineLayout, 0, 1, &referenceSet, 0, nullptr);
 
-        cmdBuffer->dispatch(mComputeImageExtents.width - 2, mComputeImageExtents.height - 2, 1);
+            cmdBuffer->dispatch(mComputeImageExtents.width - 2, mComputeImageExtents.height - 2, 1);
+        }
+
+        if (measureError) {
+            // Both fields must be completely written before comparison
+            vk::MemoryBarrier barrierIterationToError;
+            barrierIterationToError.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierIterationToError.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &barrierIterationToError, 0, nullptr, 0, nullptr);
+
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mErrorPipeline);
+
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mErrorPipelineLayout, 0, 1, &errorSet, 0, nullptr);
+
+            cmdBuffer->dispatch(mErrorGroups.width, mErrorGroups.height, 1);
+
+            vk::MemoryBarrier barrierErrorToHost;
+            barrierErrorToHost.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierErrorToHost.dstAccessMask = vk::AccessFlagBits::eHostRead;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), 1, &barrierErrorToHost, 0, nullptr, 0, nullptr);
+        }
 
         // Make conversion
+        // The field written by the iteration is sampled, the cleared target is overwritten
+        mStateTracker.AddMemoryDependency(vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead);
+        mStateTracker.UseImage(renderingResource.imageHandle, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eGeneral);
+        mStateTracker.Flush(cmdBuffer);
+
         cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mConversionPipeline);
 
-        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mConversionPipelineLayout, 0, 1, renderingResource.descriptorSet.get(), 0, nullptr);
+        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mConversionPipelineLayout, 0, 1, &conversionSet, 0, nullptr);
 
-        cmdBuffer->dispatch(mFramebufferExtents.width, mFramebufferExtents.height, 1);
+        cmdBuffer->dispatch((mFramebufferExtents.width + CONVERSION_TILE_SIZE - 1) / CONVERSION_TILE_SIZE, (mFramebufferExtents.height + CONVERSION_TILE_SIZE - 1) / CONVERSION_TILE_SIZE, 1);
 
-        vk::ImageMemoryBarrier barrierFromDrawToPresent;
-        barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-        barrierFromDrawToPresent.oldLayout = vk::ImageLayout::eGeneral;
-        barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-        barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyGraphics;
-        barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-        barrierFromDrawToPresent.image = renderingResource.imageHandle;
-        barrierFromDrawToPresent.subresourceRange = range;
-        cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+        mStateTracker.UseImage(renderingResource.imageHandle, vk::PipelineStageFlagBits::eBottomOfPipe, vk::AccessFlags(), vk::ImageLayout::ePresentSrcKHR);
+        mStateTracker.Flush(cmdBuffer);
         
         cmdBuffer->end();
 
@@ -918,8 +1207,47 @@ public:
             return false;
         }
 
+        if (mFrameCounter % ERROR_CHECK_PERIOD == 0) {
+            std::array<uint64_t, 2> timestamps = { 0, 0 };
+            mDevice->getQueryPoolResults(mQueryPool, 0, 2, sizeof(timestamps), &timestamps[0], sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+            std::cout << "Step " << mFrameCounter << ": iteration time = " << (timestamps[1] - timestamps[0]) * mTimestampPeriod / 1e6 << " ms";
+            if (mSparse) {
+                const vk::DispatchIndirectCommand* args = static_cast<const vk::DispatchIndirectCommand*>(mDevice->mapMemory(mDispatchArgsMemory, 0, sizeof(vk::DispatchIndirectCommand)));
+                if (args == nullptr) {
+                    std::cout << std::endl;
+                    std::cout << "Failed to map dispatch arguments buffer!" << std::endl;
+                    return false;
+                }
+                std::cout << ", active tiles = " << args->x << " / " << mTilesCount.width * mTilesCount.height;
+                mDevice->unmapMemory(mDispatchArgsMemory);
+            }
+            if (measureError) {
+                const uint32_t groupsCount = mErrorGroups.width * mErrorGroups.height;
+                const float* errors = static_cast<const float*>(mDevice->mapMemory(mErrorBufferMemory, 0, groupsCount * 2 * sizeof(float)));
+                if (errors == nullptr) {
+                    std::cout << std::endl;
+                    std::cout << "Failed to map error buffer!" << std::endl;
+                    return false;
+                }
+                float maxError = 0.0f;
+                double sumSquares = 0.0;
+                for (uint32_t i = 0; i < groupsCount; ++i) {
+                    maxError = std::max(maxError, errors[2 * i]);
+                    sumSquares += errors[2 * i + 1];
+                }
+                mDevice->unmapMemory(mErrorBufferMemory);
+
+                const double rmsError = std::sqrt(sumSquares / (mComputeImageExtents.width * mComputeImageExtents.height));
+                std::cout << ", r16f vs r32f: max abs error = " << maxError << ", RMS error = " << rmsError;
+            }
+            std::cout << ", descriptor sets: " << mDescriptorCache.GetWritesCount() << " written, " << mDescriptorCache.GetHitsCount() << " reused";
+            std::cout << std::endl;
+        }
+
         mNextComputeResIdx = 1 - mNextComputeResIdx;
         mFirstDraw = false;
+        ++mFrameCounter;
         return true;
     }
 
@@ -932,8 +1260,26 @@ public:
 
 };
 
-int main() {
+int main(int argc, char** argv) {
     try {
+        // Pass --fp16 to store the heat field in half precision
+        // Pass --sparse [threshold] to step only tiles near changed ones
+        HeatPrecision precision = HeatPrecision::Float32;
+        bool sparse = false;
+        float sparseThreshold = 0.0f;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--fp16") {
+                precision = HeatPrecision::Float16;
+            }
+            else if (arg == "--sparse") {
+                sparse = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    sparseThreshold = std::stof(argv[++i]);
+                }
+            }
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("11 - Heat map", 512, 512)) {
@@ -941,7 +1287,7 @@ int main() {
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, precision, sparse, sparseThreshold);
         if (!window.RenderingLoop(application)) {
             return -1;
         }
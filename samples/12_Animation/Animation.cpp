@@ -15,6 +15,7 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
 
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
@@ -32,11 +33,7 @@ class Sample_03_Window
         Ogre::Vector2 texcoord;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
+    using Mesh = IndexedMesh<VertexData>;
 
     struct VertexUniformBuffer
     {
@@ -83,6 +80,7 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
     VulkanHolder<vk::Buffer> mMatrixesBuffer;
     VulkanHolder<vk::DeviceMemory> mMatrixesMemory;
@@ -133,54 +131,11 @@ class Sample_03_Window
         quad.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(1.0f, 0.0f)} );
         quad.vertexes.push_back(VertexData{ Ogre::Vector4( -halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4( 0.0f,  0.0f,  1.0f,  0.0f ), Ogre::Vector2(0.0f, 0.0f)} );
 
-        quad.indexes = { 0,  1,  2,    0,  2,  3 };
+        quad.indexes16 = { 0,  1,  2,    0,  2,  3 };
 
         return quad;
     }
 
-    static Mesh GenerateSphere(const float radius, const uint16_t rings, const uint16_t segments)
-    {
-        assert(rings > 1);
-        assert(segments > 2);
-
-        Mesh sphere;
-
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        const float deltaRingAngle = static_cast<float>(M_PI / rings);
-        const float deltaSegAngle = static_cast<float>(2.0 * M_PI / segments);
-        uint16_t verticeIndex = 0;
-
-        // Generate the group of rings for the sphere
-        for (uint16_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
-            float r0 = radius * std::sin(ringIdx * deltaRingAngle);
-            float y0 = radius * std::cos(ringIdx * deltaRingAngle);
-            // Generate the group of segments for the current ring
-            for (uint16_t segIdx = 0; segIdx <= segments; ++segIdx) {
-                float x0 = r0 * std::sin(segIdx * deltaSegAngle);
-                float z0 = r0 * std::cos(segIdx * deltaSegAngle);
-
-                VertexData vertex;
-                vertex.position = Ogre::Vector4(x0, y0, z0, 1.0f);
-                vertex.normal = Ogre::Vector4(Ogre::Vector3(x0, y0, z0).normalisedCopy());
-                sphere.vertexes.push_back(vertex);
-
-                if (ringIdx != rings) {
-                    // each vertex (except the last) has six indicies pointing to it
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    sphere.indexes.push_back(verticeIndex + segments);
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    ++verticeIndex;
-                }
-            }
-        }
-        return sphere;
-    }
-
 public:
 
     bool CheckPhysicalDeviceProperties(const vk::PhysicalDevice & physicalDevice, uint32_t &selected_graphics_queue_family_index, uint32_t &selected_present_queue_family_index)
@@ -721,9 +676,10 @@ public:
         std::cout << "Prepare vertex buffer...";
         {
             auto mesh = GenerateQuad(1.75f);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+            mIndexesNumber = mesh.GetIndexesCount();
+            mIndexType = mesh.indexType;
             const uint32_t vertexBufferSize  = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size()  * sizeof(decltype(mesh.indexes)::value_type));
+            const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -800,7 +756,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mIndexesMemory);
@@ -1157,7 +1113,7 @@ public:
 
         vk::DeviceSize offset = 0;
         cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
+        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
 
         if (mFirstDraw) {
             // Update matrixes
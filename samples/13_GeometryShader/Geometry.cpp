@@ -15,7 +15,15 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
-
+#include <FrustumCuller.h>
+#include <MeshBuilder.h>
+#include <MeshFile.h>
+#include <MeshletBuilder.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <GpuTimer.h>
+
+#include <math/OgreAxisAlignedBox.h>
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
 #include <math/OgreMatrix4.h>
@@ -31,12 +39,6 @@ class Sample_03_Window
         Ogre::Vector4 normal;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
-
     struct VertexUniformBuffer
     {
         Ogre::Matrix4 modelView = Ogre::Matrix4::IDENTITY;
@@ -51,6 +53,7 @@ class Sample_03_Window
         VulkanHolder<vk::Framebuffer> framebuffer;
         VulkanHolder<vk::Fence> fence;
         bool undefinedLaout;
+        bool culled = false;
     };
 
     VulkanHolder<vk::Instance> mVulkan;
@@ -78,7 +81,7 @@ class Sample_03_Window
 
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
-    uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
     VulkanHolder<vk::Buffer> mMatrixesBuffer;
     VulkanHolder<vk::DeviceMemory> mMatrixesMemory;
@@ -113,50 +116,83 @@ class Sample_03_Window
 
     bool mFirstDraw = true;
 
-    static Mesh GenerateSphere(const float radius, const uint16_t rings, const uint16_t segments)
+    GpuTimer mDrawTimer;
+
+    // Levels of detail of the mesh in the index buffer, selected per object by the projected error
+    std::vector<MeshFileLod> mLods;
+    Ogre::AxisAlignedBox mMeshBox;
+    float mMeshSize = 0.0f;
+    float mLodPixelError = 1.0f;
+    // Objects are placed on a grid of mObjectsGrid x mObjectsGrid going away from the camera
+    uint32_t mObjectsGrid = 1;
+    std::vector<Ogre::Vector4> mObjectOffsets;
+    std::vector<uint32_t> mObjectLods;
+    // Without the GPU culling the offsets are culled on the CPU against the frustum grown by the rotated mesh box
+    AabbArray mObjectPoints;
+    std::vector<uint8_t> mObjectVisible;
+    uint64_t mObjectsVisible = 0;
+    uint64_t mStatsFrames = 0;
+    uint64_t mTrianglesDrawn = 0;
+    uint64_t mTrianglesFull = 0;
+
+    // Meshlets are culled by a compute pass writing indirect draws, 2 batches per object per rendering resource:
+    // the solid batch is culled by the frustum and the normal cone, the normals batch by the frustum only
+    // With instancing the pass culls the boxes of the objects and writes a list of visible instances and one indirect draw per level of detail
+    bool mInstanced = false;
+    uint32_t mMeshletsCount = 0;
+    uint32_t mMeshletTriangles = 0;
+    float mConeSign = 1.0f;
+    bool mMultiDrawIndirect = false;
+    VulkanHolder<vk::ShaderModule> mCullShader;
+    VulkanHolder<vk::DescriptorSetLayout> mCullDescriptorSetLayout;
+    VulkanHolder<vk::DescriptorPool> mCullDescriptorPool;
+    VulkanHolder<vk::DescriptorSet> mCullDescriptorSet;
+    VulkanHolder<vk::PipelineLayout> mCullPipelineLayout;
+    VulkanHolder<vk::Pipeline> mCullPipeline;
+    VulkanHolder<vk::Buffer> mMeshletsBuffer;
+    VulkanHolder<vk::DeviceMemory> mMeshletsMemory;
+    VulkanHolder<vk::Buffer> mObjectsBuffer;
+    VulkanHolder<vk::DeviceMemory> mObjectsMemory;
+    VulkanHolder<vk::Buffer> mDrawCommandsBuffer;
+    VulkanHolder<vk::DeviceMemory> mDrawCommandsMemory;
+    VulkanHolder<vk::Buffer> mCountersBuffer;
+    VulkanHolder<vk::DeviceMemory> mCountersMemory;
+    VulkanHolder<vk::Buffer> mVisibleInstancesBuffer;
+    VulkanHolder<vk::DeviceMemory> mVisibleInstancesMemory;
+    VulkanHolder<vk::Buffer> mLodsBuffer;
+    VulkanHolder<vk::DeviceMemory> mLodsMemory;
+    std::vector<vk::DrawIndexedIndirectCommand> mInstanceCommands;
+    uint64_t mMeshletsVisible = 0;
+    uint64_t mMeshletsTotal = 0;
+    uint64_t mInstancesVisible = 0;
+
+    // Frame time of the CPU and GPU driven paths
+    uint64_t mFrames = 0;
+    double mFramesSeconds = 0.0;
+    double mRecordSeconds = 0.0;
+    std::chrono::high_resolution_clock::time_point mLastFrame;
+
+    struct CullConstants
     {
-        assert(rings > 1);
-        assert(segments > 2);
-
-        Mesh sphere;
-
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        const float deltaRingAngle = static_cast<float>(M_PI / rings);
-        const float deltaSegAngle = static_cast<float>(2.0 * M_PI / segments);
-        uint16_t verticeIndex = 0;
-
-        // Generate the group of rings for the sphere
-        for (uint16_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
-            float r0 = radius * std::sin(ringIdx * deltaRingAngle);
-            float y0 = radius * std::cos(ringIdx * deltaRingAngle);
-            // Generate the group of segments for the current ring
-            for (uint16_t segIdx = 0; segIdx <= segments; ++segIdx) {
-                float x0 = r0 * std::sin(segIdx * deltaSegAngle);
-                float z0 = r0 * std::cos(segIdx * deltaSegAngle);
-
-                Ogre::Vector3 normal = Ogre::Vector3(x0, y0, z0).normalisedCopy();
-
-                VertexData vertex;
-                vertex.position = { x0, y0, z0, 1.0f };
-                vertex.normal = { normal.x, normal.y, normal.z, 0.0f };
-                sphere.vertexes.push_back(vertex);
-
-                if (ringIdx != rings) {
-                    // each vertex (except the last) has six indicies pointing to it
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    sphere.indexes.push_back(verticeIndex + segments);
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    ++verticeIndex;
-                }
-            }
-        }
-        return sphere;
-    }
+        uint32_t meshletsCount;
+        uint32_t objectsCount;
+        uint32_t commandsBase;
+        uint32_t countersBase;
+        float coneSign;
+    };
+
+    struct InstancesCullConstants
+    {
+        Ogre::Vector4 boxCenter;
+        Ogre::Vector4 boxHalfSize;
+        uint32_t instancesCount;
+        uint32_t lodsCount;
+        uint32_t commandsBase;
+        uint32_t visibleBase;
+        float meshSize;
+        float viewportHeight;
+        float pixelError;
+    };
 
 public:
 
@@ -246,9 +282,130 @@ public:
         return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
     }
 
+    void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, VulkanHolder<vk::Buffer> & buffer, VulkanHolder<vk::DeviceMemory> & bufferMemory)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.setSize(size);
+        bufferInfo.setUsage(usage);
+        bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+        buffer = MakeHolder(mDevice->createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice->destroyBuffer(buffer); });
+
+        vk::MemoryRequirements bufferRequirements = mDevice->getBufferMemoryRequirements(buffer);
+        vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((bufferRequirements.memoryTypeBits & (1 << i)) &&
+                ((memroProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+
+                vk::MemoryAllocateInfo allocateInfo;
+                allocateInfo.setAllocationSize(bufferRequirements.size);
+                allocateInfo.setMemoryTypeIndex(i);
+                bufferMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                break;
+            }
+        }
+        if (!bufferMemory) {
+            throw std::runtime_error("Failed to allocate memory for buffer");
+        }
+        mDevice->bindBufferMemory(buffer, bufferMemory, 0);
+    }
+
+    void UploadBuffer(vk::DeviceMemory memory, const void* data, vk::DeviceSize size)
+    {
+        void* devicePtr = mDevice->mapMemory(memory, 0, size);
+        if (devicePtr == nullptr) {
+            throw std::runtime_error("Failed to map memory for buffer");
+        }
+        std::memcpy(devicePtr, data, static_cast<size_t>(size));
+        mDevice->unmapMemory(memory);
+    }
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    /**
+     * Compute pipeline of a culling pass: binding 0 is the matrixes uniform buffer, the next bindings are the storage buffers
+     */
+    void CreateCullPipeline(const std::string & shaderPath, const std::vector<vk::Buffer> & storageBuffers, uint32_t pushConstantsSize)
     {
+        mCullShader = LoadShaderFromSourceFile(shaderPath);
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings(1 + storageBuffers.size());
+        for (uint32_t i = 0; i < bindings.size(); ++i) {
+            bindings[i].setBinding(i);
+            bindings[i].setDescriptorType((i == 0) ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer);
+            bindings[i].setDescriptorCount(1);
+            bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        }
+        vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+        descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+        descriptorSetInfo.setPBindings(&bindings[0]);
+        mCullDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
+
+        std::array<vk::DescriptorPoolSize, 2> poolSize;
+        poolSize[0].setType(vk::DescriptorType::eUniformBuffer);
+        poolSize[0].setDescriptorCount(1);
+        poolSize[1].setType(vk::DescriptorType::eStorageBuffer);
+        poolSize[1].setDescriptorCount(static_cast<uint32_t>(storageBuffers.size()));
+
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+        poolInfo.setMaxSets(1);
+        poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSize.size()));
+        poolInfo.setPPoolSizes(&poolSize[0]);
+        mCullDescriptorPool = MakeHolder(mDevice->createDescriptorPool(poolInfo), [this](vk::DescriptorPool & pool) { mDevice->destroyDescriptorPool(pool); });
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.setDescriptorPool(mCullDescriptorPool);
+        allocInfo.setDescriptorSetCount(1);
+        allocInfo.setPSetLayouts(mCullDescriptorSetLayout.get());
+        vk::DescriptorSet decriptorSet;
+        if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &decriptorSet)) {
+            throw std::runtime_error("Failed to allocate descriptors set");
+        }
+        mCullDescriptorSet = MakeHolder(decriptorSet, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mCullDescriptorPool, set); });
+
+        std::vector<vk::DescriptorBufferInfo> buffersInfo(bindings.size());
+        buffersInfo[0] = vk::DescriptorBufferInfo(mMatrixesBuffer, 0, sizeof(mMatrixes));
+        for (size_t i = 0; i < storageBuffers.size(); ++i) {
+            buffersInfo[i + 1] = vk::DescriptorBufferInfo(storageBuffers[i], 0, VK_WHOLE_SIZE);
+        }
+        std::vector<vk::WriteDescriptorSet> writeDescriptorsInfo(bindings.size());
+        for (uint32_t i = 0; i < writeDescriptorsInfo.size(); ++i) {
+            writeDescriptorsInfo[i].setDescriptorType(bindings[i].descriptorType);
+            writeDescriptorsInfo[i].setDstSet(mCullDescriptorSet);
+            writeDescriptorsInfo[i].setDstBinding(i);
+            writeDescriptorsInfo[i].setDstArrayElement(0);
+            writeDescriptorsInfo[i].setDescriptorCount(1);
+            writeDescriptorsInfo[i].setPBufferInfo(&buffersInfo[i]);
+        }
+        mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+
+        vk::PipelineShaderStageCreateInfo stageInfo;
+        stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+        stageInfo.setModule(mCullShader);
+        stageInfo.setPName("main"); // Shader entry point
+
+        vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, pushConstantsSize);
+
+        vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+        pipelineLayoutInfo.setSetLayoutCount(1);
+        pipelineLayoutInfo.setPSetLayouts(mCullDescriptorSetLayout.get());
+        pipelineLayoutInfo.setPushConstantRangeCount(1);
+        pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
+        mCullPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+        vk::ComputePipelineCreateInfo computePipelineInfo;
+        computePipelineInfo.setStage(stageInfo);
+        computePipelineInfo.setLayout(mCullPipelineLayout);
+        mCullPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) { mDevice->destroyPipeline(pipeline); });
+    }
+
+
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, uint32_t rings, bool optimizeMesh, const std::string & meshPath,
+        uint32_t lodsCount, uint32_t objectsGrid, float lodPixelError, bool meshlets, bool instanced)
+        : mLodPixelError(lodPixelError), mObjectsGrid(std::max(objectsGrid, 1u)), mInstanced(instanced)
+    {
+        if (meshlets && instanced) {
+            throw std::runtime_error("Meshlets and instancing can't be used together");
+        }
+
         vk::ApplicationInfo applicationInfo;
         applicationInfo.pApplicationName = "Vulkan sample: Window";
         applicationInfo.pEngineName = "Vulkan";
@@ -339,6 +496,17 @@ public:
 
         vk::PhysicalDeviceFeatures features;
         features.setGeometryShader(VK_TRUE);
+        if (meshlets || instanced) {
+            // The culling pass is recorded into the same command buffer as the draws
+            if (!(queueProperties[mQueueFamilyPresent].queueFlags & vk::QueueFlagBits::eCompute)) {
+                throw std::runtime_error("GPU culling requires a queue with graphics and compute");
+            }
+        }
+        if (meshlets) {
+            // Otherwise each meshlet slot is a separate indirect draw
+            mMultiDrawIndirect = (VK_FALSE != mPhysicalDevice.getFeatures().multiDrawIndirect);
+            features.setMultiDrawIndirect(mMultiDrawIndirect ? VK_TRUE : VK_FALSE);
+        }
 
         vk::DeviceCreateInfo deviceCreateInfo;
         deviceCreateInfo.setEnabledExtensionCount(static_cast<uint32_t>(deviceExtensions.size()));
@@ -603,7 +771,7 @@ public:
         */
 
         std::cout << "Loading vertex shaders... " << std::endl;
-        mVertexShader = LoadShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/13.vert");
+        mVertexShader = LoadShaderFromSourceFile(mInstanced ? QUOTE(SHADERS_DIR) "/glsl/13.instanced.vert" : QUOTE(SHADERS_DIR) "/glsl/13.vert");
         std::cout << "OK" << std::endl;
 
         std::cout << "Loading vertex shaders... " << std::endl;
@@ -618,7 +786,7 @@ public:
 
         std::cout << "Create descriptors set... ";
         {
-            std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+            std::vector<vk::DescriptorSetLayoutBinding> bindings(mInstanced ? 4 : 2);
             bindings[0].setBinding(0);
             bindings[0].setDescriptorType(vk::DescriptorType::eUniformBuffer);
             bindings[0].setDescriptorCount(1);
@@ -629,19 +797,30 @@ public:
             bindings[1].setDescriptorCount(1);
             bindings[1].setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
+            // Instances and the visible instances lists
+            for (uint32_t i = 2; i < bindings.size(); ++i) {
+                bindings[i].setBinding(i);
+                bindings[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+                bindings[i].setDescriptorCount(1);
+                bindings[i].setStageFlags(vk::ShaderStageFlagBits::eVertex);
+            }
+
             vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
             descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
             descriptorSetInfo.setPBindings(&bindings[0]);
 
             mDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
 
-            std::array<vk::DescriptorPoolSize, 2> poolSize;
+            std::array<vk::DescriptorPoolSize, 3> poolSize;
             poolSize[0].setType(vk::DescriptorType::eUniformBuffer);
             poolSize[0].setDescriptorCount(1);
 
             poolSize[1].setType(vk::DescriptorType::eCombinedImageSampler);
             poolSize[1].setDescriptorCount(1);
 
+            poolSize[2].setType(vk::DescriptorType::eStorageBuffer);
+            poolSize[2].setDescriptorCount(2);
+
             vk::DescriptorPoolCreateInfo poolInfo;
             poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
             poolInfo.setMaxSets(1);
@@ -751,6 +930,8 @@ public:
             rasterizationInfo.setPolygonMode(vk::PolygonMode::eFill);
             rasterizationInfo.setFrontFace(vk::FrontFace::eCounterClockwise);
             rasterizationInfo.setLineWidth(1.0f);
+            // Framebuffer y goes down and the projection doesn't flip it, so counter-clockwise front faces have normals pointing away from the eye
+            mConeSign = (rasterizationInfo.frontFace == vk::FrontFace::eCounterClockwise) ? -1.0f : 1.0f;
 
             vk::PipelineDepthStencilStateCreateInfo depthStencilInfo;
             depthStencilInfo.setDepthTestEnable(VK_TRUE);
@@ -774,9 +955,14 @@ public:
             blendingInfo.setAttachmentCount(1);
             blendingInfo.setPAttachments(&colorAttachmentBlending);
 
+            // View space offset of the drawn object
+            vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(Ogre::Vector4));
+
             vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
             pipelineLayoutInfo.setSetLayoutCount(1);
             pipelineLayoutInfo.setPSetLayouts(mDescriptorSetLayout.get());
+            pipelineLayoutInfo.setPushConstantRangeCount(1);
+            pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
             mPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
 
             vk::GraphicsPipelineCreateInfo grapichsPipelineInfo;
@@ -803,12 +989,85 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        IndexedMesh<VertexData> mesh;
+        if (!meshPath.empty()) {
+            std::cout << "Load mesh...";
+            MeshFile meshFile;
+            meshFile.Open(meshPath);
+            // Levels of detail of the file are used as is, unless the mesh is reordered
+            if (meshFile.GetHeader().lodsCount > 1 && !optimizeMesh && !meshlets) {
+                mesh = meshFile.Load<VertexData>(true);
+                mLods.assign(meshFile.GetLods(), meshFile.GetLods() + meshFile.GetHeader().lodsCount);
+            }
+            else {
+                mesh = meshFile.Load<VertexData>();
+            }
+        }
+        else {
+            std::cout << "Generate mesh...";
+            mesh = MeshBuilder::GenerateSphere<VertexData>(0.7f, rings, rings, 1.0f);
+        }
+        VertexCacheStatistics cacheBefore, cacheAfter;
+        if (optimizeMesh) {
+            MeshOptimizer::Optimize(mesh, cacheBefore, cacheAfter);
+        }
+        else if (mLods.empty()) {
+            cacheBefore = cacheAfter = MeshOptimizer::AnalyzeVertexCache(mesh.GetIndexes(), static_cast<uint32_t>(mesh.vertexes.size()));
+        }
+        std::cout << "OK" << std::endl;
+        if (mLods.empty()) {
+            std::cout << "Mesh: " << mesh.GetIndexesCount() / 3 << " triangles, " << mesh.vertexes.size() << " vertexes, ACMR = " << cacheBefore.acmr << " -> " << cacheAfter.acmr
+                << ", ATVR = " << cacheBefore.atvr << " -> " << cacheAfter.atvr << std::endl;
+        }
+
+        std::vector<Meshlet> meshletsData;
+        if (meshlets) {
+            std::cout << "Build meshlets...";
+            meshletsData = MeshletBuilder::Build(mesh);
+            mMeshletsCount = static_cast<uint32_t>(meshletsData.size());
+            mMeshletTriangles = mesh.GetIndexesCount() / 3;
+            std::cout << "OK" << std::endl;
+            std::cout << "Meshlets: " << mMeshletsCount << ", " << static_cast<float>(mMeshletTriangles) / mMeshletsCount << " triangles per meshlet" << std::endl;
+            if (lodsCount > 1) {
+                std::cout << "LODs are not used with meshlets" << std::endl;
+            }
+        }
+        else if (mLods.empty() && lodsCount > 1) {
+            std::cout << "Generate LODs...";
+            const auto start = std::chrono::high_resolution_clock::now();
+            mLods = MeshSimplifier::GenerateLods(mesh, lodsCount);
+            const double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << "OK (" << seconds << " s)" << std::endl;
+        }
+        if (mLods.empty()) {
+            mLods.push_back(MeshFileLod{ 0, mesh.GetIndexesCount(), 0.0f, 0 });
+        }
+        for (size_t i = 0; i < mLods.size(); ++i) {
+            std::cout << "LOD " << i << ": " << mLods[i].indexesCount / 3 << " triangles, error " << mLods[i].error << std::endl;
+        }
+
+        {
+            mMeshBox.setNull();
+            for (const auto & vertex : mesh.vertexes) {
+                mMeshBox.merge(Ogre::Vector3(vertex.position.x, vertex.position.y, vertex.position.z));
+            }
+            mMeshSize = mMeshBox.getSize().length();
+
+            const float spacing = 1.2f * mMeshSize;
+            for (uint32_t z = 0; z < mObjectsGrid; ++z) {
+                for (uint32_t x = 0; x < mObjectsGrid; ++x) {
+                    mObjectOffsets.emplace_back((x - 0.5f * (mObjectsGrid - 1)) * spacing, 0.0f, -(z * spacing), 0.0f);
+                    mObjectPoints.Add(Ogre::Vector3(mObjectOffsets.back().x, mObjectOffsets.back().y, mObjectOffsets.back().z), Ogre::Vector3::ZERO);
+                }
+            }
+            mObjectLods.resize(mObjectOffsets.size(), 0);
+        }
+
         std::cout << "Prepare vertex buffer...";
         {
-            auto mesh = GenerateSphere(0.7f, 32, 32);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+            mIndexType = mesh.indexType;
             const uint32_t vertexBufferSize = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size() * sizeof(decltype(mesh.indexes)::value_type));
+            const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -885,7 +1144,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
                 vk::MappedMemoryRange mappedRange;
                 mappedRange.setMemory(mIndexesMemory);
@@ -961,6 +1220,69 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        if (mMeshletsCount > 0) {
+            std::cout << "Prepare meshlets culling...";
+            if (mMultiDrawIndirect && mPhysicalDevice.getProperties().limits.maxDrawIndirectCount < mMeshletsCount) {
+                mMultiDrawIndirect = false;
+            }
+
+            const uint32_t objectsCount = static_cast<uint32_t>(mObjectOffsets.size());
+            const vk::DeviceSize commandsSize = static_cast<vk::DeviceSize>(mRenderingResources.size()) * objectsCount * 2 * mMeshletsCount * sizeof(vk::DrawIndexedIndirectCommand);
+            const vk::DeviceSize countersSize = static_cast<vk::DeviceSize>(mRenderingResources.size()) * objectsCount * 4 * sizeof(uint32_t);
+
+            CreateBuffer(meshletsData.size() * sizeof(Meshlet), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mMeshletsBuffer, mMeshletsMemory);
+            UploadBuffer(mMeshletsMemory, meshletsData.data(), meshletsData.size() * sizeof(Meshlet));
+            CreateBuffer(mObjectOffsets.size() * sizeof(Ogre::Vector4), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mObjectsBuffer, mObjectsMemory);
+            UploadBuffer(mObjectsMemory, mObjectOffsets.data(), mObjectOffsets.size() * sizeof(Ogre::Vector4));
+            CreateBuffer(commandsSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eDeviceLocal, mDrawCommandsBuffer, mDrawCommandsMemory);
+            // Counters are read back for the statistics
+            CreateBuffer(countersSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mCountersBuffer, mCountersMemory);
+
+            CreateCullPipeline(QUOTE(SHADERS_DIR) "/glsl/13.cull.comp", { mMeshletsBuffer, mObjectsBuffer, mDrawCommandsBuffer, mCountersBuffer }, sizeof(CullConstants));
+            std::cout << "OK" << std::endl;
+            if (!mMultiDrawIndirect) {
+                std::cout << "multiDrawIndirect is not supported, meshlets are drawn one by one" << std::endl;
+            }
+        }
+
+        if (mInstanced) {
+            std::cout << "Prepare instances culling...";
+            const uint32_t instancesCount = static_cast<uint32_t>(mObjectOffsets.size());
+            for (const auto & lod : mLods) {
+                mInstanceCommands.push_back(vk::DrawIndexedIndirectCommand(lod.indexesCount, 0, lod.firstIndex, 0, 0));
+            }
+            const vk::DeviceSize commandsSize = static_cast<vk::DeviceSize>(mRenderingResources.size()) * mInstanceCommands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+            const vk::DeviceSize visibleSize = static_cast<vk::DeviceSize>(mRenderingResources.size()) * mLods.size() * instancesCount * sizeof(uint32_t);
+
+            CreateBuffer(instancesCount * sizeof(Ogre::Vector4), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mObjectsBuffer, mObjectsMemory);
+            UploadBuffer(mObjectsMemory, mObjectOffsets.data(), instancesCount * sizeof(Ogre::Vector4));
+            CreateBuffer(mLods.size() * sizeof(MeshFileLod), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mLodsBuffer, mLodsMemory);
+            UploadBuffer(mLodsMemory, mLods.data(), mLods.size() * sizeof(MeshFileLod));
+            CreateBuffer(visibleSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, mVisibleInstancesBuffer, mVisibleInstancesMemory);
+            // Commands are read back for the statistics
+            CreateBuffer(commandsSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mDrawCommandsBuffer, mDrawCommandsMemory);
+
+            std::array<vk::DescriptorBufferInfo, 2> buffersInfo;
+            buffersInfo[0] = vk::DescriptorBufferInfo(mObjectsBuffer, 0, VK_WHOLE_SIZE);
+            buffersInfo[1] = vk::DescriptorBufferInfo(mVisibleInstancesBuffer, 0, VK_WHOLE_SIZE);
+            std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
+            for (uint32_t i = 0; i < writeDescriptorsInfo.size(); ++i) {
+                writeDescriptorsInfo[i].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+                writeDescriptorsInfo[i].setDstSet(mDescriptorSet);
+                writeDescriptorsInfo[i].setDstBinding(2 + i);
+                writeDescriptorsInfo[i].setDstArrayElement(0);
+                writeDescriptorsInfo[i].setDescriptorCount(1);
+                writeDescriptorsInfo[i].setPBufferInfo(&buffersInfo[i]);
+            }
+            mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+
+            CreateCullPipeline(QUOTE(SHADERS_DIR) "/glsl/13.instances.comp", { mObjectsBuffer, mVisibleInstancesBuffer, mDrawCommandsBuffer, mLodsBuffer }, sizeof(InstancesCullConstants));
+            std::cout << "OK" << std::endl;
+        }
+
         // Preparing sync resources
         for (auto & resource : mRenderingResources) {
             vk::FenceCreateInfo fenceInfo;
@@ -973,6 +1295,8 @@ public:
         mSemaphoreAvailable = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
         mSemaphoreFinished  = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
 
+        mDrawTimer.Init(mDevice, mPhysicalDevice, static_cast<uint32_t>(mRenderingResources.size()), "Draw");
+
         CanRender = true;
     }
 
@@ -981,6 +1305,110 @@ public:
         return true;
     }
 
+    /**
+     * Draws each object in the frustum with the level of detail selected by the projected error
+     */
+    void DrawLods(vk::CommandBuffer & cmdBuffer, uint32_t resourceIdx)
+    {
+        // All objects share the rotation, so their boxes are the view space box of the mesh shifted by the offsets
+        const Ogre::Matrix4 modelView = mMatrixes.modelView.transpose();
+        const Ogre::Vector3 meshCenter = mMeshBox.getCenter();
+        const Ogre::Vector3 meshHalfSize = mMeshBox.getHalfSize();
+        Ogre::Vector3 boxCenter = mPosition;
+        Ogre::Vector3 boxHalfSize = Ogre::Vector3::ZERO;
+        for (size_t r = 0; r < 3; ++r) {
+            for (size_t c = 0; c < 3; ++c) {
+                boxCenter[r] += modelView[r][c] * meshCenter[c];
+                boxHalfSize[r] += std::abs(modelView[r][c]) * meshHalfSize[c];
+            }
+        }
+        const Frustum frustum = Frustum::FromMatrix(mMatrixes.projection.transpose()).Inflated(boxCenter, boxHalfSize);
+        mObjectsVisible += FrustumCuller::CullParallel(frustum, mObjectPoints, mObjectVisible);
+
+        // Objects rotate around own centers, so the distance to the camera is the distance to the shifted center
+        uint64_t trianglesDrawn = 0;
+        for (size_t i = 0; i < mObjectOffsets.size(); ++i) {
+            if (!mObjectVisible[i]) {
+                continue;
+            }
+            const Ogre::Vector3 center = mPosition + Ogre::Vector3(mObjectOffsets[i].x, mObjectOffsets[i].y, mObjectOffsets[i].z);
+            mObjectLods[i] = MeshSimplifier::SelectLod(mLods, mMeshSize, center.length(), mMatrixes.projection[1][1], static_cast<float>(mFramebufferExtents.height), mLodPixelError);
+            trianglesDrawn += mLods[mObjectLods[i]].indexesCount / 3;
+        }
+
+        mDrawTimer.Begin(cmdBuffer, resourceIdx);
+
+        // Primary pipeline
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
+        for (size_t i = 0; i < mObjectOffsets.size(); ++i) {
+            if (!mObjectVisible[i]) {
+                continue;
+            }
+            const MeshFileLod & lod = mLods[mObjectLods[i]];
+            cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Ogre::Vector4), &mObjectOffsets[i]);
+            cmdBuffer.drawIndexed(lod.indexesCount, 1, lod.firstIndex, 0, 0);
+        }
+
+        // Secondary pipeline
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
+        for (size_t i = 0; i < mObjectOffsets.size(); ++i) {
+            if (!mObjectVisible[i]) {
+                continue;
+            }
+            const MeshFileLod & lod = mLods[mObjectLods[i]];
+            cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Ogre::Vector4), &mObjectOffsets[i]);
+            cmdBuffer.drawIndexed(lod.indexesCount, 1, lod.firstIndex, 0, 0);
+        }
+
+        mDrawTimer.End(cmdBuffer, resourceIdx);
+
+        mTrianglesDrawn += trianglesDrawn;
+        mTrianglesFull += static_cast<uint64_t>(mLods[0].indexesCount / 3) * mObjectOffsets.size();
+        if (++mStatsFrames % 1000 == 0 && mLods.size() > 1) {
+            const double drawMilliseconds = mDrawTimer.GetAverageMilliseconds();
+            std::cout << "LOD: " << mTrianglesDrawn / mStatsFrames << " of " << mTrianglesFull / mStatsFrames << " triangles per frame, "
+                << 100.0 * (mTrianglesFull - mTrianglesDrawn) / mTrianglesFull << "% saved";
+            if (drawMilliseconds > 0.0) {
+                // Both batches draw the triangles
+                std::cout << ", " << 2.0 * mTrianglesDrawn / mStatsFrames / (drawMilliseconds * 1000.0) << " Mtriangles/s";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    /**
+     * Draws the batch of each object written by the culling pass, slots after the visible meshlets are empty draws
+     */
+    void DrawCulledBatches(vk::CommandBuffer & cmdBuffer, uint32_t commandsBase, uint32_t batch)
+    {
+        const vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+        for (size_t i = 0; i < mObjectOffsets.size(); ++i) {
+            const vk::DeviceSize offset = (commandsBase + (2 * i + batch) * mMeshletsCount) * stride;
+            cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(Ogre::Vector4), &mObjectOffsets[i]);
+            if (mMultiDrawIndirect) {
+                cmdBuffer.drawIndexedIndirect(mDrawCommandsBuffer, offset, mMeshletsCount, static_cast<uint32_t>(stride));
+            }
+            else {
+                for (uint32_t j = 0; j < mMeshletsCount; ++j) {
+                    cmdBuffer.drawIndexedIndirect(mDrawCommandsBuffer, offset + j * stride, 1, static_cast<uint32_t>(stride));
+                }
+            }
+        }
+    }
+
+    /**
+     * One indirect draw per level of detail with the number of visible instances written by the culling pass
+     */
+    void DrawVisibleInstances(vk::CommandBuffer & cmdBuffer, uint32_t commandsBase, uint32_t visibleBase)
+    {
+        const uint32_t instancesCount = static_cast<uint32_t>(mObjectOffsets.size());
+        for (uint32_t lod = 0; lod < mInstanceCommands.size(); ++lod) {
+            const uint32_t firstVisible = visibleBase + lod * instancesCount;
+            cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(firstVisible), &firstVisible);
+            cmdBuffer.drawIndexedIndirect(mDrawCommandsBuffer, (commandsBase + lod) * sizeof(vk::DrawIndexedIndirectCommand), 1, sizeof(vk::DrawIndexedIndirectCommand));
+        }
+    }
+
     bool Draw() override
     {
         constexpr uint64_t TIMEOUT = 1 * 1000 * 1000 * 1000; // 1 second in nanos
@@ -993,17 +1421,71 @@ public:
 
         auto & renderingResource = mRenderingResources[imageIdx.value];
 
+        const auto frameStart = std::chrono::high_resolution_clock::now();
+        if (mFrames > 0) {
+            mFramesSeconds += std::chrono::duration_cast<std::chrono::duration<double>>(frameStart - mLastFrame).count();
+        }
+        mLastFrame = frameStart;
+
         if (vk::Result::eSuccess != mDevice->waitForFences(1, renderingResource.fence.get(), VK_FALSE, TIMEOUT)) {
             std::cout << "Waiting for fence takes too long!" << std::endl;
             return false;
         }
         mDevice->resetFences(1, renderingResource.fence.get());
+        mDrawTimer.Collect(imageIdx.value);
+
+        const uint32_t objectsCount = static_cast<uint32_t>(mObjectOffsets.size());
+        const uint32_t countersBase = imageIdx.value * objectsCount;
+        const uint32_t commandsBase = countersBase * 2 * mMeshletsCount;
+        const uint32_t lodsCount = static_cast<uint32_t>(mInstanceCommands.size());
+        const uint32_t instanceCommandsBase = imageIdx.value * lodsCount;
+        const uint32_t visibleBase = instanceCommandsBase * objectsCount;
+        if (mInstanced && renderingResource.culled) {
+            // Instance counts of the previous frame of this resource
+            const vk::DrawIndexedIndirectCommand* commands = static_cast<const vk::DrawIndexedIndirectCommand*>(
+                mDevice->mapMemory(mDrawCommandsMemory, instanceCommandsBase * sizeof(vk::DrawIndexedIndirectCommand), lodsCount * sizeof(vk::DrawIndexedIndirectCommand)));
+            if (commands == nullptr) {
+                throw std::runtime_error("Failed to map memory for commands buffer");
+            }
+            for (uint32_t i = 0; i < lodsCount; ++i) {
+                mInstancesVisible += commands[i].instanceCount;
+                mTrianglesDrawn += static_cast<uint64_t>(commands[i].instanceCount) * commands[i].indexCount / 3;
+            }
+            mDevice->unmapMemory(mDrawCommandsMemory);
+            mTrianglesFull += static_cast<uint64_t>(mLods[0].indexesCount / 3) * objectsCount;
+            ++mStatsFrames;
+        }
+        if (mMeshletsCount > 0 && renderingResource.culled) {
+            // Results of the previous frame of this resource, the fence is signaled
+            const uint32_t* counters = static_cast<const uint32_t*>(mDevice->mapMemory(mCountersMemory, countersBase * 4 * sizeof(uint32_t), objectsCount * 4 * sizeof(uint32_t)));
+            if (counters == nullptr) {
+                throw std::runtime_error("Failed to map memory for counters buffer");
+            }
+            for (uint32_t i = 0; i < objectsCount; ++i) {
+                mMeshletsVisible += counters[4 * i];
+                mTrianglesDrawn += counters[4 * i + 2];
+            }
+            mDevice->unmapMemory(mCountersMemory);
+            mMeshletsTotal += static_cast<uint64_t>(mMeshletsCount) * objectsCount;
+            mTrianglesFull += static_cast<uint64_t>(mMeshletTriangles) * objectsCount;
+            if (++mStatsFrames % 1000 == 0) {
+                std::cout << "Meshlets: " << mMeshletsVisible / mStatsFrames << " of " << mMeshletsTotal / mStatsFrames << " per frame, "
+                    << mTrianglesDrawn / mStatsFrames << " of " << mTrianglesFull / mStatsFrames << " triangles, "
+                    << 100.0 * (mTrianglesFull - mTrianglesDrawn) / mTrianglesFull << "% culled";
+                const double drawMilliseconds = mDrawTimer.GetAverageMilliseconds();
+                if (drawMilliseconds > 0.0) {
+                    std::cout << ", draw " << drawMilliseconds << " ms";
+                }
+                std::cout << std::endl;
+            }
+        }
 
         // Prepare command buffer
         auto& cmdBuffer = renderingResource.commandBuffer;
         vk::CommandBufferBeginInfo beginInfo;
         beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
         cmdBuffer->begin(beginInfo);
+        const auto recordStart = std::chrono::high_resolution_clock::now();
 
         vk::ImageSubresourceRange range;
         range.aspectMask = vk::ImageAspectFlagBits::eColor;
@@ -1057,6 +1539,63 @@ public:
         renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
         renderPassInfo.setClearValueCount(static_cast<uint32_t>(clearValues.size()));
         renderPassInfo.setPClearValues(&clearValues[0]);
+        mDrawTimer.Reset(*cmdBuffer, imageIdx.value);
+
+        if (mMeshletsCount > 0) {
+            // Unused slots of the batches stay zero and draw nothing
+            cmdBuffer->fillBuffer(mDrawCommandsBuffer, commandsBase * sizeof(vk::DrawIndexedIndirectCommand), objectsCount * 2 * mMeshletsCount * sizeof(vk::DrawIndexedIndirectCommand), 0);
+            cmdBuffer->fillBuffer(mCountersBuffer, countersBase * 4 * sizeof(uint32_t), objectsCount * 4 * sizeof(uint32_t), 0);
+
+            vk::MemoryBarrier barrierResetToCull;
+            barrierResetToCull.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrierResetToCull.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &barrierResetToCull, 0, nullptr, 0, nullptr);
+
+            const CullConstants constants = { mMeshletsCount, objectsCount, commandsBase, countersBase, mConeSign };
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mCullPipeline);
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mCullPipelineLayout, 0, 1, mCullDescriptorSet.get(), 0, nullptr);
+            cmdBuffer->pushConstants(mCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+            cmdBuffer->dispatch((mMeshletsCount * objectsCount + 63) / 64, 1, 1);
+
+            vk::MemoryBarrier barrierCullToDraw;
+            barrierCullToDraw.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierCullToDraw.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eHostRead;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), 1, &barrierCullToDraw, 0, nullptr, 0, nullptr);
+        }
+
+        if (mInstanced) {
+            // The draw time includes the culling
+            mDrawTimer.Begin(*cmdBuffer, imageIdx.value);
+
+            cmdBuffer->updateBuffer(mDrawCommandsBuffer, instanceCommandsBase * sizeof(vk::DrawIndexedIndirectCommand), lodsCount * sizeof(vk::DrawIndexedIndirectCommand), mInstanceCommands.data());
+
+            vk::MemoryBarrier barrierResetToCull;
+            barrierResetToCull.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrierResetToCull.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags(), 1, &barrierResetToCull, 0, nullptr, 0, nullptr);
+
+            InstancesCullConstants constants;
+            constants.boxCenter = Ogre::Vector4(mMeshBox.getCenter().x, mMeshBox.getCenter().y, mMeshBox.getCenter().z, 1.0f);
+            constants.boxHalfSize = Ogre::Vector4(mMeshBox.getHalfSize().x, mMeshBox.getHalfSize().y, mMeshBox.getHalfSize().z, 0.0f);
+            constants.instancesCount = objectsCount;
+            constants.lodsCount = lodsCount;
+            constants.commandsBase = instanceCommandsBase;
+            constants.visibleBase = visibleBase;
+            constants.meshSize = mMeshSize;
+            constants.viewportHeight = static_cast<float>(mFramebufferExtents.height);
+            constants.pixelError = mLodPixelError;
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mCullPipeline);
+            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mCullPipelineLayout, 0, 1, mCullDescriptorSet.get(), 0, nullptr);
+            cmdBuffer->pushConstants(mCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(constants), &constants);
+            cmdBuffer->dispatch((objectsCount + 63) / 64, 1, 1);
+
+            vk::MemoryBarrier barrierCullToDraw;
+            barrierCullToDraw.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierCullToDraw.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eHostRead;
+            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eHost,
+                vk::DependencyFlags(), 1, &barrierCullToDraw, 0, nullptr, 0, nullptr);
+        }
+
         cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
 
         // Update matrixes
@@ -1082,15 +1621,26 @@ public:
 
         vk::DeviceSize offset = 0;
         cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
-
-        // Primary pipeline
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
-
-        // Secondary pipeline
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
+
+        if (mMeshletsCount > 0) {
+            mDrawTimer.Begin(*cmdBuffer, imageIdx.value);
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
+            DrawCulledBatches(*cmdBuffer, commandsBase, 0);
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
+            DrawCulledBatches(*cmdBuffer, commandsBase, 1);
+            mDrawTimer.End(*cmdBuffer, imageIdx.value);
+        }
+        else if (mInstanced) {
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
+            DrawVisibleInstances(*cmdBuffer, instanceCommandsBase, visibleBase);
+            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
+            DrawVisibleInstances(*cmdBuffer, instanceCommandsBase, visibleBase);
+            mDrawTimer.End(*cmdBuffer, imageIdx.value);
+        }
+        else {
+            DrawLods(*cmdBuffer, imageIdx.value);
+        }
 
         cmdBuffer->endRenderPass();
 
@@ -1106,6 +1656,7 @@ public:
         cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
         
         cmdBuffer->end();
+        mRecordSeconds += std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - recordStart).count();
 
         // Submit
         vk::PipelineStageFlags waitDstStageMask = vk::PipelineStageFlagBits::eTransfer;
@@ -1122,6 +1673,21 @@ public:
             std::cout << "Failed to submit command! Stoppping." << std::endl;
             return false;
         }
+        mDrawTimer.Submitted(imageIdx.value);
+        renderingResource.culled = (mMeshletsCount > 0) || mInstanced;
+
+        if (++mFrames % 1000 == 0) {
+            const char* path = mInstanced ? "Instanced: " : ((mMeshletsCount > 0) ? "Meshlets: " : "Draw per object: ");
+            std::cout << path << mObjectOffsets.size() << " objects, frame " << 1000.0 * mFramesSeconds / (mFrames - 1)
+                << " ms, record " << 1000.0 * mRecordSeconds / mFrames << " ms, GPU " << mDrawTimer.GetAverageMilliseconds() << " ms";
+            if (mInstanced && mStatsFrames > 0) {
+                std::cout << ", " << mInstancesVisible / mStatsFrames << " visible instances, " << mTrianglesDrawn / mStatsFrames << " of " << mTrianglesFull / mStatsFrames << " triangles";
+            }
+            else if (mMeshletsCount == 0 && mStatsFrames > 0) {
+                std::cout << ", " << mObjectsVisible / mStatsFrames << " visible objects (" << FrustumCuller::GetIsaName(FrustumCuller::GetBestIsa()) << ")";
+            }
+            std::cout << std::endl;
+        }
 
         vk::PresentInfoKHR presentInfo;
         presentInfo.waitSemaphoreCount = 1;
@@ -1171,9 +1737,50 @@ public:
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
+        // Pass --rings N to change the sphere tessellation and --optimize to reorder it for the vertex cache and overdraw
+        // --mesh file.mesh draws a mesh made by MeshConverter instead of the sphere
+        // --objects N draws N x N copies going away from the camera, --lods N generates levels of detail selected for --lod-error pixels (1 by default)
+        // --meshlets splits the mesh into meshlets culled on GPU by the frustum and the normal cone, and draws them with indirect draws
+        // --instanced culls the objects on GPU and draws the visible ones with one indirect instanced draw per level of detail
+        uint32_t rings = 32;
+        bool optimizeMesh = false;
+        std::string meshPath;
+        uint32_t lodsCount = 1;
+        uint32_t objectsGrid = 1;
+        float lodPixelError = 1.0f;
+        bool meshlets = false;
+        bool instanced = false;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (arg == "--rings" && i + 1 < argc) {
+                rings = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--optimize") {
+                optimizeMesh = true;
+            }
+            else if (arg == "--mesh" && i + 1 < argc) {
+                meshPath = argv[++i];
+            }
+            else if (arg == "--lods" && i + 1 < argc) {
+                lodsCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--objects" && i + 1 < argc) {
+                objectsGrid = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--lod-error" && i + 1 < argc) {
+                lodPixelError = std::stof(argv[++i]);
+            }
+            else if (arg == "--meshlets") {
+                meshlets = true;
+            }
+            else if (arg == "--instanced") {
+                instanced = true;
+            }
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("13 - Geometry shader", 512, 512)) {
@@ -1181,7 +1788,7 @@ int main()
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, rings, optimizeMesh, meshPath, lodsCount, objectsGrid, lodPixelError, meshlets, instanced);
         window.SetMouseListener(&application);
         if (!window.RenderingLoop(application)) {
             return -1;
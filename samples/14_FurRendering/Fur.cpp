@@ -15,6 +15,9 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
+#include <MeshFile.h>
+#include <ParallelRecorder.h>
 
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
@@ -32,11 +35,7 @@ class Sample_03_Window
         Ogre::Vector2 texcoord;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint16_t> indexes;
-    };
+    using Mesh = IndexedMesh<VertexData>;
 
     struct VertexUniformBuffer
     {
@@ -90,6 +89,7 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
     VulkanHolder<vk::Buffer> mMatrixesBuffer;
     VulkanHolder<vk::DeviceMemory> mMatrixesMemory;
@@ -98,6 +98,9 @@ class Sample_03_Window
 
     std::vector<RenderingResource> mRenderingResources;
 
+    // Draws of the primary pipeline and of mFurPasses are recorded into secondary buffers on several threads
+    ParallelRecorder mRecorder;
+
     vk::PhysicalDevice mPhysicalDevice;
     vk::Queue mCommandQueue;
 
@@ -161,111 +164,15 @@ class Sample_03_Window
         dst[3][3] = 0.0f;
     }
 
-    static Mesh GenerateSphere(const float radius, const uint16_t rings, const uint16_t segments)
-    {
-        assert(rings > 1);
-        assert(segments > 2);
-
-        Mesh sphere;
-
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        const float deltaRingAngle = static_cast<float>(M_PI / rings);
-        const float deltaSegAngle = static_cast<float>(2.0 * M_PI / segments);
-        uint16_t verticeIndex = 0;
-
-        // Generate the group of rings for the sphere
-        for (uint16_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
-            float r0 = radius * std::sin(ringIdx * deltaRingAngle);
-            float y0 = radius * std::cos(ringIdx * deltaRingAngle);
-            // Generate the group of segments for the current ring
-            for (uint16_t segIdx = 0; segIdx <= segments; ++segIdx) {
-                float x0 = r0 * std::sin(segIdx * deltaSegAngle);
-                float z0 = r0 * std::cos(segIdx * deltaSegAngle);
-
-                Ogre::Vector3 normal = Ogre::Vector3(x0, y0, z0).normalisedCopy();
-
-                VertexData vertex;
-                vertex.position = { x0, y0, z0, 1.0f };
-                vertex.normal = { normal.x, normal.y, normal.z, 0.0f };
-                vertex.texcoord = { static_cast<float>(segIdx) / segments, static_cast<float>(ringIdx) / rings };
-                sphere.vertexes.push_back(vertex);
-
-                if (ringIdx != rings) {
-                    // each vertex (except the last) has six indicies pointing to it
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    sphere.indexes.push_back(verticeIndex + segments);
-                    sphere.indexes.push_back(verticeIndex + segments + 1);
-                    sphere.indexes.push_back(verticeIndex + 1);
-                    sphere.indexes.push_back(verticeIndex);
-                    ++verticeIndex;
-                }
-            }
-        }
-        return sphere;
-    }
+    std::vector<uint32_t> SortByDepth(const Mesh & mesh, const Ogre::Matrix4 & modelview) {
 
-    static Mesh GenerateCube(const float size)
-    {
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        Mesh cube;
-        const float halfSize = size / 2.0f;
-
-        // front side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-        // back side  
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-        // left side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-        // right side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-        // up side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-        // down side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 1.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f,  0.0f), Ogre::Vector2(1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f,  0.0f), Ogre::Vector2(0.0f, 0.0f) });
-
-        cube.indexes = { /* front */   0,  1,  2,    0,  2,  3,
-            /* back  */   4,  5,  6,    4,  6,  7,
-            /* left  */   8,  9, 10,    8, 10, 11,
-            /* right */  12, 13, 14,   12, 14, 15,
-            /* up    */  16, 17, 18,   16, 18, 19,
-            /* down */   20, 21, 22,   20, 22, 23
-        };
-
-        return cube;
-    }
+        std::vector<std::tuple<uint32_t, uint32_t, uint32_t, float>> indexAndDepth;
 
-    std::vector<uint16_t> SortByDepth(const Mesh & mesh, const Ogre::Matrix4 & modelview) {
-
-        std::vector<std::tuple<uint16_t, uint16_t, uint16_t, float>> indexAndDepth;
-
-        assert(mesh.indexes.size() % 3 == 0);
-        for (uint16_t j = 0; j < mesh.indexes.size(); j += 3) {
-            uint16_t i0 = mesh.indexes[j];
-            uint16_t i1 = mesh.indexes[j + 1];
-            uint16_t i2 = mesh.indexes[j + 2];
+        assert(mesh.GetIndexesCount() % 3 == 0);
+        for (uint32_t j = 0; j < mesh.GetIndexesCount(); j += 3) {
+            uint32_t i0 = mesh.GetIndex(j);
+            uint32_t i1 = mesh.GetIndex(j + 1);
+            uint32_t i2 = mesh.GetIndex(j + 2);
 
             Ogre::Vector4 v0 = mesh.vertexes[i0].position * modelview;
             Ogre::Vector4 v1 = mesh.vertexes[i1].position * modelview;
@@ -279,8 +186,8 @@ class Sample_03_Window
             return std::get<3>(t1) < std::get<3>(t2);
         });
 
-        std::vector<uint16_t> indexes;
-        indexes.reserve(mesh.indexes.size());
+        std::vector<uint32_t> indexes;
+        indexes.reserve(mesh.GetIndexesCount());
         for (const auto & t : indexAndDepth) {
             indexes.push_back(std::get<0>(t));
             indexes.push_back(std::get<1>(t));
@@ -378,7 +285,7 @@ public:
     }
 
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, const std::string & meshPath)
     {
         vk::ApplicationInfo applicationInfo;
         applicationInfo.pApplicationName = "Vulkan sample: Window";
@@ -583,7 +490,10 @@ public:
                 }
                 resource.commandBuffer = VulkanHolder<vk::CommandBuffer>(buffer, [this](vk::CommandBuffer & buffer) { mDevice->freeCommandBuffers(mCommandPool, 1, &buffer); });
             }
-            std::cout << "OK" << std::endl;
+
+            const uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+            mRecorder.Init(mDevice, mQueueFamilyPresent, static_cast<uint32_t>(mRenderingResources.size()), threads);
+            std::cout << "OK (" << mRecorder.GetThreadsCount() << " recording threads)" << std::endl;
         }
 
         /* Setting up a render pass now
@@ -969,18 +879,24 @@ public:
 
         std::cout << "Prepare vertex buffer...";
         {
-            //auto mesh = GenerateSphere(0.7f, 32, 32);
-            mMesh = std::make_unique<Mesh>(GenerateSphere(0.7f, 32, 32));
+            if (!meshPath.empty()) {
+                MeshFile meshFile;
+                meshFile.Open(meshPath);
+                mMesh = std::make_unique<Mesh>(meshFile.Load<VertexData>());
+            }
+            else {
+                mMesh = std::make_unique<Mesh>(MeshBuilder::GenerateSphere<VertexData>(0.7f, 32, 32));
+            }
             const Mesh & mesh = *mMesh;
 
             auto texScale = Ogre::Matrix4::getScale(3.0f, 3.0f, 1.0f);
             auto texRotation = Ogre::Quaternion::IDENTITY;
             mMatrixes.texTransform = texScale * texRotation;
 
-            //auto mesh = GenerateCube(0.7f);
-            mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+            mIndexesNumber = mesh.GetIndexesCount();
+            mIndexType = mesh.indexType;
             const uint32_t vertexBufferSize = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-            const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size() * sizeof(decltype(mesh.indexes)::value_type));
+            const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
             {
                 vk::BufferCreateInfo bufferInfo;
@@ -1057,7 +973,7 @@ public:
                 if (devicePtr == nullptr) {
                     throw std::runtime_error("Failed to map memory for vertex buffer");
                 }
-                std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+                std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
                 mDevice->unmapMemory(mIndexesMemory);
             }
@@ -1451,7 +1367,7 @@ public:
         renderPassInfo.setRenderArea(vk::Rect2D(vk::Offset2D(0, 0), mFramebufferExtents));
         renderPassInfo.setClearValueCount(static_cast<uint32_t>(clearValues.size()));
         renderPassInfo.setPClearValues(&clearValues[0]);
-        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eInline);
+        cmdBuffer->beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
 
         // Update matrixes
         mPosition = Ogre::Vector3(0.0f, 0.0f, -3.0f);
@@ -1468,37 +1384,54 @@ public:
         devicePtr = nullptr;
 
         auto sortedIndexes = SortByDepth(*mMesh, mMatrixes.modelView);
-        devicePtr = mDevice->mapMemory(mIndexesMemory, 0, sortedIndexes.size() * sizeof(uint16_t));
+        devicePtr = mDevice->mapMemory(mIndexesMemory, 0, mMesh->GetIndexesSize());
         if (devicePtr == nullptr) {
             throw std::runtime_error("Failed to map memory for vertex buffer");
         }
-        std::memcpy(devicePtr, sortedIndexes.data(), sortedIndexes.size() * sizeof(uint16_t));
+        MeshBuilder::PackIndexes(sortedIndexes, mIndexType, devicePtr);
 
         mDevice->unmapMemory(mIndexesMemory);
 
-        // Could be static, but let's try dynamic approach
-        vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
-        vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
-        cmdBuffer->setViewport(0, 1, &viewport);
-        cmdBuffer->setScissor(0, 1, &scissor);
-
-        cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
-
-        vk::DeviceSize offset = 0;
-        cmdBuffer->bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
-        cmdBuffer->bindIndexBuffer(mIndexesBuffer, 0, vk::IndexType::eUint16);
-
-        // Primary pipeline
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
-        cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+        // Item 0 is the primary pipeline draw, item i > 0 is the fur pass i - 1
+        // Secondary buffers don't inherit any state, so every slice binds everything it needs
+        auto recordDraws = [this](vk::CommandBuffer & secondary, uint32_t begin, uint32_t end) {
+            // Could be static, but let's try dynamic approach
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(mFramebufferExtents.width), static_cast<float>(mFramebufferExtents.height), 0.0f, 1.0f);
+            vk::Rect2D   scissor(vk::Offset2D(0, 0), mFramebufferExtents);
+            secondary.setViewport(0, 1, &viewport);
+            secondary.setScissor(0, 1, &scissor);
+
+            secondary.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipelineLayout, 0, 1, mDescriptorSet.get(), 0, nullptr);
+
+            vk::DeviceSize offset = 0;
+            secondary.bindVertexBuffers(0, 1, mVertexBuffer.get(), &offset);
+            secondary.bindIndexBuffer(mIndexesBuffer, 0, mIndexType);
+
+            uint32_t idx = begin;
+            if (idx == 0) {
+                // Primary pipeline
+                secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelinePrimary);
+                secondary.drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+                ++idx;
+            }
+            if (idx < end) {
+                // Secondary pipeline
+                secondary.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
+            }
+            for (; idx < end; ++idx) {
+                const PushConstants & pushc = mFurPasses[idx - 1];
+                secondary.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eGeometry, 0, sizeof(PushConstants), &pushc);
+                secondary.drawIndexed(mIndexesNumber, 1, 0, 0, 0);
+            }
+        };
 
-        // Secondary pipeline
-        cmdBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, mPipelineSecondary);
+        vk::CommandBufferInheritanceInfo inheritanceInfo;
+        inheritanceInfo.setRenderPass(mRenderPass);
+        inheritanceInfo.setSubpass(0);
+        inheritanceInfo.setFramebuffer(renderingResource.framebuffer);
 
-        for (const PushConstants & pushc : mFurPasses) {
-            cmdBuffer->pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eGeometry, 0, sizeof(PushConstants), &pushc);
-            cmdBuffer->drawIndexed(mIndexesNumber, 1, 0, 0, 0);
-        }
+        const auto & secondaries = mRecorder.Record(imageIdx.value, inheritanceInfo, static_cast<uint32_t>(mFurPasses.size() + 1), recordDraws);
+        cmdBuffer->executeCommands(static_cast<uint32_t>(secondaries.size()), &secondaries[0]);
 
         cmdBuffer->endRenderPass();
 
@@ -1579,9 +1512,17 @@ public:
 
 };
 
-int main()
+int main(int argc, char** argv)
 {
     try {
+        // Pass --mesh file.mesh to draw fur on a mesh made by MeshConverter --texcoord instead of the sphere
+        std::string meshPath;
+        for (int i = 1; i < argc; ++i) {
+            if (std::string(argv[i]) == "--mesh" && i + 1 < argc) {
+                meshPath = argv[++i];
+            }
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("14 - Fur rendering", 512, 512)) {
@@ -1589,7 +1530,7 @@ int main()
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, meshPath);
         window.SetMouseListener(&application);
         if (!window.RenderingLoop(application)) {
             return -1;
@@ -5,18 +5,67 @@
 * Copyright (c) 2016 Alexey Gruzdev
 */
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <string>
 #include <thread>
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <FftConvolution.h>
+#include <ResourceStateTracker.h>
+#include <RenderGraph.h>
+
+#include "BlurBatch.h"
+
+/**
+ * Blur algorithm
+ */
+enum class BlurMode
+{
+    Iterative, // 8 iterations of the fixed 7 taps kernel
+    IterativeHalf,  // same 8 iterations on rgba16f images, filtered fetches average 2 taps
+    IterativeFloat, // same 8 iterations on rgba32f images
+    Gaussian,  // single separable pass with runtime radius and sigma
+    Box,       // 3 separable sliding window box passes, cost doesn't depend on radius
+    Fft,       // 2D convolution in frequency domain with Gaussian or user kernel, cost doesn't depend on radius
+    Pyramid    // Dual Kawase downsample and upsample through mip levels, radius doubles with each level
+};
 
 class Sample_03_Window
     : public ApiWithoutSecrets::OS::TutorialBase
 {
     static const uint32_t BLOCK_SIZE = 8;
+    // Must match 16.gauss.comp
+    static const uint32_t GAUSS_GROUP_SIZE = 128;
+    static const uint32_t GAUSS_MAX_RADIUS = 128;
+    // Must match 16.box.comp
+    static const uint32_t BOX_GROUP_SIZE = 64;
+    // Shortest row segment of one invocation
+    static const uint32_t BOX_MIN_SEGMENT = 32;
+    static const uint32_t BOX_PASSES = 3;
+
+    // Must match 16.pyramid.comp
+    static const uint32_t PYRAMID_GROUP_SIZE = 16;
+    static const uint32_t PYRAMID_MAX_LEVELS = 6;
+    static const vk::Format PYRAMID_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+
+    // Float iterative blur
+    enum FloatFormat
+    {
+        FLOAT_RGBA16F,
+        FLOAT_RGBA32F,
+        FLOAT_FORMAT_COUNT
+    };
+
+    static const uint32_t BENCHMARK_REPEATS = 5;
+    // Draw workgroup covers 16x16 invocations with 2x2 pixels each, must match 16.draw.comp
+    static const uint32_t DRAW_TILE_SIZE = 32;
 
     struct RenderingResource
     {
@@ -30,8 +79,7 @@ class Sample_03_Window
 
     struct ComputeResource
     {
-        VulkanHolder<vk::Image> image;
-        VulkanHolder<vk::DeviceMemory> memory;
+        vk::Image image; // created by the render graph
         VulkanHolder<vk::ImageView> view;
         VulkanHolder<vk::Sampler> sampler;
     };
@@ -46,6 +94,17 @@ class Sample_03_Window
     VulkanHolder<vk::Image> mStagingImage;
     VulkanHolder<vk::DeviceMemory> mStagingImageMemory;
 
+    // Upload, blur pass per available mode (only the selected one is enabled) and draw
+    // Working images of all modes are transient, so in benchmark the modes share memory
+    // Declared before views of its images to be destroyed after them
+    RenderGraph mRenderGraph;
+    RenderGraph::ResourceId mGraphStaging;
+    RenderGraph::ResourceId mGraphSwapchain;
+    std::array<RenderGraph::ResourceId, 2> mGraphCompute;
+    RenderGraph::ResourceId mGraphPyramid;
+    std::array<std::array<RenderGraph::ResourceId, 2>, FLOAT_FORMAT_COUNT> mGraphFloat;
+    vk::DescriptorSet mDrawDescriptorSet; // of the acquired swapchain image
+
     VulkanHolder<vk::Sampler> mProcessedImageSampler;
 
     VulkanHolder<vk::ShaderModule> mDrawShader;
@@ -65,6 +124,84 @@ class Sample_03_Window
     VulkanHolder<vk::PipelineLayout> mBlurPipelineLayout;
     VulkanHolder<vk::Pipeline> mBlurPipeline;
 
+    // Gaussian
+    BlurMode mBlurMode;
+    uint32_t mGaussRadius;
+    float mGaussSigma;
+
+    VulkanHolder<vk::ShaderModule> mGaussShader;
+    VulkanHolder<vk::DescriptorSetLayout> mGaussDescriptorSetLayout;
+    std::array<VulkanHolder<vk::DescriptorSet>, 2> mGaussDescriptorSets;
+    VulkanHolder<vk::PipelineLayout> mGaussPipelineLayout;
+    VulkanHolder<vk::Pipeline> mGaussPipeline;
+
+    VulkanHolder<vk::Buffer> mGaussWeightsBuffer;
+    VulkanHolder<vk::DeviceMemory> mGaussWeightsMemory;
+
+    // Box
+    uint32_t mBoxRadius;
+
+    // Must match push constants of 16.box.comp
+    struct BoxConstants
+    {
+        uint32_t radius;
+        uint32_t segmentLength;
+    };
+
+    VulkanHolder<vk::ShaderModule> mBoxShader;
+    VulkanHolder<vk::PipelineLayout> mBoxPipelineLayout;
+    VulkanHolder<vk::Pipeline> mBoxPipeline;
+
+    // Pyramid
+    enum PyramidPass
+    {
+        PYRAMID_CONVERT,
+        PYRAMID_DOWN,
+        PYRAMID_UP,
+        PYRAMID_UP_FINAL,
+        PYRAMID_PASS_COUNT
+    };
+
+    uint32_t mPyramidLevels;
+    uint32_t mPyramidMaxLevels = 0;
+
+    vk::Image mPyramidImage; // created by the render graph
+    std::vector<VulkanHolder<vk::ImageView>> mPyramidViews; // view per mip level
+    VulkanHolder<vk::Sampler> mPyramidSampler;
+
+    std::array<VulkanHolder<vk::ShaderModule>, PYRAMID_PASS_COUNT> mPyramidShaders;
+    std::array<VulkanHolder<vk::Pipeline>, PYRAMID_PASS_COUNT> mPyramidPipelines;
+    VulkanHolder<vk::PipelineLayout> mPyramidPipelineLayout;
+
+    VulkanHolder<vk::DescriptorSet> mPyramidConvertDescriptorSet;
+    std::vector<VulkanHolder<vk::DescriptorSet>> mPyramidDownDescriptorSets; // [i] reads level i, writes i + 1
+    std::vector<VulkanHolder<vk::DescriptorSet>> mPyramidUpDescriptorSets;   // [i] reads level i + 1, writes i, [0] writes the compute image
+
+    // Float iterative
+    struct FloatBlurResource
+    {
+        vk::Format format;
+        bool supported = false;
+        std::array<ComputeResource, 2> images; // ping-pong, the second one is transposed
+        VulkanHolder<vk::ShaderModule> convertShader;
+        VulkanHolder<vk::ShaderModule> blurShader;
+        VulkanHolder<vk::Pipeline> convertPipeline;
+        VulkanHolder<vk::Pipeline> blurPipeline;
+        VulkanHolder<vk::DescriptorSet> convertDescriptorSet; // rgba8ui compute image to images[0]
+        std::array<VulkanHolder<vk::DescriptorSet>, 2> blurDescriptorSets;
+    };
+
+    std::array<FloatBlurResource, FLOAT_FORMAT_COUNT> mFloatBlur;
+
+    // FFT
+    std::string mFftKernelFile;
+    std::unique_ptr<FftConvolution> mFft;
+
+    bool mBenchmark;
+    bool mStagingRegistered = false;
+
+    ResourceStateTracker mStateTracker;
+
     VulkanHolder<vk::CommandPool> mCommandPool;
 
     std::array<ComputeResource, 2> mComputeResources; // ping-pong
@@ -83,6 +220,7 @@ class Sample_03_Window
     VulkanHolder<vk::Semaphore> mSemaphoreFinished;
 
     VulkanHolder<vk::QueryPool> mQueryPool;
+    float mTimestampPeriod = 1.0f;
 
     uint64_t mFrameCounter;
 
@@ -158,7 +296,353 @@ public:
         return MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
     }
 
-    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height)
+    /**
+     * Normalized weights of 1D Gaussian kernel for offsets 0..radius
+     */
+    static std::vector<float> MakeGaussWeights(uint32_t radius, float sigma)
+    {
+        std::vector<float> weights(radius + 1);
+        float sum = 0.0f;
+        for (uint32_t k = 0; k <= radius; ++k) {
+            weights[k] = std::exp(-static_cast<float>(k * k) / (2.0f * sigma * sigma));
+            sum += (k == 0) ? weights[k] : 2.0f * weights[k];
+        }
+        for (auto & w : weights) {
+            w /= sum;
+        }
+        return weights;
+    }
+
+    /**
+     * Equivalent sigma of BOX_PASSES successive box filters of the given radius
+     */
+    static float BoxToGaussSigma(uint32_t radius)
+    {
+        const float width = 2.0f * radius + 1.0f;
+        return std::sqrt(BOX_PASSES * (width * width - 1.0f) / 12.0f);
+    }
+
+    /**
+     * Sigma of 8 iterations of 16.blur.comp, each is 13 texels box along x and y
+     */
+    static float IterativeToGaussSigma()
+    {
+        return std::sqrt(8.0f * (13.0f * 13.0f - 1.0f) / 12.0f);
+    }
+
+    /**
+     * Sigma of Dual Kawase impulse response, measured on host: 1.7, 3.8, 7.7, 15.5, 31.1 and 62.2 for 1..6 levels
+     */
+    static float PyramidToGaussSigma(uint32_t levels)
+    {
+        static const float MEASURED_SIGMA[PYRAMID_MAX_LEVELS] = { 1.7f, 3.8f, 7.7f, 15.5f, 31.1f, 62.2f };
+        levels = std::max(levels, 1u);
+        return MEASURED_SIGMA[((levels < PYRAMID_MAX_LEVELS) ? levels : PYRAMID_MAX_LEVELS) - 1];
+    }
+
+    static vk::Extent2D PyramidLevelExtent(const vk::Extent2D & extent, uint32_t level)
+    {
+        return vk::Extent2D(std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u));
+    }
+
+    static bool IsFloatMode(BlurMode mode)
+    {
+        return mode == BlurMode::IterativeHalf || mode == BlurMode::IterativeFloat;
+    }
+
+    static FloatFormat GetFloatFormat(BlurMode mode)
+    {
+        return (mode == BlurMode::IterativeFloat) ? FLOAT_RGBA32F : FLOAT_RGBA16F;
+    }
+
+    /**
+     * Normalized (2 * radius + 1)^2 Gaussian kernel for FFT convolution
+     */
+    static std::vector<float> MakeGaussKernel2D(uint32_t radius, float sigma)
+    {
+        const auto weights = MakeGaussWeights(radius, sigma);
+        const uint32_t size = 2 * radius + 1;
+        std::vector<float> kernel(size * size);
+        for (uint32_t y = 0; y < size; ++y) {
+            for (uint32_t x = 0; x < size; ++x) {
+                kernel[y * size + x] = weights[std::abs(static_cast<int>(y) - static_cast<int>(radius))] * weights[std::abs(static_cast<int>(x) - static_cast<int>(radius))];
+            }
+        }
+        return kernel;
+    }
+
+    /**
+     * Descriptor set of mBlurDescriptorSetLayout: sampled source and storage destination
+     */
+    VulkanHolder<vk::DescriptorSet> MakeBlurDescriptorSet(const vk::ImageView & srcView, const vk::Sampler & srcSampler, const vk::ImageView & dstView)
+    {
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.setDescriptorPool(mDescriptorPool);
+        allocInfo.setDescriptorSetCount(1);
+        allocInfo.setPSetLayouts(mBlurDescriptorSetLayout.get());
+
+        vk::DescriptorSet decriptorSetTmp;
+        if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &decriptorSetTmp)) {
+            throw std::runtime_error("Failed to allocate descriptors set");
+        }
+
+        std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
+        std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
+
+        descriptorImageInfo[0].setImageView(srcView);
+        descriptorImageInfo[0].setSampler(srcSampler);
+        descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+        descriptorImageInfo[1].setImageView(dstView);
+        descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+        writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writeDescriptorsInfo[0].setDstSet(decriptorSetTmp);
+        writeDescriptorsInfo[0].setDstBinding(0);
+        writeDescriptorsInfo[0].setDstArrayElement(0);
+        writeDescriptorsInfo[0].setDescriptorCount(1);
+        writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
+
+        writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        writeDescriptorsInfo[1].setDstSet(decriptorSetTmp);
+        writeDescriptorsInfo[1].setDstBinding(1);
+        writeDescriptorsInfo[1].setDstArrayElement(0);
+        writeDescriptorsInfo[1].setDescriptorCount(1);
+        writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
+
+        mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+        return MakeHolder(decriptorSetTmp, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
+    }
+
+    /**
+     * Views of the float ping-pong images with linear unnormalized samplers, pipelines and descriptor sets
+     */
+    void CreateFloatBlurResource(FloatFormat format)
+    {
+        auto & res = mFloatBlur[format];
+        for (uint32_t j = 0; j < 2; ++j) {
+            res.images[j].image = mRenderGraph.GetImage(mGraphFloat[format][j]);
+
+            vk::ImageViewCreateInfo viewInfo;
+            viewInfo.setImage(res.images[j].image);
+            viewInfo.setViewType(vk::ImageViewType::e2D);
+            viewInfo.setFormat(res.format);
+            viewInfo.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+            res.images[j].view = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
+
+            // Same addressing as for rgba8ui, but here linear filtering really works
+            vk::SamplerCreateInfo samplerInfo;
+            samplerInfo.setMagFilter(vk::Filter::eLinear);
+            samplerInfo.setMinFilter(vk::Filter::eLinear);
+            samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAnisotropyEnable(VK_FALSE);
+            samplerInfo.setMaxAnisotropy(1.0f);
+            samplerInfo.setBorderColor(vk::BorderColor::eFloatOpaqueBlack);
+            samplerInfo.setUnnormalizedCoordinates(VK_TRUE); // Use [0, Size)
+            samplerInfo.setCompareEnable(VK_FALSE);
+            samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+            samplerInfo.setMipLodBias(0.0f);
+            samplerInfo.setMinLod(0.0f);
+            samplerInfo.setMaxLod(0.0f);
+            res.images[j].sampler = MakeHolder(mDevice->createSampler(samplerInfo), [this](vk::Sampler & sampler) { mDevice->destroySampler(sampler); });
+        }
+
+        vk::PipelineShaderStageCreateInfo stageInfo;
+        stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+        stageInfo.setPName("main"); // Shader entry point
+
+        vk::ComputePipelineCreateInfo computePipelineInfo;
+        computePipelineInfo.setLayout(mBlurPipelineLayout);
+
+        stageInfo.setModule(res.convertShader);
+        computePipelineInfo.setStage(stageInfo);
+        res.convertPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+
+        stageInfo.setModule(res.blurShader);
+        computePipelineInfo.setStage(stageInfo);
+        res.blurPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+
+        res.convertDescriptorSet = MakeBlurDescriptorSet(mComputeResources[0].view, mComputeResources[0].sampler, res.images[0].view);
+        res.blurDescriptorSets[0] = MakeBlurDescriptorSet(res.images[0].view, res.images[0].sampler, res.images[1].view);
+        res.blurDescriptorSets[1] = MakeBlurDescriptorSet(res.images[1].view, res.images[1].sampler, res.images[0].view);
+    }
+
+    bool IsModeAvailable(BlurMode mode) const
+    {
+        switch (mode) {
+        case BlurMode::Iterative:
+            return true;
+        case BlurMode::IterativeHalf:
+        case BlurMode::IterativeFloat:
+            return mFloatBlur[GetFloatFormat(mode)].supported;
+        case BlurMode::Fft:
+            return mBlurMode == BlurMode::Fft;
+        default:
+            return mBlurMode == mode || mBenchmark;
+        }
+    }
+
+    /**
+     * Images are declared with their uses, so the graph knows lifetimes before memory is allocated
+     * Views and descriptor sets are created after, from GetImage()
+     */
+    void CreateRenderGraph()
+    {
+        auto makeImageInfo = [](vk::Format format, uint32_t width, uint32_t height, uint32_t mipLevels, vk::ImageUsageFlags usage) {
+            vk::ImageCreateInfo imageInfo;
+            imageInfo.setImageType(vk::ImageType::e2D);
+            imageInfo.setExtent(vk::Extent3D(width, height, 1));
+            imageInfo.setMipLevels(mipLevels);
+            imageInfo.setArrayLayers(1);
+            imageInfo.setFormat(format);
+            imageInfo.setTiling(vk::ImageTiling::eOptimal);
+            imageInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+            imageInfo.setUsage(usage);
+            imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+            imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+            return imageInfo;
+        };
+        const vk::ImageUsageFlags sampledStorage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage;
+
+        mGraphStaging = mRenderGraph.ImportImage(mStagingImage);
+        mGraphSwapchain = mRenderGraph.ImportImage();
+
+        // Second image will be transposed
+        mGraphCompute[0] = mRenderGraph.CreateImage(makeImageInfo(vk::Format::eR8G8B8A8Uint, mTextureExtents.width, mTextureExtents.height, 1, vk::ImageUsageFlagBits::eTransferDst | sampledStorage));
+        mGraphCompute[1] = mRenderGraph.CreateImage(makeImageInfo(vk::Format::eR8G8B8A8Uint, mTextureExtents.height, mTextureExtents.width, 1, vk::ImageUsageFlagBits::eTransferDst | sampledStorage));
+
+        for (uint32_t f = 0; f < FLOAT_FORMAT_COUNT; ++f) {
+            if (mFloatBlur[f].supported) {
+                mGraphFloat[f][0] = mRenderGraph.CreateImage(makeImageInfo(mFloatBlur[f].format, mTextureExtents.width, mTextureExtents.height, 1, sampledStorage));
+                mGraphFloat[f][1] = mRenderGraph.CreateImage(makeImageInfo(mFloatBlur[f].format, mTextureExtents.height, mTextureExtents.width, 1, sampledStorage));
+            }
+        }
+
+        // Mip levels of one float image hold the pyramid, level 0 is the converted source
+        if (IsModeAvailable(BlurMode::Pyramid)) {
+            while (mPyramidMaxLevels < PYRAMID_MAX_LEVELS && (std::min(mTextureExtents.width, mTextureExtents.height) >> (mPyramidMaxLevels + 1)) > 0) {
+                ++mPyramidMaxLevels;
+            }
+            if (mPyramidLevels < 1 || mPyramidLevels > mPyramidMaxLevels) {
+                throw std::runtime_error("Pyramid levels should be in range [1, " + std::to_string(mPyramidMaxLevels) + "]");
+            }
+            mGraphPyramid = mRenderGraph.CreateImage(makeImageInfo(PYRAMID_FORMAT, mTextureExtents.width, mTextureExtents.height, mPyramidMaxLevels + 1, sampledStorage));
+        }
+
+        auto computeUse = [](RenderGraph::ResourceId image, vk::AccessFlags access) {
+            return RenderGraph::ImageUse{ image, vk::PipelineStageFlagBits::eComputeShader, access, vk::ImageLayout::eGeneral };
+        };
+        const vk::AccessFlags readWrite = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+        mRenderGraph.AddPass("upload", {
+                { mGraphStaging, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal },
+                { mGraphCompute[0], vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eGeneral }
+            }, [this](const vk::CommandBuffer & cmdBuffer) { RecordUpload(cmdBuffer); });
+
+        // Passes inside a mode are synchronized by RecordPassBarrier, the graph sees a mode as one pass
+        for (BlurMode mode : { BlurMode::Iterative, BlurMode::Gaussian, BlurMode::Box, BlurMode::Fft, BlurMode::Pyramid, BlurMode::IterativeHalf, BlurMode::IterativeFloat }) {
+            if (!IsModeAvailable(mode)) {
+                continue;
+            }
+            std::vector<RenderGraph::ImageUse> uses = { computeUse(mGraphCompute[0], readWrite) };
+            switch (mode) {
+            case BlurMode::Iterative:
+            case BlurMode::Gaussian:
+            case BlurMode::Box:
+                uses.push_back(computeUse(mGraphCompute[1], readWrite));
+                break;
+            case BlurMode::Pyramid:
+                uses.push_back(computeUse(mGraphPyramid, readWrite));
+                break;
+            case BlurMode::IterativeHalf:
+            case BlurMode::IterativeFloat:
+                uses.push_back(computeUse(mGraphFloat[GetFloatFormat(mode)][0], readWrite));
+                uses.push_back(computeUse(mGraphFloat[GetFloatFormat(mode)][1], readWrite));
+                break;
+            default:
+                break;
+            }
+            const RenderGraph::PassId pass = mRenderGraph.AddPass("blur", uses, [this, mode](const vk::CommandBuffer & cmdBuffer) {
+                cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 0);
+                RecordBlur(cmdBuffer, mode);
+                cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 1);
+            });
+            mRenderGraph.SetPassEnabled(pass, mode == mBlurMode);
+        }
+
+        // Float blur result is drawn directly
+        const RenderGraph::ResourceId drawSource = IsFloatMode(mBlurMode) ? mGraphFloat[GetFloatFormat(mBlurMode)][0] : mGraphCompute[0];
+        mRenderGraph.AddPass("draw", { computeUse(drawSource, vk::AccessFlagBits::eShaderRead), computeUse(mGraphSwapchain, vk::AccessFlagBits::eShaderWrite) },
+            [this](const vk::CommandBuffer & cmdBuffer) {
+                cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mDrawPipeline);
+                cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mDrawPipelineLayout, 0, 1, &mDrawDescriptorSet, 0, nullptr);
+                cmdBuffer.dispatch((mFramebufferExtents.width + DRAW_TILE_SIZE - 1) / DRAW_TILE_SIZE, (mFramebufferExtents.height + DRAW_TILE_SIZE - 1) / DRAW_TILE_SIZE, 1);
+            });
+
+        mRenderGraph.Compile(mDevice, mPhysicalDevice);
+    }
+
+    /**
+     * FFT convolution blurs the first compute image in place
+     */
+    std::unique_ptr<FftConvolution> CreateFft(const std::vector<float> & kernel, const vk::Extent2D & kernelExtent)
+    {
+        std::unique_ptr<FftConvolution> fft(new FftConvolution(mDevice, mPhysicalDevice, QUOTE(SHADERS_DIR) "/glsl/fft.comp", mTextureExtents, kernel, kernelExtent));
+        fft->SetImages(mComputeResources[0].view, mComputeResources[0].sampler, mComputeResources[0].view);
+        return fft;
+    }
+
+    /**
+     * Gaussian pipeline is created for the given radius, as it is a specialization constant
+     */
+    void CreateGaussPipeline(uint32_t radius)
+    {
+        vk::SpecializationMapEntry specializationEntry;
+        specializationEntry.setConstantID(0);
+        specializationEntry.setOffset(0);
+        specializationEntry.setSize(sizeof(uint32_t));
+
+        vk::SpecializationInfo specializationInfo;
+        specializationInfo.setMapEntryCount(1);
+        specializationInfo.setPMapEntries(&specializationEntry);
+        specializationInfo.setDataSize(sizeof(uint32_t));
+        specializationInfo.setPData(&radius);
+
+        vk::PipelineShaderStageCreateInfo stageInfo;
+        stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+        stageInfo.setModule(mGaussShader);
+        stageInfo.setPName("main"); // Shader entry point
+        stageInfo.setPSpecializationInfo(&specializationInfo);
+
+        vk::ComputePipelineCreateInfo computePipelineInfo;
+        computePipelineInfo.setStage(stageInfo);
+        computePipelineInfo.setLayout(mGaussPipelineLayout);
+        mGaussPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+    }
+
+    /**
+     * Write Gaussian weights to the uniform buffer, the buffer must not be in use
+     */
+    void UpdateGaussWeights(uint32_t radius, float sigma)
+    {
+        // std140 layout of the weights block in 16.gauss.comp
+        const vk::DeviceSize weightsSize = ((GAUSS_MAX_RADIUS + 1 + 3) / 4) * 4 * sizeof(float);
+
+        float* weightsPtr = static_cast<float*>(mDevice->mapMemory(mGaussWeightsMemory, 0, weightsSize));
+        if (weightsPtr == nullptr) {
+            throw std::runtime_error("Failed to map weights memory!");
+        }
+        std::fill_n(weightsPtr, weightsSize / sizeof(float), 0.0f);
+        const auto weights = MakeGaussWeights(radius, sigma);
+        std::copy(weights.cbegin(), weights.cend(), weightsPtr);
+        mDevice->unmapMemory(mGaussWeightsMemory);
+    }
+
+    Sample_03_Window(ApiWithoutSecrets::OS::WindowParameters window, uint32_t width, uint32_t height, BlurMode blurMode, uint32_t gaussRadius, float gaussSigma, uint32_t boxRadius,
+        uint32_t pyramidLevels, const std::string & fftKernelFile, bool benchmark)
+        : mBlurMode(blurMode), mGaussRadius(gaussRadius), mGaussSigma(gaussSigma), mBoxRadius(boxRadius), mPyramidLevels(pyramidLevels), mFftKernelFile(fftKernelFile), mBenchmark(benchmark)
     {
         (void)width;
         (void)height;
@@ -354,10 +838,6 @@ public:
             mTextureExtents.setWidth(rgbaImage.width);
             mTextureExtents.setHeight(rgbaImage.height);
 
-            if (mTextureExtents.width % BLOCK_SIZE != 0 || mTextureExtents.height % BLOCK_SIZE != 0) {
-                throw std::runtime_error("Image extents should be dividable by " + std::to_string(BLOCK_SIZE));
-            }
-
             vk::ImageCreateInfo imageInfo;
             imageInfo.setImageType(vk::ImageType::e2D);
             imageInfo.setExtent(vk::Extent3D(mTextureExtents.width, mTextureExtents.height, 1));
@@ -421,7 +901,8 @@ public:
         std::cout << "Loading shader... ";
         {
             {
-                auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.draw.comp");
+                // Float modes are converted to 8 bits only here
+                auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.draw.comp", IsFloatMode(mBlurMode) ? std::vector<std::string>{ "DRAW_FLOAT" } : std::vector<std::string>{});
                 if (code.empty()) {
                     throw std::runtime_error("LoadShader: Failed to read shader file!");
                 }
@@ -442,6 +923,75 @@ public:
 
                 mBlurShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
             }
+            if (mBlurMode == BlurMode::Gaussian || mBenchmark) {
+                if (mGaussRadius > GAUSS_MAX_RADIUS) {
+                    throw std::runtime_error("Gaussian radius should not exceed " + std::to_string(GAUSS_MAX_RADIUS));
+                }
+                auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.gauss.comp");
+                if (code.empty()) {
+                    throw std::runtime_error("LoadShader: Failed to read shader file!");
+                }
+                vk::ShaderModuleCreateInfo shaderInfo;
+                shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                shaderInfo.setCodeSize(code.size());
+
+                mGaussShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+            }
+            if (mBlurMode == BlurMode::Box || mBenchmark) {
+                auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.box.comp");
+                if (code.empty()) {
+                    throw std::runtime_error("LoadShader: Failed to read shader file!");
+                }
+                vk::ShaderModuleCreateInfo shaderInfo;
+                shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                shaderInfo.setCodeSize(code.size());
+
+                mBoxShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+            }
+
+            if (mBlurMode == BlurMode::Pyramid || mBenchmark) {
+                const std::array<const char*, PYRAMID_PASS_COUNT> passDefines = { "PYRAMID_CONVERT", "PYRAMID_DOWN", "PYRAMID_UP", "PYRAMID_UP_FINAL" };
+                for (uint32_t pass = 0; pass < PYRAMID_PASS_COUNT; ++pass) {
+                    auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.pyramid.comp", { passDefines[pass] });
+                    if (code.empty()) {
+                        throw std::runtime_error("LoadShader: Failed to read shader file!");
+                    }
+                    vk::ShaderModuleCreateInfo shaderInfo;
+                    shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                    shaderInfo.setCodeSize(code.size());
+
+                    mPyramidShaders[pass] = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+                }
+            }
+
+            mFloatBlur[FLOAT_RGBA16F].format = vk::Format::eR16G16B16A16Sfloat;
+            mFloatBlur[FLOAT_RGBA32F].format = vk::Format::eR32G32B32A32Sfloat;
+            for (uint32_t f = 0; f < FLOAT_FORMAT_COUNT; ++f) {
+                if (!(mBenchmark || (IsFloatMode(mBlurMode) && GetFloatFormat(mBlurMode) == f))) {
+                    continue;
+                }
+                // Linear filtering of rgba32f is optional
+                const vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImageFilterLinear | vk::FormatFeatureFlagBits::eStorageImage;
+                if ((mPhysicalDevice.getFormatProperties(mFloatBlur[f].format).optimalTilingFeatures & required) != required) {
+                    if (!mBenchmark) {
+                        throw std::runtime_error("Device doesn't support filtering and storage of " + vk::to_string(mFloatBlur[f].format));
+                    }
+                    continue;
+                }
+                const std::string formatDefine = (f == FLOAT_RGBA32F) ? "BLUR_RGBA32F" : "BLUR_RGBA16F";
+                for (bool convert : { true, false }) {
+                    auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.blurf.comp", convert ? std::vector<std::string>{ formatDefine, "BLUR_CONVERT" } : std::vector<std::string>{ formatDefine });
+                    if (code.empty()) {
+                        throw std::runtime_error("LoadShader: Failed to read shader file!");
+                    }
+                    vk::ShaderModuleCreateInfo shaderInfo;
+                    shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                    shaderInfo.setCodeSize(code.size());
+
+                    (convert ? mFloatBlur[f].convertShader : mFloatBlur[f].blurShader) = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+                }
+                mFloatBlur[f].supported = true;
+            }
 
             // Descriptors layout for draw
             {
@@ -485,19 +1035,51 @@ public:
                 mBlurDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
             }
 
+            // Descriptors layout for Gaussian blur
+            {
+                std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+
+                bindings[0].setBinding(0);
+                bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+                bindings[0].setDescriptorCount(1);
+                bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                bindings[1].setBinding(1);
+                bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+                bindings[1].setDescriptorCount(1);
+                bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                // Kernel weights
+                bindings[2].setBinding(2);
+                bindings[2].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+                bindings[2].setDescriptorCount(1);
+                bindings[2].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+                descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+                descriptorSetInfo.setPBindings(&bindings[0]);
+                mGaussDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
+            }
+
             // Pool
             {
-                std::array<vk::DescriptorPoolSize, 2> poolSize;
+                // 2 sets for iterative blur, 2 sets for Gaussian blur, pyramid sets, float blur sets and a draw set per swapchain image
+                const uint32_t pyramidSets = 2 * PYRAMID_MAX_LEVELS + 1;
+                const uint32_t floatSets = 3 * FLOAT_FORMAT_COUNT;
+                std::array<vk::DescriptorPoolSize, 3> poolSize;
 
                 poolSize[0].setType(vk::DescriptorType::eCombinedImageSampler);
-                poolSize[0].setDescriptorCount(2 + static_cast<uint32_t>(swapchainImages.size()));
+                poolSize[0].setDescriptorCount(4 + pyramidSets + floatSets + static_cast<uint32_t>(swapchainImages.size()));
 
                 poolSize[1].setType(vk::DescriptorType::eStorageImage);
-                poolSize[1].setDescriptorCount(2 + static_cast<uint32_t>(swapchainImages.size()));
+                poolSize[1].setDescriptorCount(4 + pyramidSets + floatSets + static_cast<uint32_t>(swapchainImages.size()));
+
+                poolSize[2].setType(vk::DescriptorType::eUniformBuffer);
+                poolSize[2].setDescriptorCount(2);
 
                 vk::DescriptorPoolCreateInfo poolInfo;
                 poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
-                poolInfo.setMaxSets(2 + static_cast<uint32_t>(swapchainImages.size()));
+                poolInfo.setMaxSets(4 + pyramidSets + floatSets + static_cast<uint32_t>(swapchainImages.size()));
                 poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSize.size()));
                 poolInfo.setPPoolSizes(&poolSize[0]);
 
@@ -522,6 +1104,22 @@ public:
                 }
                 mBlurDescriptorSets[1] = MakeHolder(decriptorSetTmp, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
             }
+
+            // Descriptors sets for Gaussian blur
+            {
+                vk::DescriptorSetAllocateInfo allocInfo;
+                allocInfo.setDescriptorPool(mDescriptorPool);
+                allocInfo.setDescriptorSetCount(1);
+                allocInfo.setPSetLayouts(mGaussDescriptorSetLayout.get());
+
+                for (auto & descriptorSet : mGaussDescriptorSets) {
+                    vk::DescriptorSet decriptorSetTmp;
+                    if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &decriptorSetTmp)) {
+                        throw std::runtime_error("Failed to allocate descriptors set");
+                    }
+                    descriptorSet = MakeHolder(decriptorSetTmp, [this](vk::DescriptorSet & set) { mDevice->freeDescriptorSets(mDescriptorPool, set); });
+                }
+            }
             std::cout << "OK" << std::endl;
         }
 
@@ -565,6 +1163,72 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        if (mBlurMode == BlurMode::Gaussian || mBenchmark) {
+            std::cout << "Create Gaussian blur pipeline...";
+
+            vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            pipelineLayoutInfo.setSetLayoutCount(1);
+            pipelineLayoutInfo.setPSetLayouts(mGaussDescriptorSetLayout.get());
+            mGaussPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+            CreateGaussPipeline(mGaussRadius);
+
+            std::cout << "OK" << std::endl;
+        }
+
+        if (mBlurMode == BlurMode::Box || mBenchmark) {
+            std::cout << "Create box blur pipeline...";
+
+            // Radius and segment length are push constants, so the same pipeline serves any radius
+            vk::PushConstantRange pushConstantRange;
+            pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+            pushConstantRange.setOffset(0);
+            pushConstantRange.setSize(sizeof(BoxConstants));
+
+            vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            pipelineLayoutInfo.setSetLayoutCount(1);
+            pipelineLayoutInfo.setPSetLayouts(mBlurDescriptorSetLayout.get());
+            pipelineLayoutInfo.setPushConstantRangeCount(1);
+            pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
+            mBoxPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+            vk::PipelineShaderStageCreateInfo stageInfo;
+            stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+            stageInfo.setModule(mBoxShader);
+            stageInfo.setPName("main"); // Shader entry point
+
+            vk::ComputePipelineCreateInfo computePipelineInfo;
+            computePipelineInfo.setStage(stageInfo);
+            computePipelineInfo.setLayout(mBoxPipelineLayout);
+            mBoxPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+
+            std::cout << "OK" << std::endl;
+        }
+
+        if (mBlurMode == BlurMode::Pyramid || mBenchmark) {
+            std::cout << "Create pyramid blur pipelines...";
+
+            // All passes read binding 0 and write binding 1 like the iterative blur
+            vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            pipelineLayoutInfo.setSetLayoutCount(1);
+            pipelineLayoutInfo.setPSetLayouts(mBlurDescriptorSetLayout.get());
+            mPyramidPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+            for (uint32_t pass = 0; pass < PYRAMID_PASS_COUNT; ++pass) {
+                vk::PipelineShaderStageCreateInfo stageInfo;
+                stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+                stageInfo.setModule(mPyramidShaders[pass]);
+                stageInfo.setPName("main"); // Shader entry point
+
+                vk::ComputePipelineCreateInfo computePipelineInfo;
+                computePipelineInfo.setStage(stageInfo);
+                computePipelineInfo.setLayout(mPyramidPipelineLayout);
+                mPyramidPipelines[pass] = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+            }
+
+            std::cout << "OK" << std::endl;
+        }
+
         std::cout << "Create command buffers...";
         {
             vk::CommandPoolCreateInfo commandsPoolInfo;
@@ -587,47 +1251,18 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        std::cout << "Create render graph...";
+        CreateRenderGraph();
+        std::cout << "OK (" << mRenderGraph.GetOrder().size() << " passes, transient images " << mRenderGraph.GetTransientMemorySize() / (1024.0 * 1024.0) << " MB, "
+            << mRenderGraph.GetUnaliasedMemorySize() / (1024.0 * 1024.0) << " MB without aliasing)" << std::endl;
+
         /**
-         * Create two images to use as ping-pong buffer for computations
+         * Views and samplers of the ping-pong images for computations
          */
         std::cout << "Create buffers...";
         {
-            // Second image will be transposed
             for (uint32_t j = 0; j < 2; ++j) {
-                vk::ImageCreateInfo imageInfo;
-                imageInfo.setImageType(vk::ImageType::e2D);
-                if (j == 0) {
-                    imageInfo.setExtent(vk::Extent3D(mTextureExtents.width, mTextureExtents.height, 1));
-                } else {
-                    imageInfo.setExtent(vk::Extent3D(mTextureExtents.height, mTextureExtents.width, 1));
-                }
-                imageInfo.setMipLevels(1);
-                imageInfo.setArrayLayers(1);
-                imageInfo.setFormat(vk::Format::eR8G8B8A8Uint);
-                imageInfo.setTiling(vk::ImageTiling::eOptimal);
-                imageInfo.setInitialLayout(vk::ImageLayout::eUndefined);
-                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
-                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
-                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
-
-                mComputeResources[j].image = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
-
-                vk::MemoryRequirements imageMemoryRequirments = mDevice->getImageMemoryRequirements(mComputeResources[j].image);
-                vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
-                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
-                    if ((imageMemoryRequirments.memoryTypeBits & (1 << i)) &&
-                        (memroProperties.memoryTypes[i].propertyFlags & (vk::MemoryPropertyFlagBits::eDeviceLocal))) {
-
-                        vk::MemoryAllocateInfo allocateInfo;
-                        allocateInfo.setAllocationSize(imageMemoryRequirments.size);
-                        allocateInfo.setMemoryTypeIndex(i);
-                        mComputeResources[j].memory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
-                    }
-                }
-                if (!mComputeResources[j].memory) {
-                    throw std::runtime_error("Failed to allocate memory for compute image");
-                }
-                mDevice->bindImageMemory(mComputeResources[j].image, mComputeResources[j].memory, 0);
+                mComputeResources[j].image = mRenderGraph.GetImage(mGraphCompute[j]);
 
                 vk::ImageSubresourceRange range;
                 range.setAspectMask(vk::ImageAspectFlagBits::eColor);
@@ -671,7 +1306,7 @@ public:
             samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToBorder);
             samplerInfo.setAnisotropyEnable(VK_FALSE);
             samplerInfo.setMaxAnisotropy(1.0f);
-            samplerInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
+            samplerInfo.setBorderColor(IsFloatMode(mBlurMode) ? vk::BorderColor::eFloatOpaqueBlack : vk::BorderColor::eIntOpaqueBlack);
             samplerInfo.setUnnormalizedCoordinates(VK_FALSE); // Use [0, 1)
             samplerInfo.setCompareEnable(VK_FALSE);
             samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
@@ -683,6 +1318,16 @@ public:
             std::cout << "OK" << std::endl;
         }
 
+        for (uint32_t f = 0; f < FLOAT_FORMAT_COUNT; ++f) {
+            if (mFloatBlur[f].supported) {
+                std::cout << "Create " << vk::to_string(mFloatBlur[f].format) << " blur images...";
+                CreateFloatBlurResource(static_cast<FloatFormat>(f));
+                std::cout << "OK" << std::endl;
+            }
+        }
+        // Float blur result is drawn directly
+        const vk::ImageView drawSourceView = IsFloatMode(mBlurMode) ? mFloatBlur[GetFloatFormat(mBlurMode)].images[0].view : mComputeResources[0].view;
+
         // Preparing rendering resources
         for (uint32_t i = 0; i < mRenderingResources.size(); ++i) {
             mRenderingResources[i].imageHandle = swapchainImages[i];
@@ -718,7 +1363,7 @@ public:
             std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
             std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
 
-            descriptorImageInfo[0].setImageView(mComputeResources[0].view);
+            descriptorImageInfo[0].setImageView(drawSourceView);
             descriptorImageInfo[0].setSampler(mProcessedImageSampler);
             descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
 
@@ -800,6 +1445,160 @@ public:
             }
         }
 
+        // Prepare weights and descriptors for Gaussian blur
+        if (mBlurMode == BlurMode::Gaussian || mBenchmark) {
+            std::cout << "Create Gaussian weights (radius = " << mGaussRadius << ", sigma = " << mGaussSigma << ")...";
+
+            // std140 layout of the weights block in 16.gauss.comp
+            const vk::DeviceSize weightsSize = ((GAUSS_MAX_RADIUS + 1 + 3) / 4) * 4 * sizeof(float);
+
+            vk::BufferCreateInfo bufferInfo;
+            bufferInfo.setSize(weightsSize);
+            bufferInfo.setUsage(vk::BufferUsageFlagBits::eUniformBuffer);
+            bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+            mGaussWeightsBuffer = MakeHolder(mDevice->createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice->destroyBuffer(buffer); });
+
+            vk::MemoryRequirements memoryRequirments = mDevice->getBufferMemoryRequirements(mGaussWeightsBuffer);
+            vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+            const vk::MemoryPropertyFlags requiredProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+            for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+                if ((memoryRequirments.memoryTypeBits & (1 << i)) &&
+                    ((memroProperties.memoryTypes[i].propertyFlags & requiredProperties) == requiredProperties)) {
+
+                    vk::MemoryAllocateInfo allocateInfo;
+                    allocateInfo.setAllocationSize(memoryRequirments.size);
+                    allocateInfo.setMemoryTypeIndex(i);
+                    mGaussWeightsMemory = MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                    break;
+                }
+            }
+            if (!mGaussWeightsMemory) {
+                throw std::runtime_error("Failed to allocate memory for Gaussian weights");
+            }
+            mDevice->bindBufferMemory(mGaussWeightsBuffer, mGaussWeightsMemory, 0);
+
+            UpdateGaussWeights(mGaussRadius, mGaussSigma);
+
+            // Pass 0 reads image 0 and writes transposed image 1, pass 1 reads image 1 and writes image 0 back
+            for (uint32_t j = 0; j < 2; ++j) {
+                std::array<vk::WriteDescriptorSet, 3> writeDescriptorsInfo;
+                std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
+                vk::DescriptorBufferInfo descriptorBufferInfo;
+
+                descriptorImageInfo[0].setImageView(mComputeResources[j].view);
+                descriptorImageInfo[0].setSampler(mComputeResources[j].sampler);
+                descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+                descriptorImageInfo[1].setImageView(mComputeResources[1 - j].view);
+                descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+                descriptorBufferInfo.setBuffer(mGaussWeightsBuffer);
+                descriptorBufferInfo.setOffset(0);
+                descriptorBufferInfo.setRange(VK_WHOLE_SIZE);
+
+                writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+                writeDescriptorsInfo[0].setDstSet(mGaussDescriptorSets[j]);
+                writeDescriptorsInfo[0].setDstBinding(0);
+                writeDescriptorsInfo[0].setDstArrayElement(0);
+                writeDescriptorsInfo[0].setDescriptorCount(1);
+                writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
+
+                writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+                writeDescriptorsInfo[1].setDstSet(mGaussDescriptorSets[j]);
+                writeDescriptorsInfo[1].setDstBinding(1);
+                writeDescriptorsInfo[1].setDstArrayElement(0);
+                writeDescriptorsInfo[1].setDescriptorCount(1);
+                writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
+
+                writeDescriptorsInfo[2].setDescriptorType(vk::DescriptorType::eUniformBuffer);
+                writeDescriptorsInfo[2].setDstSet(mGaussDescriptorSets[j]);
+                writeDescriptorsInfo[2].setDstBinding(2);
+                writeDescriptorsInfo[2].setDstArrayElement(0);
+                writeDescriptorsInfo[2].setDescriptorCount(1);
+                writeDescriptorsInfo[2].setPBufferInfo(&descriptorBufferInfo);
+
+                mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+            }
+
+            std::cout << "OK" << std::endl;
+        }
+
+        // Mip levels of one float image hold the pyramid, level 0 is the converted source
+        if (mBlurMode == BlurMode::Pyramid || mBenchmark) {
+            std::cout << "Create blur pyramid...";
+
+            mPyramidImage = mRenderGraph.GetImage(mGraphPyramid);
+
+            // Each pass samples one level and stores to another, so every level gets own view
+            for (uint32_t level = 0; level <= mPyramidMaxLevels; ++level) {
+                vk::ImageViewCreateInfo viewInfo;
+                viewInfo.setImage(mPyramidImage);
+                viewInfo.setViewType(vk::ImageViewType::e2D);
+                viewInfo.setFormat(PYRAMID_FORMAT);
+                viewInfo.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+                mPyramidViews.push_back(MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); }));
+            }
+
+            // Taps between texels are averaged by the hardware
+            vk::SamplerCreateInfo samplerInfo;
+            samplerInfo.setMagFilter(vk::Filter::eLinear);
+            samplerInfo.setMinFilter(vk::Filter::eLinear);
+            samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+            samplerInfo.setAnisotropyEnable(VK_FALSE);
+            samplerInfo.setMaxAnisotropy(1.0f);
+            samplerInfo.setBorderColor(vk::BorderColor::eFloatOpaqueBlack);
+            samplerInfo.setUnnormalizedCoordinates(VK_FALSE); // Use [0, 1)
+            samplerInfo.setCompareEnable(VK_FALSE);
+            samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+            samplerInfo.setMipLodBias(0.0f);
+            samplerInfo.setMinLod(0.0f);
+            samplerInfo.setMaxLod(0.0f);
+            mPyramidSampler = MakeHolder(mDevice->createSampler(samplerInfo), [this](vk::Sampler & sampler) { mDevice->destroySampler(sampler); });
+
+            mPyramidConvertDescriptorSet = MakeBlurDescriptorSet(mComputeResources[0].view, mComputeResources[0].sampler, mPyramidViews[0]);
+            for (uint32_t level = 0; level < mPyramidMaxLevels; ++level) {
+                mPyramidDownDescriptorSets.push_back(MakeBlurDescriptorSet(mPyramidViews[level], mPyramidSampler, mPyramidViews[level + 1]));
+                mPyramidUpDescriptorSets.push_back(MakeBlurDescriptorSet(mPyramidViews[level + 1], mPyramidSampler, (level == 0) ? mComputeResources[0].view : mPyramidViews[level]));
+            }
+
+            std::cout << "OK" << std::endl;
+        }
+
+        if (mBlurMode == BlurMode::Fft) {
+            std::vector<float> kernel;
+            vk::Extent2D kernelExtent;
+            if (mFftKernelFile.empty()) {
+                std::cout << "Create FFT convolution (Gaussian radius = " << mGaussRadius << ", sigma = " << mGaussSigma << ")...";
+                kernel = MakeGaussKernel2D(mGaussRadius, mGaussSigma);
+                kernelExtent = vk::Extent2D(2 * mGaussRadius + 1, 2 * mGaussRadius + 1);
+            }
+            else {
+                std::cout << "Create FFT convolution (kernel " << mFftKernelFile << ")...";
+                RgbaImage kernelImage = LoadBmpImage(mFftKernelFile);
+                if (kernelImage.pixels.empty()) {
+                    throw std::runtime_error("Failed to load kernel");
+                }
+                // Brightness of the image is the kernel, normalized to keep the image brightness
+                kernel.resize(kernelImage.width * kernelImage.height);
+                float sum = 0.0f;
+                for (size_t i = 0; i < kernel.size(); ++i) {
+                    kernel[i] = kernelImage.pixels[4 * i] + kernelImage.pixels[4 * i + 1] + kernelImage.pixels[4 * i + 2];
+                    sum += kernel[i];
+                }
+                if (sum <= 0.0f) {
+                    throw std::runtime_error("Kernel image is black");
+                }
+                for (auto & k : kernel) {
+                    k /= sum;
+                }
+                kernelExtent = vk::Extent2D(kernelImage.width, kernelImage.height);
+            }
+            mFft = CreateFft(kernel, kernelExtent);
+            std::cout << "OK (padded to " << mFft->GetPaddedExtent().width << "x" << mFft->GetPaddedExtent().height << ")" << std::endl;
+        }
+
         mSemaphoreAvailable = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
         mSemaphoreFinished  = MakeHolder(mDevice->createSemaphore(vk::SemaphoreCreateInfo()), [this](vk::Semaphore & sem) { mDevice->destroySemaphore(sem); });
 
@@ -807,152 +1606,384 @@ public:
         queryPoolInfo.setQueryCount(2);
         queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
         mQueryPool = MakeHolder(mDevice->createQueryPool(queryPoolInfo), [this](vk::QueryPool & pool) { mDevice->destroyQueryPool(pool); });
+        mTimestampPeriod = mPhysicalDevice.getProperties().limits.timestampPeriod;
+
+        if (mBenchmark) {
+            RunBenchmark();
+        }
 
         CanRender = true;
         mFrameCounter = 0;
     }
 
-    bool OnWindowSizeChanged() override 
+    /**
+     * Staging image is written by host before the first submit, other images are tracked by the render graph
+     */
+    void RegisterStagingImage()
     {
-        return true;
+        if (mStagingRegistered) {
+            return;
+        }
+        mStateTracker.SetImageState(mStagingImage, vk::ImageLayout::ePreinitialized, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostWrite);
+        mStagingRegistered = true;
     }
 
-    bool Draw() override
+    /**
+     * Copy the source image from staging memory to the first compute image
+     * Staging image must be in transfer source layout, the compute image in general
+     */
+    void RecordUpload(const vk::CommandBuffer & cmdBuffer)
     {
-        constexpr uint64_t TIMEOUT = 1 * 1000 * 1000 * 1000; // 1 second in nanos
+        vk::ImageSubresourceLayers subResource;
+        subResource.setAspectMask(vk::ImageAspectFlagBits::eColor);
+        subResource.setBaseArrayLayer(0);
+        subResource.setMipLevel(0);
+        subResource.setLayerCount(1);
+
+        vk::ImageCopy copyInfo;
+        copyInfo.setSrcSubresource(subResource);
+        copyInfo.setDstSubresource(subResource);
+        copyInfo.setSrcOffset(vk::Offset3D(0, 0, 0));
+        copyInfo.setDstOffset(vk::Offset3D(0, 0, 0));
+        copyInfo.setExtent(vk::Extent3D(mTextureExtents.width, mTextureExtents.height, 1));
+
+        cmdBuffer.copyImage(mStagingImage, vk::ImageLayout::eTransferSrcOptimal, mComputeResources[0].image, vk::ImageLayout::eGeneral, 1, &copyInfo);
+    }
 
-        auto imageIdx = mDevice->acquireNextImageKHR(mSwapChain, TIMEOUT, mSemaphoreAvailable, nullptr);
-        if (imageIdx.result != vk::Result::eSuccess) {
-            std::cout << "Failed to acquire image! Stoppping." << std::endl;
-            return false;
+    /**
+     * Each pass reads what the previous one (or the upload) has written
+     * Merged with the tracked barriers declared since the last flush
+     */
+    void RecordPassBarrier(const vk::CommandBuffer & cmdBuffer)
+    {
+        mStateTracker.AddMemoryDependency(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+        mStateTracker.Flush(cmdBuffer);
+    }
+
+    /**
+     * Blur the first compute image in place, the second one is used as transposed temporary
+     */
+    void RecordBlur(const vk::CommandBuffer & cmdBuffer, BlurMode mode)
+    {
+        switch (mode) {
+        case BlurMode::Gaussian:
+            /*
+             * Single separable pass: rows of image 0 to columns of image 1 and back
+             */
+            cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mGaussPipeline);
+
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mGaussPipelineLayout, 0, 1, mGaussDescriptorSets[0].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.width + GAUSS_GROUP_SIZE - 1) / GAUSS_GROUP_SIZE, mTextureExtents.height, 1);
+
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mGaussPipelineLayout, 0, 1, mGaussDescriptorSets[1].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.height + GAUSS_GROUP_SIZE - 1) / GAUSS_GROUP_SIZE, mTextureExtents.width, 1);
+            break;
+
+        case BlurMode::Box:
+            RecordBoxBlur(cmdBuffer, mBoxRadius);
+            break;
+
+        case BlurMode::Fft:
+            RecordPassBarrier(cmdBuffer);
+            mFft->RecordConvolution(cmdBuffer);
+            break;
+
+        case BlurMode::Pyramid:
+            RecordPyramidBlur(cmdBuffer, mPyramidLevels);
+            break;
+
+        case BlurMode::IterativeHalf:
+        case BlurMode::IterativeFloat:
+            RecordFloatBlur(cmdBuffer, GetFloatFormat(mode));
+            break;
+
+        case BlurMode::Iterative:
+            /*
+             * Make blur iterations
+             */
+            for (int i = 0; i < 8; ++i) {
+                cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mBlurPipeline);
+
+                // from 0 to 1
+                RecordPassBarrier(cmdBuffer);
+                cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, mBlurDescriptorSets[0].get(), 0, nullptr);
+
+                cmdBuffer.dispatch((mTextureExtents.width + BLOCK_SIZE - 1) / BLOCK_SIZE, (mTextureExtents.height + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+
+                // from 1 to 0
+                RecordPassBarrier(cmdBuffer);
+                cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, mBlurDescriptorSets[1].get(), 0, nullptr);
+
+                cmdBuffer.dispatch((mTextureExtents.height + BLOCK_SIZE - 1) / BLOCK_SIZE, (mTextureExtents.width + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+            }
+            break;
         }
+    }
 
-        auto & renderingResource = mRenderingResources[imageIdx.value];
+    /**
+     * Convert the first compute image to the first float image and make 8 iterations there, the result stays in float
+     */
+    void RecordFloatBlur(const vk::CommandBuffer & cmdBuffer, FloatFormat format)
+    {
+        const auto & res = mFloatBlur[format];
 
-        mDevice->resetFences(1, renderingResource.fence.get());
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, res.convertPipeline);
+        RecordPassBarrier(cmdBuffer);
+        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, res.convertDescriptorSet.get(), 0, nullptr);
+        cmdBuffer.dispatch((mTextureExtents.width + BLOCK_SIZE - 1) / BLOCK_SIZE, (mTextureExtents.height + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
 
-        // Preapare command buffer
-        auto& cmdBuffer = renderingResource.commandBuffer;
-        vk::CommandBufferBeginInfo beginInfo;
-        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-        cmdBuffer->begin(beginInfo);
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, res.blurPipeline);
+        for (int i = 0; i < 8; ++i) {
+            // from 0 to 1
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, res.blurDescriptorSets[0].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.width + BLOCK_SIZE - 1) / BLOCK_SIZE, (mTextureExtents.height + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
 
-        vk::ImageSubresourceRange range;
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0;
-        range.levelCount = 1;
-        range.baseArrayLayer = 0;
-        range.layerCount = 1;
-
-        if (mFrameCounter == 0) {
-            vk::ImageMemoryBarrier barrierStagingImage;
-            barrierStagingImage.srcAccessMask = vk::AccessFlagBits::eHostWrite;
-            barrierStagingImage.dstAccessMask = vk::AccessFlagBits::eTransferRead;
-            barrierStagingImage.oldLayout = vk::ImageLayout::ePreinitialized;
-            barrierStagingImage.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-            barrierStagingImage.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierStagingImage.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierStagingImage.image = mStagingImage;
-            barrierStagingImage.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierStagingImage);
-
-            for(auto & cres : mComputeResources) {
-
-                vk::ImageMemoryBarrier barrierComputeImage;
-                barrierComputeImage.srcAccessMask = vk::AccessFlags();
-                barrierComputeImage.dstAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
-                barrierComputeImage.oldLayout = vk::ImageLayout::eUndefined;
-                barrierComputeImage.newLayout = vk::ImageLayout::eGeneral;
-                barrierComputeImage.srcQueueFamilyIndex = mQueueFamilyPresent;
-                barrierComputeImage.dstQueueFamilyIndex = mQueueFamilyPresent;
-                barrierComputeImage.image = cres.image;
-                barrierComputeImage.subresourceRange = range;
-
-                cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierComputeImage);
-            }
+            // from 1 to 0
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, res.blurDescriptorSets[1].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.height + BLOCK_SIZE - 1) / BLOCK_SIZE, (mTextureExtents.width + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
         }
+    }
 
-        /**
-         * Init image
-         */
-        {
-            vk::ImageSubresourceLayers subResource;
-            subResource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-            subResource.setBaseArrayLayer(0);
-            subResource.setMipLevel(0);
-            subResource.setLayerCount(1);
+    /**
+     * BOX_PASSES pairs of sliding window passes, one invocation per row segment: groups of BOX_GROUP_SIZE rows along x, segments along y
+     */
+    void RecordBoxBlur(const vk::CommandBuffer & cmdBuffer, uint32_t radius)
+    {
+        // Summing the window at the segment start costs at most as much as sliding over the segment
+        BoxConstants constants;
+        constants.radius = radius;
+        constants.segmentLength = std::max(BOX_MIN_SEGMENT, 2 * radius + 1);
 
-            vk::ImageCopy copyInfo;
-            copyInfo.setSrcSubresource(subResource);
-            copyInfo.setDstSubresource(subResource);
-            copyInfo.setSrcOffset(vk::Offset3D(0, 0, 0));
-            copyInfo.setDstOffset(vk::Offset3D(0, 0, 0));
-            copyInfo.setExtent(vk::Extent3D(mTextureExtents.width, mTextureExtents.height, 1));
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mBoxPipeline);
+        cmdBuffer.pushConstants(mBoxPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(BoxConstants), &constants);
 
-            cmdBuffer->copyImage(mStagingImage, vk::ImageLayout::eTransferSrcOptimal, mComputeResources[0].image, vk::ImageLayout::eGeneral, 1, &copyInfo);
+        auto segments = [&constants](uint32_t length) { return (length + constants.segmentLength - 1) / constants.segmentLength; };
+        for (uint32_t i = 0; i < BOX_PASSES; ++i) {
+            // from 0 to 1
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBoxPipelineLayout, 0, 1, mBlurDescriptorSets[0].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.height + BOX_GROUP_SIZE - 1) / BOX_GROUP_SIZE, segments(mTextureExtents.width), 1);
+
+            // from 1 to 0
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBoxPipelineLayout, 0, 1, mBlurDescriptorSets[1].get(), 0, nullptr);
+            cmdBuffer.dispatch((mTextureExtents.width + BOX_GROUP_SIZE - 1) / BOX_GROUP_SIZE, segments(mTextureExtents.height), 1);
         }
+    }
 
-        cmdBuffer->resetQueryPool(mQueryPool, 0, 2);
+    /**
+     * Convert to level 0, downsample to the given level and upsample back to the first compute image
+     */
+    void RecordPyramidBlur(const vk::CommandBuffer & cmdBuffer, uint32_t levels)
+    {
+        auto dispatchLevel = [this, &cmdBuffer](uint32_t level) {
+            const vk::Extent2D extent = PyramidLevelExtent(mTextureExtents, level);
+            cmdBuffer.dispatch((extent.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (extent.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+        };
 
-        cmdBuffer->writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 0);
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPyramidPipelines[PYRAMID_CONVERT]);
+        RecordPassBarrier(cmdBuffer);
+        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPyramidPipelineLayout, 0, 1, mPyramidConvertDescriptorSet.get(), 0, nullptr);
+        dispatchLevel(0);
 
-        /*
-         * Make blur iterations
-         */
-        for(int i = 0; i < 8; ++i) {
-            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mBlurPipeline);
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPyramidPipelines[PYRAMID_DOWN]);
+        for (uint32_t level = 0; level < levels; ++level) {
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPyramidPipelineLayout, 0, 1, mPyramidDownDescriptorSets[level].get(), 0, nullptr);
+            dispatchLevel(level + 1);
+        }
 
-            // from 0 to 1
-            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, mBlurDescriptorSets[0].get(), 0, nullptr);
+        for (uint32_t level = levels; level-- > 0; ) {
+            // The last upsample writes rgba8ui result instead of level 0
+            cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPyramidPipelines[(level == 0) ? PYRAMID_UP_FINAL : PYRAMID_UP]);
+            RecordPassBarrier(cmdBuffer);
+            cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPyramidPipelineLayout, 0, 1, mPyramidUpDescriptorSets[level].get(), 0, nullptr);
+            dispatchLevel(level);
+        }
+    }
 
-            cmdBuffer->dispatch(mTextureExtents.width / BLOCK_SIZE, mTextureExtents.height / BLOCK_SIZE, 1);
+    /**
+     * Submit recorded commands BENCHMARK_REPEATS times and return the best GPU time in ms
+     */
+    double MeasureBlur(const vk::CommandBuffer & cmdBuffer, const vk::Fence & fence, const std::function<void(const vk::CommandBuffer &)> & recordBlur)
+    {
+        constexpr uint64_t TIMEOUT = 10ull * 1000 * 1000 * 1000; // 10 seconds in nanos
+
+        double bestTime = std::numeric_limits<double>::max();
+        for (uint32_t i = 0; i < BENCHMARK_REPEATS; ++i) {
+            vk::CommandBufferBeginInfo beginInfo;
+            beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+            cmdBuffer.begin(beginInfo);
+
+            // Working images of the previous measurement may share memory with this one
+            RegisterStagingImage();
+            mRenderGraph.DiscardTransients(mStateTracker, vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eGeneral);
+            mStateTracker.UseImage(mStagingImage, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal);
+            mStateTracker.UseImage(mComputeResources[0].image, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eGeneral);
+            mStateTracker.Flush(cmdBuffer);
+            RecordUpload(cmdBuffer);
+
+            cmdBuffer.resetQueryPool(mQueryPool, 0, 2);
+            cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 0);
+            recordBlur(cmdBuffer);
+            cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 1);
+
+            cmdBuffer.end();
+
+            vk::SubmitInfo submitInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &cmdBuffer;
+            if (vk::Result::eSuccess != mCommandQueue.submit(1, &submitInfo, fence)) {
+                throw std::runtime_error("Failed to submit benchmark commands");
+            }
+            if (vk::Result::eSuccess != mDevice->waitForFences(1, &fence, VK_FALSE, TIMEOUT)) {
+                throw std::runtime_error("Waiting for benchmark takes too long");
+            }
+            mDevice->resetFences(1, &fence);
 
-            // from 1 to 0
-            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mBlurPipelineLayout, 0, 1, mBlurDescriptorSets[1].get(), 0, nullptr);
+            std::array<uint64_t, 2> timestamps = { 0, 0 };
+            mDevice->getQueryPoolResults(mQueryPool, 0, 2, sizeof(timestamps), &timestamps[0], sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+            bestTime = std::min(bestTime, (timestamps[1] - timestamps[0]) * mTimestampPeriod / 1e6);
+        }
+        return bestTime;
+    }
 
-            cmdBuffer->dispatch(mTextureExtents.height / BLOCK_SIZE, mTextureExtents.width / BLOCK_SIZE, 1);
+    /**
+     * Compare box, Gaussian and iterative blur for radii 4..256
+     * Gaussian is taken with the same sigma as the 3 box passes, its radius is limited by GAUSS_MAX_RADIUS
+     * Then FFT convolution is compared with the separable Gaussian of the same kernel for radii 4..GAUSS_MAX_RADIUS
+     */
+    void RunBenchmark()
+    {
+        std::cout << "Benchmark " << mTextureExtents.width << "x" << mTextureExtents.height << ", best of " << BENCHMARK_REPEATS << " runs" << std::endl;
+
+        auto & cmdBuffer = mRenderingResources[0].commandBuffer;
+        auto fence = MakeHolder(mDevice->createFence(vk::FenceCreateInfo()), [this](vk::Fence & fence) { mDevice->destroyFence(fence); });
+
+        const double iterativeTime = MeasureBlur(cmdBuffer, fence, [this](const vk::CommandBuffer & cmd) { RecordBlur(cmd, BlurMode::Iterative); });
+        // Every pass reads and writes the whole image once, texture cache serves the neighbour taps
+        const double passBytes = 2.0 * mTextureExtents.width * mTextureExtents.height;
+        std::cout << "  iterative (8 x 7 taps, sigma " << IterativeToGaussSigma() << "): " << iterativeTime << " ms, "
+            << "rgba8ui with 7 taps per 7 fetches, " << 16 * passBytes * 4 / (iterativeTime * 1e6) << " GB/s" << std::endl;
+        // Float modes include the conversion pass and are truly 13 taps wide
+        for (uint32_t f = 0; f < FLOAT_FORMAT_COUNT; ++f) {
+            const uint32_t pixelSize = (f == FLOAT_RGBA32F) ? 16 : 8;
+            if (!mFloatBlur[f].supported) {
+                std::cout << "  iterative " << vk::to_string(mFloatBlur[f].format) << ": linear filtering is not supported" << std::endl;
+                continue;
+            }
+            const double floatTime = MeasureBlur(cmdBuffer, fence, [this, f](const vk::CommandBuffer & cmd) { RecordFloatBlur(cmd, static_cast<FloatFormat>(f)); });
+            std::cout << "  iterative " << vk::to_string(mFloatBlur[f].format) << ": " << floatTime << " ms, 13 taps per 7 fetches, " << 16 * passBytes * pixelSize / (floatTime * 1e6) << " GB/s"
+                << ", " << floatTime / iterativeTime << "x of rgba8ui time" << std::endl;
         }
 
-        cmdBuffer->writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, mQueryPool, 1);
+        // Pyramid levels with the nearest sigma to the iterative blur are the matched visual radius
+        uint32_t matchedLevels = 1;
+        for (uint32_t levels = 1; levels <= mPyramidMaxLevels; ++levels) {
+            if (std::abs(std::log2(PyramidToGaussSigma(levels) / IterativeToGaussSigma())) < std::abs(std::log2(PyramidToGaussSigma(matchedLevels) / IterativeToGaussSigma()))) {
+                matchedLevels = levels;
+            }
+        }
+        for (uint32_t levels = 1; levels <= mPyramidMaxLevels; ++levels) {
+            const double pyramidTime = MeasureBlur(cmdBuffer, fence, [this, levels](const vk::CommandBuffer & cmd) { RecordPyramidBlur(cmd, levels); });
+            std::cout << "  pyramid " << levels << " levels (sigma " << PyramidToGaussSigma(levels) << "): " << pyramidTime << " ms";
+            if (levels == matchedLevels) {
+                std::cout << ", " << iterativeTime / pyramidTime << "x faster than iterative at matched radius";
+            }
+            std::cout << std::endl;
+        }
 
-        /* 
-         * Draw from first image
-         */
-        {
-            vk::ImageMemoryBarrier barrierFromPresentToDraw;
-            barrierFromPresentToDraw.srcAccessMask = vk::AccessFlagBits::eMemoryRead;
-            barrierFromPresentToDraw.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
-            barrierFromPresentToDraw.oldLayout = renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR;
-            barrierFromPresentToDraw.newLayout = vk::ImageLayout::eGeneral;
-            barrierFromPresentToDraw.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPresentToDraw.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromPresentToDraw.image = renderingResource.imageHandle;
-            barrierFromPresentToDraw.subresourceRange = range;
+        for (uint32_t radius = 4; radius <= 256; radius *= 2) {
+            const double boxTime = MeasureBlur(cmdBuffer, fence, [this, radius](const vk::CommandBuffer & cmd) { RecordBoxBlur(cmd, radius); });
+
+            const float sigma = BoxToGaussSigma(radius);
+            const uint32_t gaussRadius = std::min(static_cast<uint32_t>(std::ceil(3.0f * sigma)), GAUSS_MAX_RADIUS);
+            CreateGaussPipeline(gaussRadius);
+            UpdateGaussWeights(gaussRadius, sigma);
+            const double gaussTime = MeasureBlur(cmdBuffer, fence, [this](const vk::CommandBuffer & cmd) { RecordBlur(cmd, BlurMode::Gaussian); });
+
+            std::cout << "  radius " << radius << " (sigma " << sigma << "): box x" << BOX_PASSES << " = " << boxTime << " ms, "
+                << "gaussian r" << gaussRadius << " = " << gaussTime << " ms" << (gaussRadius == GAUSS_MAX_RADIUS ? " (truncated)" : "") << std::endl;
+        }
 
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTopOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromPresentToDraw);
+        uint32_t fftCrossoverRadius = 0;
+        for (uint32_t radius = 4; radius <= GAUSS_MAX_RADIUS; radius *= 2) {
+            const float sigma = radius / 3.0f;
+            CreateGaussPipeline(radius);
+            UpdateGaussWeights(radius, sigma);
+            const double gaussTime = MeasureBlur(cmdBuffer, fence, [this](const vk::CommandBuffer & cmd) { RecordBlur(cmd, BlurMode::Gaussian); });
+
+            // The first run includes the kernel spectrum, it is dropped by taking the best time
+            auto fft = CreateFft(MakeGaussKernel2D(radius, sigma), vk::Extent2D(2 * radius + 1, 2 * radius + 1));
+            const double fftTime = MeasureBlur(cmdBuffer, fence, [this, &fft](const vk::CommandBuffer & cmd) { RecordPassBarrier(cmd); fft->RecordConvolution(cmd); });
+
+            std::cout << "  gaussian radius " << radius << ": separable = " << gaussTime << " ms, "
+                << "fft " << fft->GetPaddedExtent().width << "x" << fft->GetPaddedExtent().height << " = " << fftTime << " ms" << std::endl;
+            if (fftCrossoverRadius == 0 && fftTime < gaussTime) {
+                fftCrossoverRadius = radius;
+            }
+        }
+        if (fftCrossoverRadius != 0) {
+            std::cout << "  fft is faster than separable gaussian from radius " << fftCrossoverRadius << std::endl;
+        }
+        else {
+            std::cout << "  fft is slower than separable gaussian up to radius " << GAUSS_MAX_RADIUS << std::endl;
+        }
 
-            renderingResource.undefinedLaout = false;
+        // Restore the configured Gaussian
+        CreateGaussPipeline(mGaussRadius);
+        UpdateGaussWeights(mGaussRadius, mGaussSigma);
+    }
+
+    bool OnWindowSizeChanged() override 
+    {
+        return true;
+    }
 
+    bool Draw() override
+    {
+        constexpr uint64_t TIMEOUT = 1 * 1000 * 1000 * 1000; // 1 second in nanos
 
-            cmdBuffer->bindPipeline(vk::PipelineBindPoint::eCompute, mDrawPipeline);
+        auto imageIdx = mDevice->acquireNextImageKHR(mSwapChain, TIMEOUT, mSemaphoreAvailable, nullptr);
+        if (imageIdx.result != vk::Result::eSuccess) {
+            std::cout << "Failed to acquire image! Stoppping." << std::endl;
+            return false;
+        }
 
-            cmdBuffer->bindDescriptorSets(vk::PipelineBindPoint::eCompute, mDrawPipelineLayout, 0, 1, renderingResource.descriptorSet.get(), 0, nullptr);
+        auto & renderingResource = mRenderingResources[imageIdx.value];
 
-            cmdBuffer->dispatch(mFramebufferExtents.width, mFramebufferExtents.height, 1);
+        mDevice->resetFences(1, renderingResource.fence.get());
 
+        // Preapare command buffer
+        auto& cmdBuffer = renderingResource.commandBuffer;
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        cmdBuffer->begin(beginInfo);
 
-            vk::ImageMemoryBarrier barrierFromDrawToPresent;
-            barrierFromDrawToPresent.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
-            barrierFromDrawToPresent.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
-            barrierFromDrawToPresent.oldLayout = vk::ImageLayout::eGeneral;
-            barrierFromDrawToPresent.newLayout = vk::ImageLayout::ePresentSrcKHR;
-            barrierFromDrawToPresent.srcQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromDrawToPresent.dstQueueFamilyIndex = mQueueFamilyPresent;
-            barrierFromDrawToPresent.image = renderingResource.imageHandle;
-            barrierFromDrawToPresent.subresourceRange = range;
-            cmdBuffer->pipelineBarrier(vk::PipelineStageFlagBits::eBottomOfPipe, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrierFromDrawToPresent);
+        RegisterStagingImage();
+
+        /**
+         * Upload, blur and draw from the blur result, barriers are inserted by the render graph
+         * Transition of the swapchain image and the dependency on the blur go with one barrier
+         */
+        // Contents of the presented image are not needed
+        mStateTracker.SetImageState(renderingResource.imageHandle, renderingResource.undefinedLaout ? vk::ImageLayout::eUndefined : vk::ImageLayout::ePresentSrcKHR);
+        renderingResource.undefinedLaout = false;
+        mRenderGraph.SetImportedImage(mGraphSwapchain, renderingResource.imageHandle);
+        mDrawDescriptorSet = renderingResource.descriptorSet;
+
+        cmdBuffer->resetQueryPool(mQueryPool, 0, 2);
+
+        mRenderGraph.Execute(cmdBuffer, mStateTracker);
+
+        mStateTracker.UseImage(renderingResource.imageHandle, vk::PipelineStageFlagBits::eBottomOfPipe, vk::AccessFlags(), vk::ImageLayout::ePresentSrcKHR);
+        mStateTracker.Flush(cmdBuffer);
 
-        }
         cmdBuffer->end();
 
         // Submit
@@ -996,7 +2027,7 @@ public:
             std::array<uint64_t, 2> timestamps = { 0, 0 }; // nanoseconds 
             mDevice->getQueryPoolResults(mQueryPool, 0, 2, sizeof(timestamps), &timestamps[0], sizeof(uint64_t), vk::QueryResultFlagBits::e64);
 
-            std::cout << "Execution time = " << (timestamps[1] - timestamps[0]) / 1e6 << " ms" << std::endl;
+            std::cout << "Execution time = " << (timestamps[1] - timestamps[0]) * mTimestampPeriod / 1e6 << " ms" << std::endl;
         }
 
         ++mFrameCounter;
@@ -1012,8 +2043,91 @@ public:
 
 };
 
-int main() {
+int main(int argc, char** argv) {
     try {
+        // Pass --format rgba16f or --format rgba32f to make the 8 iterations on float images with filtered taps
+        // Pass --gaussian [radius [sigma]] to blur with a single separable Gaussian pass
+        // Pass --box [radius] to blur with 3 sliding window box passes
+        // Pass --pyramid [levels] to blur with Dual Kawase pyramid, each level doubles the radius
+        // Pass --fft [radius [sigma]] to convolve with 2D Gaussian via FFT, radius is not limited
+        // Pass --fft-kernel file.bmp to convolve via FFT with the brightness of the image as kernel
+        // Pass --benchmark to compare blur modes for radii 4..256 and find the radius where FFT outruns the separable Gaussian
+        // Pass --batch input_dir output_dir [threads] [--cpu | --verify] to blur all .bmp images of the directory without window,
+        //   on CPU or with comparison of GPU results to CPU ones
+        if (argc >= 4 && std::string(argv[1]) == "--batch") {
+            uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+            BatchDevice device = BatchDevice::Gpu;
+            for (int i = 4; i < argc; ++i) {
+                const std::string arg = argv[i];
+                if (arg == "--cpu") {
+                    device = BatchDevice::Cpu;
+                }
+                else if (arg == "--verify") {
+                    device = BatchDevice::GpuVerify;
+                }
+                else {
+                    threads = static_cast<uint32_t>(std::stoul(arg));
+                }
+            }
+            RunBlurBatch(argv[2], argv[3], threads, device);
+            return 0;
+        }
+
+        BlurMode blurMode = BlurMode::Iterative;
+        uint32_t gaussRadius = 16;
+        float gaussSigma = 0.0f;
+        uint32_t boxRadius = 8;
+        uint32_t pyramidLevels = 4;
+        std::string fftKernelFile;
+        bool benchmark = false;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--benchmark") {
+                benchmark = true;
+            }
+            else if (arg == "--format" && i + 1 < argc) {
+                const std::string format = argv[++i];
+                if (format == "rgba16f") {
+                    blurMode = BlurMode::IterativeHalf;
+                }
+                else if (format == "rgba32f") {
+                    blurMode = BlurMode::IterativeFloat;
+                }
+                else if (format != "rgba8ui") {
+                    throw std::runtime_error("Unknown format " + format);
+                }
+            }
+            else if (arg == "--box") {
+                blurMode = BlurMode::Box;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    boxRadius = static_cast<uint32_t>(std::stoul(argv[++i]));
+                }
+            }
+            else if (arg == "--pyramid") {
+                blurMode = BlurMode::Pyramid;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    pyramidLevels = static_cast<uint32_t>(std::stoul(argv[++i]));
+                }
+            }
+            else if (arg == "--fft-kernel" && i + 1 < argc) {
+                blurMode = BlurMode::Fft;
+                fftKernelFile = argv[++i];
+            }
+            else if (arg == "--gaussian" || arg == "--fft") {
+                blurMode = (arg == "--fft") ? BlurMode::Fft : BlurMode::Gaussian;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    gaussRadius = static_cast<uint32_t>(std::stoul(argv[++i]));
+                }
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    gaussSigma = std::stof(argv[++i]);
+                }
+            }
+        }
+        if (gaussSigma <= 0.0f) {
+            // Kernel covers +-3 sigma
+            gaussSigma = std::max(gaussRadius / 3.0f, 0.5f);
+        }
+
         ApiWithoutSecrets::OS::Window window;
         // Window creation
         if (!window.Create("16 - Blur", 512, 512)) {
@@ -1021,7 +2135,7 @@ int main() {
         }
 
         // Render loop
-        Sample_03_Window application(window.GetParameters(), 512, 512);
+        Sample_03_Window application(window.GetParameters(), 512, 512, blurMode, gaussRadius, gaussSigma, boxRadius, pyramidLevels, fftKernelFile, benchmark);
         if (!window.RenderingLoop(application)) {
             return -1;
         }
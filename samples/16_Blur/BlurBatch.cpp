@@ -0,0 +1,758 @@
+/**
+* Vulkan samples
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#include "BlurBatch.h"
+#include "BlurCpu.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <VulkanUtility.h>
+#include <OperatingSystem.h>
+
+namespace
+{
+    // Must match 16.blur.comp
+    constexpr uint32_t BLOCK_SIZE = 8;
+    constexpr uint32_t BLUR_ITERATIONS = 8;
+
+    // Images being uploaded, blurred or read back at the same time
+    constexpr uint32_t IMAGES_IN_FLIGHT = 3;
+    // Decoded images waiting for upload and blurred images waiting for encoding
+    constexpr size_t QUEUE_CAPACITY = 8;
+
+    /**
+     * Bounded queue between pipeline stages, Pop returns false when the queue is closed and empty,
+     * Push drops the item and returns false when the queue is closed
+     */
+    template <typename Ty_>
+    class BlockingQueue
+    {
+        std::deque<Ty_> mItems;
+        std::mutex mMutex;
+        std::condition_variable mNotEmpty;
+        std::condition_variable mNotFull;
+        size_t mCapacity;
+        bool mClosed = false;
+
+    public:
+        explicit BlockingQueue(size_t capacity)
+            : mCapacity(capacity)
+        { }
+
+        bool Push(Ty_ && item)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotFull.wait(lock, [this] { return mItems.size() < mCapacity || mClosed; });
+            if (mClosed) {
+                return false;
+            }
+            mItems.push_back(std::move(item));
+            mNotEmpty.notify_one();
+            return true;
+        }
+
+        bool Pop(Ty_ & item)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotEmpty.wait(lock, [this] { return !mItems.empty() || mClosed; });
+            if (mItems.empty()) {
+                return false;
+            }
+            item = std::move(mItems.front());
+            mItems.pop_front();
+            mNotFull.notify_one();
+            return true;
+        }
+
+        void Close()
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mClosed = true;
+            mNotEmpty.notify_all();
+            // Producers blocked on a full queue stop too
+            mNotFull.notify_all();
+        }
+    };
+
+    struct BatchImage
+    {
+        std::string name;
+        RgbaImage image;
+        RgbaImage source; // kept for verification
+    };
+
+    std::vector<std::string> ListBmpFiles(const std::string & directory)
+    {
+        std::vector<std::string> names;
+        WIN32_FIND_DATAA findData;
+        HANDLE findHandle = FindFirstFileA((directory + "\\*.bmp").c_str(), &findData);
+        if (findHandle == INVALID_HANDLE_VALUE) {
+            return names;
+        }
+        do {
+            if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+                names.push_back(findData.cFileName);
+            }
+        } while (FindNextFileA(findHandle, &findData));
+        FindClose(findHandle);
+        std::sort(names.begin(), names.end());
+        return names;
+    }
+
+
+    class BlurBatch
+    {
+        /**
+         * Resources of one image in flight: staging memory of the ring, ping-pong images and commands
+         * Images are recreated only when the size of the next image differs
+         */
+        struct Slot
+        {
+            vk::Extent2D extent;
+            vk::DeviceSize capacity = 0;
+
+            VulkanHolder<vk::Buffer> uploadBuffer;
+            VulkanHolder<vk::DeviceMemory> uploadMemory;
+            uint8_t* uploadPtr = nullptr;
+
+            VulkanHolder<vk::Buffer> readbackBuffer;
+            VulkanHolder<vk::DeviceMemory> readbackMemory;
+            uint8_t* readbackPtr = nullptr;
+
+            std::array<VulkanHolder<vk::Image>, 2> images; // second one is transposed
+            std::array<VulkanHolder<vk::DeviceMemory>, 2> imagesMemory;
+            std::array<VulkanHolder<vk::ImageView>, 2> views;
+            std::array<vk::DescriptorSet, 2> descriptorSets; // freed with the pool
+            bool undefinedLayout = true;
+
+            VulkanHolder<vk::CommandBuffer> commandBuffer;
+            VulkanHolder<vk::Fence> fence;
+
+            bool busy = false;
+            std::string name;
+            RgbaImage source;
+        };
+
+        VulkanHolder<vk::Instance> mVulkan;
+        VulkanHolder<vk::Device> mDevice;
+        vk::PhysicalDevice mPhysicalDevice;
+        uint32_t mQueueFamily = std::numeric_limits<uint32_t>::max();
+        vk::Queue mQueue;
+
+        VulkanHolder<vk::ShaderModule> mBlurShader;
+        VulkanHolder<vk::DescriptorSetLayout> mDescriptorSetLayout;
+        VulkanHolder<vk::DescriptorPool> mDescriptorPool;
+        VulkanHolder<vk::PipelineLayout> mPipelineLayout;
+        VulkanHolder<vk::Pipeline> mPipeline;
+        VulkanHolder<vk::Sampler> mSampler;
+        VulkanHolder<vk::CommandPool> mCommandPool;
+
+        std::array<Slot, IMAGES_IN_FLIGHT> mSlots;
+
+        VulkanHolder<vk::DeviceMemory> AllocateMemory(const vk::MemoryRequirements & requirements, vk::MemoryPropertyFlags required, vk::MemoryPropertyFlags preferred = vk::MemoryPropertyFlags())
+        {
+            vk::PhysicalDeviceMemoryProperties memroProperties = mPhysicalDevice.getMemoryProperties();
+            for (const auto & properties : { required | preferred, required }) {
+                for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+                    if ((requirements.memoryTypeBits & (1 << i)) &&
+                        ((memroProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+
+                        vk::MemoryAllocateInfo allocateInfo;
+                        allocateInfo.setAllocationSize(requirements.size);
+                        allocateInfo.setMemoryTypeIndex(i);
+                        return MakeHolder(mDevice->allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice->freeMemory(memory); });
+                    }
+                }
+            }
+            throw std::runtime_error("Failed to find suitable memory type");
+        }
+
+        void CreateStaging(Slot & slot, vk::DeviceSize size)
+        {
+            slot.uploadPtr = nullptr;
+            slot.readbackPtr = nullptr;
+            slot.uploadMemory.destory();
+            slot.readbackMemory.destory();
+
+            vk::BufferCreateInfo bufferInfo;
+            bufferInfo.setSize(size);
+            bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+
+            bufferInfo.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
+            slot.uploadBuffer = MakeHolder(mDevice->createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice->destroyBuffer(buffer); });
+            slot.uploadMemory = AllocateMemory(mDevice->getBufferMemoryRequirements(slot.uploadBuffer), vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+            mDevice->bindBufferMemory(slot.uploadBuffer, slot.uploadMemory, 0);
+
+            // Reading uncached memory on host is slow
+            bufferInfo.setUsage(vk::BufferUsageFlagBits::eTransferDst);
+            slot.readbackBuffer = MakeHolder(mDevice->createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice->destroyBuffer(buffer); });
+            slot.readbackMemory = AllocateMemory(mDevice->getBufferMemoryRequirements(slot.readbackBuffer), vk::MemoryPropertyFlagBits::eHostVisible, vk::MemoryPropertyFlagBits::eHostCached);
+            mDevice->bindBufferMemory(slot.readbackBuffer, slot.readbackMemory, 0);
+
+            // Staging memory stays mapped
+            slot.uploadPtr = static_cast<uint8_t*>(mDevice->mapMemory(slot.uploadMemory, 0, VK_WHOLE_SIZE));
+            slot.readbackPtr = static_cast<uint8_t*>(mDevice->mapMemory(slot.readbackMemory, 0, VK_WHOLE_SIZE));
+            if (slot.uploadPtr == nullptr || slot.readbackPtr == nullptr) {
+                throw std::runtime_error("Failed to map staging memory!");
+            }
+            slot.capacity = size;
+        }
+
+        void CreateImages(Slot & slot, const vk::Extent2D & extent)
+        {
+            for (uint32_t j = 0; j < 2; ++j) {
+                slot.views[j].destory();
+                slot.images[j].destory();
+
+                vk::ImageCreateInfo imageInfo;
+                imageInfo.setImageType(vk::ImageType::e2D);
+                if (j == 0) {
+                    imageInfo.setExtent(vk::Extent3D(extent.width, extent.height, 1));
+                } else {
+                    imageInfo.setExtent(vk::Extent3D(extent.height, extent.width, 1));
+                }
+                imageInfo.setMipLevels(1);
+                imageInfo.setArrayLayers(1);
+                imageInfo.setFormat(vk::Format::eR8G8B8A8Uint);
+                imageInfo.setTiling(vk::ImageTiling::eOptimal);
+                imageInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+                imageInfo.setUsage(vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
+                imageInfo.setSharingMode(vk::SharingMode::eExclusive);
+                imageInfo.setSamples(vk::SampleCountFlagBits::e1);
+                slot.images[j] = MakeHolder(mDevice->createImage(imageInfo), [this](vk::Image & img) { mDevice->destroyImage(img); });
+
+                slot.imagesMemory[j] = AllocateMemory(mDevice->getImageMemoryRequirements(slot.images[j]), vk::MemoryPropertyFlagBits::eDeviceLocal);
+                mDevice->bindImageMemory(slot.images[j], slot.imagesMemory[j], 0);
+
+                vk::ImageViewCreateInfo viewInfo;
+                viewInfo.setImage(slot.images[j]);
+                viewInfo.setViewType(vk::ImageViewType::e2D);
+                viewInfo.setFormat(vk::Format::eR8G8B8A8Uint);
+                viewInfo.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+                slot.views[j] = MakeHolder(mDevice->createImageView(viewInfo), [this](vk::ImageView & view) { mDevice->destroyImageView(view); });
+            }
+
+            // Pass 0 reads image 0 and writes transposed image 1, pass 1 goes back
+            for (uint32_t j = 0; j < 2; ++j) {
+                std::array<vk::WriteDescriptorSet, 2> writeDescriptorsInfo;
+                std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
+
+                descriptorImageInfo[0].setImageView(slot.views[j]);
+                descriptorImageInfo[0].setSampler(mSampler);
+                descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+                descriptorImageInfo[1].setImageView(slot.views[1 - j]);
+                descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+                writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+                writeDescriptorsInfo[0].setDstSet(slot.descriptorSets[j]);
+                writeDescriptorsInfo[0].setDstBinding(0);
+                writeDescriptorsInfo[0].setDstArrayElement(0);
+                writeDescriptorsInfo[0].setDescriptorCount(1);
+                writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
+
+                writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+                writeDescriptorsInfo[1].setDstSet(slot.descriptorSets[j]);
+                writeDescriptorsInfo[1].setDstBinding(1);
+                writeDescriptorsInfo[1].setDstArrayElement(0);
+                writeDescriptorsInfo[1].setDescriptorCount(1);
+                writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
+
+                mDevice->updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+            }
+
+            slot.extent = extent;
+            slot.undefinedLayout = true;
+        }
+
+        void RecordBlur(Slot & slot)
+        {
+            const vk::CommandBuffer & cmdBuffer = *slot.commandBuffer;
+            const vk::Extent2D & extent = slot.extent;
+
+            vk::CommandBufferBeginInfo beginInfo;
+            beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+            cmdBuffer.begin(beginInfo);
+
+            if (slot.undefinedLayout) {
+                std::array<vk::ImageMemoryBarrier, 2> barriers;
+                for (uint32_t j = 0; j < 2; ++j) {
+                    barriers[j].srcAccessMask = vk::AccessFlags();
+                    barriers[j].dstAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+                    barriers[j].oldLayout = vk::ImageLayout::eUndefined;
+                    barriers[j].newLayout = vk::ImageLayout::eGeneral;
+                    barriers[j].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barriers[j].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    barriers[j].image = slot.images[j];
+                    barriers[j].subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+                }
+                cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                    vk::DependencyFlags(), 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), &barriers[0]);
+                slot.undefinedLayout = false;
+            }
+
+            vk::BufferImageCopy copyInfo;
+            copyInfo.setBufferOffset(0);
+            copyInfo.setBufferRowLength(0); // tightly packed
+            copyInfo.setBufferImageHeight(0);
+            copyInfo.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+            copyInfo.setImageOffset(vk::Offset3D(0, 0, 0));
+            copyInfo.setImageExtent(vk::Extent3D(extent.width, extent.height, 1));
+            cmdBuffer.copyBufferToImage(slot.uploadBuffer, slot.images[0], vk::ImageLayout::eGeneral, 1, &copyInfo);
+
+            vk::MemoryBarrier barrierBetweenPasses;
+            barrierBetweenPasses.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+            barrierBetweenPasses.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+
+            cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline);
+            for (uint32_t i = 0; i < BLUR_ITERATIONS; ++i) {
+                // from 0 to 1
+                cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+                    vk::DependencyFlags(), 1, &barrierBetweenPasses, 0, nullptr, 0, nullptr);
+                cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPipelineLayout, 0, 1, &slot.descriptorSets[0], 0, nullptr);
+                cmdBuffer.dispatch((extent.width + BLOCK_SIZE - 1) / BLOCK_SIZE, (extent.height + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+
+                // from 1 to 0
+                cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                    vk::DependencyFlags(), 1, &barrierBetweenPasses, 0, nullptr, 0, nullptr);
+                cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPipelineLayout, 0, 1, &slot.descriptorSets[1], 0, nullptr);
+                cmdBuffer.dispatch((extent.height + BLOCK_SIZE - 1) / BLOCK_SIZE, (extent.width + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+            }
+
+            vk::MemoryBarrier barrierToReadback;
+            barrierToReadback.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrierToReadback.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+                vk::DependencyFlags(), 1, &barrierToReadback, 0, nullptr, 0, nullptr);
+
+            cmdBuffer.copyImageToBuffer(slot.images[0], vk::ImageLayout::eGeneral, slot.readbackBuffer, 1, &copyInfo);
+
+            vk::MemoryBarrier barrierToHost;
+            barrierToHost.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrierToHost.dstAccessMask = vk::AccessFlagBits::eHostRead;
+            cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                vk::DependencyFlags(), 1, &barrierToHost, 0, nullptr, 0, nullptr);
+
+            cmdBuffer.end();
+        }
+
+        /**
+         * Wait for the image in flight and pass it to encoding
+         */
+        void FinishSlot(Slot & slot, BlockingQueue<BatchImage> & results)
+        {
+            constexpr uint64_t TIMEOUT = 10ull * 1000 * 1000 * 1000; // 10 seconds in nanos
+
+            if (!slot.busy) {
+                return;
+            }
+            if (vk::Result::eSuccess != mDevice->waitForFences(1, slot.fence.get(), VK_FALSE, TIMEOUT)) {
+                throw std::runtime_error("Waiting for blur takes too long");
+            }
+            slot.busy = false;
+
+            // Readback memory may be not coherent
+            vk::MappedMemoryRange mappedRange;
+            mappedRange.setMemory(slot.readbackMemory);
+            mappedRange.setOffset(0);
+            mappedRange.setSize(VK_WHOLE_SIZE);
+            mDevice->invalidateMappedMemoryRanges(mappedRange);
+
+            BatchImage result;
+            result.name = std::move(slot.name);
+            result.source = std::move(slot.source);
+            result.image.width = slot.extent.width;
+            result.image.height = slot.extent.height;
+            result.image.pixels.assign(slot.readbackPtr, slot.readbackPtr + slot.extent.width * slot.extent.height * 4);
+            results.Push(std::move(result));
+        }
+
+        void SubmitSlot(Slot & slot, BatchImage & item)
+        {
+            const vk::Extent2D extent(item.image.width, item.image.height);
+            const vk::DeviceSize size = item.image.pixels.size();
+
+            if (size > slot.capacity) {
+                CreateStaging(slot, size);
+            }
+            if (extent != slot.extent) {
+                CreateImages(slot, extent);
+            }
+            std::memcpy(slot.uploadPtr, item.image.pixels.data(), item.image.pixels.size());
+
+            RecordBlur(slot);
+
+            mDevice->resetFences(1, slot.fence.get());
+            vk::SubmitInfo submitInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = slot.commandBuffer.get();
+            if (vk::Result::eSuccess != mQueue.submit(1, &submitInfo, slot.fence)) {
+                throw std::runtime_error("Failed to submit blur commands");
+            }
+            slot.busy = true;
+            slot.name = std::move(item.name);
+            slot.source = std::move(item.image);
+        }
+
+    public:
+        BlurBatch()
+        {
+            vk::ApplicationInfo applicationInfo;
+            applicationInfo.pApplicationName = "Vulkan sample: Blur batch";
+            applicationInfo.pEngineName = "Vulkan";
+            applicationInfo.apiVersion = VK_MAKE_VERSION(1, 0, 0);
+            applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+            applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+
+            // No surface is needed
+            std::vector<const char*> extensions = {
+#ifndef NDEBUG
+                VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+#endif
+            };
+            std::cout << "Check extensions...";
+            CheckExtensions(extensions);
+            std::cout << "OK" << std::endl;
+
+            std::cout << "Create Vulkan Instance...";
+            vk::InstanceCreateInfo instanceCreateInfo;
+            instanceCreateInfo.pApplicationInfo = &applicationInfo;
+            instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+            instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
+#ifndef NDEBUG
+            std::vector<const char*> layers = { "VK_LAYER_LUNARG_standard_validation" };
+            CheckLayers(layers);
+            instanceCreateInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
+            instanceCreateInfo.ppEnabledLayerNames = &layers[0];
+#endif
+            mVulkan = vk::createInstance(instanceCreateInfo);
+            if (!mVulkan) {
+                throw std::runtime_error("Failed to create Vulkan instance");
+            }
+            std::cout << "OK" << std::endl;
+
+            std::cout << "Find Vulkan physical device...";
+            std::vector<vk::PhysicalDevice> devices = mVulkan->enumeratePhysicalDevices();
+            if (devices.empty()) {
+                throw std::runtime_error("Physical device was not found");
+            }
+            mPhysicalDevice = devices.front();
+            auto queueFamilyProperties = mPhysicalDevice.getQueueFamilyProperties();
+            for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i) {
+                if ((queueFamilyProperties[i].queueCount > 0) && (queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute)) {
+                    mQueueFamily = i;
+                    break;
+                }
+            }
+            if (mQueueFamily >= queueFamilyProperties.size()) {
+                throw std::runtime_error("Device doesn't support compute queue");
+            }
+            std::cout << "OK" << std::endl;
+
+            std::cout << "Create logical device...";
+            std::vector<float> queuePriorities = { 1.0f };
+            vk::DeviceQueueCreateInfo queueCreateInfo;
+            queueCreateInfo.queueFamilyIndex = mQueueFamily;
+            queueCreateInfo.queueCount = static_cast<uint32_t>(queuePriorities.size());
+            queueCreateInfo.pQueuePriorities = &queuePriorities[0];
+            vk::DeviceCreateInfo deviceCreateInfo;
+            deviceCreateInfo.queueCreateInfoCount = 1;
+            deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+            mDevice = mPhysicalDevice.createDevice(deviceCreateInfo);
+            mQueue = mDevice->getQueue(mQueueFamily, 0);
+            std::cout << "OK" << std::endl;
+
+            std::cout << "Create blur pipeline...";
+            {
+                auto code = GetBinaryShaderFromSourceFile(QUOTE(SHADERS_DIR) "/glsl/16.blur.comp");
+                if (code.empty()) {
+                    throw std::runtime_error("LoadShader: Failed to read shader file!");
+                }
+                vk::ShaderModuleCreateInfo shaderInfo;
+                shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                shaderInfo.setCodeSize(code.size());
+                mBlurShader = MakeHolder(mDevice->createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice->destroyShaderModule(shader); });
+
+                std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+
+                bindings[0].setBinding(0);
+                bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+                bindings[0].setDescriptorCount(1);
+                bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                bindings[1].setBinding(1);
+                bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+                bindings[1].setDescriptorCount(1);
+                bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+                vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+                descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+                descriptorSetInfo.setPBindings(&bindings[0]);
+                mDescriptorSetLayout = MakeHolder(mDevice->createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice->destroyDescriptorSetLayout(layout); });
+
+                vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+                pipelineLayoutInfo.setSetLayoutCount(1);
+                pipelineLayoutInfo.setPSetLayouts(mDescriptorSetLayout.get());
+                mPipelineLayout = MakeHolder(mDevice->createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice->destroyPipelineLayout(layout); });
+
+                vk::PipelineShaderStageCreateInfo stageInfo;
+                stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+                stageInfo.setModule(mBlurShader);
+                stageInfo.setPName("main"); // Shader entry point
+
+                vk::ComputePipelineCreateInfo computePipelineInfo;
+                computePipelineInfo.setStage(stageInfo);
+                computePipelineInfo.setLayout(mPipelineLayout);
+                mPipeline = MakeHolder(mDevice->createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) {mDevice->destroyPipeline(pipeline); });
+
+                // Same sampler as in the interactive mode
+                vk::SamplerCreateInfo samplerInfo;
+                samplerInfo.setMagFilter(vk::Filter::eLinear);
+                samplerInfo.setMinFilter(vk::Filter::eLinear);
+                samplerInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+                samplerInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+                samplerInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+                samplerInfo.setAnisotropyEnable(VK_FALSE);
+                samplerInfo.setMaxAnisotropy(1.0f);
+                samplerInfo.setBorderColor(vk::BorderColor::eIntOpaqueBlack);
+                samplerInfo.setUnnormalizedCoordinates(VK_TRUE); // Use [0, Size)
+                samplerInfo.setCompareEnable(VK_FALSE);
+                samplerInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+                samplerInfo.setMipLodBias(0.0f);
+                samplerInfo.setMinLod(0.0f);
+                samplerInfo.setMaxLod(0.0f);
+                mSampler = MakeHolder(mDevice->createSampler(samplerInfo), [this](vk::Sampler & sampler) { mDevice->destroySampler(sampler); });
+
+                std::cout << "OK" << std::endl;
+            }
+
+            std::cout << "Create " << IMAGES_IN_FLIGHT << " slots for images in flight...";
+            {
+                std::array<vk::DescriptorPoolSize, 2> poolSize;
+                poolSize[0].setType(vk::DescriptorType::eCombinedImageSampler);
+                poolSize[0].setDescriptorCount(2 * IMAGES_IN_FLIGHT);
+                poolSize[1].setType(vk::DescriptorType::eStorageImage);
+                poolSize[1].setDescriptorCount(2 * IMAGES_IN_FLIGHT);
+
+                vk::DescriptorPoolCreateInfo poolInfo;
+                poolInfo.setMaxSets(2 * IMAGES_IN_FLIGHT);
+                poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSize.size()));
+                poolInfo.setPPoolSizes(&poolSize[0]);
+                mDescriptorPool = MakeHolder(mDevice->createDescriptorPool(poolInfo), [this](vk::DescriptorPool & pool) { mDevice->destroyDescriptorPool(pool); });
+
+                vk::CommandPoolCreateInfo commandsPoolInfo;
+                commandsPoolInfo.setQueueFamilyIndex(mQueueFamily);
+                commandsPoolInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+                mCommandPool = MakeHolder(mDevice->createCommandPool(commandsPoolInfo), [this](vk::CommandPool & pool) { mDevice->destroyCommandPool(pool); });
+
+                for (auto & slot : mSlots) {
+                    std::array<vk::DescriptorSetLayout, 2> setLayouts = { *mDescriptorSetLayout, *mDescriptorSetLayout };
+                    vk::DescriptorSetAllocateInfo allocInfo;
+                    allocInfo.setDescriptorPool(mDescriptorPool);
+                    allocInfo.setDescriptorSetCount(static_cast<uint32_t>(setLayouts.size()));
+                    allocInfo.setPSetLayouts(&setLayouts[0]);
+                    if (vk::Result::eSuccess != mDevice->allocateDescriptorSets(&allocInfo, &slot.descriptorSets[0])) {
+                        throw std::runtime_error("Failed to allocate descriptors set");
+                    }
+
+                    vk::CommandBufferAllocateInfo allocateInfo;
+                    allocateInfo.setCommandPool(mCommandPool);
+                    allocateInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+                    allocateInfo.setCommandBufferCount(1);
+
+                    vk::CommandBuffer buffer;
+                    if (vk::Result::eSuccess != mDevice->allocateCommandBuffers(&allocateInfo, &buffer)) {
+                        throw std::runtime_error("Failed to create command buffers");
+                    }
+                    slot.commandBuffer = VulkanHolder<vk::CommandBuffer>(buffer, [this](vk::CommandBuffer & buffer) { mDevice->freeCommandBuffers(mCommandPool, 1, &buffer); });
+
+                    slot.fence = MakeHolder(mDevice->createFence(vk::FenceCreateInfo()), [this](vk::Fence & fence) { mDevice->destroyFence(fence); });
+                }
+                std::cout << "OK" << std::endl;
+            }
+        }
+
+        BlurBatch(const BlurBatch&) = delete;
+        BlurBatch& operator= (const BlurBatch&) = delete;
+
+        ~BlurBatch()
+        {
+            if (*mDevice) {
+                mDevice->waitIdle();
+            }
+        }
+
+        /**
+         * Decoders -> upload and blur (this thread) -> encoders
+         * Each stage is connected with a bounded queue, so all of them work at the same time
+         */
+        void Process(const std::string & inputDirectory, const std::string & outputDirectory, uint32_t workerThreads, bool verify)
+        {
+            const std::vector<std::string> names = ListBmpFiles(inputDirectory);
+            if (names.empty()) {
+                std::cout << "No .bmp images in " << inputDirectory << std::endl;
+                return;
+            }
+            std::cout << "Blur " << names.size() << " images with " << workerThreads << " decoding and " << workerThreads << " encoding threads" << std::endl;
+
+            BlockingQueue<BatchImage> decoded(QUEUE_CAPACITY);
+            BlockingQueue<BatchImage> blurred(QUEUE_CAPACITY);
+
+            std::atomic<size_t> nextName(0);
+            std::atomic<uint32_t> activeDecoders(workerThreads);
+            std::atomic<size_t> failed(0);
+            std::atomic<uint64_t> pixels(0);
+
+            std::mutex reportMutex;
+            ImageDiff totalDiff;
+
+            const auto start = std::chrono::high_resolution_clock::now();
+
+            std::vector<std::thread> workers;
+            for (uint32_t t = 0; t < workerThreads; ++t) {
+                workers.emplace_back([&] {
+                    for (size_t i = nextName++; i < names.size(); i = nextName++) {
+                        BatchImage item;
+                        item.name = names[i];
+                        item.image = LoadBmpImage(inputDirectory + "\\" + names[i]);
+                        if (item.image.pixels.empty()) {
+                            ++failed;
+                            continue;
+                        }
+                        if (!decoded.Push(std::move(item))) {
+                            // Blurring failed
+                            break;
+                        }
+                    }
+                    if (--activeDecoders == 0) {
+                        decoded.Close();
+                    }
+                });
+                workers.emplace_back([&] {
+                    BatchImage item;
+                    while (blurred.Pop(item)) {
+                        if (verify) {
+                            // Encoders already run in parallel
+                            RgbaImage diffImage;
+                            const ImageDiff diff = CompareImages(item.image, BlurImageCpu(item.source, BLUR_ITERATIONS, 1), &diffImage);
+                            std::unique_lock<std::mutex> lock(reportMutex);
+                            std::cout << item.name << ": " << diff.differentPixels << " of " << diff.pixels << " pixels differ";
+                            if (diff.differentPixels > 0) {
+                                std::cout << ", max " << diff.maxDifference << ", mean " << diff.meanDifference << ", first at (" << diff.firstX << ", " << diff.firstY << ")";
+                                SaveBmpImage(outputDirectory + "\\diff_" + item.name, diffImage);
+                            }
+                            std::cout << std::endl;
+                            totalDiff.pixels += diff.pixels;
+                            totalDiff.differentPixels += diff.differentPixels;
+                            totalDiff.maxDifference = std::max(totalDiff.maxDifference, diff.maxDifference);
+                        }
+                        if (!SaveBmpImage(outputDirectory + "\\" + item.name, item.image)) {
+                            ++failed;
+                        }
+                        pixels += static_cast<uint64_t>(item.image.width) * item.image.height;
+                    }
+                });
+            }
+
+            try {
+                // Slots are taken round robin, so waiting for a slot means its image was submitted IMAGES_IN_FLIGHT images ago
+                uint32_t slotIdx = 0;
+                BatchImage item;
+                while (decoded.Pop(item)) {
+                    Slot & slot = mSlots[slotIdx];
+                    slotIdx = (slotIdx + 1) % IMAGES_IN_FLIGHT;
+
+                    FinishSlot(slot, blurred);
+                    SubmitSlot(slot, item);
+                }
+                for (uint32_t i = 0; i < IMAGES_IN_FLIGHT; ++i) {
+                    FinishSlot(mSlots[(slotIdx + i) % IMAGES_IN_FLIGHT], blurred);
+                }
+            }
+            catch (...) {
+                // Let workers finish before the queues are destroyed
+                decoded.Close();
+                blurred.Close();
+                for (auto & worker : workers) {
+                    worker.join();
+                }
+                throw;
+            }
+            blurred.Close();
+            for (auto & worker : workers) {
+                worker.join();
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            const size_t done = names.size() - failed;
+            std::cout << "Processed " << done << " images (" << failed << " failed) in " << seconds << " s: "
+                << done / seconds << " images/s, " << pixels / seconds / 1e6 << " Mpixels/s" << std::endl;
+            if (verify) {
+                std::cout << "CPU reference: " << totalDiff.differentPixels << " of " << totalDiff.pixels << " pixels differ, max difference " << totalDiff.maxDifference << std::endl;
+            }
+        }
+    };
+}
+
+namespace
+{
+    /**
+     * Images are processed one by one, the blur itself uses all threads
+     */
+    void RunCpuBatch(const std::string & inputDirectory, const std::string & outputDirectory, uint32_t threads)
+    {
+        const std::vector<std::string> names = ListBmpFiles(inputDirectory);
+        std::cout << "Blur " << names.size() << " images on CPU with " << threads << " threads" << std::endl;
+
+        size_t done = 0;
+        uint64_t pixels = 0;
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (const auto & name : names) {
+            const RgbaImage image = LoadBmpImage(inputDirectory + "\\" + name);
+            if (image.pixels.empty() || !SaveBmpImage(outputDirectory + "\\" + name, BlurImageCpu(image, BLUR_ITERATIONS, threads))) {
+                continue;
+            }
+            pixels += static_cast<uint64_t>(image.width) * image.height;
+            ++done;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "Processed " << done << " images (" << names.size() - done << " failed) in " << seconds << " s: "
+            << done / seconds << " images/s, " << pixels / seconds / 1e6 << " Mpixels/s" << std::endl;
+    }
+}
+
+void RunBlurBatch(const std::string & inputDirectory, const std::string & outputDirectory, uint32_t workerThreads, BatchDevice device)
+{
+    workerThreads = std::max(workerThreads, 1u);
+    if (device != BatchDevice::Cpu) {
+        std::unique_ptr<BlurBatch> batch;
+        try {
+            batch.reset(new BlurBatch());
+        }
+        catch (std::runtime_error & err) {
+            std::cout << "Failed!" << std::endl << err.what() << std::endl;
+            std::cout << "Vulkan device is not available, fall back to CPU" << std::endl;
+        }
+        if (batch) {
+            batch->Process(inputDirectory, outputDirectory, workerThreads, device == BatchDevice::GpuVerify);
+            return;
+        }
+    }
+    RunCpuBatch(inputDirectory, outputDirectory, workerThreads);
+}
@@ -0,0 +1,28 @@
+/**
+* Vulkan samples
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _BLUR_BATCH_H_
+#define _BLUR_BATCH_H_
+
+#include <cstdint>
+#include <string>
+
+enum class BatchDevice
+{
+    Gpu,
+    Cpu,        // BlurImageCpu, also used when Vulkan device is not available
+    GpuVerify   // GPU results are compared with BlurImageCpu
+};
+
+/**
+ * Headless blur of all .bmp images of the input directory to the output directory with 8 iterations of 16.blur.comp
+ * Decoding and encoding run on worker threads, several images are uploaded, blurred and read back at the same time
+ * Prints images per second
+ */
+void RunBlurBatch(const std::string & inputDirectory, const std::string & outputDirectory, uint32_t workerThreads, BatchDevice device = BatchDevice::Gpu);
+
+#endif
@@ -0,0 +1,217 @@
+/**
+* Vulkan samples
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#include "BlurCpu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <emmintrin.h>
+
+namespace
+{
+    // Distance from the pixel to the first and the last tap
+    constexpr uint32_t TAPS_BEFORE = 5;
+    constexpr uint32_t TAPS_AFTER = 6;
+
+    // Rows filtered together and written transposed with 4x4 blocks
+    constexpr uint32_t ROWS_BLOCK = 4;
+
+    // x / 13 == (x * 5042) >> 16 for all x <= 13 * 255
+    constexpr uint32_t DIV_13_MUL = 5042;
+
+    inline uint32_t FilterPixel(const uint32_t* padded, uint32_t x)
+    {
+        uint32_t result = 0;
+        for (uint32_t c = 0; c < 3; ++c) {
+            const uint32_t shift = 8 * c;
+            uint32_t sum = 0;
+            for (uint32_t tap : { 0u, 2u, 4u, 7u, 9u, 11u }) {
+                sum += (padded[x + tap] >> shift) & 0xFF;
+            }
+            const uint32_t anchor = (padded[x + TAPS_BEFORE] >> shift) & 0xFF;
+            result |= ((2 * sum + anchor) / 13) << shift;
+        }
+        return result;
+    }
+
+    /**
+     * Filters 4 pixels starting from x, padded[i] is the pixel i - TAPS_BEFORE
+     */
+    inline __m128i FilterPixelsSse(const uint32_t* padded, uint32_t x)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sumLo = zero;
+        __m128i sumHi = zero;
+        for (uint32_t tap : { 0u, 2u, 4u, 7u, 9u, 11u }) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + tap));
+            sumLo = _mm_add_epi16(sumLo, _mm_unpacklo_epi8(v, zero));
+            sumHi = _mm_add_epi16(sumHi, _mm_unpackhi_epi8(v, zero));
+        }
+        const __m128i anchor = _mm_loadu_si128(reinterpret_cast<const __m128i*>(padded + x + TAPS_BEFORE));
+        sumLo = _mm_add_epi16(_mm_add_epi16(sumLo, sumLo), _mm_unpacklo_epi8(anchor, zero));
+        sumHi = _mm_add_epi16(_mm_add_epi16(sumHi, sumHi), _mm_unpackhi_epi8(anchor, zero));
+
+        const __m128i div = _mm_set1_epi16(static_cast<short>(DIV_13_MUL));
+        const __m128i rgb = _mm_packus_epi16(_mm_mulhi_epu16(sumLo, div), _mm_mulhi_epu16(sumHi, div));
+        return _mm_and_si128(rgb, _mm_set1_epi32(0x00FFFFFF));
+    }
+
+    /**
+     * Filters rows [rowsBegin, rowsEnd) of src (width x height) and writes them as columns of dst (height x width)
+     */
+    void BlurRowsTransposed(const uint32_t* src, uint32_t* dst, uint32_t width, uint32_t height, uint32_t rowsBegin, uint32_t rowsEnd)
+    {
+        std::vector<uint32_t> padded(width + TAPS_BEFORE + TAPS_AFTER);
+        std::vector<uint32_t> filtered(ROWS_BLOCK * width);
+
+        for (uint32_t y0 = rowsBegin; y0 < rowsEnd; y0 += ROWS_BLOCK) {
+            const uint32_t rows = std::min(ROWS_BLOCK, rowsEnd - y0);
+
+            for (uint32_t r = 0; r < rows; ++r) {
+                const uint32_t* srcRow = src + static_cast<size_t>(y0 + r) * width;
+                std::fill(padded.begin(), padded.begin() + TAPS_BEFORE, srcRow[0]);
+                std::memcpy(&padded[TAPS_BEFORE], srcRow, width * sizeof(uint32_t));
+                std::fill(padded.end() - TAPS_AFTER, padded.end(), srcRow[width - 1]);
+
+                uint32_t* out = &filtered[r * width];
+                if (width >= 4) {
+                    // The last group overlaps the previous one instead of a scalar tail
+                    for (uint32_t x = 0; x < width; x += 4) {
+                        const uint32_t xs = std::min(x, width - 4);
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + xs), FilterPixelsSse(&padded[0], xs));
+                    }
+                } else {
+                    for (uint32_t x = 0; x < width; ++x) {
+                        out[x] = FilterPixel(&padded[0], x);
+                    }
+                }
+            }
+
+            // Transposed write, 4 rows give 16 contiguous bytes in each destination row
+            uint32_t x = 0;
+            if (rows == ROWS_BLOCK) {
+                for (; x + 4 <= width; x += 4) {
+                    const __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&filtered[0 * width + x]));
+                    const __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&filtered[1 * width + x]));
+                    const __m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&filtered[2 * width + x]));
+                    const __m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&filtered[3 * width + x]));
+                    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+                    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+                    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+                    uint32_t* dstColumn = dst + static_cast<size_t>(x) * height + y0;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dstColumn), _mm_unpacklo_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dstColumn + height), _mm_unpackhi_epi64(t0, t1));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dstColumn + 2 * height), _mm_unpacklo_epi64(t2, t3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dstColumn + 3 * height), _mm_unpackhi_epi64(t2, t3));
+                }
+            }
+            for (; x < width; ++x) {
+                for (uint32_t r = 0; r < rows; ++r) {
+                    dst[static_cast<size_t>(x) * height + y0 + r] = filtered[r * width + x];
+                }
+            }
+        }
+    }
+
+    void BlurPass(const uint32_t* src, uint32_t* dst, uint32_t width, uint32_t height, uint32_t threads)
+    {
+        // Blocks are small enough to balance threads and large enough to keep a thread in its own destination cache lines
+        constexpr uint32_t ROWS_PER_TASK = 16 * ROWS_BLOCK;
+        const uint32_t tasks = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+
+        std::atomic<uint32_t> nextTask(0);
+        auto worker = [&] {
+            for (uint32_t task = nextTask++; task < tasks; task = nextTask++) {
+                const uint32_t rowsBegin = task * ROWS_PER_TASK;
+                BlurRowsTransposed(src, dst, width, height, rowsBegin, std::min(rowsBegin + ROWS_PER_TASK, height));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (uint32_t t = 1; t < std::min(threads, tasks); ++t) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto & w : workers) {
+            w.join();
+        }
+    }
+}
+
+RgbaImage BlurImageCpu(const RgbaImage & image, uint32_t iterations, uint32_t threads)
+{
+    if (image.width == 0 || image.height == 0 || image.pixels.size() != static_cast<size_t>(image.width) * image.height * 4) {
+        throw std::runtime_error("BlurImageCpu: invalid image");
+    }
+    const size_t count = static_cast<size_t>(image.width) * image.height;
+    std::vector<uint32_t> ping(count);
+    std::vector<uint32_t> pong(count);
+    std::memcpy(&ping[0], &image.pixels[0], count * sizeof(uint32_t));
+    if (iterations == 0) {
+        // Same alpha as after the shader
+        for (auto & pixel : ping) {
+            pixel &= 0x00FFFFFF;
+        }
+    }
+
+    threads = std::max(threads, 1u);
+    for (uint32_t i = 0; i < iterations; ++i) {
+        BlurPass(&ping[0], &pong[0], image.width, image.height, threads);
+        BlurPass(&pong[0], &ping[0], image.height, image.width, threads);
+    }
+
+    RgbaImage result;
+    result.width = image.width;
+    result.height = image.height;
+    result.pixels.resize(count * 4);
+    std::memcpy(&result.pixels[0], &ping[0], count * sizeof(uint32_t));
+    return result;
+}
+
+ImageDiff CompareImages(const RgbaImage & lhs, const RgbaImage & rhs, RgbaImage* diffImage)
+{
+    if (lhs.width != rhs.width || lhs.height != rhs.height || lhs.pixels.size() != rhs.pixels.size()) {
+        throw std::runtime_error("CompareImages: sizes don't match");
+    }
+    if (diffImage) {
+        diffImage->width = lhs.width;
+        diffImage->height = lhs.height;
+        diffImage->pixels.assign(lhs.pixels.size(), 0);
+    }
+
+    ImageDiff diff;
+    diff.pixels = static_cast<uint64_t>(lhs.width) * lhs.height;
+    uint64_t total = 0;
+    for (size_t i = 0; i < lhs.pixels.size(); i += 4) {
+        uint32_t pixelDifference = 0;
+        for (size_t c = 0; c < 3; ++c) {
+            const uint32_t d = static_cast<uint32_t>(std::abs(int(lhs.pixels[i + c]) - int(rhs.pixels[i + c])));
+            pixelDifference = std::max(pixelDifference, d);
+            total += d;
+            if (diffImage) {
+                diffImage->pixels[i + c] = static_cast<uint8_t>(std::min(d * 64u, 255u));
+            }
+        }
+        if (pixelDifference > 0) {
+            if (diff.differentPixels == 0) {
+                diff.firstX = static_cast<uint32_t>((i / 4) % lhs.width);
+                diff.firstY = static_cast<uint32_t>((i / 4) / lhs.width);
+            }
+            ++diff.differentPixels;
+            diff.maxDifference = std::max(diff.maxDifference, pixelDifference);
+        }
+    }
+    diff.meanDifference = static_cast<double>(total) / (3.0 * diff.pixels);
+    return diff;
+}
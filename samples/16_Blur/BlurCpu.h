@@ -0,0 +1,43 @@
+/**
+* Vulkan samples
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _BLUR_CPU_H_
+#define _BLUR_CPU_H_
+
+#include <cstdint>
+
+#include <VulkanUtility.h>
+
+/**
+ * CPU version of 16.blur.comp, the result is expected to match the GPU one bit to bit
+ * Each iteration is two passes, a pass filters rows and writes the result transposed, so the second pass filters columns of the source
+ * The filter is 6 taps with weight 2 and the center with weight 1 divided by 13
+ * rgba8ui can't be filtered linearly, so the half texel offsets of the shader fetch the nearest texels x-5, x-3, x-1, x, x+2, x+4, x+6 clamped to edge
+ * Rows are split into blocks between threads, alpha of the result is 0 like in the shader
+ */
+RgbaImage BlurImageCpu(const RgbaImage & image, uint32_t iterations, uint32_t threads);
+
+/**
+ * Per pixel comparison of RGB channels
+ */
+struct ImageDiff
+{
+    uint64_t pixels = 0;
+    uint64_t differentPixels = 0;
+    uint32_t maxDifference = 0;
+    double meanDifference = 0.0;
+    uint32_t firstX = 0;  // first different pixel
+    uint32_t firstY = 0;
+};
+
+/**
+ * Compares images of the same size
+ * If diffImage is not null, it gets absolute differences scaled to be visible
+ */
+ImageDiff CompareImages(const RgbaImage & lhs, const RgbaImage & rhs, RgbaImage* diffImage = nullptr);
+
+#endif
@@ -15,6 +15,7 @@
 
 #include <VulkanUtility.h>
 #include <OperatingSystem.h>
+#include <MeshBuilder.h>
 
 #include <math/OgreVector2.h>
 #include <math/OgreVector4.h>
@@ -31,12 +32,6 @@ class Sample_03_Window
         Ogre::Vector4 normal;
     };
 
-    struct Mesh
-    {
-        std::vector<VertexData> vertexes;
-        std::vector<uint32_t> indexes;
-    };
-
     struct CameraProperties
     {
         Ogre::Matrix4 viewInverse;
@@ -85,6 +80,7 @@ class Sample_03_Window
     VulkanHolder<vk::Buffer> mIndexesBuffer;
     VulkanHolder<vk::DeviceMemory> mIndexesMemory;
     uint32_t mIndexesNumber = 0;
+    vk::IndexType mIndexType = vk::IndexType::eUint16;
 
 
     VulkanHolder<vk::AccelerationStructureNV> mAccelerationStructureBottom;
@@ -159,56 +155,6 @@ class Sample_03_Window
 
 
 
-    static Mesh GenerateCube(const float size)
-    {
-        // Code adopted from Ogre::PrefabFactory
-        // https://bitbucket.org/sinbad/ogre/src
-
-        Mesh cube;
-        const float halfSize = size / 2.0f;
-
-        // front side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f,  1.0f, 0.0f) });
-        // back side  
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  0.0f, -1.0f, 0.0f) });
-        // left side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(-1.0f,  0.0f,  0.0f, 0.0f) });
-        // right side
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(1.0f,  0.0f,  0.0f, 0.0f) });
-        // up side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize,  halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize,  halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f,  1.0f,  0.0f, 0.0f) });
-        // down side 
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize, -halfSize, -halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4( halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f, 0.0f) });
-        cube.vertexes.push_back(VertexData{ Ogre::Vector4(-halfSize, -halfSize,  halfSize, 1.0f), Ogre::Vector4(0.0f, -1.0f,  0.0f, 0.0f) });
-
-        cube.indexes = { /* front */   0,  1,  2,    0,  2,  3,
-            /* back  */   4,  5,  6,    4,  6,  7,
-            /* left  */   8,  9, 10,    8, 10, 11,
-            /* right */  12, 13, 14,   12, 14, 15,
-            /* up    */  16, 17, 18,   16, 18, 19,
-            /* down */   20, 21, 22,   20, 22, 23
-        };
-
-        return cube;
-    }
-
     void BuildAccelerationStructures(vk::AccelerationStructureInfoNV topASInfo, vk::AccelerationStructureInfoNV bottomASInfo, std::vector<VkGeometryInstance>& instances)
     {
         vk::AccelerationStructureCreateInfoNV accelerationStructureCreateInfoTop{};
@@ -731,11 +677,13 @@ public:
         mRotationY = Ogre::Quaternion::IDENTITY;
         MakePerspectiveProjectionMatrix(mProjectionMatrix, static_cast<float>(width) / height, 45.0f, 0.01f, 1000.0f);
 
-        auto mesh = GenerateCube(1.0f);
+        // Hit shader fetches 32 bit indexes from the storage buffer
+        auto mesh = MeshBuilder::GenerateCube<VertexData>(1.0f, vk::IndexType::eUint32);
 
-        mIndexesNumber = static_cast<uint32_t>(mesh.indexes.size());
+        mIndexesNumber = mesh.GetIndexesCount();
+        mIndexType = mesh.indexType;
         const uint32_t vertexBufferSize  = static_cast<uint32_t>(mesh.vertexes.size() * sizeof(decltype(mesh.vertexes)::value_type));
-        const uint32_t indexesBufferSize = static_cast<uint32_t>(mesh.indexes.size()  * sizeof(decltype(mesh.indexes)::value_type));
+        const uint32_t indexesBufferSize = mesh.GetIndexesSize();
 
         {
             vk::BufferCreateInfo bufferInfo;
@@ -814,7 +762,7 @@ public:
             if (devicePtr == nullptr) {
                 throw std::runtime_error("Failed to map memory for vertex buffer");
             }
-            std::memcpy(devicePtr, mesh.indexes.data(), indexesBufferSize);
+            std::memcpy(devicePtr, mesh.GetIndexesData(), indexesBufferSize);
 
             vk::MappedMemoryRange mappedRange;
             mappedRange.setMemory(mIndexesMemory);
@@ -833,10 +781,10 @@ public:
         meshTriangles.setVertexOffset(offsetof(VertexData, position));
         meshTriangles.setVertexFormat(vk::Format::eR32G32B32Sfloat);
         meshTriangles.setVertexStride(sizeof(VertexData));
-        meshTriangles.setIndexCount(static_cast<uint32_t>(mesh.indexes.size()));
+        meshTriangles.setIndexCount(mesh.GetIndexesCount());
         meshTriangles.setIndexData(mIndexesBuffer);
         meshTriangles.setIndexOffset(0);
-        meshTriangles.setIndexType(vk::IndexType::eUint32);
+        meshTriangles.setIndexType(mIndexType);
 
         vk::GeometryAABBNV meshAabs{};
         meshAabs.setNumAABBs(0);
@@ -0,0 +1,204 @@
+/**
+* Vulkan samples
+*
+* Global table of textures indexed in shaders, VK_EXT_descriptor_indexing
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _BINDLESS_TEXTURES_H_
+#define _BINDLESS_TEXTURES_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "VulkanUtility.h"
+
+/**
+ * One descriptor set with a single binding: a large array of combined image samplers.
+ * The binding is partially bound, so only the written elements must be valid, and update after bind,
+ * so new textures are added while the set is bound in pending command buffers.
+ * Shaders declare the binding as an unsized array and select the texture by an index from push constants or per instance data,
+ * so draws with different textures don't switch descriptor sets.
+ * Requires Vulkan 1.1 instance and device, VK_EXT_descriptor_indexing device extension and features enabled with EnableFeatures().
+ */
+class BindlessTextures
+{
+    vk::Device mDevice;
+    vk::DescriptorSetLayout mLayout;
+    vk::DescriptorPool mPool;
+    vk::DescriptorSet mSet;
+    uint32_t mCapacity = 0;
+    uint32_t mCount = 0;
+
+public:
+    static bool IsSupported(const vk::PhysicalDevice & physicalDevice)
+    {
+        const auto properties = physicalDevice.getProperties();
+        if (VK_VERSION_MAJOR(properties.apiVersion) == 1 && VK_VERSION_MINOR(properties.apiVersion) < 1) {
+            return false;
+        }
+        bool hasExtension = false;
+        for (const auto & extension : physicalDevice.enumerateDeviceExtensionProperties()) {
+            if (std::string(extension.extensionName) == VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) {
+                hasExtension = true;
+            }
+        }
+        if (!hasExtension) {
+            return false;
+        }
+        vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+        vk::PhysicalDeviceFeatures2 features2;
+        features2.pNext = &indexingFeatures;
+        physicalDevice.getFeatures2(&features2);
+        return features2.features.shaderSampledImageArrayDynamicIndexing && indexingFeatures.runtimeDescriptorArray &&
+            indexingFeatures.descriptorBindingPartiallyBound && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+    }
+
+    /**
+     * Sets the features used by the table, indexingFeatures must be chained to the device create info
+     */
+    static void EnableFeatures(vk::PhysicalDeviceFeatures & features, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT & indexingFeatures)
+    {
+        features.setShaderSampledImageArrayDynamicIndexing(VK_TRUE);
+        indexingFeatures.setRuntimeDescriptorArray(VK_TRUE);
+        indexingFeatures.setDescriptorBindingPartiallyBound(VK_TRUE);
+        indexingFeatures.setDescriptorBindingSampledImageUpdateAfterBind(VK_TRUE);
+    }
+
+    BindlessTextures() = default;
+
+    BindlessTextures(const BindlessTextures&) = delete;
+    BindlessTextures& operator=(const BindlessTextures&) = delete;
+
+    ~BindlessTextures()
+    {
+        Destroy();
+    }
+
+    /**
+     * Creates the layout, the pool and the set. Capacity is clamped by the update after bind limits of the device
+     */
+    void Init(const vk::Device & device, const vk::PhysicalDevice & physicalDevice, uint32_t capacity, vk::ShaderStageFlags stages)
+    {
+        Destroy();
+        mDevice = device;
+
+        vk::PhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties;
+        vk::PhysicalDeviceProperties2 properties2;
+        properties2.pNext = &indexingProperties;
+        physicalDevice.getProperties2(&properties2);
+        mCapacity = std::min({ capacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+        if (mCapacity == 0) {
+            throw std::runtime_error("BindlessTextures: zero capacity");
+        }
+
+        vk::DescriptorSetLayoutBinding binding;
+        binding.setBinding(0);
+        binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        binding.setDescriptorCount(mCapacity);
+        binding.setStageFlags(stages);
+
+        const vk::DescriptorBindingFlagsEXT bindingFlags = vk::DescriptorBindingFlagBitsEXT::ePartiallyBound | vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind;
+        vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo;
+        bindingFlagsInfo.setBindingCount(1);
+        bindingFlagsInfo.setPBindingFlags(&bindingFlags);
+
+        vk::DescriptorSetLayoutCreateInfo layoutInfo;
+        layoutInfo.setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT);
+        layoutInfo.setBindingCount(1);
+        layoutInfo.setPBindings(&binding);
+        layoutInfo.setPNext(&bindingFlagsInfo);
+        mLayout = mDevice.createDescriptorSetLayout(layoutInfo);
+
+        vk::DescriptorPoolSize poolSize(vk::DescriptorType::eCombinedImageSampler, mCapacity);
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT);
+        poolInfo.setMaxSets(1);
+        poolInfo.setPoolSizeCount(1);
+        poolInfo.setPPoolSizes(&poolSize);
+        mPool = mDevice.createDescriptorPool(poolInfo);
+
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.setDescriptorPool(mPool);
+        allocInfo.setDescriptorSetCount(1);
+        allocInfo.setPSetLayouts(&mLayout);
+        if (vk::Result::eSuccess != mDevice.allocateDescriptorSets(&allocInfo, &mSet)) {
+            throw std::runtime_error("BindlessTextures: failed to allocate descriptors set");
+        }
+        mCount = 0;
+    }
+
+    void Destroy()
+    {
+        if (mPool) {
+            mDevice.destroyDescriptorPool(mPool);
+            mPool = vk::DescriptorPool();
+        }
+        if (mLayout) {
+            mDevice.destroyDescriptorSetLayout(mLayout);
+            mLayout = vk::DescriptorSetLayout();
+        }
+        mSet = vk::DescriptorSet();
+        mCapacity = 0;
+        mCount = 0;
+    }
+
+    /**
+     * Writes the texture to the next free element and returns its index for shaders
+     */
+    uint32_t Add(const vk::ImageView & view, const vk::Sampler & sampler, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal)
+    {
+        if (mCount >= mCapacity) {
+            throw std::runtime_error("BindlessTextures: table is full");
+        }
+        Update(mCount, view, sampler, layout);
+        return mCount++;
+    }
+
+    /**
+     * Replaces an element. Elements used by pending command buffers must not be replaced
+     */
+    void Update(uint32_t index, const vk::ImageView & view, const vk::Sampler & sampler, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal)
+    {
+        vk::DescriptorImageInfo imageInfo;
+        imageInfo.setImageView(view);
+        imageInfo.setSampler(sampler);
+        imageInfo.setImageLayout(layout);
+
+        vk::WriteDescriptorSet writeInfo;
+        writeInfo.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writeInfo.setDstSet(mSet);
+        writeInfo.setDstBinding(0);
+        writeInfo.setDstArrayElement(index);
+        writeInfo.setDescriptorCount(1);
+        writeInfo.setPImageInfo(&imageInfo);
+        mDevice.updateDescriptorSets(1, &writeInfo, 0, nullptr);
+    }
+
+    const vk::DescriptorSetLayout & GetLayout() const
+    {
+        return mLayout;
+    }
+
+    const vk::DescriptorSet & GetSet() const
+    {
+        return mSet;
+    }
+
+    uint32_t GetCount() const
+    {
+        return mCount;
+    }
+
+    uint32_t GetCapacity() const
+    {
+        return mCapacity;
+    }
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**
+* Vulkan samples
+*
+* Reuse of command buffers recorded for swapchain images while the recorded state doesn't change
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _COMMAND_BUFFER_CACHE_H_
+#define _COMMAND_BUFFER_CACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "StateHash.h"
+
+/**
+ * Remembers the state hash each swapchain image command buffer was recorded with
+ * Begin() returns false if the buffer can be submitted again as is, otherwise the caller records it between Begin() and End()
+ * The state hash covers handles of pipelines, buffers and framebuffers, draw counts, layouts; values only read by GPU (uniform buffers contents) must not be added
+ * Command buffers must be allocated from a pool with eResetCommandBuffer flag and must not be submitted with eOneTimeSubmit usage.
+ * Every reportPeriod frames prints the number of recorded and reused buffers and CPU time saved by reuse.
+ */
+class CommandBufferCache
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Entry
+    {
+        uint64_t hash = 0;
+        bool valid = false;
+    };
+
+    std::vector<Entry> mEntries;
+    uint32_t mReportPeriod;
+
+    uint32_t mCurrent = 0;
+    uint64_t mCurrentHash = 0;
+    Clock::time_point mRecordStart;
+
+    uint64_t mFrames = 0;
+    uint64_t mRecorded = 0;
+    uint64_t mReused = 0;
+    double mRecordSeconds = 0.0;
+
+    void CountFrame()
+    {
+        ++mFrames;
+        if (mReportPeriod != 0 && mFrames % mReportPeriod == 0) {
+            const double recordTime = (mRecorded > 0) ? 1e6 * mRecordSeconds / mRecorded : 0.0;
+            std::cout << "Command buffers: " << mRecorded << " recorded, " << mReused << " reused, record time " << recordTime << " us, saved "
+                << recordTime * mReused / mFrames << " us per frame" << std::endl;
+        }
+    }
+
+public:
+    explicit CommandBufferCache(uint32_t reportPeriod = 1000)
+        : mReportPeriod(reportPeriod)
+    { }
+
+    bool Begin(uint32_t imageIndex, uint64_t stateHash)
+    {
+        if (imageIndex >= mEntries.size()) {
+            mEntries.resize(imageIndex + 1);
+        }
+        const Entry & entry = mEntries[imageIndex];
+        if (entry.valid && entry.hash == stateHash) {
+            ++mReused;
+            CountFrame();
+            return false;
+        }
+        mCurrent = imageIndex;
+        mCurrentHash = stateHash;
+        mRecordStart = Clock::now();
+        return true;
+    }
+
+    void End()
+    {
+        mRecordSeconds += std::chrono::duration_cast<std::chrono::duration<double>>(Clock::now() - mRecordStart).count();
+        ++mRecorded;
+        mEntries[mCurrent].hash = mCurrentHash;
+        mEntries[mCurrent].valid = true;
+        CountFrame();
+    }
+};
+
+#endif
@@ -0,0 +1,294 @@
+/**
+* Vulkan samples
+*
+* Growable descriptor sets allocator and cache of sets by layout and bound resources
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _DESCRIPTOR_ALLOCATOR_H_
+#define _DESCRIPTOR_ALLOCATOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "StateHash.h"
+#include "VulkanUtility.h"
+
+/**
+ * Chain of descriptor pools. When the current pool is exhausted or fragmented the next one is taken,
+ * a new pool is created twice larger than the previous one. Sets are never freed one by one:
+ * Reset() returns all sets of all pools at once, e.g. per frame after the frame fence is waited.
+ */
+class DescriptorAllocator
+{
+    vk::Device mDevice;
+    std::vector<vk::DescriptorPoolSize> mSizesPerSet;
+    uint32_t mSetsPerPool = 0;
+    uint32_t mMaxSetsPerPool = 0;
+
+    std::vector<vk::DescriptorPool> mPools;
+    size_t mCurrent = 0;
+
+    vk::DescriptorPool CreatePool()
+    {
+        std::vector<vk::DescriptorPoolSize> poolSizes = mSizesPerSet;
+        for (auto & size : poolSizes) {
+            size.descriptorCount *= mSetsPerPool;
+        }
+
+        vk::DescriptorPoolCreateInfo poolInfo;
+        poolInfo.setMaxSets(mSetsPerPool);
+        poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()));
+        poolInfo.setPPoolSizes(&poolSizes[0]);
+        vk::DescriptorPool pool = mDevice.createDescriptorPool(poolInfo);
+
+        mSetsPerPool = std::min(2 * mSetsPerPool, mMaxSetsPerPool);
+        return pool;
+    }
+
+public:
+    DescriptorAllocator() = default;
+
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    ~DescriptorAllocator()
+    {
+        Destroy();
+    }
+
+    /**
+     * sizesPerSet is the expected average number of descriptors of each type in one set
+     */
+    void Init(vk::Device device, std::initializer_list<vk::DescriptorPoolSize> sizesPerSet, uint32_t setsPerPool = 16, uint32_t maxSetsPerPool = 1024)
+    {
+        Destroy();
+        if (sizesPerSet.size() == 0) {
+            throw std::runtime_error("DescriptorAllocator: pool sizes are empty");
+        }
+        mDevice = device;
+        mSizesPerSet.assign(sizesPerSet.begin(), sizesPerSet.end());
+        mSetsPerPool = std::max(setsPerPool, 1u);
+        mMaxSetsPerPool = std::max(maxSetsPerPool, mSetsPerPool);
+    }
+
+    void Destroy()
+    {
+        for (auto & pool : mPools) {
+            mDevice.destroyDescriptorPool(pool);
+        }
+        mPools.clear();
+        mCurrent = 0;
+    }
+
+    vk::DescriptorSet Allocate(const vk::DescriptorSetLayout & layout)
+    {
+        vk::DescriptorSetAllocateInfo allocInfo;
+        allocInfo.setDescriptorSetCount(1);
+        allocInfo.setPSetLayouts(&layout);
+
+        vk::DescriptorSet set;
+        for (; mCurrent < mPools.size(); ++mCurrent) {
+            allocInfo.setDescriptorPool(mPools[mCurrent]);
+            // Out of pool memory or fragmentation, both are resolved by the next pool
+            if (vk::Result::eSuccess == mDevice.allocateDescriptorSets(&allocInfo, &set)) {
+                return set;
+            }
+        }
+
+        mPools.push_back(CreatePool());
+        allocInfo.setDescriptorPool(mPools.back());
+        if (vk::Result::eSuccess != mDevice.allocateDescriptorSets(&allocInfo, &set)) {
+            throw std::runtime_error("DescriptorAllocator: failed to allocate descriptors set from a new pool");
+        }
+        return set;
+    }
+
+    /**
+     * Frees all sets at once, pools are kept for the next allocations. The sets must not be in use by device
+     */
+    void Reset()
+    {
+        for (auto & pool : mPools) {
+            mDevice.resetDescriptorPool(pool, vk::DescriptorPoolResetFlags());
+        }
+        mCurrent = 0;
+    }
+
+    uint32_t GetPoolsCount() const
+    {
+        return static_cast<uint32_t>(mPools.size());
+    }
+};
+
+/**
+ * Resources bound to a descriptor set, one descriptor per binding
+ */
+class DescriptorBindings
+{
+public:
+    struct Binding
+    {
+        uint32_t binding;
+        vk::DescriptorType type;
+        VkImageView view;
+        VkSampler sampler;
+        vk::ImageLayout layout;
+        VkBuffer buffer;
+        vk::DeviceSize offset;
+        vk::DeviceSize range;
+
+        bool operator==(const Binding & other) const
+        {
+            return binding == other.binding && type == other.type && view == other.view && sampler == other.sampler && layout == other.layout &&
+                buffer == other.buffer && offset == other.offset && range == other.range;
+        }
+    };
+
+private:
+    std::vector<Binding> mBindings;
+
+public:
+    DescriptorBindings & Image(uint32_t binding, vk::DescriptorType type, const vk::ImageView & view, const vk::Sampler & sampler, vk::ImageLayout layout)
+    {
+        mBindings.push_back(Binding{ binding, type, static_cast<VkImageView>(view), static_cast<VkSampler>(sampler), layout, VK_NULL_HANDLE, 0, 0 });
+        return *this;
+    }
+
+    DescriptorBindings & Buffer(uint32_t binding, vk::DescriptorType type, const vk::Buffer & buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE)
+    {
+        mBindings.push_back(Binding{ binding, type, VK_NULL_HANDLE, VK_NULL_HANDLE, vk::ImageLayout::eUndefined, static_cast<VkBuffer>(buffer), offset, range });
+        return *this;
+    }
+
+    const std::vector<Binding> & Get() const
+    {
+        return mBindings;
+    }
+
+    uint64_t Hash(const vk::DescriptorSetLayout & layout) const
+    {
+        StateHash hash;
+        hash.Add(static_cast<VkDescriptorSetLayout>(layout));
+        for (const auto & b : mBindings) {
+            hash.Add(b.binding).Add(b.type).Add(b.view).Add(b.sampler).Add(b.layout).Add(b.buffer).Add(b.offset).Add(b.range);
+        }
+        return hash.Get();
+    }
+
+    /**
+     * Writes all bindings to the set with one updateDescriptorSets call
+     */
+    void Write(const vk::Device & device, const vk::DescriptorSet & set) const
+    {
+        std::vector<vk::DescriptorImageInfo> imageInfos(mBindings.size());
+        std::vector<vk::DescriptorBufferInfo> bufferInfos(mBindings.size());
+        std::vector<vk::WriteDescriptorSet> writeDescriptorsInfo(mBindings.size());
+        for (size_t i = 0; i < mBindings.size(); ++i) {
+            const Binding & b = mBindings[i];
+            writeDescriptorsInfo[i].setDescriptorType(b.type);
+            writeDescriptorsInfo[i].setDstSet(set);
+            writeDescriptorsInfo[i].setDstBinding(b.binding);
+            writeDescriptorsInfo[i].setDstArrayElement(0);
+            writeDescriptorsInfo[i].setDescriptorCount(1);
+            if (b.buffer != VK_NULL_HANDLE) {
+                bufferInfos[i].setBuffer(b.buffer);
+                bufferInfos[i].setOffset(b.offset);
+                bufferInfos[i].setRange(b.range);
+                writeDescriptorsInfo[i].setPBufferInfo(&bufferInfos[i]);
+            } else {
+                imageInfos[i].setImageView(b.view);
+                imageInfos[i].setSampler(b.sampler);
+                imageInfos[i].setImageLayout(b.layout);
+                writeDescriptorsInfo[i].setPImageInfo(&imageInfos[i]);
+            }
+        }
+        if (!writeDescriptorsInfo.empty()) {
+            device.updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+        }
+    }
+};
+
+/**
+ * Returns an existing set if one was already written with the same layout and resources, otherwise allocates and writes a new one.
+ * Ping-pong bindings end up as a few cached sets, so steady state frames don't update descriptors at all
+ * and a set is never rewritten while a previous frame may still use it.
+ * Sets live until Reset(), which resets the allocator as well.
+ */
+class DescriptorSetCache
+{
+    struct Entry
+    {
+        VkDescriptorSetLayout layout;
+        std::vector<DescriptorBindings::Binding> bindings;
+        vk::DescriptorSet set;
+    };
+
+    vk::Device mDevice;
+    DescriptorAllocator* mAllocator = nullptr;
+    std::unordered_multimap<uint64_t, Entry> mEntries;
+
+    uint64_t mHits = 0;
+    uint64_t mWrites = 0;
+
+public:
+    void Init(vk::Device device, DescriptorAllocator & allocator)
+    {
+        mDevice = device;
+        mAllocator = &allocator;
+        mEntries.clear();
+    }
+
+    vk::DescriptorSet Get(const vk::DescriptorSetLayout & layout, const DescriptorBindings & bindings)
+    {
+        if (mAllocator == nullptr) {
+            throw std::runtime_error("DescriptorSetCache: not initialized");
+        }
+        const uint64_t hash = bindings.Hash(layout);
+        auto range = mEntries.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.layout == static_cast<VkDescriptorSetLayout>(layout) && it->second.bindings == bindings.Get()) {
+                ++mHits;
+                return it->second.set;
+            }
+        }
+
+        Entry entry;
+        entry.layout = static_cast<VkDescriptorSetLayout>(layout);
+        entry.bindings = bindings.Get();
+        entry.set = mAllocator->Allocate(layout);
+        bindings.Write(mDevice, entry.set);
+        ++mWrites;
+
+        const vk::DescriptorSet set = entry.set;
+        mEntries.emplace(hash, std::move(entry));
+        return set;
+    }
+
+    /**
+     * Drops all cached sets and returns them to the allocator. The sets must not be in use by device
+     */
+    void Reset()
+    {
+        mEntries.clear();
+        mAllocator->Reset();
+    }
+
+    uint64_t GetHitsCount() const
+    {
+        return mHits;
+    }
+
+    uint64_t GetWritesCount() const
+    {
+        return mWrites;
+    }
+};
+
+#endif
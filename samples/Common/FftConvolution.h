@@ -0,0 +1,386 @@
+/**
+* Vulkan samples
+*
+* 2D convolution of rgba8ui images with arbitrary kernels via FFT on GPU
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _FFT_CONVOLUTION_H_
+#define _FFT_CONVOLUTION_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "VulkanUtility.h"
+
+/**
+ * Convolves RGB channels of an image with a kernel given on host
+ * Image is padded by the kernel radius with the edge pixels and extended to power of 2 sizes,
+ * so the circular convolution doesn't wrap inside the image. Cost doesn't depend on the kernel size.
+ *
+ * Passes (see shaders/glsl/fft.comp):
+ *   forward FFT of the padded rows -> forward FFT of columns, multiplication by the kernel spectrum, inverse FFT of columns
+ *   -> inverse FFT of rows -> output
+ * Kernel spectrum is computed on GPU as part of the first recorded convolution.
+ */
+class FftConvolution
+{
+public:
+    // Must match fft.comp
+    static const uint32_t GROUP_SIZE = 256;
+    static const uint32_t COMPOSE_GROUP_SIZE = 16;
+    static const uint32_t CHANNELS = 3;
+
+private:
+    enum Pass
+    {
+        PASS_KERNEL_ROWS,
+        PASS_KERNEL_COLUMNS,
+        PASS_FORWARD,
+        PASS_CONVOLVE,
+        PASS_INVERSE,
+        PASS_COMPOSE,
+        PASS_COUNT
+    };
+
+    struct PushConstants
+    {
+        int32_t offsetX;
+        int32_t offsetY;
+        uint32_t lineStride;
+        uint32_t elementStride;
+        uint32_t planeStride;
+        float scale;
+    };
+
+    vk::Device mDevice;
+    vk::Extent2D mImageExtent;
+    vk::Extent2D mPaddedExtent;
+    vk::Offset2D mImageOffset;
+    bool mSpectrumReady = false;
+
+    VulkanHolder<vk::DescriptorSetLayout> mDescriptorSetLayout;
+    VulkanHolder<vk::DescriptorPool> mDescriptorPool;
+    vk::DescriptorSet mDescriptorSet; // freed with the pool
+    VulkanHolder<vk::PipelineLayout> mPipelineLayout;
+    std::array<VulkanHolder<vk::ShaderModule>, PASS_COUNT> mShaders;
+    std::array<VulkanHolder<vk::Pipeline>, PASS_COUNT> mPipelines;
+
+    VulkanHolder<vk::Buffer> mDataBuffer;
+    VulkanHolder<vk::DeviceMemory> mDataMemory;
+    VulkanHolder<vk::Buffer> mKernelBuffer;
+    VulkanHolder<vk::DeviceMemory> mKernelMemory;
+    VulkanHolder<vk::Buffer> mKernelStagingBuffer;
+    VulkanHolder<vk::DeviceMemory> mKernelStagingMemory;
+
+    static uint32_t NextPowerOf2(uint32_t value)
+    {
+        uint32_t result = 1;
+        while (result < value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    void CreateBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, const vk::PhysicalDevice & physicalDevice,
+        VulkanHolder<vk::Buffer> & buffer, VulkanHolder<vk::DeviceMemory> & memory)
+    {
+        vk::BufferCreateInfo bufferInfo;
+        bufferInfo.setSize(size);
+        bufferInfo.setUsage(usage);
+        bufferInfo.setSharingMode(vk::SharingMode::eExclusive);
+        buffer = MakeHolder(mDevice.createBuffer(bufferInfo), [this](vk::Buffer & buffer) { mDevice.destroyBuffer(buffer); });
+
+        vk::MemoryRequirements memoryRequirments = mDevice.getBufferMemoryRequirements(buffer);
+        vk::PhysicalDeviceMemoryProperties memroProperties = physicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((memoryRequirments.memoryTypeBits & (1 << i)) &&
+                ((memroProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+
+                vk::MemoryAllocateInfo allocateInfo;
+                allocateInfo.setAllocationSize(memoryRequirments.size);
+                allocateInfo.setMemoryTypeIndex(i);
+                memory = MakeHolder(mDevice.allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice.freeMemory(memory); });
+                break;
+            }
+        }
+        if (!memory) {
+            throw std::runtime_error("FftConvolution: Failed to allocate buffer memory");
+        }
+        mDevice.bindBufferMemory(buffer, memory, 0);
+    }
+
+    void RecordPass(const vk::CommandBuffer & cmdBuffer, Pass pass, const PushConstants & constants, uint32_t groupsX, uint32_t groupsY)
+    {
+        cmdBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipelines[pass]);
+        cmdBuffer.pushConstants(mPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &constants);
+        cmdBuffer.dispatch(groupsX, groupsY, 1);
+    }
+
+    static void RecordBarrier(const vk::CommandBuffer & cmdBuffer)
+    {
+        vk::MemoryBarrier barrier;
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        cmdBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    PushConstants RowsConstants(float scale = 1.0f) const
+    {
+        return { mImageOffset.x, mImageOffset.y, mPaddedExtent.width, 1, mPaddedExtent.width * mPaddedExtent.height, scale };
+    }
+
+    PushConstants ColumnsConstants() const
+    {
+        return { mImageOffset.x, mImageOffset.y, 1, mPaddedExtent.width, mPaddedExtent.width * mPaddedExtent.height, 1.0f };
+    }
+
+public:
+    /**
+     * kernel is a row-major kernelExtent.width x kernelExtent.height matrix, its center is (width / 2, height / 2)
+     * shaderFilename is the path to fft.comp
+     */
+    FftConvolution(const vk::Device & device, const vk::PhysicalDevice & physicalDevice, const std::string & shaderFilename,
+        const vk::Extent2D & imageExtent, const std::vector<float> & kernel, const vk::Extent2D & kernelExtent)
+        : mDevice(device), mImageExtent(imageExtent)
+    {
+        if (kernel.size() != static_cast<size_t>(kernelExtent.width) * kernelExtent.height || kernel.empty()) {
+            throw std::runtime_error("FftConvolution: Kernel size doesn't match its extent");
+        }
+
+        const int32_t radiusX = static_cast<int32_t>(kernelExtent.width / 2);
+        const int32_t radiusY = static_cast<int32_t>(kernelExtent.height / 2);
+        mImageOffset = vk::Offset2D(radiusX, radiusY);
+        mPaddedExtent = vk::Extent2D(NextPowerOf2(imageExtent.width + 2 * radiusX), NextPowerOf2(imageExtent.height + 2 * radiusY));
+
+        // Two lines are kept in shared memory for ping-pong
+        const auto limits = physicalDevice.getProperties().limits;
+        const uint32_t maxLine = std::max(mPaddedExtent.width, mPaddedExtent.height);
+        if (2 * maxLine * 2 * sizeof(float) > limits.maxComputeSharedMemorySize) {
+            throw std::runtime_error("FftConvolution: Padded size " + std::to_string(maxLine) + " doesn't fit to shared memory");
+        }
+
+        const vk::DeviceSize planeSize = static_cast<vk::DeviceSize>(mPaddedExtent.width) * mPaddedExtent.height * 2 * sizeof(float);
+
+        CreateBuffer(CHANNELS * planeSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, physicalDevice, mDataBuffer, mDataMemory);
+        CreateBuffer(planeSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal, physicalDevice, mKernelBuffer, mKernelMemory);
+        CreateBuffer(planeSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, physicalDevice, mKernelStagingBuffer, mKernelStagingMemory);
+
+        // Kernel center is moved to (0, 0), negative offsets wrap around
+        {
+            float* planePtr = static_cast<float*>(mDevice.mapMemory(mKernelStagingMemory, 0, planeSize));
+            if (planePtr == nullptr) {
+                throw std::runtime_error("FftConvolution: Failed to map kernel memory");
+            }
+            std::fill_n(planePtr, planeSize / sizeof(float), 0.0f);
+            for (uint32_t y = 0; y < kernelExtent.height; ++y) {
+                for (uint32_t x = 0; x < kernelExtent.width; ++x) {
+                    const uint32_t px = (x + mPaddedExtent.width - radiusX) % mPaddedExtent.width;
+                    const uint32_t py = (y + mPaddedExtent.height - radiusY) % mPaddedExtent.height;
+                    planePtr[2 * (py * mPaddedExtent.width + px)] = kernel[y * kernelExtent.width + x];
+                }
+            }
+            mDevice.unmapMemory(mKernelStagingMemory);
+        }
+
+        // Descriptors
+        {
+            std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+
+            bindings[0].setBinding(0);
+            bindings[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+            bindings[0].setDescriptorCount(1);
+            bindings[0].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+            bindings[1].setBinding(1);
+            bindings[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+            bindings[1].setDescriptorCount(1);
+            bindings[1].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+            // Data planes
+            bindings[2].setBinding(2);
+            bindings[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+            bindings[2].setDescriptorCount(1);
+            bindings[2].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+            // Kernel spectrum
+            bindings[3].setBinding(3);
+            bindings[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+            bindings[3].setDescriptorCount(1);
+            bindings[3].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+
+            vk::DescriptorSetLayoutCreateInfo descriptorSetInfo;
+            descriptorSetInfo.setBindingCount(static_cast<uint32_t>(bindings.size()));
+            descriptorSetInfo.setPBindings(&bindings[0]);
+            mDescriptorSetLayout = MakeHolder(mDevice.createDescriptorSetLayout(descriptorSetInfo), [this](vk::DescriptorSetLayout & layout) { mDevice.destroyDescriptorSetLayout(layout); });
+
+            std::array<vk::DescriptorPoolSize, 3> poolSize;
+            poolSize[0].setType(vk::DescriptorType::eCombinedImageSampler);
+            poolSize[0].setDescriptorCount(1);
+            poolSize[1].setType(vk::DescriptorType::eStorageImage);
+            poolSize[1].setDescriptorCount(1);
+            poolSize[2].setType(vk::DescriptorType::eStorageBuffer);
+            poolSize[2].setDescriptorCount(2);
+
+            vk::DescriptorPoolCreateInfo poolInfo;
+            poolInfo.setMaxSets(1);
+            poolInfo.setPoolSizeCount(static_cast<uint32_t>(poolSize.size()));
+            poolInfo.setPPoolSizes(&poolSize[0]);
+            mDescriptorPool = MakeHolder(mDevice.createDescriptorPool(poolInfo), [this](vk::DescriptorPool & pool) { mDevice.destroyDescriptorPool(pool); });
+
+            vk::DescriptorSetAllocateInfo allocInfo;
+            allocInfo.setDescriptorPool(mDescriptorPool);
+            allocInfo.setDescriptorSetCount(1);
+            allocInfo.setPSetLayouts(mDescriptorSetLayout.get());
+            if (vk::Result::eSuccess != mDevice.allocateDescriptorSets(&allocInfo, &mDescriptorSet)) {
+                throw std::runtime_error("FftConvolution: Failed to allocate descriptors set");
+            }
+        }
+
+        // Pipelines, line length is a specialization constant
+        {
+            vk::PushConstantRange pushConstantRange;
+            pushConstantRange.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+            pushConstantRange.setOffset(0);
+            pushConstantRange.setSize(sizeof(PushConstants));
+
+            vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+            pipelineLayoutInfo.setSetLayoutCount(1);
+            pipelineLayoutInfo.setPSetLayouts(mDescriptorSetLayout.get());
+            pipelineLayoutInfo.setPushConstantRangeCount(1);
+            pipelineLayoutInfo.setPPushConstantRanges(&pushConstantRange);
+            mPipelineLayout = MakeHolder(mDevice.createPipelineLayout(pipelineLayoutInfo), [this](vk::PipelineLayout & layout) { mDevice.destroyPipelineLayout(layout); });
+
+            const std::array<const char*, PASS_COUNT> passDefines = { "FFT_PASS_KERNEL", "FFT_PASS_KERNEL", "FFT_PASS_FORWARD", "FFT_PASS_CONVOLVE", "FFT_PASS_INVERSE", "FFT_PASS_COMPOSE" };
+            const std::array<uint32_t, PASS_COUNT> lineLength = { mPaddedExtent.width, mPaddedExtent.height, mPaddedExtent.width, mPaddedExtent.height, mPaddedExtent.width, mPaddedExtent.width };
+
+            for (uint32_t pass = 0; pass < PASS_COUNT; ++pass) {
+                auto code = GetBinaryShaderFromSourceFile(shaderFilename, { passDefines[pass] });
+                if (code.empty()) {
+                    throw std::runtime_error("FftConvolution: Failed to read shader file!");
+                }
+                vk::ShaderModuleCreateInfo shaderInfo;
+                shaderInfo.setPCode(reinterpret_cast<const uint32_t*>(&code[0]));
+                shaderInfo.setCodeSize(code.size());
+                mShaders[pass] = MakeHolder(mDevice.createShaderModule(shaderInfo), [this](vk::ShaderModule & shader) { mDevice.destroyShaderModule(shader); });
+
+                vk::SpecializationMapEntry specializationEntry;
+                specializationEntry.setConstantID(0);
+                specializationEntry.setOffset(0);
+                specializationEntry.setSize(sizeof(uint32_t));
+
+                vk::SpecializationInfo specializationInfo;
+                specializationInfo.setMapEntryCount(1);
+                specializationInfo.setPMapEntries(&specializationEntry);
+                specializationInfo.setDataSize(sizeof(uint32_t));
+                specializationInfo.setPData(&lineLength[pass]);
+
+                vk::PipelineShaderStageCreateInfo stageInfo;
+                stageInfo.setStage(vk::ShaderStageFlagBits::eCompute);
+                stageInfo.setModule(mShaders[pass]);
+                stageInfo.setPName("main"); // Shader entry point
+                stageInfo.setPSpecializationInfo(&specializationInfo);
+
+                vk::ComputePipelineCreateInfo computePipelineInfo;
+                computePipelineInfo.setStage(stageInfo);
+                computePipelineInfo.setLayout(mPipelineLayout);
+                mPipelines[pass] = MakeHolder(mDevice.createComputePipeline(vk::PipelineCache(), computePipelineInfo), [this](vk::Pipeline & pipeline) { mDevice.destroyPipeline(pipeline); });
+            }
+        }
+    }
+
+    FftConvolution(const FftConvolution&) = delete;
+    FftConvolution& operator= (const FftConvolution&) = delete;
+
+    /**
+     * Source and destination may be the same image, both are expected in general layout
+     */
+    void SetImages(const vk::ImageView & srcView, const vk::Sampler & srcSampler, const vk::ImageView & dstView)
+    {
+        std::array<vk::WriteDescriptorSet, 4> writeDescriptorsInfo;
+        std::array<vk::DescriptorImageInfo, 2> descriptorImageInfo;
+        std::array<vk::DescriptorBufferInfo, 2> descriptorBufferInfo;
+
+        descriptorImageInfo[0].setImageView(srcView);
+        descriptorImageInfo[0].setSampler(srcSampler);
+        descriptorImageInfo[0].setImageLayout(vk::ImageLayout::eGeneral);
+
+        descriptorImageInfo[1].setImageView(dstView);
+        descriptorImageInfo[1].setImageLayout(vk::ImageLayout::eGeneral);
+
+        descriptorBufferInfo[0].setBuffer(mDataBuffer);
+        descriptorBufferInfo[0].setOffset(0);
+        descriptorBufferInfo[0].setRange(VK_WHOLE_SIZE);
+
+        descriptorBufferInfo[1].setBuffer(mKernelBuffer);
+        descriptorBufferInfo[1].setOffset(0);
+        descriptorBufferInfo[1].setRange(VK_WHOLE_SIZE);
+
+        for (uint32_t i = 0; i < writeDescriptorsInfo.size(); ++i) {
+            writeDescriptorsInfo[i].setDstSet(mDescriptorSet);
+            writeDescriptorsInfo[i].setDstBinding(i);
+            writeDescriptorsInfo[i].setDstArrayElement(0);
+            writeDescriptorsInfo[i].setDescriptorCount(1);
+        }
+        writeDescriptorsInfo[0].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writeDescriptorsInfo[0].setPImageInfo(&descriptorImageInfo[0]);
+        writeDescriptorsInfo[1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        writeDescriptorsInfo[1].setPImageInfo(&descriptorImageInfo[1]);
+        writeDescriptorsInfo[2].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        writeDescriptorsInfo[2].setPBufferInfo(&descriptorBufferInfo[0]);
+        writeDescriptorsInfo[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        writeDescriptorsInfo[3].setPBufferInfo(&descriptorBufferInfo[1]);
+
+        mDevice.updateDescriptorSets(static_cast<uint32_t>(writeDescriptorsInfo.size()), &writeDescriptorsInfo[0], 0, nullptr);
+    }
+
+    /**
+     * Record convolution of the source image to the destination image
+     * Caller is responsible for barriers before reading the source and after writing the destination
+     */
+    void RecordConvolution(const vk::CommandBuffer & cmdBuffer)
+    {
+        cmdBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
+
+        if (!mSpectrumReady) {
+            vk::BufferCopy region;
+            region.setSrcOffset(0);
+            region.setDstOffset(0);
+            region.setSize(static_cast<vk::DeviceSize>(mPaddedExtent.width) * mPaddedExtent.height * 2 * sizeof(float));
+            cmdBuffer.copyBuffer(mKernelStagingBuffer, mKernelBuffer, 1, &region);
+
+            RecordBarrier(cmdBuffer);
+            RecordPass(cmdBuffer, PASS_KERNEL_ROWS, RowsConstants(), mPaddedExtent.height, 1);
+            RecordBarrier(cmdBuffer);
+            RecordPass(cmdBuffer, PASS_KERNEL_COLUMNS, ColumnsConstants(), mPaddedExtent.width, 1);
+            // Submitted once, the spectrum stays valid for all following convolutions
+            mSpectrumReady = true;
+        }
+
+        RecordBarrier(cmdBuffer);
+        RecordPass(cmdBuffer, PASS_FORWARD, RowsConstants(), mPaddedExtent.height, CHANNELS);
+        RecordBarrier(cmdBuffer);
+        RecordPass(cmdBuffer, PASS_CONVOLVE, ColumnsConstants(), mPaddedExtent.width, CHANNELS);
+        RecordBarrier(cmdBuffer);
+        RecordPass(cmdBuffer, PASS_INVERSE, RowsConstants(1.0f / (static_cast<float>(mPaddedExtent.width) * mPaddedExtent.height)), mImageExtent.height, CHANNELS);
+        RecordBarrier(cmdBuffer);
+        RecordPass(cmdBuffer, PASS_COMPOSE, RowsConstants(), (mImageExtent.width + COMPOSE_GROUP_SIZE - 1) / COMPOSE_GROUP_SIZE, (mImageExtent.height + COMPOSE_GROUP_SIZE - 1) / COMPOSE_GROUP_SIZE);
+    }
+
+    /**
+     * Size of the transformed planes
+     */
+    const vk::Extent2D & GetPaddedExtent() const
+    {
+        return mPaddedExtent;
+    }
+};
+
+#endif
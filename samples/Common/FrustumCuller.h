@@ -0,0 +1,424 @@
+/**
+* Vulkan samples
+*
+* Batch frustum culling of axis aligned boxes stored as structure of arrays with SSE, AVX or NEON
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _FRUSTUM_CULLER_H_
+#define _FRUSTUM_CULLER_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "math/OgreAxisAlignedBox.h"
+#include "math/OgreMatrix4.h"
+#include "math/OgreVector3.h"
+#include "math/OgreVector4.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+# define FRUSTUM_CULLER_X86
+# include <immintrin.h>
+# ifdef _MSC_VER
+#  include <intrin.h>
+// MSVC compiles AVX intrinsics without /arch:AVX
+#  define FRUSTUM_CULLER_AVX_TARGET
+# else
+#  define FRUSTUM_CULLER_AVX_TARGET __attribute__((target("avx")))
+# endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+# define FRUSTUM_CULLER_NEON
+# include <arm_neon.h>
+#endif
+
+/**
+ * Six planes (nx, ny, nz, d), a point p is inside if dot(n, p) + d >= 0 for all of them.
+ * Planes are not normalized, culling uses only the sign of the distance.
+ */
+struct Frustum
+{
+    std::array<Ogre::Vector4, 6> planes;
+
+    /**
+     * Gribb-Hartmann extraction from a projection or a view projection matrix: clip = m * position with rows m[0]..m[3]
+     * as in Ogre::Matrix4, and the clip volume -w <= x, y <= w, 0 <= z <= w of Vulkan.
+     * Matrixes uploaded for GLSL (like the output of MakePerspectiveProjectionMatrix) have to be transposed first.
+     */
+    static Frustum FromMatrix(const Ogre::Matrix4 & m)
+    {
+        auto row = [&m](size_t r) { return Ogre::Vector4(m[r][0], m[r][1], m[r][2], m[r][3]); };
+        auto add = [](const Ogre::Vector4 & a, const Ogre::Vector4 & b, float s) { return Ogre::Vector4(a.x + s * b.x, a.y + s * b.y, a.z + s * b.z, a.w + s * b.w); };
+        Frustum frustum;
+        frustum.planes[0] = add(row(3), row(0), 1.0f);   // left
+        frustum.planes[1] = add(row(3), row(0), -1.0f);  // right
+        frustum.planes[2] = add(row(3), row(1), 1.0f);   // bottom
+        frustum.planes[3] = add(row(3), row(1), -1.0f);  // top
+        frustum.planes[4] = row(2);                      // near
+        frustum.planes[5] = add(row(3), row(2), -1.0f);  // far
+        return frustum;
+    }
+
+    /**
+     * Frustum for testing points p instead of the boxes (p + center, halfSize): every plane is moved out by the box.
+     * Allows culling many copies of one box by their positions only.
+     */
+    Frustum Inflated(const Ogre::Vector3 & center, const Ogre::Vector3 & halfSize) const
+    {
+        Frustum frustum = *this;
+        for (auto & p : frustum.planes) {
+            p.w += p.x * center.x + p.y * center.y + p.z * center.z + std::abs(p.x) * halfSize.x + std::abs(p.y) * halfSize.y + std::abs(p.z) * halfSize.z;
+        }
+        return frustum;
+    }
+};
+
+/**
+ * Boxes as separate arrays of centers and half sizes, so 4 or 8 boxes are loaded into SIMD registers with one load per coordinate
+ */
+class AabbArray
+{
+public:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> halfX, halfY, halfZ;
+
+    size_t Size() const
+    {
+        return centerX.size();
+    }
+
+    void Reserve(size_t count)
+    {
+        for (auto* v : { &centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ }) {
+            v->reserve(count);
+        }
+    }
+
+    void Clear()
+    {
+        for (auto* v : { &centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ }) {
+            v->clear();
+        }
+    }
+
+    void Add(const Ogre::Vector3 & center, const Ogre::Vector3 & halfSize)
+    {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        halfX.push_back(halfSize.x);
+        halfY.push_back(halfSize.y);
+        halfZ.push_back(halfSize.z);
+    }
+
+    void Add(const Ogre::AxisAlignedBox & box)
+    {
+        Add(box.getCenter(), box.getHalfSize());
+    }
+};
+
+enum class CullingIsa
+{
+    Scalar,
+    Sse,
+    Avx,
+    Neon
+};
+
+/**
+ * A box is culled if it is completely behind one of the planes: dot(n, center) + dot(|n|, halfSize) + d < 0.
+ * Boxes crossing the corners of the frustum outside of it are kept, as with one-at-a-time plane tests.
+ */
+class FrustumCuller
+{
+    // Boxes per thread below which spawning threads costs more than culling
+    static const size_t PARALLEL_BOXES_THRESHOLD = 64 * 1024;
+
+    struct PlanesSoA
+    {
+        float nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+
+        explicit PlanesSoA(const Frustum & frustum)
+        {
+            for (size_t i = 0; i < 6; ++i) {
+                const Ogre::Vector4 & p = frustum.planes[i];
+                nx[i] = p.x;
+                ny[i] = p.y;
+                nz[i] = p.z;
+                ax[i] = std::abs(p.x);
+                ay[i] = std::abs(p.y);
+                az[i] = std::abs(p.z);
+                d[i] = p.w;
+            }
+        }
+    };
+
+    static size_t CullScalar(const PlanesSoA & planes, const AabbArray & boxes, size_t begin, size_t end, uint8_t* visible)
+    {
+        size_t count = 0;
+        for (size_t i = begin; i < end; ++i) {
+            bool inside = true;
+            for (size_t p = 0; p < 6; ++p) {
+                const float distance = planes.nx[p] * boxes.centerX[i] + planes.ny[p] * boxes.centerY[i] + planes.nz[p] * boxes.centerZ[i]
+                    + planes.ax[p] * boxes.halfX[i] + planes.ay[p] * boxes.halfY[i] + planes.az[p] * boxes.halfZ[i] + planes.d[p];
+                inside = inside && (distance >= 0.0f);
+            }
+            visible[i] = inside ? 1 : 0;
+            count += inside ? 1 : 0;
+        }
+        return count;
+    }
+
+#ifdef FRUSTUM_CULLER_X86
+    static size_t CullSse(const PlanesSoA & planes, const AabbArray & boxes, size_t begin, size_t end, uint8_t* visible)
+    {
+        __m128 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+        for (size_t p = 0; p < 6; ++p) {
+            nx[p] = _mm_set1_ps(planes.nx[p]);
+            ny[p] = _mm_set1_ps(planes.ny[p]);
+            nz[p] = _mm_set1_ps(planes.nz[p]);
+            ax[p] = _mm_set1_ps(planes.ax[p]);
+            ay[p] = _mm_set1_ps(planes.ay[p]);
+            az[p] = _mm_set1_ps(planes.az[p]);
+            d[p] = _mm_set1_ps(planes.d[p]);
+        }
+        const __m128 zero = _mm_setzero_ps();
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+            const __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+            const __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+            const __m128 hx = _mm_loadu_ps(&boxes.halfX[i]);
+            const __m128 hy = _mm_loadu_ps(&boxes.halfY[i]);
+            const __m128 hz = _mm_loadu_ps(&boxes.halfZ[i]);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (size_t p = 0; p < 6; ++p) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(nx[p], cx), d[p]);
+                distance = _mm_add_ps(distance, _mm_mul_ps(ny[p], cy));
+                distance = _mm_add_ps(distance, _mm_mul_ps(nz[p], cz));
+                distance = _mm_add_ps(distance, _mm_mul_ps(ax[p], hx));
+                distance = _mm_add_ps(distance, _mm_mul_ps(ay[p], hy));
+                distance = _mm_add_ps(distance, _mm_mul_ps(az[p], hz));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+            }
+            const int mask = _mm_movemask_ps(inside);
+            for (size_t k = 0; k < 4; ++k) {
+                visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+            }
+            count += static_cast<size_t>(((mask >> 0) & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1));
+        }
+        return count + CullScalar(planes, boxes, i, end, visible);
+    }
+
+    FRUSTUM_CULLER_AVX_TARGET
+    static size_t CullAvx(const PlanesSoA & planes, const AabbArray & boxes, size_t begin, size_t end, uint8_t* visible)
+    {
+        __m256 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+        for (size_t p = 0; p < 6; ++p) {
+            nx[p] = _mm256_set1_ps(planes.nx[p]);
+            ny[p] = _mm256_set1_ps(planes.ny[p]);
+            nz[p] = _mm256_set1_ps(planes.nz[p]);
+            ax[p] = _mm256_set1_ps(planes.ax[p]);
+            ay[p] = _mm256_set1_ps(planes.ay[p]);
+            az[p] = _mm256_set1_ps(planes.az[p]);
+            d[p] = _mm256_set1_ps(planes.d[p]);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 cx = _mm256_loadu_ps(&boxes.centerX[i]);
+            const __m256 cy = _mm256_loadu_ps(&boxes.centerY[i]);
+            const __m256 cz = _mm256_loadu_ps(&boxes.centerZ[i]);
+            const __m256 hx = _mm256_loadu_ps(&boxes.halfX[i]);
+            const __m256 hy = _mm256_loadu_ps(&boxes.halfY[i]);
+            const __m256 hz = _mm256_loadu_ps(&boxes.halfZ[i]);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (size_t p = 0; p < 6; ++p) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(nx[p], cx), d[p]);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(ny[p], cy));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(nz[p], cz));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(ax[p], hx));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(ay[p], hy));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(az[p], hz));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+            }
+            const int mask = _mm256_movemask_ps(inside);
+            for (size_t k = 0; k < 8; ++k) {
+                visible[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+                count += static_cast<size_t>((mask >> k) & 1);
+            }
+        }
+        // Leaves the AVX state before the scalar tail
+        _mm256_zeroupper();
+        return count + CullScalar(planes, boxes, i, end, visible);
+    }
+
+    static bool CheckAvx()
+    {
+# ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        // The OS saves the YMM registers
+        return osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6);
+# else
+        return __builtin_cpu_supports("avx") != 0;
+# endif
+    }
+#endif
+
+#ifdef FRUSTUM_CULLER_NEON
+    static size_t CullNeon(const PlanesSoA & planes, const AabbArray & boxes, size_t begin, size_t end, uint8_t* visible)
+    {
+        float32x4_t nx[6], ny[6], nz[6], ax[6], ay[6], az[6], d[6];
+        for (size_t p = 0; p < 6; ++p) {
+            nx[p] = vdupq_n_f32(planes.nx[p]);
+            ny[p] = vdupq_n_f32(planes.ny[p]);
+            nz[p] = vdupq_n_f32(planes.nz[p]);
+            ax[p] = vdupq_n_f32(planes.ax[p]);
+            ay[p] = vdupq_n_f32(planes.ay[p]);
+            az[p] = vdupq_n_f32(planes.az[p]);
+            d[p] = vdupq_n_f32(planes.d[p]);
+        }
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const uint32x4_t one = vdupq_n_u32(1);
+        size_t count = 0;
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const float32x4_t cx = vld1q_f32(&boxes.centerX[i]);
+            const float32x4_t cy = vld1q_f32(&boxes.centerY[i]);
+            const float32x4_t cz = vld1q_f32(&boxes.centerZ[i]);
+            const float32x4_t hx = vld1q_f32(&boxes.halfX[i]);
+            const float32x4_t hy = vld1q_f32(&boxes.halfY[i]);
+            const float32x4_t hz = vld1q_f32(&boxes.halfZ[i]);
+            uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+            for (size_t p = 0; p < 6; ++p) {
+                float32x4_t distance = vmlaq_f32(d[p], nx[p], cx);
+                distance = vmlaq_f32(distance, ny[p], cy);
+                distance = vmlaq_f32(distance, nz[p], cz);
+                distance = vmlaq_f32(distance, ax[p], hx);
+                distance = vmlaq_f32(distance, ay[p], hy);
+                distance = vmlaq_f32(distance, az[p], hz);
+                inside = vandq_u32(inside, vcgeq_f32(distance, zero));
+            }
+            const uint32x4_t flags = vandq_u32(inside, one);
+            visible[i + 0] = static_cast<uint8_t>(vgetq_lane_u32(flags, 0));
+            visible[i + 1] = static_cast<uint8_t>(vgetq_lane_u32(flags, 1));
+            visible[i + 2] = static_cast<uint8_t>(vgetq_lane_u32(flags, 2));
+            visible[i + 3] = static_cast<uint8_t>(vgetq_lane_u32(flags, 3));
+            count += vaddvq_u32(flags);
+        }
+        return count + CullScalar(planes, boxes, i, end, visible);
+    }
+#endif
+
+public:
+    static CullingIsa GetBestIsa()
+    {
+#if defined(FRUSTUM_CULLER_X86)
+        static const bool avx = CheckAvx();
+        return avx ? CullingIsa::Avx : CullingIsa::Sse;
+#elif defined(FRUSTUM_CULLER_NEON)
+        return CullingIsa::Neon;
+#else
+        return CullingIsa::Scalar;
+#endif
+    }
+
+    static bool IsSupported(CullingIsa isa)
+    {
+        switch (isa) {
+        case CullingIsa::Scalar:
+            return true;
+#if defined(FRUSTUM_CULLER_X86)
+        case CullingIsa::Sse:
+            return true;
+        case CullingIsa::Avx:
+            return GetBestIsa() == CullingIsa::Avx;
+#elif defined(FRUSTUM_CULLER_NEON)
+        case CullingIsa::Neon:
+            return true;
+#endif
+        default:
+            return false;
+        }
+    }
+
+    static const char* GetIsaName(CullingIsa isa)
+    {
+        switch (isa) {
+        case CullingIsa::Sse:
+            return "SSE";
+        case CullingIsa::Avx:
+            return "AVX";
+        case CullingIsa::Neon:
+            return "NEON";
+        default:
+            return "Scalar";
+        }
+    }
+
+    /**
+     * Writes 1 to visible[i] for the boxes of [begin, end) inside or crossing the frustum and 0 for the culled ones, returns the number of visible boxes
+     */
+    static size_t Cull(const Frustum & frustum, const AabbArray & boxes, size_t begin, size_t end, uint8_t* visible, CullingIsa isa = GetBestIsa())
+    {
+        const PlanesSoA planes(frustum);
+        switch (isa) {
+#if defined(FRUSTUM_CULLER_X86)
+        case CullingIsa::Sse:
+            return CullSse(planes, boxes, begin, end, visible);
+        case CullingIsa::Avx:
+            return CullAvx(planes, boxes, begin, end, visible);
+#elif defined(FRUSTUM_CULLER_NEON)
+        case CullingIsa::Neon:
+            return CullNeon(planes, boxes, begin, end, visible);
+#endif
+        default:
+            return CullScalar(planes, boxes, begin, end, visible);
+        }
+    }
+
+    /**
+     * Culls all boxes, splitting them into contiguous ranges of up to threadsCount threads (0 - all hardware threads).
+     * Every thread writes its own range of visible, so no synchronization is needed.
+     */
+    static size_t CullParallel(const Frustum & frustum, const AabbArray & boxes, std::vector<uint8_t> & visible, uint32_t threadsCount = 0, CullingIsa isa = GetBestIsa())
+    {
+        const size_t size = boxes.Size();
+        visible.resize(size);
+        if (threadsCount == 0) {
+            threadsCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const size_t threads = std::max<size_t>(1, std::min<size_t>(threadsCount, size / PARALLEL_BOXES_THRESHOLD));
+        // Ranges start at multiples of 8 to keep the SIMD blocks whole
+        auto rangeBegin = [&](size_t t) { return std::min(size, (size * t / threads) & ~static_cast<size_t>(7)); };
+
+        std::vector<size_t> counts(threads, 0);
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                counts[t] = Cull(frustum, boxes, rangeBegin(t), (t + 1 < threads) ? rangeBegin(t + 1) : size, visible.data(), isa);
+            });
+        }
+        counts[0] = Cull(frustum, boxes, 0, (threads > 1) ? rangeBegin(1) : size, visible.data(), isa);
+        for (auto & worker : workers) {
+            worker.join();
+        }
+        size_t count = 0;
+        for (size_t c : counts) {
+            count += c;
+        }
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+/**
+* Vulkan samples
+*
+* Average GPU time of a command buffer range measured with timestamp queries
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "VulkanUtility.h"
+
+/**
+ * A pair of timestamp queries per slot, e.g. per swapchain image. Begin() and End() are recorded into the command buffer of the slot,
+ * Collect() is called after the fence of the slot was waited and reads the previous submission without stalling.
+ * Queries are reset in the command buffer itself, so the buffer can be recorded once and submitted many times.
+ * Submitted() marks the slot as measured, so Collect() never reads queries which were not written yet.
+ * Every reportPeriod collected frames prints the average time.
+ */
+class GpuTimer
+{
+    vk::Device mDevice;
+    vk::QueryPool mQueryPool;
+    float mTimestampPeriod = 1.0f;
+    std::string mName;
+    uint32_t mReportPeriod = 0;
+    std::vector<bool> mSubmitted;
+
+    uint64_t mFrames = 0;
+    double mMilliseconds = 0.0;
+
+public:
+    GpuTimer() = default;
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    ~GpuTimer()
+    {
+        Destroy();
+    }
+
+    void Init(vk::Device device, const vk::PhysicalDevice & physicalDevice, uint32_t slots, const std::string & name, uint32_t reportPeriod = 1000)
+    {
+        Destroy();
+        mDevice = device;
+        mName = name;
+        mReportPeriod = reportPeriod;
+        mTimestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+        vk::QueryPoolCreateInfo queryPoolInfo;
+        queryPoolInfo.setQueryCount(2 * slots);
+        queryPoolInfo.setQueryType(vk::QueryType::eTimestamp);
+        mQueryPool = mDevice.createQueryPool(queryPoolInfo);
+        mSubmitted.assign(slots, false);
+    }
+
+    void Destroy()
+    {
+        if (mQueryPool) {
+            mDevice.destroyQueryPool(mQueryPool);
+            mQueryPool = vk::QueryPool();
+        }
+        mFrames = 0;
+        mMilliseconds = 0.0;
+    }
+
+    /**
+     * Must be recorded outside of a render pass
+     */
+    void Reset(vk::CommandBuffer & cmdBuffer, uint32_t slot)
+    {
+        cmdBuffer.resetQueryPool(mQueryPool, 2 * slot, 2);
+    }
+
+    void Begin(vk::CommandBuffer & cmdBuffer, uint32_t slot)
+    {
+        cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, mQueryPool, 2 * slot);
+    }
+
+    void End(vk::CommandBuffer & cmdBuffer, uint32_t slot)
+    {
+        cmdBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, mQueryPool, 2 * slot + 1);
+    }
+
+    void Submitted(uint32_t slot)
+    {
+        mSubmitted[slot] = true;
+    }
+
+    /**
+     * Reads the last finished measurement of the slot, if there is one
+     */
+    void Collect(uint32_t slot)
+    {
+        if (!mSubmitted[slot]) {
+            return;
+        }
+        mSubmitted[slot] = false;
+        uint64_t timestamps[2] = { 0, 0 };
+        if (vk::Result::eSuccess != mDevice.getQueryPoolResults(mQueryPool, 2 * slot, 2, sizeof(timestamps), &timestamps[0], sizeof(uint64_t), vk::QueryResultFlagBits::e64)) {
+            return;
+        }
+        mMilliseconds += (timestamps[1] - timestamps[0]) * mTimestampPeriod / 1e6;
+        ++mFrames;
+        if (mReportPeriod != 0 && mFrames % mReportPeriod == 0) {
+            std::cout << mName << " time = " << GetAverageMilliseconds() << " ms" << std::endl;
+        }
+    }
+
+    double GetAverageMilliseconds() const
+    {
+        return (mFrames > 0) ? mMilliseconds / mFrames : 0.0;
+    }
+};
+
+#endif
@@ -0,0 +1,307 @@
+/**
+* Vulkan samples
+*
+* Generation of prefab meshes with exactly sized buffers and 16 or 32 bit indexes
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _MESH_BUILDER_H_
+#define _MESH_BUILDER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "VulkanUtility.h"
+#include "math/OgreVector2.h"
+#include "math/OgreVector4.h"
+
+/**
+ * Indexed triangle list. Only one of the index arrays is filled, indexType tells which one,
+ * and has to be passed through to bindIndexBuffer() or to the acceleration structure geometry.
+ */
+template <typename _Vertex>
+struct IndexedMesh
+{
+    std::vector<_Vertex> vertexes;
+    std::vector<uint16_t> indexes16;
+    std::vector<uint32_t> indexes32;
+    vk::IndexType indexType = vk::IndexType::eUint16;
+
+    uint32_t GetIndexesCount() const
+    {
+        return static_cast<uint32_t>((indexType == vk::IndexType::eUint16) ? indexes16.size() : indexes32.size());
+    }
+
+    uint32_t GetIndex(size_t i) const
+    {
+        return (indexType == vk::IndexType::eUint16) ? indexes16[i] : indexes32[i];
+    }
+
+    std::vector<uint32_t> GetIndexes() const
+    {
+        if (indexType == vk::IndexType::eUint16) {
+            return std::vector<uint32_t>(indexes16.begin(), indexes16.end());
+        }
+        return indexes32;
+    }
+
+    /**
+     * Replaces indexes keeping the index type
+     */
+    void SetIndexes(const std::vector<uint32_t> & indexes)
+    {
+        if (indexType == vk::IndexType::eUint16) {
+            indexes16.assign(indexes.begin(), indexes.end());
+        }
+        else {
+            indexes32 = indexes;
+        }
+    }
+
+    const void* GetIndexesData() const
+    {
+        return (indexType == vk::IndexType::eUint16) ? static_cast<const void*>(indexes16.data()) : static_cast<const void*>(indexes32.data());
+    }
+
+    /**
+     * Size of the index buffer in bytes
+     */
+    uint32_t GetIndexesSize() const
+    {
+        return GetIndexesCount() * MeshIndexSize(indexType);
+    }
+
+    uint32_t GetVertexesSize() const
+    {
+        return static_cast<uint32_t>(vertexes.size() * sizeof(_Vertex));
+    }
+
+    static uint32_t MeshIndexSize(vk::IndexType type)
+    {
+        return (type == vk::IndexType::eUint16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+};
+
+/**
+ * Prefab shapes adopted from Ogre::PrefabFactory. The vertex type must have Ogre::Vector4 position and normal,
+ * Ogre::Vector2 texcoord is filled only if the vertex type has it.
+ * Vertex and index arrays are allocated once with the exact size and written in place,
+ * 16 bit indexes are used while all vertexes are addressable by them.
+ */
+class MeshBuilder
+{
+    // Sphere rings are generated in parallel starting from this number of vertexes
+    static const uint32_t PARALLEL_VERTEXES_THRESHOLD = 16 * 1024;
+
+    template <typename _Vertex>
+    static auto SetTexcoord(_Vertex & vertex, const Ogre::Vector2 & texcoord, int) -> decltype(vertex.texcoord = texcoord, void())
+    {
+        vertex.texcoord = texcoord;
+    }
+
+    template <typename _Vertex>
+    static void SetTexcoord(_Vertex &, const Ogre::Vector2 &, long)
+    { }
+
+    template <typename _Vertex>
+    static _Vertex MakeVertex(const Ogre::Vector4 & position, const Ogre::Vector4 & normal, const Ogre::Vector2 & texcoord)
+    {
+        _Vertex vertex;
+        vertex.position = position;
+        vertex.normal = normal;
+        SetTexcoord(vertex, texcoord, 0);
+        return vertex;
+    }
+
+    template <typename _Vertex>
+    static void ResizeIndexes(IndexedMesh<_Vertex> & mesh, size_t count)
+    {
+        if (mesh.indexType == vk::IndexType::eUint16) {
+            mesh.indexes16.resize(count);
+        }
+        else {
+            mesh.indexes32.resize(count);
+        }
+    }
+
+    template <typename _Vertex, typename _Index>
+    static void WriteSphereRings(uint32_t ringBegin, uint32_t ringEnd, uint32_t rings, uint32_t segments, float radius, float normalW,
+        const std::vector<float> & ringSin, const std::vector<float> & ringCos, const std::vector<float> & segSin, const std::vector<float> & segCos,
+        _Vertex* vertexes, _Index* indexes)
+    {
+        uint32_t verticeIndex = ringBegin * (segments + 1);
+        _Index* dst = indexes + static_cast<size_t>(ringBegin) * (segments + 1) * 6;
+        for (uint32_t ringIdx = ringBegin; ringIdx < ringEnd; ++ringIdx) {
+            for (uint32_t segIdx = 0; segIdx <= segments; ++segIdx) {
+                // Unit sphere point is the normal
+                const float nx = ringSin[ringIdx] * segSin[segIdx];
+                const float ny = ringCos[ringIdx];
+                const float nz = ringSin[ringIdx] * segCos[segIdx];
+
+                vertexes[verticeIndex] = MakeVertex<_Vertex>(Ogre::Vector4(radius * nx, radius * ny, radius * nz, 1.0f), Ogre::Vector4(nx, ny, nz, normalW),
+                    Ogre::Vector2(static_cast<float>(segIdx) / segments, static_cast<float>(ringIdx) / rings));
+
+                if (ringIdx != rings) {
+                    // each vertex (except the last) has six indicies pointing to it
+                    *dst++ = static_cast<_Index>(verticeIndex + segments + 1);
+                    *dst++ = static_cast<_Index>(verticeIndex);
+                    *dst++ = static_cast<_Index>(verticeIndex + segments);
+                    *dst++ = static_cast<_Index>(verticeIndex + segments + 1);
+                    *dst++ = static_cast<_Index>(verticeIndex + 1);
+                    *dst++ = static_cast<_Index>(verticeIndex);
+                }
+                ++verticeIndex;
+            }
+        }
+    }
+
+    template <typename _Vertex, typename _Index>
+    static void WriteSphere(IndexedMesh<_Vertex> & mesh, _Index* indexes, float radius, uint32_t rings, uint32_t segments, float normalW)
+    {
+        const double pi = 3.14159265358979323846;
+
+        // Sines and cosines are computed once per ring and once per segment, instead of per vertex
+        std::vector<float> ringSin(rings + 1), ringCos(rings + 1);
+        for (uint32_t ringIdx = 0; ringIdx <= rings; ++ringIdx) {
+            ringSin[ringIdx] = static_cast<float>(std::sin(ringIdx * pi / rings));
+            ringCos[ringIdx] = static_cast<float>(std::cos(ringIdx * pi / rings));
+        }
+        std::vector<float> segSin(segments + 1), segCos(segments + 1);
+        for (uint32_t segIdx = 0; segIdx <= segments; ++segIdx) {
+            segSin[segIdx] = static_cast<float>(std::sin(segIdx * 2.0 * pi / segments));
+            segCos[segIdx] = static_cast<float>(std::cos(segIdx * 2.0 * pi / segments));
+        }
+
+        // Every ring writes its own ranges of the arrays, so rings are split between threads without synchronization
+        uint32_t threads = 1;
+        if (mesh.vertexes.size() >= PARALLEL_VERTEXES_THRESHOLD) {
+            threads = std::max(1u, std::min(std::thread::hardware_concurrency(), rings + 1));
+        }
+        std::vector<std::thread> workers;
+        for (uint32_t t = 1; t < threads; ++t) {
+            const uint32_t ringBegin = static_cast<uint32_t>(static_cast<uint64_t>(rings + 1) * t / threads);
+            const uint32_t ringEnd = static_cast<uint32_t>(static_cast<uint64_t>(rings + 1) * (t + 1) / threads);
+            workers.emplace_back([&, ringBegin, ringEnd] {
+                WriteSphereRings(ringBegin, ringEnd, rings, segments, radius, normalW, ringSin, ringCos, segSin, segCos, mesh.vertexes.data(), indexes);
+            });
+        }
+        WriteSphereRings(0, static_cast<uint32_t>(static_cast<uint64_t>(rings + 1) / threads), rings, segments, radius, normalW,
+            ringSin, ringCos, segSin, segCos, mesh.vertexes.data(), indexes);
+        for (auto & worker : workers) {
+            worker.join();
+        }
+    }
+
+public:
+    /**
+     * 16 bit indexes if all vertexes are addressable by them and minIndexType allows, otherwise 32 bit
+     */
+    static vk::IndexType SelectIndexType(uint64_t vertexesCount, vk::IndexType minIndexType = vk::IndexType::eUint16)
+    {
+        if (vertexesCount > static_cast<uint64_t>(std::numeric_limits<uint32_t>::max()) + 1) {
+            throw std::runtime_error("MeshBuilder: too many vertexes for 32 bit indexes");
+        }
+        if (minIndexType == vk::IndexType::eUint16 && vertexesCount <= static_cast<uint64_t>(std::numeric_limits<uint16_t>::max()) + 1) {
+            return vk::IndexType::eUint16;
+        }
+        return vk::IndexType::eUint32;
+    }
+
+    /**
+     * Writes indexes in the given format, e.g. to a mapped index buffer
+     */
+    static void PackIndexes(const std::vector<uint32_t> & indexes, vk::IndexType indexType, void* dst)
+    {
+        if (indexType == vk::IndexType::eUint16) {
+            uint16_t* dst16 = static_cast<uint16_t*>(dst);
+            for (size_t i = 0; i < indexes.size(); ++i) {
+                dst16[i] = static_cast<uint16_t>(indexes[i]);
+            }
+        }
+        else if (!indexes.empty()) {
+            std::memcpy(dst, indexes.data(), indexes.size() * sizeof(uint32_t));
+        }
+    }
+
+    /**
+     * UV sphere of (rings + 1) * (segments + 1) vertexes.
+     * normalW is the w component of normals: 0 for directions, samples transforming normals as points pass 1.
+     */
+    template <typename _Vertex>
+    static IndexedMesh<_Vertex> GenerateSphere(const float radius, const uint32_t rings, const uint32_t segments, const float normalW = 0.0f,
+        const vk::IndexType minIndexType = vk::IndexType::eUint16)
+    {
+        if (rings < 2 || segments < 3) {
+            throw std::runtime_error("MeshBuilder: sphere must have at least 2 rings and 3 segments");
+        }
+        const uint64_t vertexesCount = static_cast<uint64_t>(rings + 1) * (segments + 1);
+        const uint64_t indexesCount = static_cast<uint64_t>(rings) * (segments + 1) * 6;
+
+        IndexedMesh<_Vertex> sphere;
+        sphere.indexType = SelectIndexType(vertexesCount, minIndexType);
+        sphere.vertexes.resize(static_cast<size_t>(vertexesCount));
+        ResizeIndexes(sphere, static_cast<size_t>(indexesCount));
+
+        if (sphere.indexType == vk::IndexType::eUint16) {
+            WriteSphere(sphere, sphere.indexes16.data(), radius, rings, segments, normalW);
+        }
+        else {
+            WriteSphere(sphere, sphere.indexes32.data(), radius, rings, segments, normalW);
+        }
+        return sphere;
+    }
+
+    /**
+     * Cube of 24 vertexes, 4 per side, and 6 indexes per side in the order front, back, left, right, up, down
+     */
+    template <typename _Vertex>
+    static IndexedMesh<_Vertex> GenerateCube(const float size, const vk::IndexType minIndexType = vk::IndexType::eUint16)
+    {
+        const float h = size / 2.0f;
+        struct Side
+        {
+            Ogre::Vector4 normal;
+            Ogre::Vector4 corners[4];
+        };
+        const Side sides[] = {
+            /* front */ { Ogre::Vector4( 0.0f,  0.0f,  1.0f, 0.0f), { Ogre::Vector4( h, -h,  h, 1.0f), Ogre::Vector4( h,  h,  h, 1.0f), Ogre::Vector4(-h,  h,  h, 1.0f), Ogre::Vector4(-h, -h,  h, 1.0f) } },
+            /* back  */ { Ogre::Vector4( 0.0f,  0.0f, -1.0f, 0.0f), { Ogre::Vector4( h, -h, -h, 1.0f), Ogre::Vector4(-h, -h, -h, 1.0f), Ogre::Vector4(-h,  h, -h, 1.0f), Ogre::Vector4( h,  h, -h, 1.0f) } },
+            /* left  */ { Ogre::Vector4(-1.0f,  0.0f,  0.0f, 0.0f), { Ogre::Vector4(-h, -h, -h, 1.0f), Ogre::Vector4(-h, -h,  h, 1.0f), Ogre::Vector4(-h,  h,  h, 1.0f), Ogre::Vector4(-h,  h, -h, 1.0f) } },
+            /* right */ { Ogre::Vector4( 1.0f,  0.0f,  0.0f, 0.0f), { Ogre::Vector4( h, -h,  h, 1.0f), Ogre::Vector4( h, -h, -h, 1.0f), Ogre::Vector4( h,  h, -h, 1.0f), Ogre::Vector4( h,  h,  h, 1.0f) } },
+            /* up    */ { Ogre::Vector4( 0.0f,  1.0f,  0.0f, 0.0f), { Ogre::Vector4(-h,  h,  h, 1.0f), Ogre::Vector4( h,  h,  h, 1.0f), Ogre::Vector4( h,  h, -h, 1.0f), Ogre::Vector4(-h,  h, -h, 1.0f) } },
+            /* down  */ { Ogre::Vector4( 0.0f, -1.0f,  0.0f, 0.0f), { Ogre::Vector4(-h, -h, -h, 1.0f), Ogre::Vector4( h, -h, -h, 1.0f), Ogre::Vector4( h, -h,  h, 1.0f), Ogre::Vector4(-h, -h,  h, 1.0f) } }
+        };
+        const Ogre::Vector2 texcoords[4] = { Ogre::Vector2(0.0f, 1.0f), Ogre::Vector2(1.0f, 1.0f), Ogre::Vector2(1.0f, 0.0f), Ogre::Vector2(0.0f, 0.0f) };
+        const uint32_t sideIndexes[6] = { 0, 1, 2, 0, 2, 3 };
+
+        IndexedMesh<_Vertex> cube;
+        cube.indexType = SelectIndexType(24, minIndexType);
+        cube.vertexes.reserve(24);
+        ResizeIndexes(cube, 36);
+        for (uint32_t s = 0; s < 6; ++s) {
+            for (uint32_t c = 0; c < 4; ++c) {
+                cube.vertexes.push_back(MakeVertex<_Vertex>(sides[s].corners[c], sides[s].normal, texcoords[c]));
+            }
+            for (uint32_t i = 0; i < 6; ++i) {
+                const uint32_t index = 4 * s + sideIndexes[i];
+                if (cube.indexType == vk::IndexType::eUint16) {
+                    cube.indexes16[6 * s + i] = static_cast<uint16_t>(index);
+                }
+                else {
+                    cube.indexes32[6 * s + i] = index;
+                }
+            }
+        }
+        return cube;
+    }
+};
+
+#endif
@@ -0,0 +1,337 @@
+/**
+* Vulkan samples
+*
+* Binary mesh container which is memory mapped and copied to buffers without parsing
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _MESH_FILE_H_
+#define _MESH_FILE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+# ifndef NOMINMAX
+#  define NOMINMAX
+# endif
+# include <Windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "MeshBuilder.h"
+
+/**
+ * File layout, all offsets are from the file start and blobs are aligned to MeshFile::ALIGNMENT:
+ *   MeshFileHeader
+ *   MeshFileLod[lodsCount]   index ranges of levels of detail, LOD 0 is the full mesh
+ *   vertexes                 vertexesCount * vertexStride bytes in the layout of the samples VertexData:
+ *                            Vector4 position, Vector4 normal and, with MESH_FILE_TEXCOORD, Vector2 texcoord
+ *   indexes                  indexesCount * indexSize bytes, all LODs one after another
+ */
+enum MeshFileAttributes : uint32_t
+{
+    MESH_FILE_POSITION = 1,
+    MESH_FILE_NORMAL = 2,
+    MESH_FILE_TEXCOORD = 4
+};
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t attributes;
+    uint32_t vertexStride;
+    uint32_t indexSize;
+    uint32_t lodsCount;
+    uint32_t vertexesCount;
+    uint32_t indexesCount;
+    uint64_t lodsOffset;
+    uint64_t vertexesOffset;
+    uint64_t indexesOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct MeshFileLod
+{
+    uint32_t firstIndex;
+    uint32_t indexesCount;
+    float error;            // relative to the bounding box diagonal, 0 for LOD 0
+    uint32_t reserved;
+};
+
+/**
+ * Read only view of a mesh file. The file is memory mapped, so the blobs are copied to mapped buffers directly
+ * and only the pages which are copied are read from disk.
+ */
+class MeshFile
+{
+public:
+    static const uint32_t MAGIC = 0x534D4B56; // "VKMS"
+    static const uint32_t VERSION = 1;
+    static const uint64_t ALIGNMENT = 256;
+
+private:
+    const uint8_t* mData = nullptr;
+    uint64_t mSize = 0;
+#if defined(_WIN32)
+    HANDLE mFile = INVALID_HANDLE_VALUE;
+    HANDLE mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+
+    static uint64_t Align(uint64_t offset)
+    {
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    void Map(const std::string & path)
+    {
+#if defined(_WIN32)
+        mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size;
+        if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || size.QuadPart == 0) {
+            throw std::runtime_error("MeshFile: failed to open " + path);
+        }
+        mSize = static_cast<uint64_t>(size.QuadPart);
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping != nullptr) {
+            mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        mFile = open(path.c_str(), O_RDONLY);
+        struct stat info;
+        if (mFile < 0 || fstat(mFile, &info) != 0 || info.st_size == 0) {
+            throw std::runtime_error("MeshFile: failed to open " + path);
+        }
+        mSize = static_cast<uint64_t>(info.st_size);
+        void* data = mmap(nullptr, static_cast<size_t>(mSize), PROT_READ, MAP_PRIVATE, mFile, 0);
+        mData = (data != MAP_FAILED) ? static_cast<const uint8_t*>(data) : nullptr;
+#endif
+        if (mData == nullptr) {
+            throw std::runtime_error("MeshFile: failed to map " + path);
+        }
+    }
+
+    template <typename _Type>
+    static void WriteAt(std::ofstream & file, uint64_t offset, const _Type* data, size_t count)
+    {
+        // Blobs are written in order, the alignment gaps are zero filled
+        const char zero = 0;
+        for (uint64_t position = static_cast<uint64_t>(file.tellp()); position < offset; ++position) {
+            file.write(&zero, 1);
+        }
+        file.write(reinterpret_cast<const char*>(data), count * sizeof(_Type));
+    }
+
+public:
+    MeshFile() = default;
+
+    MeshFile(const MeshFile&) = delete;
+    MeshFile& operator=(const MeshFile&) = delete;
+
+    ~MeshFile()
+    {
+        Close();
+    }
+
+    /**
+     * Maps the file and validates the header and the blob ranges, throws if the file is not a valid mesh
+     */
+    void Open(const std::string & path)
+    {
+        Close();
+        Map(path);
+        if (mSize < sizeof(MeshFileHeader) || GetHeader().magic != MAGIC) {
+            throw std::runtime_error("MeshFile: " + path + " is not a mesh file");
+        }
+        const MeshFileHeader & header = GetHeader();
+        if (header.version != VERSION) {
+            throw std::runtime_error("MeshFile: unsupported version of " + path);
+        }
+        if ((header.indexSize != 2 && header.indexSize != 4) || header.lodsCount == 0 ||
+            header.lodsOffset + static_cast<uint64_t>(header.lodsCount) * sizeof(MeshFileLod) > mSize ||
+            header.vertexesOffset + static_cast<uint64_t>(header.vertexesCount) * header.vertexStride > mSize ||
+            header.indexesOffset + static_cast<uint64_t>(header.indexesCount) * header.indexSize > mSize) {
+            throw std::runtime_error("MeshFile: " + path + " is corrupted");
+        }
+        for (uint32_t i = 0; i < header.lodsCount; ++i) {
+            if (static_cast<uint64_t>(GetLods()[i].firstIndex) + GetLods()[i].indexesCount > header.indexesCount) {
+                throw std::runtime_error("MeshFile: " + path + " has invalid LOD table");
+            }
+        }
+    }
+
+    void Close()
+    {
+#if defined(_WIN32)
+        if (mData != nullptr) {
+            UnmapViewOfFile(mData);
+        }
+        if (mMapping != nullptr) {
+            CloseHandle(mMapping);
+            mMapping = nullptr;
+        }
+        if (mFile != INVALID_HANDLE_VALUE) {
+            CloseHandle(mFile);
+            mFile = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (mData != nullptr) {
+            munmap(const_cast<uint8_t*>(mData), static_cast<size_t>(mSize));
+        }
+        if (mFile >= 0) {
+            close(mFile);
+            mFile = -1;
+        }
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    const MeshFileHeader & GetHeader() const
+    {
+        return *reinterpret_cast<const MeshFileHeader*>(mData);
+    }
+
+    const MeshFileLod* GetLods() const
+    {
+        return reinterpret_cast<const MeshFileLod*>(mData + GetHeader().lodsOffset);
+    }
+
+    const void* GetVertexes() const
+    {
+        return mData + GetHeader().vertexesOffset;
+    }
+
+    uint64_t GetVertexesSize() const
+    {
+        return static_cast<uint64_t>(GetHeader().vertexesCount) * GetHeader().vertexStride;
+    }
+
+    const void* GetIndexes() const
+    {
+        return mData + GetHeader().indexesOffset;
+    }
+
+    uint64_t GetIndexesSize() const
+    {
+        return static_cast<uint64_t>(GetHeader().indexesCount) * GetHeader().indexSize;
+    }
+
+    vk::IndexType GetIndexType() const
+    {
+        return (GetHeader().indexSize == 2) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+    }
+
+    const void* GetLodIndexes(uint32_t lod) const
+    {
+        return static_cast<const uint8_t*>(GetIndexes()) + static_cast<uint64_t>(GetLods()[lod].firstIndex) * GetHeader().indexSize;
+    }
+
+    uint64_t GetLodIndexesSize(uint32_t lod) const
+    {
+        return static_cast<uint64_t>(GetLods()[lod].indexesCount) * GetHeader().indexSize;
+    }
+
+    /**
+     * Throws if the vertexes of the file can't be read as _Vertex, call it before copying GetVertexes() to a buffer
+     */
+    template <typename _Vertex>
+    void CheckVertexType() const
+    {
+        if (GetHeader().vertexStride != sizeof(_Vertex)) {
+            throw std::runtime_error("MeshFile: vertex layout of the file doesn't match the vertex type");
+        }
+    }
+
+    /**
+     * Copies the blobs to a mesh with one memcpy per blob. The vertex type must have the layout of the file.
+     * By default only the indexes of LOD 0 are loaded, with allLods the index ranges of GetLods() are valid for the mesh
+     */
+    template <typename _Vertex>
+    IndexedMesh<_Vertex> Load(bool allLods = false) const
+    {
+        CheckVertexType<_Vertex>();
+        const MeshFileHeader & header = GetHeader();
+        const uint32_t indexesCount = allLods ? header.indexesCount : GetLods()[0].indexesCount;
+        const void* indexes = allLods ? GetIndexes() : GetLodIndexes(0);
+        IndexedMesh<_Vertex> mesh;
+        mesh.indexType = GetIndexType();
+        mesh.vertexes.resize(header.vertexesCount);
+        std::memcpy(mesh.vertexes.data(), GetVertexes(), static_cast<size_t>(GetVertexesSize()));
+        if (mesh.indexType == vk::IndexType::eUint16) {
+            mesh.indexes16.resize(indexesCount);
+            std::memcpy(mesh.indexes16.data(), indexes, indexesCount * sizeof(uint16_t));
+        }
+        else {
+            mesh.indexes32.resize(indexesCount);
+            std::memcpy(mesh.indexes32.data(), indexes, indexesCount * sizeof(uint32_t));
+        }
+        return mesh;
+    }
+
+    /**
+     * Writes a mesh file. lods are index ranges of the mesh, by default the whole mesh is LOD 0
+     */
+    template <typename _Vertex>
+    static void Write(const std::string & path, const IndexedMesh<_Vertex> & mesh, uint32_t attributes, std::vector<MeshFileLod> lods = std::vector<MeshFileLod>())
+    {
+        if (lods.empty()) {
+            lods.push_back(MeshFileLod{ 0, mesh.GetIndexesCount(), 0.0f, 0 });
+        }
+
+        MeshFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.attributes = attributes;
+        header.vertexStride = sizeof(_Vertex);
+        header.indexSize = IndexedMesh<_Vertex>::MeshIndexSize(mesh.indexType);
+        header.lodsCount = static_cast<uint32_t>(lods.size());
+        header.vertexesCount = static_cast<uint32_t>(mesh.vertexes.size());
+        header.indexesCount = mesh.GetIndexesCount();
+        header.lodsOffset = Align(sizeof(MeshFileHeader));
+        header.vertexesOffset = Align(header.lodsOffset + lods.size() * sizeof(MeshFileLod));
+        header.indexesOffset = Align(header.vertexesOffset + static_cast<uint64_t>(header.vertexesCount) * header.vertexStride);
+        for (uint32_t k = 0; k < 3; ++k) {
+            header.boundsMin[k] = mesh.vertexes.empty() ? 0.0f : std::numeric_limits<float>::max();
+            header.boundsMax[k] = mesh.vertexes.empty() ? 0.0f : std::numeric_limits<float>::lowest();
+        }
+        for (const auto & vertex : mesh.vertexes) {
+            const float p[3] = { vertex.position.x, vertex.position.y, vertex.position.z };
+            for (uint32_t k = 0; k < 3; ++k) {
+                header.boundsMin[k] = std::min(header.boundsMin[k], p[k]);
+                header.boundsMax[k] = std::max(header.boundsMax[k], p[k]);
+            }
+        }
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("MeshFile: failed to create " + path);
+        }
+        WriteAt(file, 0, &header, 1);
+        WriteAt(file, header.lodsOffset, lods.data(), lods.size());
+        WriteAt(file, header.vertexesOffset, mesh.vertexes.data(), mesh.vertexes.size());
+        WriteAt(file, header.indexesOffset, static_cast<const uint8_t*>(mesh.GetIndexesData()), mesh.GetIndexesSize());
+        if (!file) {
+            throw std::runtime_error("MeshFile: failed to write " + path);
+        }
+    }
+};
+
+#endif
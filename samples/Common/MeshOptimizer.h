@@ -0,0 +1,331 @@
+/**
+* Vulkan samples
+*
+* Reordering of indexed triangle lists for the post-transform vertex cache, overdraw and vertex fetch
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "math/OgreVector3.h"
+
+/**
+ * Vertex cache efficiency of an index order, simulated with a FIFO cache
+ * ACMR - average cache miss ratio, transformed vertexes per triangle, 0.5 at best for large regular meshes, 3 at worst
+ * ATVR - average transformed vertex ratio, transformed vertexes per used vertex, 1 at best
+ */
+struct VertexCacheStatistics
+{
+    uint32_t misses = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+/**
+ * Mesh optimization in three stages, each keeps the triangles and their winding:
+ *   1. Tipsify (Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"):
+ *      triangles are emitted as fans around vertexes which are still in the cache, in linear time.
+ *   2. Overdraw: the order is cut into clusters where Tipsify jumped to a new region or where a cluster alone is cheap enough for the cache,
+ *      clusters are sorted by how much they face outwards from the mesh center, so the front most triangles tend to be drawn first.
+ *   3. Vertex fetch: vertexes are renumbered in the order of the first use, so vertex fetch reads memory sequentially.
+ */
+class MeshOptimizer
+{
+    static uint32_t CountCacheMisses(const std::vector<uint32_t> & indexes, size_t begin, size_t end, std::vector<uint32_t> & timestamps, uint32_t & time, uint32_t cacheSize)
+    {
+        // A vertex is in a FIFO cache if less than cacheSize misses happened after it was loaded
+        uint32_t misses = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t v = indexes[i];
+            if (time - timestamps[v] > cacheSize) {
+                timestamps[v] = time++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+
+public:
+    static VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t> & indexes, uint32_t vertexesCount, uint32_t cacheSize = 16)
+    {
+        VertexCacheStatistics statistics;
+        if (indexes.empty()) {
+            return statistics;
+        }
+        std::vector<uint32_t> timestamps(vertexesCount, 0);
+        std::vector<bool> used(vertexesCount, false);
+        for (uint32_t v : indexes) {
+            used[v] = true;
+        }
+        uint32_t time = cacheSize + 1;
+        statistics.misses = CountCacheMisses(indexes, 0, indexes.size(), timestamps, time, cacheSize);
+        statistics.acmr = static_cast<float>(statistics.misses) / (indexes.size() / 3);
+        statistics.atvr = static_cast<float>(statistics.misses) / std::max<size_t>(std::count(used.begin(), used.end(), true), 1);
+        return statistics;
+    }
+
+    /**
+     * Tipsify reordering for a cache of cacheSize vertexes. If clusters is given, it receives the first triangle of every region
+     * where the algorithm had to jump to a vertex out of the cache, these are the hard boundaries for OptimizeOverdraw()
+     */
+    static std::vector<uint32_t> OptimizeVertexCache(const std::vector<uint32_t> & indexes, uint32_t vertexesCount, uint32_t cacheSize = 16, std::vector<uint32_t>* clusters = nullptr)
+    {
+        if (indexes.size() % 3 != 0) {
+            throw std::runtime_error("MeshOptimizer: indexes don't form a triangle list");
+        }
+        const uint32_t trianglesCount = static_cast<uint32_t>(indexes.size() / 3);
+
+        // Vertex to triangles adjacency in the compressed form
+        std::vector<uint32_t> liveTriangles(vertexesCount, 0);
+        for (uint32_t v : indexes) {
+            ++liveTriangles[v];
+        }
+        std::vector<uint32_t> adjacencyOffsets(vertexesCount + 1, 0);
+        std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+        std::vector<uint32_t> adjacency(indexes.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (uint32_t t = 0; t < trianglesCount; ++t) {
+                for (uint32_t k = 0; k < 3; ++k) {
+                    adjacency[fill[indexes[3 * t + k]]++] = t;
+                }
+            }
+        }
+
+        std::vector<uint32_t> cacheTime(vertexesCount, 0);
+        std::vector<bool> emitted(trianglesCount, false);
+        std::vector<uint32_t> deadEnds;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> output;
+        output.reserve(indexes.size());
+        if (clusters != nullptr) {
+            clusters->clear();
+        }
+
+        uint32_t time = cacheSize + 1;
+        uint32_t cursor = 0;
+        int64_t fanning = vertexesCount > 0 ? 0 : -1;
+        bool jumped = true;
+        while (fanning >= 0) {
+            if (jumped && clusters != nullptr) {
+                clusters->push_back(static_cast<uint32_t>(output.size() / 3));
+            }
+            candidates.clear();
+            const uint32_t f = static_cast<uint32_t>(fanning);
+            for (uint32_t a = adjacencyOffsets[f]; a < adjacencyOffsets[f + 1]; ++a) {
+                const uint32_t t = adjacency[a];
+                if (emitted[t]) {
+                    continue;
+                }
+                for (uint32_t k = 0; k < 3; ++k) {
+                    const uint32_t v = indexes[3 * t + k];
+                    output.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    --liveTriangles[v];
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // The next fanning vertex is the candidate which stays in the cache the longest while its remaining triangles are emitted
+            int64_t next = -1;
+            int64_t bestPriority = -1;
+            for (uint32_t v : candidates) {
+                if (liveTriangles[v] > 0) {
+                    int64_t priority = 0;
+                    if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                        priority = time - cacheTime[v];
+                    }
+                    if (priority > bestPriority) {
+                        bestPriority = priority;
+                        next = v;
+                    }
+                }
+            }
+            jumped = false;
+            if (next < 0) {
+                // Dead end: the most recent vertex with live triangles, then the next one in the input order
+                while (!deadEnds.empty() && next < 0) {
+                    const uint32_t d = deadEnds.back();
+                    deadEnds.pop_back();
+                    if (liveTriangles[d] > 0) {
+                        next = d;
+                    }
+                }
+                while (cursor < vertexesCount && next < 0) {
+                    if (liveTriangles[cursor] > 0) {
+                        next = cursor;
+                        jumped = true;
+                    }
+                    ++cursor;
+                }
+            }
+            fanning = next;
+        }
+        if (output.size() != indexes.size()) {
+            throw std::runtime_error("MeshOptimizer: failed to reorder triangles");
+        }
+        return output;
+    }
+
+    /**
+     * Splits the hard clusters further while a cluster alone has ACMR within threshold of its hard cluster,
+     * then sorts clusters by dot(cluster normal, cluster center - mesh center) descending.
+     */
+    static void OptimizeOverdraw(std::vector<uint32_t> & indexes, const std::vector<Ogre::Vector3> & positions, const std::vector<uint32_t> & hardClusters,
+        uint32_t cacheSize = 16, float threshold = 1.05f)
+    {
+        const uint32_t trianglesCount = static_cast<uint32_t>(indexes.size() / 3);
+        if (trianglesCount == 0) {
+            return;
+        }
+
+        std::vector<uint32_t> boundaries;
+        std::vector<uint32_t> timestamps(positions.size(), 0);
+        uint32_t time = cacheSize + 1;
+        for (size_t c = 0; c < hardClusters.size(); ++c) {
+            const uint32_t begin = hardClusters[c];
+            const uint32_t end = (c + 1 < hardClusters.size()) ? hardClusters[c + 1] : trianglesCount;
+            if (begin >= end) {
+                continue;
+            }
+            time += cacheSize + 1;
+            const float hardAcmr = static_cast<float>(CountCacheMisses(indexes, 3 * begin, 3 * end, timestamps, time, cacheSize)) / (end - begin);
+
+            // Every soft cluster starts with a cold cache, the way it may be drawn after sorting
+            boundaries.push_back(begin);
+            time += cacheSize + 1;
+            uint32_t softBegin = begin;
+            uint32_t softMisses = 0;
+            for (uint32_t t = begin; t < end; ++t) {
+                softMisses += CountCacheMisses(indexes, 3 * t, 3 * t + 3, timestamps, time, cacheSize);
+                if (t + 1 < end && softMisses <= threshold * hardAcmr * (t + 1 - softBegin)) {
+                    boundaries.push_back(t + 1);
+                    softBegin = t + 1;
+                    softMisses = 0;
+                    time += cacheSize + 1;
+                }
+            }
+        }
+        if (boundaries.empty() || boundaries.front() != 0) {
+            boundaries.insert(boundaries.begin(), 0);
+        }
+
+        Ogre::Vector3 meshCenter = Ogre::Vector3::ZERO;
+        for (uint32_t v : indexes) {
+            meshCenter += positions[v];
+        }
+        meshCenter /= static_cast<float>(indexes.size());
+
+        struct Cluster
+        {
+            uint32_t begin;
+            uint32_t end;
+            float sortKey;
+        };
+        std::vector<Cluster> sorted;
+        sorted.reserve(boundaries.size());
+        for (size_t c = 0; c < boundaries.size(); ++c) {
+            Cluster cluster;
+            cluster.begin = boundaries[c];
+            cluster.end = (c + 1 < boundaries.size()) ? boundaries[c + 1] : trianglesCount;
+
+            // Area weighted normal and center of the cluster
+            Ogre::Vector3 normal = Ogre::Vector3::ZERO;
+            Ogre::Vector3 center = Ogre::Vector3::ZERO;
+            float area = 0.0f;
+            for (uint32_t t = cluster.begin; t < cluster.end; ++t) {
+                const Ogre::Vector3 & p0 = positions[indexes[3 * t]];
+                const Ogre::Vector3 & p1 = positions[indexes[3 * t + 1]];
+                const Ogre::Vector3 & p2 = positions[indexes[3 * t + 2]];
+                const Ogre::Vector3 n = (p1 - p0).crossProduct(p2 - p0);
+                const float a = n.length();
+                normal += n;
+                center += (p0 + p1 + p2) * (a / 3.0f);
+                area += a;
+            }
+            if (area > 0.0f) {
+                center /= area;
+            }
+            normal.normalise();
+            cluster.sortKey = normal.dotProduct(center - meshCenter);
+            sorted.push_back(cluster);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster & c1, const Cluster & c2) {
+            return c1.sortKey > c2.sortKey;
+        });
+
+        std::vector<uint32_t> output;
+        output.reserve(indexes.size());
+        for (const auto & cluster : sorted) {
+            output.insert(output.end(), indexes.begin() + 3 * cluster.begin, indexes.begin() + 3 * cluster.end);
+        }
+        indexes.swap(output);
+    }
+
+    /**
+     * Renumbers vertexes in the order of the first use and returns the remap table old -> new, unused vertexes are dropped
+     */
+    static std::vector<uint32_t> OptimizeVertexFetch(std::vector<uint32_t> & indexes, uint32_t vertexesCount, uint32_t & usedVertexesCount)
+    {
+        const uint32_t unused = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertexesCount, unused);
+        usedVertexesCount = 0;
+        for (auto & v : indexes) {
+            if (remap[v] == unused) {
+                remap[v] = usedVertexesCount++;
+            }
+            v = remap[v];
+        }
+        return remap;
+    }
+
+    /**
+     * All three stages for a mesh with Ogre::Vector4 positions, returns statistics before and after
+     */
+    template <typename _Vertex>
+    static void Optimize(IndexedMesh<_Vertex> & mesh, VertexCacheStatistics & before, VertexCacheStatistics & after, uint32_t cacheSize = 16, float overdrawThreshold = 1.05f)
+    {
+        const uint32_t vertexesCount = static_cast<uint32_t>(mesh.vertexes.size());
+        std::vector<uint32_t> indexes = mesh.GetIndexes();
+        before = AnalyzeVertexCache(indexes, vertexesCount, cacheSize);
+
+        std::vector<uint32_t> clusters;
+        indexes = OptimizeVertexCache(indexes, vertexesCount, cacheSize, &clusters);
+
+        std::vector<Ogre::Vector3> positions(vertexesCount);
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            const auto & p = mesh.vertexes[i].position;
+            positions[i] = Ogre::Vector3(p.x, p.y, p.z);
+        }
+        OptimizeOverdraw(indexes, positions, clusters, cacheSize, overdrawThreshold);
+
+        uint32_t usedVertexesCount = 0;
+        const std::vector<uint32_t> remap = OptimizeVertexFetch(indexes, vertexesCount, usedVertexesCount);
+        std::vector<_Vertex> vertexes(usedVertexesCount);
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            if (remap[i] < usedVertexesCount) {
+                vertexes[remap[i]] = mesh.vertexes[i];
+            }
+        }
+        mesh.vertexes.swap(vertexes);
+        mesh.SetIndexes(indexes);
+        after = AnalyzeVertexCache(indexes, usedVertexesCount, cacheSize);
+    }
+};
+
+#endif
@@ -0,0 +1,406 @@
+/**
+* Vulkan samples
+*
+* Levels of detail: quadric error simplification and screen space error selection
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _MESH_SIMPLIFIER_H_
+#define _MESH_SIMPLIFIER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "math/OgreVector3.h"
+
+/**
+ * Edge collapse simplification with quadric error metrics (Garland, Heckbert, "Surface Simplification Using Quadric Error Metrics").
+ * Vertexes are collapsed into a neighbour, never moved, so all levels of detail index the same vertex buffer.
+ * Vertexes on attribute seams (same position, different normal or texture coordinates) and on open borders are kept,
+ * collapses which flip a triangle or make the surface non-manifold are rejected.
+ * Planes are weighted by the triangle areas and the error of a level is the root of the largest mean squared distance of a collapse, in mesh units.
+ */
+class MeshSimplifier
+{
+    // Symmetric 4x4 matrix of the area weighted sum of squared distances to planes
+    struct Quadric
+    {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+        double b2 = 0.0, bc = 0.0, bd = 0.0;
+        double c2 = 0.0, cd = 0.0;
+        double d2 = 0.0;
+        double weight = 0.0;
+
+        void AddPlane(double a, double b, double c, double d, double w)
+        {
+            a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+            b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+            c2 += w * c * c; cd += w * c * d;
+            d2 += w * d * d;
+            weight += w;
+        }
+
+        void Add(const Quadric & q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+            weight += q.weight;
+        }
+
+        /**
+         * Mean squared distance to the planes
+         */
+        double Evaluate(const Ogre::Vector3 & p) const
+        {
+            const double x = p.x, y = p.y, z = p.z;
+            const double error = x * x * a2 + y * y * b2 + z * z * c2 + 2.0 * (x * y * ab + x * z * ac + y * z * bc + x * ad + y * bd + z * cd) + d2;
+            return (weight > 0.0) ? std::max(error / weight, 0.0) : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t versionFrom;
+        uint32_t versionTo;
+
+        bool operator > (const Collapse & other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    static Ogre::Vector3 TriangleNormal(const Ogre::Vector3 & p0, const Ogre::Vector3 & p1, const Ogre::Vector3 & p2)
+    {
+        return (p1 - p0).crossProduct(p2 - p0);
+    }
+
+    /**
+     * Assigns the same number to vertexes which compare equal, the number is the first vertex of the group
+     */
+    template <typename _Less, typename _Equal>
+    static std::vector<uint32_t> GroupVertexes(uint32_t vertexesCount, _Less less, _Equal equal)
+    {
+        std::vector<uint32_t> order(vertexesCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), less);
+        std::vector<uint32_t> groups(vertexesCount);
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            groups[order[i]] = (i > 0 && equal(order[i - 1], order[i])) ? groups[order[i - 1]] : order[i];
+        }
+        return groups;
+    }
+
+public:
+    /**
+     * Simplifies welded indexes down to each of the triangle counts in targets (descending), one index list per target.
+     * A list can have more triangles than its target, if no more collapses are possible below maxError; errors receive the error of each list.
+     */
+    static std::vector<std::vector<uint32_t>> Simplify(const std::vector<uint32_t> & indexes, const std::vector<Ogre::Vector3> & positions, const std::vector<bool> & locked,
+        const std::vector<uint32_t> & targets, float maxError, std::vector<float> & errors)
+    {
+        const uint32_t vertexesCount = static_cast<uint32_t>(positions.size());
+        const uint32_t trianglesCount = static_cast<uint32_t>(indexes.size() / 3);
+        std::vector<uint32_t> triangles(indexes.begin(), indexes.begin() + 3 * trianglesCount);
+        std::vector<bool> triangleRemoved(trianglesCount, false);
+
+        std::vector<Quadric> quadrics(vertexesCount);
+        std::vector<std::vector<uint32_t>> vertexTriangles(vertexesCount);
+        for (uint32_t t = 0; t < trianglesCount; ++t) {
+            const uint32_t* tri = &triangles[3 * t];
+            Ogre::Vector3 n = TriangleNormal(positions[tri[0]], positions[tri[1]], positions[tri[2]]);
+            const float area = 0.5f * n.normalise();
+            if (area > 0.0f) {
+                const double d = -n.dotProduct(positions[tri[0]]);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    quadrics[tri[k]].AddPlane(n.x, n.y, n.z, d, area);
+                }
+            }
+            for (uint32_t k = 0; k < 3; ++k) {
+                vertexTriangles[tri[k]].push_back(t);
+            }
+        }
+
+        std::vector<uint32_t> versions(vertexesCount, 0);
+        std::vector<bool> vertexRemoved(vertexesCount, false);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        auto push = [&](uint32_t from, uint32_t to) {
+            if (!locked[from] && from != to) {
+                Quadric q = quadrics[from];
+                q.Add(quadrics[to]);
+                queue.push(Collapse{ q.Evaluate(positions[to]), from, to, versions[from], versions[to] });
+            }
+        };
+        for (uint32_t t = 0; t < trianglesCount; ++t) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                push(triangles[3 * t + k], triangles[3 * t + (k + 1) % 3]);
+                push(triangles[3 * t + (k + 1) % 3], triangles[3 * t + k]);
+            }
+        }
+
+        // Neighbours are marked with the current stamp, so the marks don't need clearing
+        std::vector<uint32_t> marks(vertexesCount, 0);
+        uint32_t stamp = 0;
+        std::vector<uint32_t> neighbours;
+        auto collectNeighbours = [&](uint32_t v) {
+            neighbours.clear();
+            for (uint32_t t : vertexTriangles[v]) {
+                if (!triangleRemoved[t]) {
+                    for (uint32_t k = 0; k < 3; ++k) {
+                        const uint32_t w = triangles[3 * t + k];
+                        if (w != v && marks[w] != stamp) {
+                            marks[w] = stamp;
+                            neighbours.push_back(w);
+                        }
+                    }
+                }
+            }
+        };
+
+        auto isValid = [&](const Collapse & collapse) {
+            const uint32_t from = collapse.from, to = collapse.to;
+            if (vertexRemoved[from] || vertexRemoved[to] || versions[from] != collapse.versionFrom || versions[to] != collapse.versionTo) {
+                return false;
+            }
+            // Link condition: the edge must exist and the end points may share only the two vertexes opposite to it
+            ++stamp;
+            collectNeighbours(from);
+            if (marks[to] != stamp) {
+                return false;
+            }
+            const uint32_t stampFrom = stamp;
+            ++stamp;
+            uint32_t common = 0;
+            for (uint32_t t : vertexTriangles[to]) {
+                if (!triangleRemoved[t]) {
+                    for (uint32_t k = 0; k < 3; ++k) {
+                        const uint32_t w = triangles[3 * t + k];
+                        if (w != to && w != from && marks[w] == stampFrom) {
+                            marks[w] = stamp;
+                            ++common;
+                        }
+                    }
+                }
+            }
+            if (common > 2) {
+                return false;
+            }
+            // Remaining triangles of 'from' must not flip or degenerate
+            for (uint32_t t : vertexTriangles[from]) {
+                const uint32_t* tri = &triangles[3 * t];
+                if (triangleRemoved[t] || tri[0] == to || tri[1] == to || tri[2] == to) {
+                    continue;
+                }
+                Ogre::Vector3 p[3] = { positions[tri[0]], positions[tri[1]], positions[tri[2]] };
+                const Ogre::Vector3 before = TriangleNormal(p[0], p[1], p[2]);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    if (tri[k] == from) {
+                        p[k] = positions[to];
+                    }
+                }
+                const Ogre::Vector3 after = TriangleNormal(p[0], p[1], p[2]);
+                // Normals may turn by up to ~75 degrees, beyond that the surface starts to fold
+                if (before.dotProduct(after) <= 0.25f * before.length() * after.length() || after.squaredLength() <= 1e-6f * before.squaredLength()) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        std::vector<std::vector<uint32_t>> results;
+        errors.clear();
+        uint32_t aliveTriangles = trianglesCount;
+        double maxCost = 0.0;
+        for (uint32_t target : targets) {
+            while (aliveTriangles > target && !queue.empty()) {
+                const Collapse collapse = queue.top();
+                queue.pop();
+                if (!isValid(collapse)) {
+                    continue;
+                }
+                if (collapse.cost > static_cast<double>(maxError) * maxError) {
+                    // The cheapest collapse is too coarse, so are all the next ones
+                    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>().swap(queue);
+                    break;
+                }
+                const uint32_t from = collapse.from, to = collapse.to;
+                for (uint32_t t : vertexTriangles[from]) {
+                    if (triangleRemoved[t]) {
+                        continue;
+                    }
+                    uint32_t* tri = &triangles[3 * t];
+                    if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                        triangleRemoved[t] = true;
+                        --aliveTriangles;
+                    }
+                    else {
+                        std::replace(tri, tri + 3, from, to);
+                        vertexTriangles[to].push_back(t);
+                    }
+                }
+                vertexTriangles[from].clear();
+                vertexRemoved[from] = true;
+                quadrics[to].Add(quadrics[from]);
+                ++versions[to];
+                maxCost = std::max(maxCost, collapse.cost);
+
+                ++stamp;
+                collectNeighbours(to);
+                for (uint32_t w : neighbours) {
+                    push(to, w);
+                    push(w, to);
+                }
+            }
+
+            std::vector<uint32_t> result;
+            result.reserve(3 * aliveTriangles);
+            for (uint32_t t = 0; t < trianglesCount; ++t) {
+                if (!triangleRemoved[t]) {
+                    result.insert(result.end(), &triangles[3 * t], &triangles[3 * t] + 3);
+                }
+            }
+            results.push_back(std::move(result));
+            errors.push_back(static_cast<float>(std::sqrt(maxCost)));
+        }
+        return results;
+    }
+
+    /**
+     * Appends up to lodsCount - 1 simplified levels to the indexes of the mesh, each with about ratio of the triangles of the previous one.
+     * Returns the LOD table for the index buffer, LOD 0 is the original mesh. Errors in the table and maxError are relative to the bounding box diagonal.
+     */
+    template <typename _Vertex>
+    static std::vector<MeshFileLod> GenerateLods(IndexedMesh<_Vertex> & mesh, uint32_t lodsCount, float ratio = 0.5f, float maxError = 0.05f, uint32_t minTrianglesCount = 32)
+    {
+        const uint32_t vertexesCount = static_cast<uint32_t>(mesh.vertexes.size());
+        const std::vector<uint32_t> original = mesh.GetIndexes();
+        std::vector<MeshFileLod> lods;
+        lods.push_back(MeshFileLod{ 0, static_cast<uint32_t>(original.size()), 0.0f, 0 });
+        if (lodsCount < 2 || vertexesCount == 0) {
+            return lods;
+        }
+
+        std::vector<Ogre::Vector3> positions(vertexesCount);
+        Ogre::Vector3 boxMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        Ogre::Vector3 boxMax(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            const auto & p = mesh.vertexes[i].position;
+            positions[i] = Ogre::Vector3(p.x, p.y, p.z);
+            boxMin.makeFloor(positions[i]);
+            boxMax.makeCeil(positions[i]);
+        }
+        const float diagonal = std::max((boxMax - boxMin).length(), std::numeric_limits<float>::min());
+
+        // Bitwise equal vertexes are the same vertex, equal positions with different attributes are a seam
+        const std::vector<uint32_t> welded = GroupVertexes(vertexesCount,
+            [&](uint32_t a, uint32_t b) { return std::memcmp(&mesh.vertexes[a], &mesh.vertexes[b], sizeof(_Vertex)) < 0; },
+            [&](uint32_t a, uint32_t b) { return std::memcmp(&mesh.vertexes[a], &mesh.vertexes[b], sizeof(_Vertex)) == 0; });
+        const std::vector<uint32_t> samePosition = GroupVertexes(vertexesCount,
+            [&](uint32_t a, uint32_t b) { return std::make_tuple(positions[a].x, positions[a].y, positions[a].z) < std::make_tuple(positions[b].x, positions[b].y, positions[b].z); },
+            [&](uint32_t a, uint32_t b) { return positions[a] == positions[b]; });
+
+        std::vector<bool> locked(vertexesCount, false);
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            if (welded[i] != welded[samePosition[i]]) {
+                locked[welded[i]] = true;
+                locked[welded[samePosition[i]]] = true;
+            }
+        }
+
+        std::vector<uint32_t> indexes(original.size());
+        for (size_t i = 0; i < original.size(); ++i) {
+            indexes[i] = welded[original[i]];
+        }
+
+        // Edges between positions used by one triangle are borders, used by more than two are non-manifold
+        std::vector<std::pair<uint64_t, uint32_t>> edges;
+        edges.reserve(indexes.size());
+        for (size_t t = 0; t + 2 < indexes.size(); t += 3) {
+            for (uint32_t k = 0; k < 3; ++k) {
+                const uint64_t a = samePosition[indexes[t + k]], b = samePosition[indexes[t + (k + 1) % 3]];
+                edges.emplace_back((std::min(a, b) << 32) | std::max(a, b), 1);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        std::vector<bool> borderPositions(vertexesCount, false);
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j].first == edges[i].first) {
+                ++j;
+            }
+            if (j - i != 2) {
+                borderPositions[static_cast<uint32_t>(edges[i].first >> 32)] = true;
+                borderPositions[static_cast<uint32_t>(edges[i].first & 0xFFFFFFFFu)] = true;
+            }
+            i = j;
+        }
+        for (uint32_t i = 0; i < vertexesCount; ++i) {
+            if (borderPositions[samePosition[i]]) {
+                locked[welded[i]] = true;
+            }
+        }
+
+        std::vector<uint32_t> targets;
+        for (uint32_t triangles = static_cast<uint32_t>(original.size() / 3); targets.size() + 1 < lodsCount; ) {
+            triangles = static_cast<uint32_t>(triangles * ratio);
+            if (triangles < minTrianglesCount) {
+                break;
+            }
+            targets.push_back(triangles);
+        }
+
+        std::vector<float> errors;
+        const std::vector<std::vector<uint32_t>> levels = Simplify(indexes, positions, locked, targets, maxError * diagonal, errors);
+
+        std::vector<uint32_t> allIndexes = original;
+        for (size_t i = 0; i < levels.size(); ++i) {
+            // Levels which failed to get noticeably smaller are not worth switching to
+            if (levels[i].size() > lods.back().indexesCount * 9 / 10) {
+                break;
+            }
+            const std::vector<uint32_t> level = MeshOptimizer::OptimizeVertexCache(levels[i], vertexesCount);
+            lods.push_back(MeshFileLod{ static_cast<uint32_t>(allIndexes.size()), static_cast<uint32_t>(level.size()), errors[i] / diagonal, 0 });
+            allIndexes.insert(allIndexes.end(), level.begin(), level.end());
+        }
+        mesh.SetIndexes(allIndexes);
+        return lods;
+    }
+
+    /**
+     * Picks the coarsest level whose error projects to at most pixelError pixels.
+     * meshSize is the bounding box diagonal of the mesh in view space units, distance is from the eye to the mesh center,
+     * projectionScale is the [1][1] element of the projection matrix (cot(fov / 2) for MakePerspectiveProjectionMatrix).
+     */
+    static uint32_t SelectLod(const std::vector<MeshFileLod> & lods, float meshSize, float distance, float projectionScale, float viewportHeight, float pixelError)
+    {
+        if (distance <= 0.0f) {
+            return 0;
+        }
+        const float pixelsPerUnit = 0.5f * viewportHeight * projectionScale / distance;
+        for (uint32_t i = static_cast<uint32_t>(lods.size()); i-- > 1; ) {
+            if (lods[i].error * meshSize * pixelsPerUnit <= pixelError) {
+                return i;
+            }
+        }
+        return 0;
+    }
+};
+
+#endif
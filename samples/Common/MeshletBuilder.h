@@ -0,0 +1,223 @@
+/**
+* Vulkan samples
+*
+* Splitting of indexed meshes into small clusters of triangles with bounds for GPU culling
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _MESHLET_BUILDER_H_
+#define _MESHLET_BUILDER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "MeshBuilder.h"
+#include "math/OgreVector3.h"
+#include "math/OgreVector4.h"
+
+/**
+ * Cluster of triangles, a contiguous range of the index buffer. The layout matches std430 of the culling shaders.
+ * The cone bounds the normals of the triangles (right-handed, (p1 - p0) x (p2 - p0)): all triangles face away from an eye at e if
+ *   dot(center - e, axis) >= cutoff * length(center - e) + radius
+ * A cutoff of 1 or more means the normals are too spread and the cluster is never culled by the cone.
+ */
+struct Meshlet
+{
+    Ogre::Vector4 sphere;   // center, radius
+    Ogre::Vector4 cone;     // axis, cutoff
+    uint32_t firstIndex;
+    uint32_t indexesCount;
+    uint32_t vertexesCount;
+    uint32_t reserved;
+};
+
+/**
+ * Greedy clustering: a meshlet grows by the triangle which adds the least new vertexes among the triangles touching it, the closest one on ties,
+ * and starts from the next free triangle of the index order when it is full or has no free neighbours.
+ * Indexes are not remapped to local ones, meshlets are drawn as ranges of the original index buffer.
+ */
+class MeshletBuilder
+{
+    static Ogre::Vector3 Centroid(const std::vector<uint32_t> & indexes, const std::vector<Ogre::Vector3> & positions, uint32_t triangle)
+    {
+        return (positions[indexes[3 * triangle]] + positions[indexes[3 * triangle + 1]] + positions[indexes[3 * triangle + 2]]) * (1.0f / 3.0f);
+    }
+
+public:
+    static const uint32_t MAX_VERTEXES = 64;
+    static const uint32_t MAX_TRIANGLES = 124;
+
+    /**
+     * Reorders the triangles of indexes meshlet by meshlet and returns the meshlets
+     */
+    static std::vector<Meshlet> Build(std::vector<uint32_t> & indexes, const std::vector<Ogre::Vector3> & positions,
+        uint32_t maxVertexes = MAX_VERTEXES, uint32_t maxTriangles = MAX_TRIANGLES)
+    {
+        const uint32_t vertexesCount = static_cast<uint32_t>(positions.size());
+        const uint32_t trianglesCount = static_cast<uint32_t>(indexes.size() / 3);
+
+        // Triangles around each vertex
+        std::vector<uint32_t> adjacencyOffsets(vertexesCount + 1, 0);
+        for (size_t i = 0; i < 3 * static_cast<size_t>(trianglesCount); ++i) {
+            ++adjacencyOffsets[indexes[i] + 1];
+        }
+        for (uint32_t v = 0; v < vertexesCount; ++v) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        std::vector<uint32_t> adjacency(adjacencyOffsets.back());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (uint32_t t = 0; t < trianglesCount; ++t) {
+                for (uint32_t k = 0; k < 3; ++k) {
+                    adjacency[fill[indexes[3 * t + k]]++] = t;
+                }
+            }
+        }
+
+        std::vector<bool> emitted(trianglesCount, false);
+        // Vertexes of the current meshlet are marked with its number + 1
+        std::vector<uint32_t> vertexMeshlet(vertexesCount, 0);
+        std::vector<uint32_t> meshletVertexes;
+        std::vector<uint32_t> meshletTriangles;
+        std::vector<uint32_t> result;
+        result.reserve(indexes.size());
+        std::vector<Meshlet> meshlets;
+
+        auto newVertexes = [&](uint32_t t, uint32_t mark) {
+            uint32_t count = 0;
+            for (uint32_t k = 0; k < 3; ++k) {
+                count += (vertexMeshlet[indexes[3 * t + k]] != mark) ? 1 : 0;
+            }
+            return count;
+        };
+
+        uint32_t nextSeed = 0;
+        while (nextSeed < trianglesCount) {
+            if (emitted[nextSeed]) {
+                ++nextSeed;
+                continue;
+            }
+            const uint32_t mark = static_cast<uint32_t>(meshlets.size()) + 1;
+            meshletVertexes.clear();
+            meshletTriangles.clear();
+            Ogre::Vector3 centroidsSum(0.0f, 0.0f, 0.0f);
+
+            uint32_t triangle = nextSeed;
+            while (triangle != std::numeric_limits<uint32_t>::max()) {
+                emitted[triangle] = true;
+                meshletTriangles.push_back(triangle);
+                centroidsSum += Centroid(indexes, positions, triangle);
+                for (uint32_t k = 0; k < 3; ++k) {
+                    const uint32_t v = indexes[3 * triangle + k];
+                    if (vertexMeshlet[v] != mark) {
+                        vertexMeshlet[v] = mark;
+                        meshletVertexes.push_back(v);
+                    }
+                }
+                if (meshletTriangles.size() >= maxTriangles) {
+                    break;
+                }
+
+                // The best free neighbour, ties go to the triangle closest to the center to keep the meshlet round
+                const Ogre::Vector3 center = centroidsSum * (1.0f / meshletTriangles.size());
+                triangle = std::numeric_limits<uint32_t>::max();
+                uint32_t bestCost = 4;
+                float bestDistance = std::numeric_limits<float>::max();
+                for (uint32_t v : meshletVertexes) {
+                    for (uint32_t i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; ++i) {
+                        const uint32_t t = adjacency[i];
+                        if (emitted[t]) {
+                            continue;
+                        }
+                        const uint32_t cost = newVertexes(t, mark);
+                        if (meshletVertexes.size() + cost > maxVertexes || cost > bestCost) {
+                            continue;
+                        }
+                        const float distance = (Centroid(indexes, positions, t) - center).squaredLength();
+                        if (cost < bestCost || distance < bestDistance) {
+                            bestCost = cost;
+                            bestDistance = distance;
+                            triangle = t;
+                        }
+                    }
+                }
+            }
+
+            Meshlet meshlet;
+            meshlet.firstIndex = static_cast<uint32_t>(result.size());
+            meshlet.indexesCount = static_cast<uint32_t>(3 * meshletTriangles.size());
+            meshlet.vertexesCount = static_cast<uint32_t>(meshletVertexes.size());
+            meshlet.reserved = 0;
+            for (uint32_t t : meshletTriangles) {
+                result.insert(result.end(), &indexes[3 * t], &indexes[3 * t] + 3);
+            }
+            ComputeBounds(meshlet, result, positions, meshletVertexes);
+            meshlets.push_back(meshlet);
+        }
+
+        indexes.swap(result);
+        return meshlets;
+    }
+
+    /**
+     * Bounding sphere around the box of the vertexes and the cone of the triangle normals
+     */
+    static void ComputeBounds(Meshlet & meshlet, const std::vector<uint32_t> & indexes, const std::vector<Ogre::Vector3> & positions, const std::vector<uint32_t> & vertexes)
+    {
+        Ogre::Vector3 boxMin = positions[vertexes[0]];
+        Ogre::Vector3 boxMax = positions[vertexes[0]];
+        for (uint32_t v : vertexes) {
+            boxMin.makeFloor(positions[v]);
+            boxMax.makeCeil(positions[v]);
+        }
+        const Ogre::Vector3 center = (boxMin + boxMax) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t v : vertexes) {
+            radius = std::max(radius, (positions[v] - center).length());
+        }
+        meshlet.sphere = Ogre::Vector4(center.x, center.y, center.z, radius);
+
+        std::vector<Ogre::Vector3> normals;
+        normals.reserve(meshlet.indexesCount / 3);
+        Ogre::Vector3 axis(0.0f, 0.0f, 0.0f);
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexesCount; i += 3) {
+            const Ogre::Vector3 & p0 = positions[indexes[i]];
+            Ogre::Vector3 n = (positions[indexes[i + 1]] - p0).crossProduct(positions[indexes[i + 2]] - p0);
+            if (n.normalise() > 0.0f) {
+                normals.push_back(n);
+                axis += n;
+            }
+        }
+        float minDot = -1.0f;
+        if (axis.normalise() > 0.0f) {
+            minDot = 1.0f;
+            for (const auto & n : normals) {
+                minDot = std::min(minDot, n.dotProduct(axis));
+            }
+        }
+        // Cone half angle is acos(minDot), the test compares with its sine; 90 degrees and wider can't be culled
+        const float cutoff = (minDot > 0.0f) ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+        meshlet.cone = Ogre::Vector4(axis.x, axis.y, axis.z, cutoff);
+    }
+
+    template <typename _Vertex>
+    static std::vector<Meshlet> Build(IndexedMesh<_Vertex> & mesh, uint32_t maxVertexes = MAX_VERTEXES, uint32_t maxTriangles = MAX_TRIANGLES)
+    {
+        std::vector<Ogre::Vector3> positions(mesh.vertexes.size());
+        for (size_t i = 0; i < mesh.vertexes.size(); ++i) {
+            const auto & p = mesh.vertexes[i].position;
+            positions[i] = Ogre::Vector3(p.x, p.y, p.z);
+        }
+        std::vector<uint32_t> indexes = mesh.GetIndexes();
+        std::vector<Meshlet> meshlets = Build(indexes, positions, maxVertexes, maxTriangles);
+        mesh.SetIndexes(indexes);
+        return meshlets;
+    }
+};
+
+#endif
@@ -0,0 +1,247 @@
+/**
+* Vulkan samples
+*
+* Parallel recording of secondary command buffers with per-thread command pools
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _PARALLEL_RECORDER_H_
+#define _PARALLEL_RECORDER_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "VulkanUtility.h"
+
+/**
+ * Splits a draw list into contiguous slices and records each slice into a secondary command buffer on its own thread.
+ * Command pools are externally synchronized, so every thread owns a pool, and every pool owns one secondary buffer per swapchain image.
+ * The calling thread records the first slice, the rest is recorded by persistent worker threads.
+ * Secondary buffers inherit the render pass only: each slice has to bind pipelines, descriptor sets, buffers and dynamic state itself.
+ * Returned buffers are executed from the primary in order with executeCommands(), so the draw order of the list is kept.
+ */
+class ParallelRecorder
+{
+public:
+    /**
+     * Records items [begin, end) of the draw list
+     */
+    using RecordFunction = std::function<void(vk::CommandBuffer & cmdBuffer, uint32_t begin, uint32_t end)>;
+
+private:
+    vk::Device mDevice;
+    std::vector<vk::CommandPool> mPools;
+    std::vector<std::vector<vk::CommandBuffer>> mBuffers; // [thread][image]
+    std::vector<vk::CommandBuffer> mRecorded;
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    uint64_t mGeneration = 0;
+    uint32_t mPending = 0;
+    bool mStop = false;
+    std::exception_ptr mError;
+
+    // The current job
+    const RecordFunction* mRecord = nullptr;
+    const vk::CommandBufferInheritanceInfo* mInheritance = nullptr;
+    uint32_t mImageIndex = 0;
+    uint32_t mCount = 0;
+    uint32_t mSlices = 0;
+
+    void RecordSlice(uint32_t slice)
+    {
+        const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(mCount) * slice / mSlices);
+        const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(mCount) * (slice + 1) / mSlices);
+
+        vk::CommandBufferBeginInfo beginInfo;
+        beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+        beginInfo.setPInheritanceInfo(mInheritance);
+
+        vk::CommandBuffer & cmdBuffer = mBuffers[slice][mImageIndex];
+        cmdBuffer.begin(beginInfo);
+        (*mRecord)(cmdBuffer, begin, end);
+        cmdBuffer.end();
+    }
+
+    /**
+     * Waits for jobs newer than generation, the one current when the worker was started
+     */
+    void WorkerLoop(uint32_t slice, uint64_t generation)
+    {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mStart.wait(lock, [&] { return mStop || mGeneration != generation; });
+                if (mStop) {
+                    return;
+                }
+                generation = mGeneration;
+                if (slice >= mSlices) {
+                    continue;
+                }
+            }
+            std::exception_ptr error;
+            try {
+                RecordSlice(slice);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(mMutex);
+            if (error && !mError) {
+                mError = error;
+            }
+            if (--mPending == 0) {
+                mDone.notify_one();
+            }
+        }
+    }
+
+public:
+    ParallelRecorder() = default;
+
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    ~ParallelRecorder()
+    {
+        Destroy();
+    }
+
+    /**
+     * Creates a pool and imagesCount secondary buffers for each of threads, starts threads - 1 workers
+     */
+    void Init(vk::Device device, uint32_t queueFamily, uint32_t imagesCount, uint32_t threads)
+    {
+        Destroy();
+        mDevice = device;
+        threads = std::max(threads, 1u);
+
+        vk::CommandPoolCreateInfo poolInfo;
+        poolInfo.setQueueFamilyIndex(queueFamily);
+        poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+
+        for (uint32_t t = 0; t < threads; ++t) {
+            mPools.push_back(mDevice.createCommandPool(poolInfo));
+
+            vk::CommandBufferAllocateInfo allocateInfo;
+            allocateInfo.setCommandPool(mPools.back());
+            allocateInfo.setLevel(vk::CommandBufferLevel::eSecondary);
+            allocateInfo.setCommandBufferCount(imagesCount);
+
+            mBuffers.emplace_back(imagesCount);
+            if (vk::Result::eSuccess != mDevice.allocateCommandBuffers(&allocateInfo, &mBuffers.back()[0])) {
+                throw std::runtime_error("ParallelRecorder: failed to allocate secondary command buffers");
+            }
+        }
+
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStop = false;
+            generation = mGeneration;
+        }
+        for (uint32_t t = 1; t < threads; ++t) {
+            mWorkers.emplace_back(&ParallelRecorder::WorkerLoop, this, t, generation);
+        }
+    }
+
+    /**
+     * Stops workers and frees pools with their buffers. The buffers must not be in use by device
+     */
+    void Destroy()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mStart.notify_all();
+        for (auto & worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+        {
+            // Nothing of the last job may be picked up by workers of the next Init()
+            std::unique_lock<std::mutex> lock(mMutex);
+            mGeneration = 0;
+            mPending = 0;
+            mSlices = 0;
+            mRecord = nullptr;
+            mInheritance = nullptr;
+        }
+        for (auto & pool : mPools) {
+            mDevice.destroyCommandPool(pool);
+        }
+        mPools.clear();
+        mBuffers.clear();
+        mRecorded.clear();
+    }
+
+    uint32_t GetThreadsCount() const
+    {
+        return static_cast<uint32_t>(mPools.size());
+    }
+
+    /**
+     * Records count items into min(threads, count) secondary buffers of the swapchain image imageIndex and returns them in the draw order
+     * The buffers of this image must not be pending execution, e.g. its fence was waited for
+     */
+    const std::vector<vk::CommandBuffer> & Record(uint32_t imageIndex, const vk::CommandBufferInheritanceInfo & inheritance, uint32_t count, const RecordFunction & record)
+    {
+        if (mPools.empty()) {
+            throw std::runtime_error("ParallelRecorder: not initialized");
+        }
+        const uint32_t slices = std::max(std::min(GetThreadsCount(), count), 1u);
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mRecord = &record;
+            mInheritance = &inheritance;
+            mImageIndex = imageIndex;
+            mCount = count;
+            mSlices = slices;
+            mPending = slices - 1;
+            mError = nullptr;
+            ++mGeneration;
+        }
+        if (slices > 1) {
+            mStart.notify_all();
+        }
+
+        std::exception_ptr error;
+        try {
+            RecordSlice(0);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mDone.wait(lock, [this] { return mPending == 0; });
+            if (!error) {
+                error = mError;
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        mRecorded.clear();
+        for (uint32_t slice = 0; slice < slices; ++slice) {
+            mRecorded.push_back(mBuffers[slice][imageIndex]);
+        }
+        return mRecorded;
+    }
+};
+
+#endif
@@ -0,0 +1,420 @@
+/**
+* Vulkan samples
+*
+* Frame graph: passes declare used images, the graph orders passes, inserts barriers and aliases memory of transient images
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _RENDER_GRAPH_H_
+#define _RENDER_GRAPH_H_
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "VulkanUtility.h"
+#include "ResourceStateTracker.h"
+
+/**
+ * Images are either imported (owned outside, their state is set in the tracker by the owner) or created by the graph.
+ * Created transient images don't keep contents between executions, images whose lifetimes (from the first to the last pass
+ * using them in the execution order) don't overlap share memory. Persistent images get own memory.
+ *
+ * Passes are ordered by levels: a pass depends on all previously declared passes sharing an image with it, if one of them writes
+ * or changes the layout. Passes of the same level are independent and could be submitted to different queues.
+ * Disabled passes are skipped by Execute(), but images get memory as if all passes run, so passes can be switched without Compile().
+ *
+ * Usage: ImportImage() / CreateImage(), AddPass(), Compile(), GetImage() to make views, Execute() per frame.
+ */
+class RenderGraph
+{
+public:
+    using ResourceId = uint32_t;
+    using PassId = uint32_t;
+    using RecordFunction = std::function<void(const vk::CommandBuffer &)>;
+
+    struct ImageUse
+    {
+        ResourceId image;
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        vk::ImageLayout layout;
+    };
+
+private:
+    static const uint32_t NO_USE = std::numeric_limits<uint32_t>::max();
+
+    struct Image
+    {
+        vk::Image image;
+        vk::ImageCreateInfo info;
+        bool created = false;
+        bool transient = false;
+        bool registered = false;     // persistent image is known to the tracker
+
+        vk::MemoryRequirements requirements;
+        uint32_t memoryType = 0;
+        vk::DeviceSize offset = 0;
+        uint32_t firstUse = NO_USE;  // positions in the execution order
+        uint32_t lastUse = 0;
+
+        // Uses of the images sharing memory, the first use in each execution waits for them
+        vk::PipelineStageFlags aliasStages;
+        vk::AccessFlags aliasAccess;
+        uint64_t lastExecution = 0;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<ImageUse> uses;
+        RecordFunction record;
+        bool enabled = true;
+        uint32_t level = 0;
+    };
+
+    vk::Device mDevice;
+    std::vector<Image> mImages;
+    std::vector<Pass> mPasses;
+    std::vector<PassId> mOrder;
+    bool mCompiled = false;
+    uint64_t mExecution = 1;
+
+    std::vector<VulkanHolder<vk::Image>> mImageHolders;
+    std::vector<VulkanHolder<vk::DeviceMemory>> mMemory;
+    vk::DeviceSize mTransientMemorySize = 0;
+    vk::DeviceSize mUnaliasedMemorySize = 0;
+
+    static bool Writes(const ImageUse & use)
+    {
+        return static_cast<bool>(use.access & (vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+            vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite));
+    }
+
+    static bool DependsOn(const Pass & pass, const Pass & previous)
+    {
+        for (const auto & use : pass.uses) {
+            for (const auto & prevUse : previous.uses) {
+                if (use.image == prevUse.image && (Writes(use) || Writes(prevUse) || use.layout != prevUse.layout)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void CheckNotCompiled() const
+    {
+        if (mCompiled) {
+            throw std::runtime_error("RenderGraph: graph is already compiled");
+        }
+    }
+
+    void OrderPasses()
+    {
+        for (PassId pass = 0; pass < mPasses.size(); ++pass) {
+            for (PassId previous = 0; previous < pass; ++previous) {
+                if (DependsOn(mPasses[pass], mPasses[previous])) {
+                    mPasses[pass].level = std::max(mPasses[pass].level, mPasses[previous].level + 1);
+                }
+            }
+        }
+        mOrder.resize(mPasses.size());
+        for (PassId pass = 0; pass < mPasses.size(); ++pass) {
+            mOrder[pass] = pass;
+        }
+        std::stable_sort(mOrder.begin(), mOrder.end(), [this](PassId lhs, PassId rhs) { return mPasses[lhs].level < mPasses[rhs].level; });
+
+        for (uint32_t position = 0; position < mOrder.size(); ++position) {
+            for (const auto & use : mPasses[mOrder[position]].uses) {
+                Image & image = mImages[use.image];
+                image.firstUse = std::min(image.firstUse, position);
+                image.lastUse = std::max(image.lastUse, position);
+            }
+        }
+    }
+
+    uint32_t FindMemoryType(const vk::PhysicalDevice & physicalDevice, uint32_t memoryTypeBits) const
+    {
+        vk::PhysicalDeviceMemoryProperties memroProperties = physicalDevice.getMemoryProperties();
+        for (uint32_t i = 0; i < memroProperties.memoryTypeCount; ++i) {
+            if ((memoryTypeBits & (1 << i)) && (memroProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+                return i;
+            }
+        }
+        throw std::runtime_error("RenderGraph: Failed to find memory type for image");
+    }
+
+    vk::DeviceMemory Allocate(vk::DeviceSize size, uint32_t memoryType)
+    {
+        vk::MemoryAllocateInfo allocateInfo;
+        allocateInfo.setAllocationSize(size);
+        allocateInfo.setMemoryTypeIndex(memoryType);
+        mMemory.push_back(MakeHolder(mDevice.allocateMemory(allocateInfo), [this](vk::DeviceMemory & memory) { mDevice.freeMemory(memory); }));
+        return mMemory.back();
+    }
+
+    static bool LifetimesOverlap(const Image & lhs, const Image & rhs)
+    {
+        if (lhs.firstUse == NO_USE || rhs.firstUse == NO_USE) {
+            return false;
+        }
+        return lhs.firstUse <= rhs.lastUse && rhs.firstUse <= lhs.lastUse;
+    }
+
+    static bool MemoryOverlaps(const Image & lhs, const Image & rhs)
+    {
+        return lhs.memoryType == rhs.memoryType && lhs.offset < rhs.offset + rhs.requirements.size && rhs.offset < lhs.offset + lhs.requirements.size;
+    }
+
+    /**
+     * Greedy placement from the largest image: the lowest offset which doesn't intersect placed images with overlapping lifetimes
+     */
+    void PlaceTransients()
+    {
+        std::vector<ResourceId> transients;
+        for (ResourceId id = 0; id < mImages.size(); ++id) {
+            if (mImages[id].transient) {
+                transients.push_back(id);
+                mUnaliasedMemorySize += mImages[id].requirements.size;
+            }
+        }
+        std::stable_sort(transients.begin(), transients.end(), [this](ResourceId lhs, ResourceId rhs) { return mImages[lhs].requirements.size > mImages[rhs].requirements.size; });
+
+        std::vector<ResourceId> placed;
+        std::vector<std::pair<uint32_t, vk::DeviceSize>> heapSizes; // memory type, size
+        for (ResourceId id : transients) {
+            Image & image = mImages[id];
+
+            std::vector<const Image*> conflicts;
+            for (ResourceId other : placed) {
+                if (mImages[other].memoryType == image.memoryType && LifetimesOverlap(image, mImages[other])) {
+                    conflicts.push_back(&mImages[other]);
+                }
+            }
+            std::sort(conflicts.begin(), conflicts.end(), [](const Image* lhs, const Image* rhs) { return lhs->offset < rhs->offset; });
+
+            vk::DeviceSize offset = 0;
+            for (const Image* conflict : conflicts) {
+                if (offset + image.requirements.size <= conflict->offset) {
+                    break;
+                }
+                offset = std::max(offset, AlignUp(conflict->offset + conflict->requirements.size, image.requirements.alignment));
+            }
+            image.offset = offset;
+            placed.push_back(id);
+
+            auto heap = std::find_if(heapSizes.begin(), heapSizes.end(), [&image](const std::pair<uint32_t, vk::DeviceSize> & h) { return h.first == image.memoryType; });
+            if (heap == heapSizes.end()) {
+                heapSizes.emplace_back(image.memoryType, 0);
+                heap = heapSizes.end() - 1;
+            }
+            heap->second = std::max(heap->second, offset + image.requirements.size);
+        }
+
+        for (const auto & heap : heapSizes) {
+            const vk::DeviceMemory memory = Allocate(heap.second, heap.first);
+            mTransientMemorySize += heap.second;
+            for (ResourceId id : transients) {
+                if (mImages[id].memoryType == heap.first) {
+                    mDevice.bindImageMemory(mImages[id].image, memory, mImages[id].offset);
+                }
+            }
+        }
+
+        for (ResourceId id : transients) {
+            for (ResourceId other : transients) {
+                if (other != id && MemoryOverlaps(mImages[id], mImages[other])) {
+                    for (const auto & pass : mPasses) {
+                        for (const auto & use : pass.uses) {
+                            if (use.image == other) {
+                                mImages[id].aliasStages |= use.stages;
+                                mImages[id].aliasAccess |= use.access & (vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite |
+                                    vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eTransferWrite);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    /**
+     * Image owned outside, can be changed every frame, e.g. the acquired swapchain image
+     */
+    ResourceId ImportImage(const vk::Image & image = vk::Image())
+    {
+        CheckNotCompiled();
+        Image imported;
+        imported.image = image;
+        mImages.push_back(imported);
+        return static_cast<ResourceId>(mImages.size() - 1);
+    }
+
+    void SetImportedImage(ResourceId id, const vk::Image & image)
+    {
+        if (mImages.at(id).created) {
+            throw std::runtime_error("RenderGraph: image is not imported");
+        }
+        mImages[id].image = image;
+    }
+
+    /**
+     * Image is created by Compile(), transient ones must have optimal tiling
+     */
+    ResourceId CreateImage(const vk::ImageCreateInfo & info, bool transient = true)
+    {
+        CheckNotCompiled();
+        if (transient && info.tiling != vk::ImageTiling::eOptimal) {
+            throw std::runtime_error("RenderGraph: transient image must have optimal tiling");
+        }
+        Image created;
+        created.info = info;
+        created.info.setInitialLayout(vk::ImageLayout::eUndefined);
+        created.created = true;
+        created.transient = transient;
+        mImages.push_back(created);
+        return static_cast<ResourceId>(mImages.size() - 1);
+    }
+
+    PassId AddPass(const std::string & name, const std::vector<ImageUse> & uses, const RecordFunction & record)
+    {
+        CheckNotCompiled();
+        for (const auto & use : uses) {
+            if (use.image >= mImages.size()) {
+                throw std::runtime_error("RenderGraph: pass '" + name + "' uses unknown image");
+            }
+        }
+        Pass pass;
+        pass.name = name;
+        pass.uses = uses;
+        pass.record = record;
+        mPasses.push_back(pass);
+        return static_cast<PassId>(mPasses.size() - 1);
+    }
+
+    void SetPassEnabled(PassId pass, bool enabled)
+    {
+        mPasses.at(pass).enabled = enabled;
+    }
+
+    /**
+     * Orders passes, creates images and binds memory
+     */
+    void Compile(const vk::Device & device, const vk::PhysicalDevice & physicalDevice)
+    {
+        CheckNotCompiled();
+        mDevice = device;
+
+        OrderPasses();
+
+        for (auto & image : mImages) {
+            if (!image.created) {
+                continue;
+            }
+            mImageHolders.push_back(MakeHolder(mDevice.createImage(image.info), [this](vk::Image & img) { mDevice.destroyImage(img); }));
+            image.image = mImageHolders.back();
+            image.requirements = mDevice.getImageMemoryRequirements(image.image);
+            image.memoryType = FindMemoryType(physicalDevice, image.requirements.memoryTypeBits);
+            if (!image.transient) {
+                mDevice.bindImageMemory(image.image, Allocate(image.requirements.size, image.memoryType), 0);
+            }
+        }
+        PlaceTransients();
+
+        mCompiled = true;
+    }
+
+    vk::Image GetImage(ResourceId id) const
+    {
+        return mImages.at(id).image;
+    }
+
+    /**
+     * Records enabled passes in order, barriers of each pass go with one call before it
+     */
+    void Execute(const vk::CommandBuffer & cmdBuffer, ResourceStateTracker & tracker)
+    {
+        if (!mCompiled) {
+            throw std::runtime_error("RenderGraph: graph is not compiled");
+        }
+        for (PassId passId : mOrder) {
+            const Pass & pass = mPasses[passId];
+            if (!pass.enabled) {
+                continue;
+            }
+            for (const auto & use : pass.uses) {
+                Image & image = mImages[use.image];
+                if (image.transient && image.lastExecution != mExecution) {
+                    // Contents are discarded, but the images sharing memory must be done
+                    tracker.SetImageState(image.image, vk::ImageLayout::eUndefined, image.aliasStages, image.aliasAccess);
+                    image.lastExecution = mExecution;
+                }
+                else if (image.created && !image.transient && !image.registered) {
+                    tracker.SetImageState(image.image, vk::ImageLayout::eUndefined);
+                    image.registered = true;
+                }
+                tracker.UseImage(image.image, use.stages, use.access, use.layout);
+            }
+            tracker.Flush(cmdBuffer);
+            pass.record(cmdBuffer);
+        }
+        ++mExecution;
+    }
+
+    /**
+     * Transits all transient images from undefined contents to the given use, for commands recorded without Execute()
+     * The barrier is recorded by the next tracker flush
+     */
+    void DiscardTransients(ResourceStateTracker & tracker, vk::PipelineStageFlags stages, vk::AccessFlags access, vk::ImageLayout layout)
+    {
+        for (auto & image : mImages) {
+            if (image.transient) {
+                tracker.SetImageState(image.image, vk::ImageLayout::eUndefined, image.aliasStages, image.aliasAccess);
+                tracker.UseImage(image.image, stages, access, layout);
+            }
+        }
+        ++mExecution;
+    }
+
+    const std::vector<PassId> & GetOrder() const
+    {
+        return mOrder;
+    }
+
+    const std::string & GetPassName(PassId pass) const
+    {
+        return mPasses.at(pass).name;
+    }
+
+    uint32_t GetPassLevel(PassId pass) const
+    {
+        return mPasses.at(pass).level;
+    }
+
+    /**
+     * Memory of transient images with aliasing and the sum of their sizes without it
+     */
+    vk::DeviceSize GetTransientMemorySize() const
+    {
+        return mTransientMemorySize;
+    }
+
+    vk::DeviceSize GetUnaliasedMemorySize() const
+    {
+        return mUnaliasedMemorySize;
+    }
+};
+
+#endif
@@ -0,0 +1,251 @@
+/**
+* Vulkan samples
+*
+* Tracking of images and buffers state for automatic barriers
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _RESOURCE_STATE_TRACKER_H_
+#define _RESOURCE_STATE_TRACKER_H_
+
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "VulkanUtility.h"
+
+/**
+ * Remembers the layout of each registered image and the stages and accesses of the last write and the following reads
+ * of each image and buffer. Use*() declares the next access and adds a barrier only if it is needed:
+ *   - layout transition, or write after read or write - always (write after read needs only execution dependency)
+ *   - read after write or layout transition - only if it isn't visible to these stages and accesses yet, read after read never
+ * Barriers are accumulated and Flush() records all of them with one pipelineBarrier.
+ * Commands must be submitted in the order they are recorded, as the state is carried between command buffers.
+ */
+class ResourceStateTracker
+{
+    struct ResourceState
+    {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::ImageSubresourceRange range;
+        vk::PipelineStageFlags writeStages;   // the last write or layout transition
+        vk::AccessFlags writeAccess;
+        vk::PipelineStageFlags readStages;    // reads after the last write
+        vk::PipelineStageFlags visibleStages; // the last write is visible to these stages and accesses
+        vk::AccessFlags visibleAccess;
+    };
+
+    std::map<VkImage, ResourceState> mImages;
+    std::map<VkBuffer, ResourceState> mBuffers;
+
+    std::vector<vk::ImageMemoryBarrier> mImageBarriers;
+    std::vector<vk::BufferMemoryBarrier> mBufferBarriers;
+    vk::MemoryBarrier mMemoryBarrier;
+    vk::PipelineStageFlags mSrcStages;
+    vk::PipelineStageFlags mDstStages;
+
+    static vk::AccessFlags WriteAccess(vk::AccessFlags access)
+    {
+        return access & (vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+            vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite);
+    }
+
+    /**
+     * Updates the state and returns true with src and dst masks of the required barrier
+     */
+    static bool Transit(ResourceState & state, vk::PipelineStageFlags stages, vk::AccessFlags access, vk::ImageLayout layout,
+        vk::PipelineStageFlags & srcStages, vk::AccessFlags & srcAccess, vk::PipelineStageFlags & dstStages, vk::AccessFlags & dstAccess)
+    {
+        const vk::AccessFlags writeAccess = WriteAccess(access);
+        if (layout != state.layout || writeAccess) {
+            // Transition is a write too, so it waits for everything
+            srcStages = state.writeStages | state.readStages;
+            srcAccess = state.writeAccess;
+            dstStages = stages;
+            dstAccess = access;
+            const bool required = (layout != state.layout) || srcStages;
+
+            state.layout = layout;
+            // Kept for a read-only transition too, so reads from other stages wait for it
+            state.writeStages = stages;
+            state.writeAccess = writeAccess;
+            state.readStages = writeAccess ? vk::PipelineStageFlags() : stages;
+            // A new write is not visible to anyone, a transition is visible to this use
+            state.visibleStages = writeAccess ? vk::PipelineStageFlags() : stages;
+            state.visibleAccess = writeAccess ? vk::AccessFlags() : access;
+            return required;
+        }
+
+        state.readStages |= stages;
+        if (!state.writeStages || (((stages & state.visibleStages) == stages) && ((access & state.visibleAccess) == access))) {
+            return false;
+        }
+        // Make the write visible to the union, so every stage sees every access made visible so far
+        state.visibleStages |= stages;
+        state.visibleAccess |= access;
+        srcStages = state.writeStages;
+        srcAccess = state.writeAccess;
+        dstStages = state.visibleStages;
+        dstAccess = state.visibleAccess;
+        return true;
+    }
+
+    ResourceState & GetImage(const vk::Image & image)
+    {
+        auto it = mImages.find(static_cast<VkImage>(image));
+        if (it == mImages.end()) {
+            throw std::runtime_error("ResourceStateTracker: image is not registered");
+        }
+        return it->second;
+    }
+
+    ResourceState & GetBuffer(const vk::Buffer & buffer)
+    {
+        auto it = mBuffers.find(static_cast<VkBuffer>(buffer));
+        if (it == mBuffers.end()) {
+            throw std::runtime_error("ResourceStateTracker: buffer is not registered");
+        }
+        return it->second;
+    }
+
+public:
+    /**
+     * Starts tracking or overrides the known state, e.g. for a preinitialized image written by host or an acquired swapchain image
+     * writeStages and writeAccess describe a write which the next use has to wait for
+     */
+    void SetImageState(const vk::Image & image, vk::ImageLayout layout, vk::PipelineStageFlags writeStages = vk::PipelineStageFlags(), vk::AccessFlags writeAccess = vk::AccessFlags(),
+        const vk::ImageSubresourceRange & range = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS))
+    {
+        ResourceState state;
+        state.layout = layout;
+        state.range = range;
+        state.writeStages = writeStages;
+        state.writeAccess = writeAccess;
+        mImages[static_cast<VkImage>(image)] = state;
+    }
+
+    void SetBufferState(const vk::Buffer & buffer, vk::PipelineStageFlags writeStages = vk::PipelineStageFlags(), vk::AccessFlags writeAccess = vk::AccessFlags())
+    {
+        ResourceState state;
+        state.writeStages = writeStages;
+        state.writeAccess = writeAccess;
+        mBuffers[static_cast<VkBuffer>(buffer)] = state;
+    }
+
+    vk::ImageLayout GetImageLayout(const vk::Image & image)
+    {
+        return GetImage(image).layout;
+    }
+
+    /**
+     * Declares the next access to the image, the barrier is recorded by Flush()
+     */
+    void UseImage(const vk::Image & image, vk::PipelineStageFlags stages, vk::AccessFlags access, vk::ImageLayout layout)
+    {
+        ResourceState & state = GetImage(image);
+        const vk::ImageLayout oldLayout = state.layout;
+
+        vk::PipelineStageFlags srcStages, dstStages;
+        vk::AccessFlags srcAccess, dstAccess;
+        if (!Transit(state, stages, access, layout, srcStages, srcAccess, dstStages, dstAccess)) {
+            return;
+        }
+        mSrcStages |= srcStages;
+        mDstStages |= dstStages;
+
+        // Several uses before one flush are merged
+        for (auto & barrier : mImageBarriers) {
+            if (barrier.image == image) {
+                if (barrier.newLayout != layout) {
+                    throw std::runtime_error("ResourceStateTracker: image is used with different layouts between flushes");
+                }
+                barrier.srcAccessMask |= srcAccess;
+                barrier.dstAccessMask |= dstAccess;
+                return;
+            }
+        }
+        vk::ImageMemoryBarrier barrier;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = state.range;
+        mImageBarriers.push_back(barrier);
+    }
+
+    /**
+     * Declares the next access to the whole buffer, the barrier is recorded by Flush()
+     */
+    void UseBuffer(const vk::Buffer & buffer, vk::PipelineStageFlags stages, vk::AccessFlags access)
+    {
+        ResourceState & state = GetBuffer(buffer);
+
+        vk::PipelineStageFlags srcStages, dstStages;
+        vk::AccessFlags srcAccess, dstAccess;
+        if (!Transit(state, stages, access, vk::ImageLayout::eUndefined, srcStages, srcAccess, dstStages, dstAccess)) {
+            return;
+        }
+        mSrcStages |= srcStages;
+        mDstStages |= dstStages;
+
+        for (auto & barrier : mBufferBarriers) {
+            if (barrier.buffer == buffer) {
+                barrier.srcAccessMask |= srcAccess;
+                barrier.dstAccessMask |= dstAccess;
+                return;
+            }
+        }
+        vk::BufferMemoryBarrier barrier;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        mBufferBarriers.push_back(barrier);
+    }
+
+    /**
+     * Dependency of untracked resources, e.g. between dispatches working on the same images, merged into the next flush
+     */
+    void AddMemoryDependency(vk::PipelineStageFlags srcStages, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStages, vk::AccessFlags dstAccess)
+    {
+        mSrcStages |= srcStages;
+        mDstStages |= dstStages;
+        mMemoryBarrier.srcAccessMask |= srcAccess;
+        mMemoryBarrier.dstAccessMask |= dstAccess;
+    }
+
+    /**
+     * Records all accumulated barriers with one call, if there are any
+     */
+    void Flush(const vk::CommandBuffer & cmdBuffer)
+    {
+        const bool hasMemoryBarrier = mMemoryBarrier.srcAccessMask || mMemoryBarrier.dstAccessMask;
+        if (mImageBarriers.empty() && mBufferBarriers.empty() && !hasMemoryBarrier && !mSrcStages) {
+            return;
+        }
+        // Nothing to wait for, e.g. the first use of a resource
+        const vk::PipelineStageFlags srcStages = mSrcStages ? mSrcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+        const vk::PipelineStageFlags dstStages = mDstStages ? mDstStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe);
+
+        cmdBuffer.pipelineBarrier(srcStages, dstStages, vk::DependencyFlags(),
+            hasMemoryBarrier ? 1 : 0, hasMemoryBarrier ? &mMemoryBarrier : nullptr,
+            static_cast<uint32_t>(mBufferBarriers.size()), mBufferBarriers.empty() ? nullptr : &mBufferBarriers[0],
+            static_cast<uint32_t>(mImageBarriers.size()), mImageBarriers.empty() ? nullptr : &mImageBarriers[0]);
+
+        mImageBarriers.clear();
+        mBufferBarriers.clear();
+        mMemoryBarrier = vk::MemoryBarrier();
+        mSrcStages = vk::PipelineStageFlags();
+        mDstStages = vk::PipelineStageFlags();
+    }
+};
+
+#endif
@@ -0,0 +1,42 @@
+/**
+* Vulkan samples
+*
+* Incremental hash of the state objects are built from
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _STATE_HASH_H_
+#define _STATE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * FNV-1a hash of trivially copyable values, e.g. the handles and counts a command buffer or a descriptor set depends on
+ */
+class StateHash
+{
+    uint64_t mHash = 14695981039346656037ull;
+
+public:
+    template <typename _Type>
+    StateHash & Add(const _Type & value)
+    {
+        static_assert(std::is_trivially_copyable<_Type>::value, "StateHash: value must be trivially copyable");
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        for (size_t i = 0; i < sizeof(_Type); ++i) {
+            mHash = (mHash ^ bytes[i]) * 1099511628211ull;
+        }
+        return *this;
+    }
+
+    uint64_t Get() const
+    {
+        return mHash;
+    }
+};
+
+#endif
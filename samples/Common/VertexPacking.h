@@ -0,0 +1,188 @@
+/**
+* Vulkan samples
+*
+* Compressed vertex layouts: quantized positions, octahedral normals, unorm16 texture coordinates
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#ifndef _VERTEX_PACKING_H_
+#define _VERTEX_PACKING_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "VulkanUtility.h"
+#include "math/OgreVector2.h"
+#include "math/OgreVector4.h"
+
+enum class PositionPacking
+{
+    Half,       // R16G16B16A16Sfloat, absolute coordinates
+    Unorm16     // R16G16B16A16Unorm, quantized against the mesh bounding box
+};
+
+struct VertexPackingOptions
+{
+    PositionPacking position = PositionPacking::Unorm16;
+    bool texcoord = false;
+};
+
+/**
+ * Push constants of the decoding vertex shader: position = bias + scale * packed position
+ */
+struct PackedVertexDecode
+{
+    Ogre::Vector4 positionScale = Ogre::Vector4(1.0f, 1.0f, 1.0f, 0.0f);
+    Ogre::Vector4 positionBias = Ogre::Vector4(0.0f, 0.0f, 0.0f, 1.0f);
+};
+
+struct PackedVertexes
+{
+    std::vector<uint8_t> data;
+    uint32_t stride = 0;
+    PackedVertexDecode decode;
+};
+
+/**
+ * Packs vertexes with Ogre::Vector4 position and normal and optionally Ogre::Vector2 texcoord into
+ *   position: 4 x 16 bit, half floats or unorm against the bounding box, w is unused
+ *   normal:   2 x snorm16, octahedral encoding of the unit direction
+ *   texcoord: 2 x unorm16, coordinates must be in [0, 1]
+ * 12 or 16 bytes per vertex instead of 32 or 40. Attributes are read with the matching formats, so the vertex input unit converts them to float,
+ * and shaders/glsl/vertex_packing.glsl has the decode functions for the position and the normal.
+ */
+class VertexPacking
+{
+    template <typename _Vertex>
+    static auto GetTexcoord(const _Vertex & vertex, int) -> decltype(Ogre::Vector2(vertex.texcoord))
+    {
+        return vertex.texcoord;
+    }
+
+    template <typename _Vertex>
+    static Ogre::Vector2 GetTexcoord(const _Vertex &, long)
+    {
+        throw std::runtime_error("VertexPacking: vertex type has no texture coordinates");
+    }
+
+    static uint16_t ToUnorm16(float v)
+    {
+        return static_cast<uint16_t>(std::lround(std::min(std::max(v, 0.0f), 1.0f) * 65535.0f));
+    }
+
+    static int16_t ToSnorm16(float v)
+    {
+        return static_cast<int16_t>(std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    static void Write16(uint8_t* dst, uint16_t v)
+    {
+        std::memcpy(dst, &v, sizeof(v));
+    }
+
+public:
+    /**
+     * Projects the unit vector on the octahedron |x| + |y| + |z| = 1 and unfolds the lower half over the diagonals
+     */
+    static void OctEncode(float x, float y, float z, int16_t & u, int16_t & v)
+    {
+        const float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+        float px = (l1 > 0.0f) ? x / l1 : 0.0f;
+        float py = (l1 > 0.0f) ? y / l1 : 0.0f;
+        if (z < 0.0f) {
+            const float ox = px;
+            px = (1.0f - std::abs(py)) * (ox >= 0.0f ? 1.0f : -1.0f);
+            py = (1.0f - std::abs(ox)) * (py >= 0.0f ? 1.0f : -1.0f);
+        }
+        u = ToSnorm16(px);
+        v = ToSnorm16(py);
+    }
+
+    static uint32_t GetStride(const VertexPackingOptions & options)
+    {
+        return 4 * sizeof(uint16_t) + 2 * sizeof(int16_t) + (options.texcoord ? 2 * sizeof(uint16_t) : 0);
+    }
+
+    /**
+     * Locations: 0 - position, 1 - normal, 2 - texcoord
+     */
+    static std::vector<vk::VertexInputAttributeDescription> GetAttributes(const VertexPackingOptions & options, uint32_t binding)
+    {
+        std::vector<vk::VertexInputAttributeDescription> attributes;
+        attributes.emplace_back(0, binding, (options.position == PositionPacking::Half) ? vk::Format::eR16G16B16A16Sfloat : vk::Format::eR16G16B16A16Unorm, 0);
+        attributes.emplace_back(1, binding, vk::Format::eR16G16Snorm, 4 * sizeof(uint16_t));
+        if (options.texcoord) {
+            attributes.emplace_back(2, binding, vk::Format::eR16G16Unorm, 4 * sizeof(uint16_t) + 2 * sizeof(int16_t));
+        }
+        return attributes;
+    }
+
+    template <typename _Vertex>
+    static PackedVertexes Pack(const std::vector<_Vertex> & vertexes, const VertexPackingOptions & options)
+    {
+        PackedVertexes packed;
+        packed.stride = GetStride(options);
+        packed.data.resize(vertexes.size() * packed.stride);
+        if (vertexes.empty()) {
+            return packed;
+        }
+
+        Ogre::Vector4 boxMin = vertexes[0].position;
+        Ogre::Vector4 boxMax = vertexes[0].position;
+        for (const auto & vertex : vertexes) {
+            boxMin.x = std::min(boxMin.x, vertex.position.x);
+            boxMin.y = std::min(boxMin.y, vertex.position.y);
+            boxMin.z = std::min(boxMin.z, vertex.position.z);
+            boxMax.x = std::max(boxMax.x, vertex.position.x);
+            boxMax.y = std::max(boxMax.y, vertex.position.y);
+            boxMax.z = std::max(boxMax.z, vertex.position.z);
+        }
+        // Flat boxes keep a non-zero extent, so the division is defined
+        const float eps = std::numeric_limits<float>::min();
+        const Ogre::Vector4 extent(std::max(boxMax.x - boxMin.x, eps), std::max(boxMax.y - boxMin.y, eps), std::max(boxMax.z - boxMin.z, eps), 0.0f);
+        if (options.position == PositionPacking::Unorm16) {
+            packed.decode.positionScale = extent;
+            packed.decode.positionBias = Ogre::Vector4(boxMin.x, boxMin.y, boxMin.z, 1.0f);
+        }
+
+        uint8_t* dst = packed.data.data();
+        for (const auto & vertex : vertexes) {
+            const Ogre::Vector4 & p = vertex.position;
+            if (options.position == PositionPacking::Half) {
+                Write16(dst + 0, FloatToHalf(p.x));
+                Write16(dst + 2, FloatToHalf(p.y));
+                Write16(dst + 4, FloatToHalf(p.z));
+                Write16(dst + 6, FloatToHalf(1.0f));
+            }
+            else {
+                Write16(dst + 0, ToUnorm16((p.x - boxMin.x) / extent.x));
+                Write16(dst + 2, ToUnorm16((p.y - boxMin.y) / extent.y));
+                Write16(dst + 4, ToUnorm16((p.z - boxMin.z) / extent.z));
+                Write16(dst + 6, 0);
+            }
+
+            const Ogre::Vector4 & n = vertex.normal;
+            int16_t u = 0, v = 0;
+            OctEncode(n.x, n.y, n.z, u, v);
+            std::memcpy(dst + 8, &u, sizeof(u));
+            std::memcpy(dst + 10, &v, sizeof(v));
+
+            if (options.texcoord) {
+                const Ogre::Vector2 texcoord = GetTexcoord(vertex, 0);
+                Write16(dst + 12, ToUnorm16(texcoord.x));
+                Write16(dst + 14, ToUnorm16(texcoord.y));
+            }
+            dst += packed.stride;
+        }
+        return packed;
+    }
+};
+
+#endif
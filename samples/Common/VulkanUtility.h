@@ -18,6 +18,7 @@
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #ifndef NOMINMAX
 # define NOMINMAX
@@ -266,10 +267,23 @@ std::vector<char> GetBinaryFileContents(const std::string & filename)
 }
 
 
+/**
+ * Compile glsl source with glslangValidator
+ * Defines are passed to the preprocessor as NAME or NAME=VALUE
+ */
 inline 
-std::vector<char> GetBinaryShaderFromSourceFile(const std::string & filename)
+std::vector<char> GetBinaryShaderFromSourceFile(const std::string & filename, const std::vector<std::string> & defines = {})
 {
-    const std::string cmd = "%VULKAN_SDK%/Bin/glslangValidator.exe -V -o ./tmp_shader.spv \"" + filename + "\"";
+    std::string cmd = "%VULKAN_SDK%/Bin/glslangValidator.exe -V";
+    for (const auto & define : defines) {
+        cmd += " -D" + define;
+    }
+    // #include "..." is resolved next to the source file
+    const size_t slash = filename.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        cmd += " -I\"" + filename.substr(0, slash) + "\"";
+    }
+    cmd += " -o ./tmp_shader.spv \"" + filename + "\"";
     if (0 != std::system(cmd.c_str())) {
         std::cout << "Failed to compile \"" << filename << "\"!" << std::endl;
         return std::vector<char>{};
@@ -329,11 +343,105 @@ RgbaImage LoadBmpImage(const std::string & filename)
     fclose(f);
     return image;
 }
+
+/**
+ * Save 24 bits BMP, rows are written in the same order as LoadBmpImage reads them
+ */
+inline
+bool SaveBmpImage(const std::string & filename, const RgbaImage & image)
+{
+    FILE* f = fopen(filename.c_str(), "wb");
+
+    if (f == NULL) {
+        std::cout << "Failed to create output file" << std::endl;
+        return false;
+    }
+
+    const uint32_t row_padded = (image.width * 3 + 3) & (~3u);
+    const uint32_t dataSize = row_padded * image.height;
+    auto put32 = [](unsigned char* dst, uint32_t value) { std::memcpy(dst, &value, sizeof(value)); };
+    auto put16 = [](unsigned char* dst, uint16_t value) { std::memcpy(dst, &value, sizeof(value)); };
+
+    unsigned char info[54] = {};
+    info[0] = 'B';
+    info[1] = 'M';
+    put32(&info[2], 54 + dataSize);  // file size
+    put32(&info[10], 54);            // pixels offset
+    put32(&info[14], 40);            // info header size
+    put32(&info[18], image.width);
+    put32(&info[22], image.height);
+    put16(&info[26], 1);             // planes
+    put16(&info[28], 24);            // bits per pixel
+    put32(&info[34], dataSize);
+    fwrite(info, sizeof(unsigned char), 54, f);
+
+    std::vector<uint8_t> row(row_padded, 0);
+    const uint8_t* srcLine = image.pixels.data();
+    for (uint32_t i = 0; i < image.height; i++, srcLine += image.width * 4) {
+        int iSrc = 0;
+        int iDst = 0;
+        for (uint32_t j = 0; j < image.width; ++j, iSrc += 4, iDst += 3) {
+            // Convert (R, G, B) to (B, G, R)
+            row[iDst + 0] = srcLine[iSrc + 2];
+            row[iDst + 1] = srcLine[iSrc + 1];
+            row[iDst + 2] = srcLine[iSrc + 0];
+        }
+        fwrite(&row[0], sizeof(unsigned char), row_padded, f);
+    }
+    fclose(f);
+    return true;
+}
 #ifdef _MSC_VER
 # pragma warning(pop)
 #endif
 
 
+/**
+ * Convert float to IEEE 754 half precision value (round to nearest even)
+ * Used for filling half float images on host
+ */
+inline
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    uint32_t mantissa = bits & 0x007FFFFFu;
+
+    if (((bits >> 23) & 0xFFu) == 0xFFu) {
+        // Inf or NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x0200u : 0u));
+    }
+    if (exponent >= 31) {
+        // Overflow
+        return static_cast<uint16_t>(sign | 0x7C00u);
+    }
+    if (exponent <= 0) {
+        // Denormals or zero
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x00800000u;
+        const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFFu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+        ++half; // may carry to exponent, which is correct
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+
 inline
 void MakePerspectiveProjectionMatrix(Ogre::Matrix4 & dst, const float aspectRatio, const float fieldOfView, const float nearClip, const float farClip)
 {
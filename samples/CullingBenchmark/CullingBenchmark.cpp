@@ -0,0 +1,170 @@
+/**
+* Vulkan samples
+*
+* Benchmark of the CPU frustum culling of Common/FrustumCuller.h against one-at-a-time tests of Ogre::AxisAlignedBox
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <FrustumCuller.h>
+#include <VulkanUtility.h>
+#include <math/OgreAxisAlignedBox.h>
+#include <math/OgreMatrix4.h>
+#include <math/OgreVector3.h>
+#include <math/OgreVector4.h>
+
+namespace
+{
+    /**
+     * Reference test of one Ogre box at a time, the way it is done without batching
+     */
+    size_t CullBoxes(const Frustum & frustum, const std::vector<Ogre::AxisAlignedBox> & boxes, std::vector<uint8_t> & visible)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            const Ogre::Vector3 center = boxes[i].getCenter();
+            const Ogre::Vector3 halfSize = boxes[i].getHalfSize();
+            bool inside = true;
+            for (const auto & p : frustum.planes) {
+                if (p.x * center.x + p.y * center.y + p.z * center.z + std::abs(p.x) * halfSize.x + std::abs(p.y) * halfSize.y + std::abs(p.z) * halfSize.z + p.w < 0.0f) {
+                    inside = false;
+                    break;
+                }
+            }
+            visible[i] = inside ? 1 : 0;
+            count += inside ? 1 : 0;
+        }
+        return count;
+    }
+
+    struct Result
+    {
+        double bestSeconds;
+        size_t visibleCount;
+    };
+
+    Result Measure(uint32_t iterations, const std::function<size_t()> & cull)
+    {
+        Result result = { 0.0, 0 };
+        for (uint32_t i = 0; i < iterations; ++i) {
+            const auto start = std::chrono::high_resolution_clock::now();
+            result.visibleCount = cull();
+            const double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start).count();
+            result.bestSeconds = (i == 0) ? seconds : std::min(result.bestSeconds, seconds);
+        }
+        return result;
+    }
+
+    void Report(const std::string & name, const Result & result, size_t boxesCount, size_t mismatches)
+    {
+        std::cout << std::left << std::setw(20) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(3) << result.bestSeconds * 1000.0 << " ms"
+            << std::setw(10) << std::setprecision(1) << boxesCount / result.bestSeconds * 1e-6 << " Mboxes/s"
+            << std::setw(10) << result.visibleCount << " visible";
+        if (mismatches != 0) {
+            std::cout << ", " << mismatches << " mismatches";
+        }
+        std::cout << std::endl;
+    }
+
+    size_t CountMismatches(const std::vector<uint8_t> & expected, const std::vector<uint8_t> & actual)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            count += (expected[i] != actual[i]) ? 1 : 0;
+        }
+        return count;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    try {
+        size_t boxesCount = 1000 * 1000;
+        uint32_t threadsCount = 0;
+        uint32_t iterations = 20;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (arg == "--boxes" && i + 1 < argc) {
+                boxesCount = static_cast<size_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--threads" && i + 1 < argc) {
+                threadsCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--iterations" && i + 1 < argc) {
+                iterations = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+            }
+            else {
+                std::cout << "Usage: CullingBenchmark [--boxes N] [--threads N] [--iterations N]" << std::endl;
+                return -1;
+            }
+        }
+
+        // Scene of random boxes around a camera looking along -z and turned by 30 degrees around y
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.1f, 10.0f);
+        std::vector<Ogre::AxisAlignedBox> boxes;
+        boxes.reserve(boxesCount);
+        AabbArray boxesSoA;
+        boxesSoA.Reserve(boxesCount);
+        for (size_t i = 0; i < boxesCount; ++i) {
+            const Ogre::Vector3 center(position(random), position(random), position(random));
+            const Ogre::Vector3 halfSize(size(random), size(random), size(random));
+            boxes.emplace_back(center - halfSize, center + halfSize);
+            boxesSoA.Add(center, halfSize);
+        }
+
+        Ogre::Matrix4 projection;
+        MakePerspectiveProjectionMatrix(projection, 16.0f / 9.0f, 60.0f, 0.1f, 1000.0f);
+        const float angle = 30.0f * 0.01745329251994329576923690768489f;
+        const Ogre::Matrix4 view(
+            std::cos(angle), 0.0f, std::sin(angle), 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            -std::sin(angle), 0.0f, std::cos(angle), 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f);
+        // MakePerspectiveProjectionMatrix writes the matrix transposed for GLSL
+        const Frustum frustum = Frustum::FromMatrix(projection.transpose() * view);
+
+        std::cout << boxesCount << " boxes, " << iterations << " iterations, best time" << std::endl;
+
+        std::vector<uint8_t> expected(boxesCount);
+        Report("AxisAlignedBox", Measure(iterations, [&] { return CullBoxes(frustum, boxes, expected); }), boxesCount, 0);
+
+        std::vector<uint8_t> visible(boxesCount);
+        for (CullingIsa isa : { CullingIsa::Scalar, CullingIsa::Sse, CullingIsa::Avx, CullingIsa::Neon }) {
+            if (!FrustumCuller::IsSupported(isa)) {
+                continue;
+            }
+            std::fill(visible.begin(), visible.end(), 0);
+            const Result result = Measure(iterations, [&] { return FrustumCuller::Cull(frustum, boxesSoA, 0, boxesSoA.Size(), visible.data(), isa); });
+            Report(std::string("SoA ") + FrustumCuller::GetIsaName(isa), result, boxesCount, CountMismatches(expected, visible));
+        }
+
+        const CullingIsa best = FrustumCuller::GetBestIsa();
+        const uint32_t threads = (threadsCount != 0) ? threadsCount : std::max(1u, std::thread::hardware_concurrency());
+        std::fill(visible.begin(), visible.end(), 0);
+        const Result result = Measure(iterations, [&] { return FrustumCuller::CullParallel(frustum, boxesSoA, visible, threads, best); });
+        Report(std::string("SoA ") + FrustumCuller::GetIsaName(best) + " x" + std::to_string(threads), result, boxesCount, CountMismatches(expected, visible));
+    }
+    catch (std::exception & err) {
+        std::cout << "Error!" << std::endl;
+        std::cout << err.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
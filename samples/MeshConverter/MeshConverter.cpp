@@ -0,0 +1,789 @@
+/**
+* Vulkan samples
+*
+* Offline converter of OBJ and glTF 2.0 meshes to the binary mesh files of Common/MeshFile.h
+*
+* The MIT License (MIT)
+* Copyright (c) 2016 Alexey Gruzdev
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <MeshFile.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <math/OgreVector2.h>
+#include <math/OgreVector3.h>
+#include <math/OgreVector4.h>
+
+namespace
+{
+    // Layouts of VertexData in the samples
+    struct VertexPN
+    {
+        Ogre::Vector4 position;
+        Ogre::Vector4 normal;
+    };
+
+    struct VertexPNT
+    {
+        Ogre::Vector4 position;
+        Ogre::Vector4 normal;
+        Ogre::Vector2 texcoord;
+    };
+
+    void SetTexcoord(VertexPN &, const Ogre::Vector2 &)
+    { }
+
+    void SetTexcoord(VertexPNT & vertex, const Ogre::Vector2 & texcoord)
+    {
+        vertex.texcoord = texcoord;
+    }
+
+    /**
+     * Imported triangle list before the conversion to the file layout
+     */
+    struct SourceMesh
+    {
+        std::vector<Ogre::Vector3> positions;
+        std::vector<Ogre::Vector3> normals;
+        std::vector<Ogre::Vector2> texcoords;
+        std::vector<uint32_t> indexes;
+        bool hasNormals = false;
+        bool hasTexcoords = false;
+    };
+
+    std::vector<uint8_t> ReadFile(const std::string & path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        return data;
+    }
+
+    std::string Directory(const std::string & path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+    }
+
+    std::string Extension(const std::string & path)
+    {
+        const size_t dot = path.find_last_of('.');
+        std::string ext = (dot == std::string::npos) ? std::string() : path.substr(dot + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        return ext;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+    // OBJ
+
+    typedef std::tuple<int64_t, int64_t, int64_t> ObjCorner;
+
+    struct ObjCornerHash
+    {
+        size_t operator()(const ObjCorner & corner) const
+        {
+            const std::hash<int64_t> hash;
+            size_t seed = hash(std::get<0>(corner));
+            seed ^= hash(std::get<1>(corner)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= hash(std::get<2>(corner)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+    /**
+     * v, vt, vn and f records; polygons are triangulated as fans, negative indexes are relative.
+     * Vertexes are shared between faces by their (position, texcoord, normal) index triple.
+     */
+    SourceMesh ImportObj(const std::string & path)
+    {
+        std::ifstream file(path);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        std::vector<Ogre::Vector3> positions;
+        std::vector<Ogre::Vector3> normals;
+        std::vector<Ogre::Vector2> texcoords;
+
+        SourceMesh mesh;
+        // Cleared by the first corner without a normal
+        mesh.hasNormals = true;
+        std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> vertexMap;
+        std::vector<uint32_t> polygon;
+
+        auto resolve = [](int64_t index, size_t count) -> int64_t {
+            return (index < 0) ? static_cast<int64_t>(count) + index : index - 1;
+        };
+
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream stream(line);
+            std::string tag;
+            stream >> tag;
+            if (tag == "v") {
+                Ogre::Vector3 p;
+                stream >> p.x >> p.y >> p.z;
+                positions.push_back(p);
+            }
+            else if (tag == "vn") {
+                Ogre::Vector3 n;
+                stream >> n.x >> n.y >> n.z;
+                normals.push_back(n);
+            }
+            else if (tag == "vt") {
+                Ogre::Vector2 t;
+                stream >> t.x >> t.y;
+                // OBJ origin is the bottom left corner
+                texcoords.push_back(Ogre::Vector2(t.x, 1.0f - t.y));
+            }
+            else if (tag == "f") {
+                polygon.clear();
+                std::string corner;
+                while (stream >> corner) {
+                    int64_t v = 0, t = 0, n = 0;
+                    const size_t slash1 = corner.find('/');
+                    v = std::stoll(corner.substr(0, slash1));
+                    if (slash1 != std::string::npos) {
+                        const size_t slash2 = corner.find('/', slash1 + 1);
+                        const std::string ts = corner.substr(slash1 + 1, slash2 == std::string::npos ? std::string::npos : slash2 - slash1 - 1);
+                        if (!ts.empty()) {
+                            t = std::stoll(ts);
+                        }
+                        if (slash2 != std::string::npos && slash2 + 1 < corner.size()) {
+                            n = std::stoll(corner.substr(slash2 + 1));
+                        }
+                    }
+                    const int64_t vi = resolve(v, positions.size());
+                    const int64_t ti = (t != 0) ? resolve(t, texcoords.size()) : -1;
+                    const int64_t ni = (n != 0) ? resolve(n, normals.size()) : -1;
+                    // Relative indexes before the first record resolve to negative ones
+                    if (vi < 0 || vi >= static_cast<int64_t>(positions.size()) || (t != 0 && (ti < 0 || ti >= static_cast<int64_t>(texcoords.size())))
+                        || (n != 0 && (ni < 0 || ni >= static_cast<int64_t>(normals.size())))) {
+                        throw std::runtime_error("Invalid face index in " + path);
+                    }
+
+                    const ObjCorner key(vi, ti, ni);
+                    auto it = vertexMap.find(key);
+                    if (it == vertexMap.end()) {
+                        const uint32_t index = static_cast<uint32_t>(mesh.positions.size());
+                        mesh.positions.push_back(positions[static_cast<size_t>(vi)]);
+                        mesh.texcoords.push_back(ti >= 0 ? texcoords[static_cast<size_t>(ti)] : Ogre::Vector2(0.0f, 0.0f));
+                        mesh.normals.push_back(ni >= 0 ? normals[static_cast<size_t>(ni)] : Ogre::Vector3(0.0f, 0.0f, 0.0f));
+                        mesh.hasTexcoords |= (ti >= 0);
+                        mesh.hasNormals &= (ni >= 0);
+                        it = vertexMap.emplace(key, index).first;
+                    }
+                    polygon.push_back(it->second);
+                }
+                for (size_t i = 2; i < polygon.size(); ++i) {
+                    mesh.indexes.push_back(polygon[0]);
+                    mesh.indexes.push_back(polygon[i - 1]);
+                    mesh.indexes.push_back(polygon[i]);
+                }
+            }
+        }
+        return mesh;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+    // glTF
+
+    /**
+     * Minimal JSON tree, enough for glTF documents
+     */
+    struct Json
+    {
+        enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT };
+
+        Type type = NUL;
+        double number = 0.0;
+        std::string string;
+        std::vector<Json> items;
+        std::vector<std::string> keys;
+
+        const Json* Find(const std::string & key) const
+        {
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (keys[i] == key) {
+                    return &items[i];
+                }
+            }
+            return nullptr;
+        }
+
+        const Json & operator[](const std::string & key) const
+        {
+            const Json* value = Find(key);
+            if (value == nullptr) {
+                throw std::runtime_error("glTF: missing property " + key);
+            }
+            return *value;
+        }
+
+        const Json & operator[](size_t index) const
+        {
+            if (type != ARRAY || index >= items.size()) {
+                throw std::runtime_error("glTF: index out of range");
+            }
+            return items[index];
+        }
+
+        uint32_t AsUint() const
+        {
+            return static_cast<uint32_t>(number);
+        }
+
+        uint32_t UintOr(const std::string & key, uint32_t defaultValue) const
+        {
+            const Json* value = Find(key);
+            return (value != nullptr) ? value->AsUint() : defaultValue;
+        }
+    };
+
+    class JsonParser
+    {
+        const char* mPos;
+        const char* mEnd;
+
+        void SkipSpaces()
+        {
+            while (mPos < mEnd && (*mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r')) {
+                ++mPos;
+            }
+        }
+
+        char Next()
+        {
+            SkipSpaces();
+            if (mPos >= mEnd) {
+                throw std::runtime_error("JSON: unexpected end");
+            }
+            return *mPos;
+        }
+
+        void Expect(char c)
+        {
+            if (Next() != c) {
+                throw std::runtime_error(std::string("JSON: expected ") + c);
+            }
+            ++mPos;
+        }
+
+        std::string ParseString()
+        {
+            Expect('"');
+            std::string result;
+            while (mPos < mEnd && *mPos != '"') {
+                char c = *mPos++;
+                if (c == '\\' && mPos < mEnd) {
+                    c = *mPos++;
+                    switch (c) {
+                    case 'b': result += '\b'; break;
+                    case 'f': result += '\f'; break;
+                    case 'n': result += '\n'; break;
+                    case 'r': result += '\r'; break;
+                    case 't': result += '\t'; break;
+                    case 'u': {
+                        if (mEnd - mPos < 4) {
+                            throw std::runtime_error("JSON: invalid escape");
+                        }
+                        const uint32_t code = static_cast<uint32_t>(std::strtoul(std::string(mPos, mPos + 4).c_str(), nullptr, 16));
+                        mPos += 4;
+                        // UTF-8 of the basic plane, names and URIs of glTF are ASCII in practice
+                        if (code < 0x80) {
+                            result += static_cast<char>(code);
+                        }
+                        else if (code < 0x800) {
+                            result += static_cast<char>(0xC0 | (code >> 6));
+                            result += static_cast<char>(0x80 | (code & 0x3F));
+                        }
+                        else {
+                            result += static_cast<char>(0xE0 | (code >> 12));
+                            result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                            result += static_cast<char>(0x80 | (code & 0x3F));
+                        }
+                        break;
+                    }
+                    default: result += c; break;
+                    }
+                }
+                else {
+                    result += c;
+                }
+            }
+            Expect('"');
+            return result;
+        }
+
+        Json ParseValue()
+        {
+            Json value;
+            const char c = Next();
+            if (c == '{') {
+                ++mPos;
+                value.type = Json::OBJECT;
+                if (Next() == '}') {
+                    ++mPos;
+                    return value;
+                }
+                for (;;) {
+                    value.keys.push_back(ParseString());
+                    Expect(':');
+                    value.items.push_back(ParseValue());
+                    if (Next() == ',') {
+                        ++mPos;
+                        continue;
+                    }
+                    Expect('}');
+                    return value;
+                }
+            }
+            if (c == '[') {
+                ++mPos;
+                value.type = Json::ARRAY;
+                if (Next() == ']') {
+                    ++mPos;
+                    return value;
+                }
+                for (;;) {
+                    value.items.push_back(ParseValue());
+                    if (Next() == ',') {
+                        ++mPos;
+                        continue;
+                    }
+                    Expect(']');
+                    return value;
+                }
+            }
+            if (c == '"') {
+                value.type = Json::STRING;
+                value.string = ParseString();
+                return value;
+            }
+            if (std::string(mPos, std::min(mPos + 4, mEnd)) == "true") {
+                mPos += 4;
+                value.type = Json::BOOL;
+                value.number = 1.0;
+                return value;
+            }
+            if (std::string(mPos, std::min(mPos + 5, mEnd)) == "false") {
+                mPos += 5;
+                value.type = Json::BOOL;
+                return value;
+            }
+            if (std::string(mPos, std::min(mPos + 4, mEnd)) == "null") {
+                mPos += 4;
+                return value;
+            }
+            char* end = nullptr;
+            value.type = Json::NUMBER;
+            value.number = std::strtod(std::string(mPos, std::min(mPos + 64, mEnd)).c_str(), &end);
+            if (end == nullptr || *mPos == '\0' || (c != '-' && (c < '0' || c > '9'))) {
+                throw std::runtime_error("JSON: invalid value");
+            }
+            while (mPos < mEnd && (std::strchr("+-.eE", *mPos) != nullptr || (*mPos >= '0' && *mPos <= '9'))) {
+                ++mPos;
+            }
+            return value;
+        }
+
+    public:
+        static Json Parse(const char* begin, const char* end)
+        {
+            JsonParser parser;
+            parser.mPos = begin;
+            parser.mEnd = end;
+            return parser.ParseValue();
+        }
+    };
+
+    std::vector<uint8_t> DecodeBase64(const std::string & text)
+    {
+        std::vector<uint8_t> result;
+        uint32_t accumulator = 0;
+        int bits = 0;
+        for (char c : text) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '+') value = 62;
+            else if (c == '/') value = 63;
+            else continue;
+            accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                result.push_back(static_cast<uint8_t>((accumulator >> bits) & 0xFF));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Reads an accessor as floats or as unsigned integers. Float attributes must be FLOAT, indexes UNSIGNED_BYTE/SHORT/INT
+     */
+    template <typename _Type>
+    std::vector<_Type> ReadAccessor(const Json & document, const std::vector<std::vector<uint8_t>> & buffers, uint32_t accessorIndex, uint32_t components)
+    {
+        const Json & accessor = document["accessors"][accessorIndex];
+        const uint32_t count = accessor["count"].AsUint();
+        const uint32_t componentType = accessor["componentType"].AsUint();
+        uint32_t componentSize = 0;
+        switch (componentType) {
+        case 5121: componentSize = 1; break;
+        case 5123: componentSize = 2; break;
+        case 5125: componentSize = 4; break;
+        case 5126: componentSize = 4; break;
+        default: throw std::runtime_error("glTF: unsupported component type");
+        }
+        if (std::is_floating_point<_Type>::value != (componentType == 5126)) {
+            throw std::runtime_error("glTF: unexpected component type of an accessor");
+        }
+
+        std::vector<_Type> result(static_cast<size_t>(count) * components);
+        if (accessor.Find("bufferView") == nullptr) {
+            // No data means zeros
+            return result;
+        }
+        const Json & view = document["bufferViews"][accessor["bufferView"].AsUint()];
+        const std::vector<uint8_t> & buffer = buffers.at(view["buffer"].AsUint());
+        const uint32_t elementSize = componentSize * components;
+        const uint32_t stride = view.UintOr("byteStride", elementSize);
+        const uint64_t offset = static_cast<uint64_t>(view.UintOr("byteOffset", 0)) + accessor.UintOr("byteOffset", 0);
+        if (count > 0 && offset + static_cast<uint64_t>(stride) * (count - 1) + elementSize > buffer.size()) {
+            throw std::runtime_error("glTF: accessor is out of the buffer");
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t* element = buffer.data() + offset + static_cast<uint64_t>(stride) * i;
+            for (uint32_t k = 0; k < components; ++k) {
+                const uint8_t* src = element + componentSize * k;
+                _Type & dst = result[static_cast<size_t>(i) * components + k];
+                if (componentType == 5126) {
+                    float f;
+                    std::memcpy(&f, src, sizeof(f));
+                    dst = static_cast<_Type>(f);
+                }
+                else if (componentSize == 1) {
+                    dst = static_cast<_Type>(*src);
+                }
+                else if (componentSize == 2) {
+                    uint16_t v;
+                    std::memcpy(&v, src, sizeof(v));
+                    dst = static_cast<_Type>(v);
+                }
+                else {
+                    uint32_t v;
+                    std::memcpy(&v, src, sizeof(v));
+                    dst = static_cast<_Type>(v);
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * All triangle primitives of all meshes of a .gltf or .glb file are merged, node transforms are not applied
+     */
+    SourceMesh ImportGltf(const std::string & path)
+    {
+        const std::vector<uint8_t> file = ReadFile(path);
+        const char* jsonBegin = reinterpret_cast<const char*>(file.data());
+        const char* jsonEnd = jsonBegin + file.size();
+        std::vector<uint8_t> glbBuffer;
+
+        if (file.size() >= 12 && std::memcmp(file.data(), "glTF", 4) == 0) {
+            // Binary container: 12 bytes header, JSON chunk, optional BIN chunk
+            size_t offset = 12;
+            bool hasJson = false;
+            while (offset + 8 <= file.size()) {
+                uint32_t length, type;
+                std::memcpy(&length, &file[offset], 4);
+                std::memcpy(&type, &file[offset + 4], 4);
+                if (offset + 8 + length > file.size()) {
+                    throw std::runtime_error("glTF: truncated chunk in " + path);
+                }
+                if (type == 0x4E4F534A) { // JSON
+                    jsonBegin = reinterpret_cast<const char*>(&file[offset + 8]);
+                    jsonEnd = jsonBegin + length;
+                    hasJson = true;
+                }
+                else if (type == 0x004E4942) { // BIN
+                    glbBuffer.assign(file.begin() + offset + 8, file.begin() + offset + 8 + length);
+                }
+                offset += 8 + length;
+            }
+            if (!hasJson) {
+                throw std::runtime_error("glTF: no JSON chunk in " + path);
+            }
+        }
+
+        const Json document = JsonParser::Parse(jsonBegin, jsonEnd);
+
+        std::vector<std::vector<uint8_t>> buffers;
+        if (const Json* jsonBuffers = document.Find("buffers")) {
+            for (const auto & buffer : jsonBuffers->items) {
+                const Json* uri = buffer.Find("uri");
+                if (uri == nullptr) {
+                    buffers.push_back(glbBuffer);
+                }
+                else if (uri->string.compare(0, 5, "data:") == 0) {
+                    const size_t comma = uri->string.find(',');
+                    buffers.push_back(DecodeBase64(uri->string.substr(comma + 1)));
+                }
+                else {
+                    buffers.push_back(ReadFile(Directory(path) + uri->string));
+                }
+            }
+        }
+
+        SourceMesh mesh;
+        mesh.hasNormals = true;
+        mesh.hasTexcoords = true;
+        uint32_t primitivesCount = 0;
+        for (const auto & jsonMesh : document["meshes"].items) {
+            for (const auto & primitive : jsonMesh["primitives"].items) {
+                if (primitive.UintOr("mode", 4) != 4) {
+                    continue; // not a triangle list
+                }
+                const Json & attributes = primitive["attributes"];
+                const std::vector<float> positions = ReadAccessor<float>(document, buffers, attributes["POSITION"].AsUint(), 3);
+                const uint32_t vertexesCount = static_cast<uint32_t>(positions.size() / 3);
+                const uint32_t base = static_cast<uint32_t>(mesh.positions.size());
+
+                std::vector<float> normals, texcoords;
+                if (const Json* normal = attributes.Find("NORMAL")) {
+                    normals = ReadAccessor<float>(document, buffers, normal->AsUint(), 3);
+                }
+                if (const Json* texcoord = attributes.Find("TEXCOORD_0")) {
+                    texcoords = ReadAccessor<float>(document, buffers, texcoord->AsUint(), 2);
+                }
+                mesh.hasNormals &= !normals.empty();
+                mesh.hasTexcoords &= !texcoords.empty();
+
+                for (uint32_t i = 0; i < vertexesCount; ++i) {
+                    mesh.positions.push_back(Ogre::Vector3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]));
+                    mesh.normals.push_back(normals.empty() ? Ogre::Vector3(0.0f, 0.0f, 0.0f) : Ogre::Vector3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]));
+                    mesh.texcoords.push_back(texcoords.empty() ? Ogre::Vector2(0.0f, 0.0f) : Ogre::Vector2(texcoords[2 * i], texcoords[2 * i + 1]));
+                }
+
+                if (const Json* indices = primitive.Find("indices")) {
+                    for (uint32_t index : ReadAccessor<uint32_t>(document, buffers, indices->AsUint(), 1)) {
+                        if (index >= vertexesCount) {
+                            throw std::runtime_error("glTF: index out of range in " + path);
+                        }
+                        mesh.indexes.push_back(base + index);
+                    }
+                }
+                else {
+                    for (uint32_t i = 0; i + 2 < vertexesCount; i += 3) {
+                        mesh.indexes.insert(mesh.indexes.end(), { base + i, base + i + 1, base + i + 2 });
+                    }
+                }
+                ++primitivesCount;
+            }
+        }
+        if (primitivesCount == 0) {
+            mesh.hasNormals = false;
+            mesh.hasTexcoords = false;
+        }
+        return mesh;
+    }
+
+    // ------------------------------------------------------------------------------------------------
+
+    /**
+     * Area weighted vertex normals for the vertexes imported without normals (zero ones), the imported normals are kept
+     */
+    void ComputeNormals(SourceMesh & mesh)
+    {
+        std::vector<Ogre::Vector3> normals(mesh.normals.size(), Ogre::Vector3(0.0f, 0.0f, 0.0f));
+        for (size_t t = 0; t + 2 < mesh.indexes.size(); t += 3) {
+            const uint32_t i0 = mesh.indexes[t], i1 = mesh.indexes[t + 1], i2 = mesh.indexes[t + 2];
+            const Ogre::Vector3 n = (mesh.positions[i1] - mesh.positions[i0]).crossProduct(mesh.positions[i2] - mesh.positions[i0]);
+            normals[i0] += n;
+            normals[i1] += n;
+            normals[i2] += n;
+        }
+        for (size_t i = 0; i < mesh.normals.size(); ++i) {
+            if (mesh.normals[i] == Ogre::Vector3(0.0f, 0.0f, 0.0f)) {
+                mesh.normals[i] = normals[i];
+                mesh.normals[i].normalise();
+            }
+        }
+        mesh.hasNormals = true;
+    }
+
+    /**
+     * Moves the bounding box center to the origin and scales the mesh to the bounding sphere of the given radius
+     */
+    void Fit(SourceMesh & mesh, float radius)
+    {
+        if (mesh.positions.empty()) {
+            return;
+        }
+        Ogre::Vector3 boxMin = mesh.positions[0], boxMax = mesh.positions[0];
+        for (const auto & p : mesh.positions) {
+            boxMin.makeFloor(p);
+            boxMax.makeCeil(p);
+        }
+        const Ogre::Vector3 center = (boxMin + boxMax) * 0.5f;
+        float maxDistance = 0.0f;
+        for (const auto & p : mesh.positions) {
+            maxDistance = std::max(maxDistance, (p - center).length());
+        }
+        const float scale = (maxDistance > 0.0f) ? radius / maxDistance : 1.0f;
+        for (auto & p : mesh.positions) {
+            p = (p - center) * scale;
+        }
+    }
+
+    template <typename _Vertex>
+    void Convert(const SourceMesh & source, const std::string & output, bool texcoord, bool optimize, uint32_t lodsCount)
+    {
+        IndexedMesh<_Vertex> mesh;
+        mesh.indexType = MeshBuilder::SelectIndexType(source.positions.size());
+        mesh.vertexes.resize(source.positions.size());
+        for (size_t i = 0; i < source.positions.size(); ++i) {
+            _Vertex & vertex = mesh.vertexes[i];
+            vertex.position = Ogre::Vector4(source.positions[i].x, source.positions[i].y, source.positions[i].z, 1.0f);
+            vertex.normal = Ogre::Vector4(source.normals[i].x, source.normals[i].y, source.normals[i].z, 0.0f);
+            SetTexcoord(vertex, source.texcoords[i]);
+        }
+        mesh.SetIndexes(source.indexes);
+
+        if (optimize) {
+            VertexCacheStatistics before, after;
+            MeshOptimizer::Optimize(mesh, before, after);
+            std::cout << "Vertex cache: ACMR = " << before.acmr << " -> " << after.acmr << ", ATVR = " << before.atvr << " -> " << after.atvr << std::endl;
+        }
+        std::vector<MeshFileLod> lods;
+        if (lodsCount > 1) {
+            lods = MeshSimplifier::GenerateLods(mesh, lodsCount);
+            for (size_t i = 0; i < lods.size(); ++i) {
+                std::cout << "LOD " << i << ": " << lods[i].indexesCount / 3 << " triangles, error " << lods[i].error << std::endl;
+            }
+        }
+        std::cout << "Write " << output << "...";
+        uint32_t attributes = MESH_FILE_POSITION | MESH_FILE_NORMAL;
+        if (texcoord) {
+            attributes |= MESH_FILE_TEXCOORD;
+        }
+        MeshFile::Write(output, mesh, attributes, lods);
+        std::cout << "OK" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        if (argc < 3) {
+            std::cout << "Usage: MeshConverter input.obj|input.gltf|input.glb output.mesh [--texcoord] [--optimize] [--lods N] [--fit R] [--flip-winding]" << std::endl;
+            std::cout << "  --texcoord      store texture coordinates (layout of 09, 12, 14), otherwise position and normal only (07, 08, 13)" << std::endl;
+            std::cout << "  --optimize      reorder for the vertex cache, overdraw and vertex fetch" << std::endl;
+            std::cout << "  --lods N        store up to N levels of detail, each with about half of the triangles of the previous one" << std::endl;
+            std::cout << "  --fit R         center the mesh and scale it to the bounding sphere of radius R" << std::endl;
+            std::cout << "  --flip-winding  reverse the triangles winding" << std::endl;
+            return -1;
+        }
+        const std::string input = argv[1];
+        const std::string output = argv[2];
+        bool texcoord = false;
+        bool optimize = false;
+        bool flipWinding = false;
+        float fitRadius = 0.0f;
+        uint32_t lodsCount = 1;
+        for (int i = 3; i < argc; ++i) {
+            const std::string arg(argv[i]);
+            if (arg == "--texcoord") {
+                texcoord = true;
+            }
+            else if (arg == "--optimize") {
+                optimize = true;
+            }
+            else if (arg == "--flip-winding") {
+                flipWinding = true;
+            }
+            else if (arg == "--lods" && i + 1 < argc) {
+                lodsCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (arg == "--fit" && i + 1 < argc) {
+                fitRadius = std::stof(argv[++i]);
+            }
+            else {
+                throw std::runtime_error("Unknown option " + arg);
+            }
+        }
+
+        std::cout << "Import " << input << "...";
+        const auto start = std::chrono::high_resolution_clock::now();
+        const std::string ext = Extension(input);
+        SourceMesh mesh;
+        if (ext == "obj") {
+            mesh = ImportObj(input);
+        }
+        else if (ext == "gltf" || ext == "glb") {
+            mesh = ImportGltf(input);
+        }
+        else {
+            throw std::runtime_error("Unsupported format " + ext);
+        }
+        const double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "OK" << std::endl;
+        std::cout << mesh.positions.size() << " vertexes, " << mesh.indexes.size() / 3 << " triangles, parsed in " << seconds << " s" << std::endl;
+        if (mesh.indexes.empty()) {
+            throw std::runtime_error("No triangles in " + input);
+        }
+
+        if (flipWinding) {
+            for (size_t t = 0; t + 2 < mesh.indexes.size(); t += 3) {
+                std::swap(mesh.indexes[t + 1], mesh.indexes[t + 2]);
+            }
+        }
+        if (!mesh.hasNormals) {
+            std::cout << "Compute missing normals" << std::endl;
+            ComputeNormals(mesh);
+        }
+        if (texcoord && !mesh.hasTexcoords) {
+            std::cout << "Warning: no texture coordinates in " << input << ", zeros are stored" << std::endl;
+        }
+        if (fitRadius > 0.0f) {
+            Fit(mesh, fitRadius);
+        }
+
+        if (texcoord) {
+            Convert<VertexPNT>(mesh, output, texcoord, optimize, lodsCount);
+        }
+        else {
+            Convert<VertexPN>(mesh, output, texcoord, optimize, lodsCount);
+        }
+    }
+    catch (std::exception & err) {
+        std::cout << "Error!" << std::endl;
+        std::cout << err.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Vulkan samples
+// The MIT License (MIT)
+// Copyright (c) 2016 Alexey Gruzdev
+
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "vertex_packing.glsl"
+
+layout(location = 0) in vec4 inPackedPosition;
+layout(location = 1) in vec2 inPackedNormal;
+
+layout(push_constant) uniform PushConstants {
+    vec4 positionScale;
+    vec4 positionBias;
+} decode;
+
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+
+layout(location = 0) out vec4 outPosition;
+layout(location = 1) out vec4 outNormal;
+
+void main() {
+    const vec4 position = DecodePosition(inPackedPosition, decode.positionScale, decode.positionBias);
+    // w = 1 as in the unpacked sphere normals
+    outNormal = vec4(DecodeNormal(inPackedNormal), 1.0);
+    outPosition = position;
+    gl_Position = position;
+}
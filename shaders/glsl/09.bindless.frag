@@ -0,0 +1,35 @@
+// Vulkan samples
+// The MIT License (MIT)
+// Copyright (c) 2016 Alexey Gruzdev
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in  vec4 inPosition;
+layout(location = 1) in  vec4 inNormal;
+layout(location = 2) in  vec2 inTexCoord;
+
+layout(location = 0) out vec4 fragColor;
+
+// Global textures table, partially bound
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// Index of the draw texture in the table, uniform for the draw
+layout(push_constant) uniform Material {
+    uint textureIndex;
+} material;
+
+const vec3 Light0 = vec3(20.0, -100.0, 50.0); // modelview
+
+void main() {
+    const vec3 Ambient = vec3(0.3);
+    const vec3 Color   = vec3(1.0);
+
+    const vec3 lightDir = normalize(Light0 - vec3(inPosition));
+    const float diffuse = clamp(dot(lightDir, vec3(inNormal)), 0.0, 1.0);
+
+    const vec4 texColor = texture(textures[material.textureIndex], inTexCoord);
+
+    const vec3 rgb = clamp((Ambient + diffuse * Color), 0.0, 1.0) * texColor.rgb;
+    fragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,40 @@
+// Vulkan samples
+// The MIT License (MIT)
+// Copyright (c) 2016 Alexey Gruzdev
+
+#version 450
+
+layout(set = 0, binding = 0) uniform uniformBuffer {
+    mat4 modelView;
+    mat4 projection;
+} matrixes;
+
+// View space positions of the instances
+layout(std430, set = 0, binding = 2) buffer Instances {
+    restrict readonly vec4 offsets[];
+};
+
+// Instances left by 13.instances.comp
+layout(std430, set = 0, binding = 3) buffer VisibleInstances {
+    restrict readonly uint visible[];
+};
+
+layout(push_constant) uniform PushConstants {
+    uint firstVisible;  // list of the drawn level of detail
+} batch;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+
+layout(location = 2) out VertexData {
+    vec4 position;
+    vec4 normal;
+} outVertex;
+
+void main() {
+    const vec4 offset = offsets[visible[batch.firstVisible + gl_InstanceIndex]];
+    mat4 normalMatrix  = transpose(inverse(matrixes.modelView));
+    outVertex.normal   = normalize(normalMatrix * inNormal);
+    outVertex.position = matrixes.modelView * inPosition + vec4(offset.xyz, 0.0);
+    gl_Position = matrixes.projection * outVertex.position;
+}
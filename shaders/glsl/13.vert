@@ -9,6 +9,10 @@ layout(set = 0, binding = 0) uniform uniformBuffer {
     mat4 projection;
 } matrixes;
 
+layout(push_constant) uniform PushConstants {
+    vec4 offset;    // view space position of the object
+} object;
+
 layout(location = 0) in vec4 inPosition;
 layout(location = 1) in vec4 inNormal;
 
@@ -20,6 +24,6 @@ layout(location = 2) out VertexData {
 void main() {
     mat4 normalMatrix  = transpose(inverse(matrixes.modelView));
     outVertex.normal   = normalize(normalMatrix * inNormal);
-    outVertex.position = matrixes.modelView * inPosition;
+    outVertex.position = matrixes.modelView * inPosition + vec4(object.offset.xyz, 0.0);
     gl_Position = matrixes.projection * outVertex.position;
 }
@@ -0,0 +1,22 @@
+// Vulkan samples
+// The MIT License (MIT)
+// Copyright (c) 2016 Alexey Gruzdev
+
+// Decoding of the packed vertex attributes, see Common/VertexPacking.h
+// Attribute formats already convert unorm16, snorm16 and half to float
+
+// Position quantized against the mesh bounding box, positionScale.w = 0 and positionBias.w = 1
+vec4 DecodePosition(vec4 packedPosition, vec4 positionScale, vec4 positionBias)
+{
+    return positionBias + positionScale * vec4(packedPosition.xyz, 0.0);
+}
+
+// Octahedral normal in [-1, 1]^2
+vec3 DecodeNormal(vec2 packedNormal)
+{
+    vec3 n = vec3(packedNormal, 1.0 - abs(packedNormal.x) - abs(packedNormal.y));
+    const float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}